@@ -24,104 +24,259 @@
 #include "WaveBackend.h"
 #include "WaveControlCompanyIDList.h"
 
-#define WAVECONTROL_BACKEND_SIMPLEBLE 1
+#ifndef WAVECONTROL_BACKEND_SIMPLEBLE
+	#define WAVECONTROL_BACKEND_SIMPLEBLE 1
+#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 
 #if WAVECONTROL_BACKEND_SIMPLEBLE
 	#include <simpleble/SimpleBLE.h>
-#else
-	#error "Unknown backend."
 #endif // WAVECONTROL_BACKEND_SIMPLEBLE
 
+// -----------------------------------------------------------  WavePeripheral ---------------------------------------------
+
+void WavePeripheral_OnConnectionChanged( WavePeripheral& Peripheral, bool Connected )
+{
+	// Backends may report the same change twice (eg. our own Disconnect() and then the link callback).
+	if ( !Peripheral.Capture.get() || Peripheral.CaptureConnectedState.exchange( ( int ) Connected ) == ( int ) Connected )
+		return;
+
+	auto Channel = WaveBackendCapture_GetChannel( *Peripheral.Capture, Peripheral, "", "" );
+	WaveBackendCapture_Record( *Peripheral.Capture, Connected ? WAVECONTROL_CAPTURE_RECORD_CONNECT : WAVECONTROL_CAPTURE_RECORD_DISCONNECT, Channel, std::string() );
+}
+
+static WaveNotifyCallback WavePeripheral_CaptureCallback( WavePeripheral& Peripheral, int Type, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
+{
+	if ( !Peripheral.Capture.get() )
+		return Callback;
+
+	auto Capture = Peripheral.Capture;
+	auto Channel = WaveBackendCapture_GetChannel( *Capture, Peripheral, Service, Characteristic );
+	return [Capture, Type, Channel, Callback]( std::string_view Payload )
+	{
+		WaveBackendCapture_Record( *Capture, Type, Channel, Payload );
+		Callback( Payload );
+	};
+}
+
+bool WavePeripheral_IsConnected( WavePeripheral& Peripheral )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return false;
+	return Peripheral.Interface->IsConnected( Peripheral );
+}
+
+bool WavePeripheral_IsConnectable( WavePeripheral& Peripheral )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return false;
+	return Peripheral.Interface->IsConnectable( Peripheral );
+}
+
+void WavePeripheral_Connect( WavePeripheral& Peripheral )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	Peripheral.Interface->Connect( Peripheral );
+}
+
+void WavePeripheral_Disconnect( WavePeripheral& Peripheral )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	Peripheral.Interface->Disconnect( Peripheral );
+}
+
+bool WavePeripheral_HasService( WavePeripheral& Peripheral, std::string Service )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return false;
+	return Peripheral.Interface->HasService( Peripheral, Service );
+}
+
+bool WavePeripheral_HasCharacteristic( WavePeripheral& Peripheral, std::string Service, std::string Characteristic )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return false;
+	return Peripheral.Interface->HasCharacteristic( Peripheral, Service, Characteristic );
+}
+
+void WavePeripheral_Notify( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, WaveNotifyCallback Callback )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	Peripheral.Interface->Notify( Peripheral, Service, Characteristic, WavePeripheral_CaptureCallback( Peripheral, WAVECONTROL_CAPTURE_RECORD_NOTIFY, Service, Characteristic, Callback ) );
+}
+
+void WavePeripheral_Indicate( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, WaveNotifyCallback Callback )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	Peripheral.Interface->Indicate( Peripheral, Service, Characteristic, WavePeripheral_CaptureCallback( Peripheral, WAVECONTROL_CAPTURE_RECORD_INDICATE, Service, Characteristic, Callback ) );
+}
+
+void WavePeripheral_WriteCommand( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::string Payload )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	if ( Peripheral.Capture.get() ) {
+		auto Channel = WaveBackendCapture_GetChannel( *Peripheral.Capture, Peripheral, Service, Characteristic );
+		WaveBackendCapture_Record( *Peripheral.Capture, WAVECONTROL_CAPTURE_RECORD_WRITECOMMAND, Channel, Payload );
+	}
+	Peripheral.Interface->WriteCommand( Peripheral, Service, Characteristic, Payload );
+}
+
+void WavePeripheral_WriteRequest( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::string Payload )
+{
+	if ( !Peripheral.Handle.get() || !Peripheral.Interface )
+		return;
+	if ( Peripheral.Capture.get() ) {
+		auto Channel = WaveBackendCapture_GetChannel( *Peripheral.Capture, Peripheral, Service, Characteristic );
+		WaveBackendCapture_Record( *Peripheral.Capture, WAVECONTROL_CAPTURE_RECORD_WRITEREQUEST, Channel, Payload );
+	}
+	Peripheral.Interface->WriteRequest( Peripheral, Service, Characteristic, Payload );
+}
+
+// -----------------------------------------------------------  WaveBackend ---------------------------------------------
+
+const WaveBackendInterface* WaveBackend_GetInterface( int BackendType )
+{
+	switch ( BackendType )
+	{
+		case WAVECONTROL_BACKEND_TYPE_SIMPLEBLE:
+			return WaveBackendSimpleBLE_GetInterface();
+		case WAVECONTROL_BACKEND_TYPE_SYNTHETIC:
+			return WaveBackendSynthetic_GetInterface();
+		case WAVECONTROL_BACKEND_TYPE_REPLAY:
+			return WaveBackendReplay_GetInterface();
+		default:
+			assert( !"Not implemented." );
+			return nullptr;
+	}
+}
+
+void WaveBackend_Init( WaveBluetoothBackend& Backend, int AdapterIndex )
+{
+	Backend.Interface = WaveBackend_GetInterface( Backend.Options.BackendType );
+	if ( !Backend.Interface ) {
+		WAVECONTROL_LOG( "WaveBackend_Init: Backend type %d is not available in this build!\n", Backend.Options.BackendType );
+		return;
+	}
+	WAVECONTROL_LOG( "WaveBackend_Init: Using %s backend.\n", Backend.Interface->Name );
+
+	if ( Backend.Options.CaptureFile.length() ) {
+		Backend.Capture = WaveBackendCapture_Open( Backend.Options.CaptureFile );
+	}
+	Backend.Interface->Init( Backend, AdapterIndex );
+}
+
+void WaveBackend_Shutdown( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Interface )
+		return;
+	Backend.Interface->Shutdown( Backend );
+
+	if ( Backend.Capture.get() ) {
+		WaveBackendCapture_Close( *Backend.Capture );
+		Backend.Capture = nullptr;
+	}
+}
+
+void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Interface )
+		return;
+	Backend.Interface->ScanStart( Backend );
+}
+
+void WaveBackend_ScanStop( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Interface )
+		return;
+	Backend.Interface->ScanStop( Backend );
+}
+
+void WaveBackend_GetStats( WaveBluetoothBackend& Backend, WaveBackendStats& Stats )
+{
+	Stats = WaveBackendStats();
+	if ( !Backend.Interface )
+		return;
+
+	if ( Backend.Interface->GetStats ) {
+		Backend.Interface->GetStats( Backend, Stats );
+		return;
+	}
+
+	Backend.ScannedPeripheralsMutex.lock();
+	Stats.NumPeripherals = Backend.ScannedPeripherals.size();
+	Backend.ScannedPeripheralsMutex.unlock();
+}
+
+// -----------------------------------------------------------  WaveBackendSimpleBLE ---------------------------------------------
+
 #if WAVECONTROL_BACKEND_SIMPLEBLE
 
-struct Wave_PeripheralHandle
+struct WaveSimpleBLE_PeripheralHandle : public Wave_PeripheralHandle
 {
 	SimpleBLE::Peripheral Internal;
 };
 
-struct Wave_AdapterHandle
+struct WaveSimpleBLE_AdapterHandle : public Wave_AdapterHandle
 {
 	SimpleBLE::Adapter Internal;
 };
 
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
-
 static std::map< int, std::string > s_WaveDevice_BluetoothCompanyIDs;
 
-bool WavePeripheral_IsConnected( WavePeripheral& Peripheral )
+static SimpleBLE::Peripheral* WaveSimpleBLE_GetInternal( WavePeripheral& Peripheral )
 {
-	if ( !Peripheral.Handle.get() )
-		return false;
+	return &static_cast< WaveSimpleBLE_PeripheralHandle* >( Peripheral.Handle.get() )->Internal;
+}
 
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+static bool WaveSimpleBLE_IsConnected( WavePeripheral& Peripheral )
+{
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	return PeripheralInteral->is_connected();
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-bool WavePeripheral_IsConnectable( WavePeripheral& Peripheral )
+static bool WaveSimpleBLE_IsConnectable( WavePeripheral& Peripheral )
 {
-	if ( !Peripheral.Handle.get() )
-		return false;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	return PeripheralInteral->is_connectable();
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WavePeripheral_Connect( WavePeripheral& Peripheral )
+static void WaveSimpleBLE_Connect( WavePeripheral& Peripheral )
 {
-	if ( !Peripheral.Handle.get() )
-		return;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	try {
 		PeripheralInteral->connect();
 	} catch( ... ) {
 		WAVECONTROL_LOG( "WavePeripheral_Connect: Call failed!\n");
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WavePeripheral_Disconnect( WavePeripheral& Peripheral )
+static void WaveSimpleBLE_Disconnect( WavePeripheral& Peripheral )
 {
-	if ( !Peripheral.Handle.get() )
-		return;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	try {
 		PeripheralInteral->disconnect();
 	} catch( ... ) {
 		WAVECONTROL_LOG( "WavePeripheral_Disconnect: Call failed!\n");
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-bool WavePeripheral_HasService( WavePeripheral& Peripheral, std::string Service )
+static bool WaveSimpleBLE_HasService( WavePeripheral& Peripheral, const std::string& Service )
 {
-	if ( !Peripheral.Handle.get() )
-		return false;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	for ( auto& PeripheralService : PeripheralInteral->services() ) {
 		if ( PeripheralService.uuid == Service )
 			return true;
 	}
 	return false;
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-bool WavePeripheral_HasCharacteristic( WavePeripheral& Peripheral, std::string Service, std::string Characteristic )
+static bool WaveSimpleBLE_HasCharacteristic( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic )
 {
-	if ( !Peripheral.Handle.get() )
-		return false;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+	SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 	for ( auto& PeripheralService : PeripheralInteral->services() ) {
 		if ( PeripheralService.uuid == Service ) {
 			for ( auto& PeripheralCharacteristic : PeripheralService.characteristics ) {
@@ -131,78 +286,69 @@ bool WavePeripheral_HasCharacteristic( WavePeripheral& Peripheral, std::string S
 		}
 	}
 	return false;
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WavePeripheral_Notify( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::function< void( std::string payload ) > Callback )
+static void WaveSimpleBLE_Notify( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
 {
-	if ( !Peripheral.Handle.get() )
-		return;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
 	try {
-		SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
-		PeripheralInteral->notify( Service, Characteristic, Callback );
+		SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
+		PeripheralInteral->notify( Service, Characteristic, [Callback]( SimpleBLE::ByteArray Payload ) { Callback( Payload ); } );
 	} catch( ... ) {
 		// WAVECONTROL_LOG( "WavePeripheral_Notify: Call failed!\n");
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WavePeripheral_Indicate( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::function< void( std::string payload ) > Callback )
+static void WaveSimpleBLE_Indicate( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
 {
-	if ( !Peripheral.Handle.get() )
-		return;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
 	try {
-		SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
-		PeripheralInteral->indicate( Service, Characteristic, Callback );
+		SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
+		PeripheralInteral->indicate( Service, Characteristic, [Callback]( SimpleBLE::ByteArray Payload ) { Callback( Payload ); } );
 	} catch( ... ) {
 		// WAVECONTROL_LOG( "WavePeripheral_Notify: Call failed!\n");
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WavePeripheral_WriteCommand( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::string Payload )
+static void WaveSimpleBLE_WriteCommand( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload )
 {
-	if ( !Peripheral.Handle.get() )
-		return;
-
-#if WAVECONTROL_BACKEND_SIMPLEBLE
 	try {
-		SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.Handle->Internal;
+		SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
 		PeripheralInteral->write_command( Service, Characteristic, Payload );
 	} catch( ... ) {
 		// WAVECONTROL_LOG( "WavePeripheral_WriteCommand: Call failed!\n");
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
+static void WaveSimpleBLE_WriteRequest( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload )
+{
+	try {
+		SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( Peripheral );
+		PeripheralInteral->write_request( Service, Characteristic, Payload );
+	} catch( ... ) {
+		// WAVECONTROL_LOG( "WavePeripheral_WriteRequest: Call failed!\n");
+	}
+}
 
-// -----------------------------------------------------------  WaveBackend ---------------------------------------------
-
-void WaveBackend_Init( WaveBluetoothBackend& Backend, int AdapterIndex )
+static void WaveSimpleBLE_Init( WaveBluetoothBackend& Backend, int AdapterIndex )
 {
 	// Initialise adapters.
-#if WAVECONTROL_BACKEND_SIMPLEBLE
 	auto AdapterList = SimpleBLE::Adapter::get_adapters();
 	if ( !AdapterList.size() ) {
 		WAVECONTROL_LOG( "WaveBackend_Init: Failed to find any Bluetooth adapters. Does your computer support Bluetooth?\n" );
 		return;
 	}
 	assert( AdapterIndex < AdapterList.size() );
-	Backend.Adapter = std::make_shared< Wave_AdapterHandle >();
-	Backend.Adapter->Internal = AdapterList[ AdapterIndex ];
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
+	auto Adapter = std::make_shared< WaveSimpleBLE_AdapterHandle >();
+	Adapter->Internal = AdapterList[ AdapterIndex ];
+	Backend.Adapter = Adapter;
 }
 
-void WaveBackend_Shutdown( WaveBluetoothBackend& Backend )
+static void WaveSimpleBLE_Shutdown( WaveBluetoothBackend& Backend )
 {
-#if WAVECONTROL_BACKEND_SIMPLEBLE
 	Backend.ScannedPeripheralsMutex.lock();
 	for( auto& Peripheral : Backend.ScannedPeripherals ) {
-		SimpleBLE::Peripheral* PeripheralInteral = &Peripheral.second->Handle->Internal;
+		if ( !Peripheral.second->Handle.get() )
+			continue;
+		SimpleBLE::Peripheral* PeripheralInteral = WaveSimpleBLE_GetInternal( *Peripheral.second );
 		if ( PeripheralInteral && PeripheralInteral->is_connected() ) {
 			WAVECONTROL_LOG( "Disconnecting from %s ...\n", Peripheral.second->UIName.c_str());
 			try {
@@ -211,10 +357,9 @@ void WaveBackend_Shutdown( WaveBluetoothBackend& Backend )
 		}
 	}
 	Backend.ScannedPeripheralsMutex.unlock();
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
+static void WaveSimpleBLE_ScanStart( WaveBluetoothBackend& Backend )
 {
 	if ( !Backend.Adapter.get() )
 		return;
@@ -224,8 +369,7 @@ void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
 		assert( s_WaveDevice_BluetoothCompanyIDs.size() > 0 );
 	}
 
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Adapter* AdapterInternal = &Backend.Adapter->Internal;
+	SimpleBLE::Adapter* AdapterInternal = &static_cast< WaveSimpleBLE_AdapterHandle* >( Backend.Adapter.get() )->Internal;
 	AdapterInternal->set_callback_on_scan_found(
 		[&]( SimpleBLE::Peripheral PeripheralData )
 		{
@@ -233,8 +377,11 @@ void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
 				return;
 
 			auto Peripheral = std::make_shared< WavePeripheral >();
-			Peripheral->Handle = std::make_shared< Wave_PeripheralHandle >();
-			Peripheral->Handle->Internal = PeripheralData;
+			auto Handle = std::make_shared< WaveSimpleBLE_PeripheralHandle >();
+			Handle->Internal = PeripheralData;
+			Peripheral->Handle = Handle;
+			Peripheral->Interface = Backend.Interface;
+			Peripheral->Capture = Backend.Capture;
 			Peripheral->UIName = PeripheralData.identifier();
 			Peripheral->UIAddress = PeripheralData.address().c_str();
 
@@ -265,6 +412,23 @@ void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
 			Backend.ScannedPeripheralsMutex.lock();
 			if ( Backend.ScannedPeripherals.find( Peripheral->UIAddress ) == Backend.ScannedPeripherals.end() ) {
 				Backend.ScannedPeripherals[ Peripheral->UIAddress ] = Peripheral;
+
+				// Links also drop and come back on their own, so listen rather than poll.
+				std::weak_ptr< WavePeripheral > WeakPeripheral = Peripheral;
+				Handle->Internal.set_callback_on_connected(
+					[WeakPeripheral]()
+					{
+						if ( auto Locked = WeakPeripheral.lock() )
+							WavePeripheral_OnConnectionChanged( *Locked, true );
+					}
+				);
+				Handle->Internal.set_callback_on_disconnected(
+					[WeakPeripheral]()
+					{
+						if ( auto Locked = WeakPeripheral.lock() )
+							WavePeripheral_OnConnectionChanged( *Locked, false );
+					}
+				);
 			}
 			Backend.ScannedPeripheralsMutex.unlock();
 		}
@@ -274,20 +438,51 @@ void WaveBackend_ScanStart( WaveBluetoothBackend& Backend )
 	} catch ( ... ) {
 		WAVECONTROL_LOG( "WaveBackend_ScanStart: Call failed. Is the Bluetooth adapter enabled?\n" );
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
 
-void WaveBackend_ScanStop( WaveBluetoothBackend& Backend )
+static void WaveSimpleBLE_ScanStop( WaveBluetoothBackend& Backend )
 {
 	if ( !Backend.Adapter.get() )
 		return;
 
-#if WAVECONTROL_BACKEND_SIMPLEBLE
-	SimpleBLE::Adapter* AdapterInternal = &Backend.Adapter->Internal;
+	SimpleBLE::Adapter* AdapterInternal = &static_cast< WaveSimpleBLE_AdapterHandle* >( Backend.Adapter.get() )->Internal;
 	try {
 		AdapterInternal->scan_stop();
 	} catch ( ... ) {
 		WAVECONTROL_LOG( "WaveBackend_ScanStop: Call failed. Is the Bluetooth adapter enabled?\n" );
 	}
-#endif // WAVECONTROL_BACKEND_SIMPLEBLE
 }
+
+static const WaveBackendInterface s_WaveBackend_SimpleBLEInterface =
+{
+	"SimpleBLE",
+	WaveSimpleBLE_IsConnected,
+	WaveSimpleBLE_IsConnectable,
+	WaveSimpleBLE_Connect,
+	WaveSimpleBLE_Disconnect,
+	WaveSimpleBLE_HasService,
+	WaveSimpleBLE_HasCharacteristic,
+	WaveSimpleBLE_Notify,
+	WaveSimpleBLE_Indicate,
+	WaveSimpleBLE_WriteCommand,
+	WaveSimpleBLE_WriteRequest,
+	WaveSimpleBLE_Init,
+	WaveSimpleBLE_Shutdown,
+	WaveSimpleBLE_ScanStart,
+	WaveSimpleBLE_ScanStop,
+	nullptr
+};
+
+const WaveBackendInterface* WaveBackendSimpleBLE_GetInterface()
+{
+	return &s_WaveBackend_SimpleBLEInterface;
+}
+
+#else
+
+const WaveBackendInterface* WaveBackendSimpleBLE_GetInterface()
+{
+	return nullptr;
+}
+
+#endif // WAVECONTROL_BACKEND_SIMPLEBLE
@@ -22,13 +22,89 @@
 #include <cstdint>
 #include <vector>
 #include <string> 
+#include <string_view>
 #include <map> 
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
 
 // Default to first found BLE adapter.
 #define WAVECONTROL_BACKEND_DEFAULT_ADAPTER_INDEX 0
 
-struct Wave_PeripheralHandle;
-struct Wave_AdapterHandle;
+// Runtime selectable backends.
+#define WAVECONTROL_BACKEND_TYPE_SIMPLEBLE 0
+#define WAVECONTROL_BACKEND_TYPE_SYNTHETIC 1
+#define WAVECONTROL_BACKEND_TYPE_REPLAY 2
+#define WAVECONTROL_BACKEND_TYPE_NUM 3
+
+// Record types in a capture file.
+#define WAVECONTROL_CAPTURE_RECORD_NOTIFY 0
+#define WAVECONTROL_CAPTURE_RECORD_INDICATE 1
+#define WAVECONTROL_CAPTURE_RECORD_WRITECOMMAND 2
+#define WAVECONTROL_CAPTURE_RECORD_CONNECT 3
+#define WAVECONTROL_CAPTURE_RECORD_DISCONNECT 4
+#define WAVECONTROL_CAPTURE_RECORD_DEFINE_PERIPHERAL 5
+#define WAVECONTROL_CAPTURE_RECORD_DEFINE_CHARACTERISTIC 6
+#define WAVECONTROL_CAPTURE_RECORD_WRITEREQUEST 7
+
+// Backend specific data. Each backend derives its own handle types from these.
+struct Wave_PeripheralHandle
+{
+	virtual ~Wave_PeripheralHandle() {}
+};
+
+struct Wave_AdapterHandle
+{
+	virtual ~Wave_AdapterHandle() {}
+};
+
+// Notification payloads are handed to subscribers as a view of the backend's own buffer, so the hot path never copies.
+// The view is only valid for the duration of the call.
+typedef std::function< void( std::string_view Payload ) > WaveNotifyCallback;
+
+struct WavePeripheral;
+struct WaveBluetoothBackend;
+struct WaveBackendStats;
+struct WaveBackendCapture;
+
+// Function table for a backend. All WavePeripheral_* and WaveBackend_* calls go through one of these.
+struct WaveBackendInterface
+{
+	const char* Name;
+
+	bool ( *IsConnected ) ( WavePeripheral& Peripheral );
+
+	bool ( *IsConnectable ) ( WavePeripheral& Peripheral );
+
+	void ( *Connect ) ( WavePeripheral& Peripheral );
+
+	void ( *Disconnect ) ( WavePeripheral& Peripheral );
+
+	bool ( *HasService ) ( WavePeripheral& Peripheral, const std::string& Service );
+
+	bool ( *HasCharacteristic ) ( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic );
+
+	void ( *Notify ) ( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback );
+
+	void ( *Indicate ) ( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback );
+
+	void ( *WriteCommand ) ( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload );
+
+	// Write with response. Control points like FTMS reject write without response.
+	void ( *WriteRequest ) ( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload );
+
+	void ( *Init ) ( WaveBluetoothBackend& Backend, int AdapterIndex );
+
+	void ( *Shutdown ) ( WaveBluetoothBackend& Backend );
+
+	void ( *ScanStart ) ( WaveBluetoothBackend& Backend );
+
+	void ( *ScanStop ) ( WaveBluetoothBackend& Backend );
+
+	// Optional, may be nullptr.
+	void ( *GetStats ) ( WaveBluetoothBackend& Backend, WaveBackendStats& Stats );
+};
 
 struct WavePeripheral
 {
@@ -36,12 +112,20 @@ struct WavePeripheral
 	std::string UIAddress;
 
 	std::shared_ptr< Wave_PeripheralHandle > Handle;
+	const WaveBackendInterface* Interface = nullptr;
 	std::vector< std::string > Services;
 
 	int64_t RefCount = 0;
 	std::map< std::string, bool> ServicesConnected;
+
+	// Set by the backend when traffic capture is enabled.
+	std::shared_ptr< WaveBackendCapture > Capture;
+	std::atomic< int > CaptureConnectedState = -1;
 };
 
+// Backends call this whenever a link comes up or goes down, whether we asked for it or not.
+void WavePeripheral_OnConnectionChanged( WavePeripheral& Peripheral, bool Connected );
+
 bool WavePeripheral_IsConnected( WavePeripheral& Peripheral );
 
 bool WavePeripheral_IsConnectable( WavePeripheral& Peripheral );
@@ -54,19 +138,65 @@ bool WavePeripheral_HasService( WavePeripheral& Peripheral, std::string Service
 
 bool WavePeripheral_HasCharacteristic( WavePeripheral& Peripheral, std::string Service, std::string Characteristic );
 
-void WavePeripheral_Notify( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::function< void( std::string payload ) > Callback );
+void WavePeripheral_Notify( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, WaveNotifyCallback Callback );
 
-void WavePeripheral_Indicate( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::function< void( std::string payload ) > Callback );
+void WavePeripheral_Indicate( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, WaveNotifyCallback Callback );
 
 void WavePeripheral_WriteCommand( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::string Payload );
 
+void WavePeripheral_WriteRequest( WavePeripheral& Peripheral, std::string Service, std::string Characteristic, std::string Payload );
+
+// Fake fleet of sensors for WAVECONTROL_BACKEND_TYPE_SYNTHETIC. Used for load testing without a radio.
+struct WaveSyntheticFleetOptions
+{
+	int NumHR = 4;
+	int NumCSC = 4;
+	int NumPower = 4;
+	int NumTrainer = 4;
+	int NumFTMSTrainer = 0; // FTMS only, no Wahoo extension.
+	float NotifyRateHz = 4.0f; // Per subscribed characteristic.
+	float NotifyJitterMS = 10.0f; // Uniform +/- jitter on each notification.
+	uint32_t Seed = 0x5eed;
+};
+
+struct WaveBackendOptions
+{
+	int BackendType = WAVECONTROL_BACKEND_TYPE_SIMPLEBLE;
+	int AdapterIndex = WAVECONTROL_BACKEND_DEFAULT_ADAPTER_INDEX;
+	WaveSyntheticFleetOptions SyntheticFleet;
+
+	// When set, all BLE traffic is written to this file for later replay.
+	std::string CaptureFile;
+
+	// Source file for WAVECONTROL_BACKEND_TYPE_REPLAY. Speed 1.0 = realtime, 0.0 = as fast as possible.
+	std::string ReplayFile;
+	float ReplaySpeed = 1.0f;
+};
+
+struct WaveBackendStats
+{
+	uint64_t NumPeripherals = 0;
+	uint64_t NumSubscriptions = 0;
+	uint64_t NotificationsSent = 0;
+	uint64_t NotificationBytesSent = 0;
+	uint64_t CommandsReceived = 0;
+	uint64_t NotificationsDropped = 0;
+};
+
 struct WaveBluetoothBackend
 {
+	WaveBackendOptions Options;
+	const WaveBackendInterface* Interface = nullptr;
+
 	std::shared_ptr< Wave_AdapterHandle > Adapter;
+	std::shared_ptr< WaveBackendCapture > Capture;
 	std::map< std::string, std::shared_ptr< WavePeripheral > > ScannedPeripherals;
 	std::mutex ScannedPeripheralsMutex;
 };
 
+// Returns nullptr if the backend wasn't compiled in.
+const WaveBackendInterface* WaveBackend_GetInterface( int BackendType );
+
 void WaveBackend_Init( WaveBluetoothBackend& Backend, int AdapterIndex = WAVECONTROL_BACKEND_DEFAULT_ADAPTER_INDEX );
 
 void WaveBackend_Shutdown( WaveBluetoothBackend& Backend );
@@ -75,5 +205,24 @@ void WaveBackend_ScanStart( WaveBluetoothBackend& Backend );
 
 void WaveBackend_ScanStop( WaveBluetoothBackend& Backend );
 
+void WaveBackend_GetStats( WaveBluetoothBackend& Backend, WaveBackendStats& Stats );
+
+// ------------------------------------------------ Backend implementations -------------------------------------------------
+
+const WaveBackendInterface* WaveBackendSimpleBLE_GetInterface();
+
+const WaveBackendInterface* WaveBackendSynthetic_GetInterface();
+
+const WaveBackendInterface* WaveBackendReplay_GetInterface();
+
+// ------------------------------------------------ Traffic capture -------------------------------------------------
+
+std::shared_ptr< WaveBackendCapture > WaveBackendCapture_Open( const std::string& FileName );
+
+void WaveBackendCapture_Close( WaveBackendCapture& Capture );
+
+// Returns a channel ID for the given peripheral + characteristic, defining it in the capture file if needed.
+uint32_t WaveBackendCapture_GetChannel( WaveBackendCapture& Capture, WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic );
 
+void WaveBackendCapture_Record( WaveBackendCapture& Capture, int Type, uint32_t Channel, std::string_view Payload );
 
@@ -0,0 +1,606 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <condition_variable>
+
+#include "WaveDevice.h"
+#include "WaveControl.h"
+#include "WaveBackend.h"
+
+// Capture writes every notification, indication, write command and connection change into a compact binary log.
+// The replay backend plays such a log back in place of the radio, either in realtime or as fast as possible.
+//
+// File layout, all integers little endian:
+//     "WAVECAP" u8 Version
+//     DEFINE_PERIPHERAL:     u8 Type, u16 ID, u16 Len, Address, u16 Len, Name
+//     DEFINE_CHARACTERISTIC: u8 Type, u16 ID, u16 Len, Service, u16 Len, Characteristic
+//     Everything else:       u8 Type, u64 TimeNS, u16 PeripheralID, u16 CharacteristicID, u16 Len, Payload
+//
+
+#define WAVECONTROL_CAPTURE_MAGIC "WAVECAP"
+#define WAVECONTROL_CAPTURE_VERSION 1
+#define WAVECONTROL_CAPTURE_NO_CHARACTERISTIC 0xffff
+
+struct WaveBackendCapture
+{
+	std::mutex Mutex;
+	std::ofstream FileStream;
+	std::chrono::steady_clock::time_point StartTime;
+	std::map< std::string, uint16_t > PeripheralIDs;
+	std::map< std::string, uint16_t > CharacteristicIDs;
+	uint64_t NumRecords = 0;
+};
+
+static void WaveCapture_PutU16( std::string& Bytes, uint16_t Value )
+{
+	Bytes.push_back( ( char ) ( Value & 0xff ) );
+	Bytes.push_back( ( char ) ( Value >> 8 ) );
+}
+
+static void WaveCapture_PutU64( std::string& Bytes, uint64_t Value )
+{
+	for ( int i = 0; i < 8; i++ ) {
+		Bytes.push_back( ( char ) ( ( Value >> ( i * 8 ) ) & 0xff ) );
+	}
+}
+
+static void WaveCapture_PutString( std::string& Bytes, const std::string& Value )
+{
+	assert( Value.size() < 0xffff );
+	WaveCapture_PutU16( Bytes, ( uint16_t ) Value.size() );
+	Bytes += Value;
+}
+
+std::shared_ptr< WaveBackendCapture > WaveBackendCapture_Open( const std::string& FileName )
+{
+	auto Capture = std::make_shared< WaveBackendCapture >();
+	Capture->FileStream.open( FileName, std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( !Capture->FileStream.is_open() ) {
+		WAVECONTROL_LOG( "ERROR: Failed to open capture file %s!\n", FileName.c_str() );
+		return nullptr;
+	}
+
+	Capture->FileStream.write( WAVECONTROL_CAPTURE_MAGIC, 7 );
+	Capture->FileStream.put( ( char ) WAVECONTROL_CAPTURE_VERSION );
+	Capture->StartTime = std::chrono::steady_clock::now();
+	WAVECONTROL_LOG( "Capturing BLE traffic to %s\n", FileName.c_str() );
+	return Capture;
+}
+
+void WaveBackendCapture_Close( WaveBackendCapture& Capture )
+{
+	std::lock_guard< std::mutex > CaptureLock( Capture.Mutex );
+	if ( Capture.FileStream.is_open() ) {
+		WAVECONTROL_LOG( "Capture finished, %d records.\n", ( int ) Capture.NumRecords );
+		Capture.FileStream.close();
+	}
+}
+
+uint32_t WaveBackendCapture_GetChannel( WaveBackendCapture& Capture, WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic )
+{
+	std::lock_guard< std::mutex > CaptureLock( Capture.Mutex );
+	if ( !Capture.FileStream.is_open() )
+		return 0;
+
+	uint16_t PeripheralID = 0;
+	auto PeripheralItr = Capture.PeripheralIDs.find( Peripheral.UIAddress );
+	if ( PeripheralItr == Capture.PeripheralIDs.end() ) {
+		PeripheralID = ( uint16_t ) Capture.PeripheralIDs.size();
+		Capture.PeripheralIDs[ Peripheral.UIAddress ] = PeripheralID;
+
+		std::string Bytes;
+		Bytes.push_back( ( char ) WAVECONTROL_CAPTURE_RECORD_DEFINE_PERIPHERAL );
+		WaveCapture_PutU16( Bytes, PeripheralID );
+		WaveCapture_PutString( Bytes, Peripheral.UIAddress );
+		WaveCapture_PutString( Bytes, Peripheral.UIName );
+		Capture.FileStream.write( Bytes.data(), Bytes.size() );
+	} else {
+		PeripheralID = PeripheralItr->second;
+	}
+
+	uint16_t CharacteristicID = WAVECONTROL_CAPTURE_NO_CHARACTERISTIC;
+	if ( Characteristic.length() ) {
+		auto CharacteristicKey = Service + " " + Characteristic;
+		auto CharacteristicItr = Capture.CharacteristicIDs.find( CharacteristicKey );
+		if ( CharacteristicItr == Capture.CharacteristicIDs.end() ) {
+			CharacteristicID = ( uint16_t ) Capture.CharacteristicIDs.size();
+			Capture.CharacteristicIDs[ CharacteristicKey ] = CharacteristicID;
+
+			std::string Bytes;
+			Bytes.push_back( ( char ) WAVECONTROL_CAPTURE_RECORD_DEFINE_CHARACTERISTIC );
+			WaveCapture_PutU16( Bytes, CharacteristicID );
+			WaveCapture_PutString( Bytes, Service );
+			WaveCapture_PutString( Bytes, Characteristic );
+			Capture.FileStream.write( Bytes.data(), Bytes.size() );
+		} else {
+			CharacteristicID = CharacteristicItr->second;
+		}
+	}
+
+	return ( ( uint32_t ) PeripheralID << 16 ) | CharacteristicID;
+}
+
+void WaveBackendCapture_Record( WaveBackendCapture& Capture, int Type, uint32_t Channel, std::string_view Payload )
+{
+	// Stamp under the lock so records from different threads land in the file in time order.
+	std::lock_guard< std::mutex > CaptureLock( Capture.Mutex );
+	if ( !Capture.FileStream.is_open() )
+		return;
+	uint64_t TimeNS = std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - Capture.StartTime ).count();
+
+	char Bytes[15];
+	Bytes[0] = ( char ) Type;
+	for ( int i = 0; i < 8; i++ ) {
+		Bytes[1 + i] = ( char ) ( ( TimeNS >> ( i * 8 ) ) & 0xff );
+	}
+	Bytes[9] = ( char ) ( ( Channel >> 16 ) & 0xff );
+	Bytes[10] = ( char ) ( ( Channel >> 24 ) & 0xff );
+	Bytes[11] = ( char ) ( Channel & 0xff );
+	Bytes[12] = ( char ) ( ( Channel >> 8 ) & 0xff );
+	uint16_t PayloadLength = ( uint16_t ) ( Payload.size() < 0xffff ? Payload.size() : 0xffff );
+	Bytes[13] = ( char ) ( PayloadLength & 0xff );
+	Bytes[14] = ( char ) ( PayloadLength >> 8 );
+
+	Capture.FileStream.write( Bytes, sizeof( Bytes ) );
+	Capture.FileStream.write( Payload.data(), PayloadLength );
+	Capture.NumRecords++;
+
+	// Connection changes are rare and usually what we're hunting for, so make sure they hit the disk.
+	if ( Type == WAVECONTROL_CAPTURE_RECORD_CONNECT || Type == WAVECONTROL_CAPTURE_RECORD_DISCONNECT ) {
+		Capture.FileStream.flush();
+	}
+}
+
+// ------------------------------------------------ WaveBackendReplay -------------------------------------------------
+
+struct WaveReplay_Record
+{
+	uint64_t TimeNS = 0;
+	uint16_t PeripheralID = 0;
+	uint16_t CharacteristicID = 0;
+	uint8_t Type = 0;
+	std::string Payload;
+};
+
+struct WaveReplay_Subscription
+{
+	uint16_t CharacteristicID;
+	WaveNotifyCallback Callback;
+	bool Indicate = false;
+};
+
+struct WaveReplay_PeripheralHandle : public Wave_PeripheralHandle
+{
+	struct WaveReplay_AdapterHandle* Adapter = nullptr;
+	uint16_t ID = 0;
+	std::vector< uint16_t > CharacteristicIDs;
+	std::atomic< bool > Connected = false;
+	std::atomic< bool > LinkUp = true; // Follows the captured CONNECT / DISCONNECT records.
+
+	std::mutex SubscriptionsMutex;
+	std::vector< WaveReplay_Subscription > Subscriptions;
+};
+
+struct WaveReplay_AdapterHandle : public Wave_AdapterHandle
+{
+	float Speed = 1.0f;
+	std::vector< std::shared_ptr< WavePeripheral > > Peripherals;
+	std::vector< std::pair< std::string, std::string > > Characteristics;
+	std::vector< WaveReplay_Record > Records;
+
+	std::thread PlaybackThread;
+	std::mutex PlaybackMutex;
+	std::condition_variable PlaybackCondition;
+	bool PlaybackExit = false;
+	bool PlaybackStarted = false;
+
+	std::atomic< uint64_t > NumSubscriptions = 0;
+	std::atomic< uint64_t > NotificationsSent = 0;
+	std::atomic< uint64_t > NotificationBytesSent = 0;
+	std::atomic< uint64_t > NotificationsDropped = 0;
+	std::atomic< uint64_t > CommandsReceived = 0;
+
+	void StopPlayback()
+	{
+		if ( PlaybackThread.joinable() ) {
+			PlaybackMutex.lock();
+			PlaybackExit = true;
+			PlaybackMutex.unlock();
+			PlaybackCondition.notify_all();
+			PlaybackThread.join();
+		}
+	}
+
+	virtual ~WaveReplay_AdapterHandle()
+	{
+		StopPlayback();
+	}
+};
+
+static WaveReplay_PeripheralHandle* WaveReplay_GetInternal( WavePeripheral& Peripheral )
+{
+	return static_cast< WaveReplay_PeripheralHandle* >( Peripheral.Handle.get() );
+}
+
+static bool WaveReplay_LoadCapture( WaveBluetoothBackend& Backend, WaveReplay_AdapterHandle& Adapter, const std::string& FileName )
+{
+	std::ifstream FileStream( FileName, std::ios::in | std::ios::binary );
+	if ( !FileStream.is_open() ) {
+		WAVECONTROL_LOG( "ERROR: Failed to open replay file %s!\n", FileName.c_str() );
+		return false;
+	}
+	std::string Data( ( std::istreambuf_iterator< char >( FileStream ) ), std::istreambuf_iterator< char >() );
+	FileStream.close();
+
+	size_t Offset = 0;
+	bool Truncated = false;
+	auto ReadU8 = [&]() -> uint8_t
+	{
+		if ( Offset + 1 > Data.size() ) { Truncated = true; return 0; }
+		return ( uint8_t ) Data[ Offset++ ];
+	};
+	auto ReadU16 = [&]() -> uint16_t
+	{
+		uint16_t Lo = ReadU8();
+		uint16_t Hi = ReadU8();
+		return Lo | ( Hi << 8 );
+	};
+	auto ReadU64 = [&]() -> uint64_t
+	{
+		uint64_t Value = 0;
+		for ( int i = 0; i < 8; i++ ) {
+			Value |= ( ( uint64_t ) ReadU8() ) << ( i * 8 );
+		}
+		return Value;
+	};
+	auto ReadString = [&]() -> std::string
+	{
+		uint16_t Length = ReadU16();
+		if ( Truncated || Offset + Length > Data.size() ) { Truncated = true; return std::string(); }
+		Offset += Length;
+		return Data.substr( Offset - Length, Length );
+	};
+
+	if ( Data.size() < 8 || Data.compare( 0, 7, WAVECONTROL_CAPTURE_MAGIC ) != 0 || Data[7] != WAVECONTROL_CAPTURE_VERSION ) {
+		WAVECONTROL_LOG( "ERROR: %s is not a valid capture file!\n", FileName.c_str() );
+		return false;
+	}
+	Offset = 8;
+
+	while ( Offset < Data.size() && !Truncated ) {
+		uint8_t Type = ReadU8();
+		if ( Type == WAVECONTROL_CAPTURE_RECORD_DEFINE_PERIPHERAL ) {
+			uint16_t ID = ReadU16();
+			auto Address = ReadString();
+			auto Name = ReadString();
+			if ( Truncated || ID != Adapter.Peripherals.size() )
+				break;
+
+			auto Handle = std::make_shared< WaveReplay_PeripheralHandle >();
+			Handle->Adapter = &Adapter;
+			Handle->ID = ID;
+
+			auto Peripheral = std::make_shared< WavePeripheral >();
+			Peripheral->Handle = Handle;
+			Peripheral->Interface = WaveBackendReplay_GetInterface();
+			Peripheral->Capture = Backend.Capture;
+			Peripheral->UIAddress = Address;
+			Peripheral->UIName = Name;
+			Adapter.Peripherals.push_back( Peripheral );
+		} else if ( Type == WAVECONTROL_CAPTURE_RECORD_DEFINE_CHARACTERISTIC ) {
+			uint16_t ID = ReadU16();
+			auto Service = ReadString();
+			auto Characteristic = ReadString();
+			if ( Truncated || ID != Adapter.Characteristics.size() )
+				break;
+			Adapter.Characteristics.push_back( std::make_pair( Service, Characteristic ) );
+		} else {
+			WaveReplay_Record Record;
+			Record.Type = Type;
+			Record.TimeNS = ReadU64();
+			Record.PeripheralID = ReadU16();
+			Record.CharacteristicID = ReadU16();
+			Record.Payload = ReadString();
+			if ( Truncated || Record.PeripheralID >= Adapter.Peripherals.size() )
+				break;
+
+			// Work out which services each peripheral exposes from the traffic we saw.
+			if ( Record.CharacteristicID < Adapter.Characteristics.size() ) {
+				auto Handle = WaveReplay_GetInternal( *Adapter.Peripherals[ Record.PeripheralID ] );
+				auto& Peripheral = *Adapter.Peripherals[ Record.PeripheralID ];
+				if ( std::find( Handle->CharacteristicIDs.begin(), Handle->CharacteristicIDs.end(), Record.CharacteristicID ) == Handle->CharacteristicIDs.end() ) {
+					Handle->CharacteristicIDs.push_back( Record.CharacteristicID );
+					auto& Service = Adapter.Characteristics[ Record.CharacteristicID ].first;
+					if ( std::find( Peripheral.Services.begin(), Peripheral.Services.end(), Service ) == Peripheral.Services.end() ) {
+						Peripheral.Services.push_back( Service );
+					}
+				}
+			}
+			Adapter.Records.push_back( Record );
+		}
+	}
+
+	if ( Truncated ) {
+		// Captures from a crashed session are cut short; play what we have.
+		WAVECONTROL_LOG( "WARNING: Replay file %s is truncated.\n", FileName.c_str() );
+	}
+	WAVECONTROL_LOG( "Loaded replay %s: %d peripherals, %d records.\n", FileName.c_str(), ( int ) Adapter.Peripherals.size(), ( int ) Adapter.Records.size() );
+	return true;
+}
+
+static void WaveReplay_Disconnect( WavePeripheral& Peripheral );
+
+static void WaveReplay_PlayRecord( WaveReplay_AdapterHandle& Adapter, const WaveReplay_Record& Record )
+{
+	auto Handle = WaveReplay_GetInternal( *Adapter.Peripherals[ Record.PeripheralID ] );
+
+	if ( Record.Type == WAVECONTROL_CAPTURE_RECORD_DISCONNECT ) {
+		// Reproduce the link dropping. The consumer is expected to reconnect like it would in the field,
+		// which only succeeds once the link comes back at the captured CONNECT.
+		Handle->LinkUp = false;
+		WaveReplay_Disconnect( *Adapter.Peripherals[ Record.PeripheralID ] );
+		return;
+	}
+
+	if ( Record.Type == WAVECONTROL_CAPTURE_RECORD_CONNECT ) {
+		Handle->LinkUp = true;
+		return;
+	}
+
+	if ( Record.Type != WAVECONTROL_CAPTURE_RECORD_NOTIFY && Record.Type != WAVECONTROL_CAPTURE_RECORD_INDICATE )
+		return;
+
+	bool Delivered = false;
+	if ( Handle->Connected ) {
+		std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+		for ( auto& Subscription : Handle->Subscriptions ) {
+			if ( Subscription.CharacteristicID != Record.CharacteristicID || Subscription.Indicate != ( Record.Type == WAVECONTROL_CAPTURE_RECORD_INDICATE ) )
+				continue;
+			Subscription.Callback( Record.Payload );
+			Adapter.NotificationsSent++;
+			Adapter.NotificationBytesSent += Record.Payload.size();
+			Delivered = true;
+		}
+	}
+	if ( !Delivered ) {
+		Adapter.NotificationsDropped++;
+	}
+}
+
+static void WaveReplay_PlaybackThread_Entry( WaveReplay_AdapterHandle* Adapter )
+{
+	using namespace std::chrono;
+
+	// Playback clock starts on first subscription, lined up with the first captured notification.
+	{
+		std::unique_lock< std::mutex > PlaybackLock( Adapter->PlaybackMutex );
+		Adapter->PlaybackCondition.wait( PlaybackLock, [&]() { return Adapter->PlaybackExit || Adapter->PlaybackStarted; } );
+		if ( Adapter->PlaybackExit )
+			return;
+	}
+
+	uint64_t FirstTimeNS = 0;
+	for ( auto& Record : Adapter->Records ) {
+		if ( Record.Type == WAVECONTROL_CAPTURE_RECORD_NOTIFY || Record.Type == WAVECONTROL_CAPTURE_RECORD_INDICATE ) {
+			FirstTimeNS = Record.TimeNS;
+			break;
+		}
+	}
+
+	auto StartTime = steady_clock::now();
+	for ( auto& Record : Adapter->Records ) {
+		if ( Record.TimeNS < FirstTimeNS )
+			continue;
+
+		if ( Adapter->Speed > 0.0f ) {
+			auto Due = StartTime + duration_cast< steady_clock::duration >( nanoseconds( Record.TimeNS - FirstTimeNS ) / Adapter->Speed );
+			std::unique_lock< std::mutex > PlaybackLock( Adapter->PlaybackMutex );
+			Adapter->PlaybackCondition.wait_until( PlaybackLock, Due, [&]() { return Adapter->PlaybackExit; } );
+		}
+		if ( Adapter->PlaybackExit )
+			return;
+
+		WaveReplay_PlayRecord( *Adapter, Record );
+	}
+
+	WAVECONTROL_LOG( "Replay finished, %d notifications sent, %d dropped.\n", ( int ) Adapter->NotificationsSent, ( int ) Adapter->NotificationsDropped );
+}
+
+static bool WaveReplay_IsConnected( WavePeripheral& Peripheral )
+{
+	return WaveReplay_GetInternal( Peripheral )->Connected;
+}
+
+static bool WaveReplay_IsConnectable( WavePeripheral& Peripheral )
+{
+	return true;
+}
+
+static void WaveReplay_Connect( WavePeripheral& Peripheral )
+{
+	auto Handle = WaveReplay_GetInternal( Peripheral );
+	if ( !Handle->LinkUp )
+		return;
+	Handle->Connected = true;
+	WavePeripheral_OnConnectionChanged( Peripheral, true );
+}
+
+static void WaveReplay_Disconnect( WavePeripheral& Peripheral )
+{
+	auto Handle = WaveReplay_GetInternal( Peripheral );
+	Handle->Connected = false;
+	WavePeripheral_OnConnectionChanged( Peripheral, false );
+
+	std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+	Handle->Adapter->NumSubscriptions -= Handle->Subscriptions.size();
+	Handle->Subscriptions.clear();
+}
+
+static bool WaveReplay_HasService( WavePeripheral& Peripheral, const std::string& Service )
+{
+	for ( auto& PeripheralService : Peripheral.Services ) {
+		if ( PeripheralService == Service )
+			return true;
+	}
+	return false;
+}
+
+static int WaveReplay_FindCharacteristic( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic )
+{
+	auto Handle = WaveReplay_GetInternal( Peripheral );
+	for ( auto ID : Handle->CharacteristicIDs ) {
+		auto& Pair = Handle->Adapter->Characteristics[ ID ];
+		if ( Pair.first == Service && Pair.second == Characteristic )
+			return ID;
+	}
+	return -1;
+}
+
+static bool WaveReplay_HasCharacteristic( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic )
+{
+	return WaveReplay_FindCharacteristic( Peripheral, Service, Characteristic ) >= 0;
+}
+
+static void WaveReplay_Subscribe( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback, bool Indicate )
+{
+	auto Handle = WaveReplay_GetInternal( Peripheral );
+	int CharacteristicID = WaveReplay_FindCharacteristic( Peripheral, Service, Characteristic );
+	if ( !Handle->Connected || CharacteristicID < 0 )
+		return;
+
+	WaveReplay_Subscription Subscription;
+	Subscription.CharacteristicID = ( uint16_t ) CharacteristicID;
+	Subscription.Callback = Callback;
+	Subscription.Indicate = Indicate;
+
+	Handle->SubscriptionsMutex.lock();
+	Handle->Subscriptions.push_back( Subscription );
+	Handle->Adapter->NumSubscriptions++;
+	Handle->SubscriptionsMutex.unlock();
+
+	auto Adapter = Handle->Adapter;
+	Adapter->PlaybackMutex.lock();
+	Adapter->PlaybackStarted = true;
+	Adapter->PlaybackMutex.unlock();
+	Adapter->PlaybackCondition.notify_all();
+}
+
+static void WaveReplay_Notify( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
+{
+	WaveReplay_Subscribe( Peripheral, Service, Characteristic, Callback, false );
+}
+
+static void WaveReplay_Indicate( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
+{
+	WaveReplay_Subscribe( Peripheral, Service, Characteristic, Callback, true );
+}
+
+static void WaveReplay_WriteCommand( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload )
+{
+	// Responses are part of the capture, so there's nothing to do here beyond counting.
+	WaveReplay_GetInternal( Peripheral )->Adapter->CommandsReceived++;
+}
+
+static void WaveReplay_Init( WaveBluetoothBackend& Backend, int AdapterIndex )
+{
+	auto Adapter = std::make_shared< WaveReplay_AdapterHandle >();
+	Adapter->Speed = Backend.Options.ReplaySpeed;
+	if ( !WaveReplay_LoadCapture( Backend, *Adapter, Backend.Options.ReplayFile ) )
+		return;
+
+	Adapter->PlaybackThread = std::thread( WaveReplay_PlaybackThread_Entry, Adapter.get() );
+	Backend.Adapter = Adapter;
+}
+
+static void WaveReplay_Shutdown( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveReplay_AdapterHandle* >( Backend.Adapter.get() );
+	Adapter->StopPlayback();
+	for ( auto& Peripheral : Adapter->Peripherals ) {
+		WaveReplay_Disconnect( *Peripheral );
+	}
+}
+
+static void WaveReplay_ScanStart( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveReplay_AdapterHandle* >( Backend.Adapter.get() );
+	Backend.ScannedPeripheralsMutex.lock();
+	for ( auto& Peripheral : Adapter->Peripherals ) {
+		if ( Backend.ScannedPeripherals.find( Peripheral->UIAddress ) == Backend.ScannedPeripherals.end() ) {
+			Backend.ScannedPeripherals[ Peripheral->UIAddress ] = Peripheral;
+			WAVECONTROL_LOG( "    FOUND %s [%s]\n", Peripheral->UIName.c_str(), Peripheral->UIAddress.c_str() );
+		}
+	}
+	Backend.ScannedPeripheralsMutex.unlock();
+}
+
+static void WaveReplay_ScanStop( WaveBluetoothBackend& Backend )
+{
+}
+
+static void WaveReplay_GetStats( WaveBluetoothBackend& Backend, WaveBackendStats& Stats )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveReplay_AdapterHandle* >( Backend.Adapter.get() );
+	Stats.NumPeripherals = Adapter->Peripherals.size();
+	Stats.NumSubscriptions = Adapter->NumSubscriptions;
+	Stats.NotificationsSent = Adapter->NotificationsSent;
+	Stats.NotificationBytesSent = Adapter->NotificationBytesSent;
+	Stats.NotificationsDropped = Adapter->NotificationsDropped;
+	Stats.CommandsReceived = Adapter->CommandsReceived;
+}
+
+static const WaveBackendInterface s_WaveBackend_ReplayInterface =
+{
+	"Replay",
+	WaveReplay_IsConnected,
+	WaveReplay_IsConnectable,
+	WaveReplay_Connect,
+	WaveReplay_Disconnect,
+	WaveReplay_HasService,
+	WaveReplay_HasCharacteristic,
+	WaveReplay_Notify,
+	WaveReplay_Indicate,
+	WaveReplay_WriteCommand,
+	WaveReplay_WriteCommand,
+	WaveReplay_Init,
+	WaveReplay_Shutdown,
+	WaveReplay_ScanStart,
+	WaveReplay_ScanStop,
+	WaveReplay_GetStats
+};
+
+const WaveBackendInterface* WaveBackendReplay_GetInterface()
+{
+	return &s_WaveBackend_ReplayInterface;
+}
@@ -0,0 +1,579 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <cassert>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <queue>
+#include <condition_variable>
+
+#include "WaveDevice.h"
+#include "WaveControl.h"
+#include "WaveBackend.h"
+
+// Synthetic backend. Fakes a fleet of HR / CSC / Power / Trainer / FTMS Trainer peripherals that notify at a set rate with jitter,
+// so the rest of WaveControl can be load tested without any Bluetooth hardware.
+
+#define WAVESYNTHETIC_KIND_HR 0
+#define WAVESYNTHETIC_KIND_CSC 1
+#define WAVESYNTHETIC_KIND_POWER 2
+#define WAVESYNTHETIC_KIND_TRAINER 3
+#define WAVESYNTHETIC_KIND_FTMS_TRAINER 4
+#define WAVESYNTHETIC_KIND_NUM 5
+
+#define WAVESYNTHETIC_WHEEL_CIRCUMFERENCE_M 2.105f
+
+static const char* s_WaveSynthetic_HRM_ServiceUUID = "0000180d-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_HRM_CharUUID = "00002a37-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_CSC_ServiceUUID = "00001816-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_CSC_MeasurementUUID = "00002a5b-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_PS_ServiceUUID = "00001818-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_PS_MeasurementUUID = "00002a63-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_PS_WahooBrakeExtensionUUID = "a026e005-0a7d-4ab3-97fa-f1500f9feb8b";
+static const char* s_WaveSynthetic_FTMS_ServiceUUID = "00001826-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_FTMS_IndoorBikeDataUUID = "00002ad2-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_FTMS_ControlPointUUID = "00002ad9-0000-1000-8000-00805f9b34fb";
+static const char* s_WaveSynthetic_FTMS_StatusUUID = "00002ada-0000-1000-8000-00805f9b34fb";
+
+struct WaveSynthetic_Subscription
+{
+	std::string Service;
+	std::string Characteristic;
+	WaveNotifyCallback Callback;
+	bool Indicate = false;
+};
+
+struct WaveSynthetic_PeripheralHandle : public Wave_PeripheralHandle
+{
+	struct WaveSynthetic_AdapterHandle* Adapter = nullptr;
+	int Kind = WAVESYNTHETIC_KIND_HR;
+	int Index = 0;
+	std::atomic< bool > Connected = false;
+
+	std::mutex SubscriptionsMutex;
+	std::vector< WaveSynthetic_Subscription > Subscriptions;
+	std::vector< std::pair< std::string, std::string > > PendingIndications; // Characteristic, payload.
+
+	// FTMS control point state. Written from the worker thread, read by the emitter thread.
+	std::atomic< bool > FTMS_HasControl = false;
+	std::atomic< int > FTMS_TargetPower = 0;
+
+	// Simulated sensor state. Only touched by the emitter thread.
+	double WheelRevs = 0.0;
+	double CrankRevs = 0.0;
+	double LastEventSeconds = 0.0;
+};
+
+struct WaveSynthetic_ScheduleItem
+{
+	std::chrono::steady_clock::time_point Due;
+	WaveSynthetic_PeripheralHandle* Handle;
+
+	bool operator>( const WaveSynthetic_ScheduleItem& Other ) const
+	{
+		return Due > Other.Due;
+	}
+};
+
+struct WaveSynthetic_AdapterHandle : public Wave_AdapterHandle
+{
+	WaveSyntheticFleetOptions Options;
+	std::vector< std::shared_ptr< WavePeripheral > > Fleet;
+
+	std::thread EmitterThread;
+	std::mutex EmitterMutex;
+	std::condition_variable EmitterCondition;
+	bool EmitterExit = false;
+	bool EmitterHasPendingIndications = false;
+
+	std::atomic< uint64_t > NumSubscriptions = 0;
+	std::atomic< uint64_t > NotificationsSent = 0;
+	std::atomic< uint64_t > NotificationBytesSent = 0;
+	std::atomic< uint64_t > CommandsReceived = 0;
+
+	void StopEmitter()
+	{
+		if ( EmitterThread.joinable() ) {
+			EmitterMutex.lock();
+			EmitterExit = true;
+			EmitterMutex.unlock();
+			EmitterCondition.notify_all();
+			EmitterThread.join();
+		}
+	}
+
+	virtual ~WaveSynthetic_AdapterHandle()
+	{
+		StopEmitter();
+	}
+};
+
+static WaveSynthetic_PeripheralHandle* WaveSynthetic_GetInternal( WavePeripheral& Peripheral )
+{
+	return static_cast< WaveSynthetic_PeripheralHandle* >( Peripheral.Handle.get() );
+}
+
+// ------------------------------------------------ Payload generation -------------------------------------------------
+
+static void WaveSynthetic_PutU16( std::string& Bytes, uint16_t Value )
+{
+	Bytes.push_back( ( char ) ( Value & 0xff ) );
+	Bytes.push_back( ( char ) ( Value >> 8 ) );
+}
+
+static void WaveSynthetic_PutU32( std::string& Bytes, uint32_t Value )
+{
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) ( Value & 0xffff ) );
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) ( Value >> 16 ) );
+}
+
+static std::string WaveSynthetic_MakeHRPayload( WaveSynthetic_PeripheralHandle& Handle, std::mt19937& Random )
+{
+	std::uniform_int_distribution< int > Noise( -2, 2 );
+	int BPM = 110 + ( Handle.Index % 50 ) + Noise( Random );
+
+	std::string Bytes;
+	Bytes.push_back( 0x06 ); // uint8 measurement, contact detected.
+	Bytes.push_back( ( char ) BPM );
+	return Bytes;
+}
+
+static std::string WaveSynthetic_MakeCSCPayload( WaveSynthetic_PeripheralHandle& Handle, double TimeSeconds )
+{
+	float SpeedMS = 7.0f + ( Handle.Index % 8 ); // ~25 - 54 Km/hr.
+	float CadenceRPM = 80.0f + ( Handle.Index % 20 );
+
+	double DeltaSeconds = TimeSeconds - Handle.LastEventSeconds;
+	Handle.WheelRevs += DeltaSeconds * SpeedMS / WAVESYNTHETIC_WHEEL_CIRCUMFERENCE_M;
+	Handle.CrankRevs += DeltaSeconds * CadenceRPM / 60.0;
+	Handle.LastEventSeconds = TimeSeconds;
+
+	// Event time is in 1/1024th of a second, and wraps around like a real sensor.
+	uint16_t EventTime = ( uint16_t ) ( ( uint64_t ) ( TimeSeconds * 1024.0 ) & 0xffff );
+
+	std::string Bytes;
+	Bytes.push_back( 0x03 ); // Wheel + crank revolution data present.
+	WaveSynthetic_PutU32( Bytes, ( uint32_t ) Handle.WheelRevs );
+	WaveSynthetic_PutU16( Bytes, EventTime );
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) Handle.CrankRevs );
+	WaveSynthetic_PutU16( Bytes, EventTime );
+	return Bytes;
+}
+
+static std::string WaveSynthetic_MakePowerPayload( WaveSynthetic_PeripheralHandle& Handle, std::mt19937& Random )
+{
+	std::uniform_int_distribution< int > Noise( -15, 15 );
+	int Power = 150 + ( Handle.Index % 150 ) + Noise( Random );
+
+	std::string Bytes;
+	WaveSynthetic_PutU16( Bytes, 0 ); // Flags.
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) Power );
+	return Bytes;
+}
+
+static std::string WaveSynthetic_MakeIndoorBikeDataPayload( WaveSynthetic_PeripheralHandle& Handle, std::mt19937& Random )
+{
+	std::uniform_int_distribution< int > Noise( -10, 10 );
+	int TargetPower = Handle.FTMS_TargetPower;
+	int Power = ( TargetPower > 0 ? TargetPower : 180 + ( Handle.Index % 100 ) ) + Noise( Random );
+	float SpeedKMH = 30.0f + ( Handle.Index % 10 );
+	float CadenceRPM = 85.0f + ( Handle.Index % 10 );
+
+	std::string Bytes;
+	WaveSynthetic_PutU16( Bytes, 0x0044 ); // Speed ( More Data clear ), cadence and power present.
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) ( SpeedKMH * 100.0f ) );
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) ( CadenceRPM * 2.0f ) );
+	WaveSynthetic_PutU16( Bytes, ( uint16_t ) Power );
+	return Bytes;
+}
+
+static std::string WaveSynthetic_MakePayload( WaveSynthetic_PeripheralHandle& Handle, const WaveSynthetic_Subscription& Subscription, double TimeSeconds, std::mt19937& Random )
+{
+	if ( Subscription.Characteristic == s_WaveSynthetic_HRM_CharUUID ) {
+		return WaveSynthetic_MakeHRPayload( Handle, Random );
+	} else if ( Subscription.Characteristic == s_WaveSynthetic_CSC_MeasurementUUID ) {
+		return WaveSynthetic_MakeCSCPayload( Handle, TimeSeconds );
+	} else if ( Subscription.Characteristic == s_WaveSynthetic_PS_MeasurementUUID ) {
+		return WaveSynthetic_MakePowerPayload( Handle, Random );
+	} else if ( Subscription.Characteristic == s_WaveSynthetic_FTMS_IndoorBikeDataUUID ) {
+		return WaveSynthetic_MakeIndoorBikeDataPayload( Handle, Random );
+	}
+	return std::string();
+}
+
+// ------------------------------------------------ Emitter thread -------------------------------------------------
+
+static void WaveSynthetic_DeliverPendingIndications( WaveSynthetic_AdapterHandle& Adapter )
+{
+	for ( auto& Peripheral : Adapter.Fleet ) {
+		auto Handle = WaveSynthetic_GetInternal( *Peripheral );
+		std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+		if ( !Handle->PendingIndications.size() )
+			continue;
+
+		for ( auto& Pending : Handle->PendingIndications ) {
+			for ( auto& Subscription : Handle->Subscriptions ) {
+				if ( !Subscription.Indicate || Subscription.Characteristic != Pending.first )
+					continue;
+				Subscription.Callback( Pending.second );
+				Adapter.NotificationsSent++;
+				Adapter.NotificationBytesSent += Pending.second.size();
+			}
+		}
+		Handle->PendingIndications.clear();
+	}
+}
+
+static void WaveSynthetic_EmitterThread_Entry( WaveSynthetic_AdapterHandle* Adapter )
+{
+	using namespace std::chrono;
+
+	std::mt19937 Random( Adapter->Options.Seed );
+	float RateHz = Adapter->Options.NotifyRateHz > 0.001f ? Adapter->Options.NotifyRateHz : 0.001f;
+	float JitterMS = Adapter->Options.NotifyJitterMS > 0.0f ? Adapter->Options.NotifyJitterMS : 0.0f;
+	std::uniform_real_distribution< float > Jitter( -JitterMS, JitterMS );
+	auto Period = duration_cast< steady_clock::duration >( duration< float >( 1.0f / RateHz ) );
+
+	auto StartTime = steady_clock::now();
+	std::priority_queue< WaveSynthetic_ScheduleItem, std::vector< WaveSynthetic_ScheduleItem >, std::greater< WaveSynthetic_ScheduleItem > > Schedule;
+
+	// Stagger the fleet evenly across the first period, so we don't get a thundering herd.
+	for ( size_t i = 0; i < Adapter->Fleet.size(); i++ ) {
+		WaveSynthetic_ScheduleItem Item;
+		Item.Handle = WaveSynthetic_GetInternal( *Adapter->Fleet[i] );
+		Item.Due = StartTime + ( Period * i ) / Adapter->Fleet.size();
+		Schedule.push( Item );
+	}
+
+	while ( true ) {
+		{
+			std::unique_lock< std::mutex > EmitterLock( Adapter->EmitterMutex );
+			auto NextDue = Schedule.size() ? Schedule.top().Due : steady_clock::now() + seconds( 1 );
+			Adapter->EmitterCondition.wait_until( EmitterLock, NextDue, [&]() { return Adapter->EmitterExit || Adapter->EmitterHasPendingIndications; } );
+			if ( Adapter->EmitterExit )
+				break;
+			Adapter->EmitterHasPendingIndications = false;
+		}
+
+		WaveSynthetic_DeliverPendingIndications( *Adapter );
+
+		auto TimeNow = steady_clock::now();
+		double TimeSeconds = duration< double >( TimeNow - StartTime ).count();
+		while ( Schedule.size() && Schedule.top().Due <= TimeNow ) {
+			auto Item = Schedule.top();
+			Schedule.pop();
+
+			auto Handle = Item.Handle;
+			if ( Handle->Connected ) {
+				std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+				for ( auto& Subscription : Handle->Subscriptions ) {
+					if ( Subscription.Indicate )
+						continue;
+					auto Payload = WaveSynthetic_MakePayload( *Handle, Subscription, TimeSeconds, Random );
+					if ( !Payload.size() )
+						continue;
+					Subscription.Callback( Payload );
+					Adapter->NotificationsSent++;
+					Adapter->NotificationBytesSent += Payload.size();
+				}
+			}
+
+			Item.Due += Period + duration_cast< steady_clock::duration >( duration< float, std::milli >( Jitter( Random ) ) );
+			if ( Item.Due < TimeNow ) {
+				// We fell behind; don't try to catch up with a burst.
+				Item.Due = TimeNow + Period;
+			}
+			Schedule.push( Item );
+		}
+	}
+}
+
+// ------------------------------------------------ WaveBackendInterface -------------------------------------------------
+
+static bool WaveSynthetic_IsConnected( WavePeripheral& Peripheral )
+{
+	return WaveSynthetic_GetInternal( Peripheral )->Connected;
+}
+
+static bool WaveSynthetic_IsConnectable( WavePeripheral& Peripheral )
+{
+	return true;
+}
+
+static void WaveSynthetic_Connect( WavePeripheral& Peripheral )
+{
+	WaveSynthetic_GetInternal( Peripheral )->Connected = true;
+	WavePeripheral_OnConnectionChanged( Peripheral, true );
+}
+
+static void WaveSynthetic_Disconnect( WavePeripheral& Peripheral )
+{
+	auto Handle = WaveSynthetic_GetInternal( Peripheral );
+	Handle->Connected = false;
+	WavePeripheral_OnConnectionChanged( Peripheral, false );
+
+	// Like a real device, subscriptions are lost on disconnect.
+	std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+	Handle->Adapter->NumSubscriptions -= Handle->Subscriptions.size();
+	Handle->Subscriptions.clear();
+	Handle->PendingIndications.clear();
+	Handle->FTMS_HasControl = false;
+	Handle->FTMS_TargetPower = 0;
+}
+
+static bool WaveSynthetic_HasService( WavePeripheral& Peripheral, const std::string& Service )
+{
+	for ( auto& PeripheralService : Peripheral.Services ) {
+		if ( PeripheralService == Service )
+			return true;
+	}
+	return false;
+}
+
+static bool WaveSynthetic_HasCharacteristic( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic )
+{
+	if ( !WaveSynthetic_HasService( Peripheral, Service ) )
+		return false;
+
+	switch ( WaveSynthetic_GetInternal( Peripheral )->Kind )
+	{
+		case WAVESYNTHETIC_KIND_HR:
+			return Characteristic == s_WaveSynthetic_HRM_CharUUID;
+		case WAVESYNTHETIC_KIND_CSC:
+			return Characteristic == s_WaveSynthetic_CSC_MeasurementUUID;
+		case WAVESYNTHETIC_KIND_POWER:
+			return Characteristic == s_WaveSynthetic_PS_MeasurementUUID;
+		case WAVESYNTHETIC_KIND_TRAINER:
+			return Characteristic == s_WaveSynthetic_PS_MeasurementUUID || Characteristic == s_WaveSynthetic_PS_WahooBrakeExtensionUUID;
+		case WAVESYNTHETIC_KIND_FTMS_TRAINER:
+			return Characteristic == s_WaveSynthetic_FTMS_IndoorBikeDataUUID || Characteristic == s_WaveSynthetic_FTMS_ControlPointUUID || Characteristic == s_WaveSynthetic_FTMS_StatusUUID;
+		default:
+			return false;
+	}
+}
+
+static void WaveSynthetic_Subscribe( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback, bool Indicate )
+{
+	auto Handle = WaveSynthetic_GetInternal( Peripheral );
+	if ( !Handle->Connected || !WaveSynthetic_HasCharacteristic( Peripheral, Service, Characteristic ) )
+		return;
+
+	WaveSynthetic_Subscription Subscription;
+	Subscription.Service = Service;
+	Subscription.Characteristic = Characteristic;
+	Subscription.Callback = Callback;
+	Subscription.Indicate = Indicate;
+
+	std::lock_guard< std::mutex > SubscriptionsLock( Handle->SubscriptionsMutex );
+	Handle->Subscriptions.push_back( Subscription );
+	Handle->Adapter->NumSubscriptions++;
+}
+
+static void WaveSynthetic_Notify( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
+{
+	WaveSynthetic_Subscribe( Peripheral, Service, Characteristic, Callback, false );
+}
+
+static void WaveSynthetic_Indicate( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, WaveNotifyCallback Callback )
+{
+	WaveSynthetic_Subscribe( Peripheral, Service, Characteristic, Callback, true );
+}
+
+// Responses are delivered from the emitter thread like a real indication.
+static void WaveSynthetic_QueueIndication( WaveSynthetic_PeripheralHandle& Handle, const std::string& Characteristic, const std::string& Payload )
+{
+	Handle.SubscriptionsMutex.lock();
+	Handle.PendingIndications.push_back( std::make_pair( Characteristic, Payload ) );
+	Handle.SubscriptionsMutex.unlock();
+
+	Handle.Adapter->EmitterMutex.lock();
+	Handle.Adapter->EmitterHasPendingIndications = true;
+	Handle.Adapter->EmitterMutex.unlock();
+	Handle.Adapter->EmitterCondition.notify_one();
+}
+
+static void WaveSynthetic_WriteCommand( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload )
+{
+	auto Handle = WaveSynthetic_GetInternal( Peripheral );
+	if ( !Handle->Connected || !Payload.size() )
+		return;
+
+	Handle->Adapter->CommandsReceived++;
+
+	if ( Characteristic == s_WaveSynthetic_PS_WahooBrakeExtensionUUID ) {
+		// Acknowledge with a success response.
+		std::string Response;
+		Response.push_back( 0x01 );
+		Response.push_back( Payload[0] );
+		WaveSynthetic_QueueIndication( *Handle, Characteristic, Response );
+	}
+}
+
+static void WaveSynthetic_WriteRequest( WavePeripheral& Peripheral, const std::string& Service, const std::string& Characteristic, const std::string& Payload )
+{
+	auto Handle = WaveSynthetic_GetInternal( Peripheral );
+	if ( Characteristic != s_WaveSynthetic_FTMS_ControlPointUUID || Handle->Kind != WAVESYNTHETIC_KIND_FTMS_TRAINER ) {
+		WaveSynthetic_WriteCommand( Peripheral, Service, Characteristic, Payload );
+		return;
+	}
+	if ( !Handle->Connected || !Payload.size() )
+		return;
+
+	Handle->Adapter->CommandsReceived++;
+
+	// Behave like a strict FTMS trainer: everything but Request Control needs control granted first.
+	uint8_t OpCode = ( uint8_t ) Payload[0];
+	uint8_t Result = 0x01; // Success.
+	if ( OpCode == 0x00 ) {
+		Handle->FTMS_HasControl = true;
+	} else if ( !Handle->FTMS_HasControl ) {
+		Result = 0x05; // Control not permitted.
+	} else if ( OpCode == 0x05 ) {
+		Result = Payload.size() >= 3 ? 0x01 : 0x03;
+		if ( Result == 0x01 ) {
+			Handle->FTMS_TargetPower = ( int16_t ) ( ( uint8_t ) Payload[1] | ( ( uint8_t ) Payload[2] << 8 ) );
+		}
+	} else if ( OpCode == 0x11 ) {
+		Result = Payload.size() >= 7 ? 0x01 : 0x03;
+		if ( Result == 0x01 ) {
+			Handle->FTMS_TargetPower = 0;
+		}
+	} else if ( OpCode != 0x01 && OpCode != 0x07 && OpCode != 0x08 ) {
+		Result = 0x02; // Not supported.
+	}
+
+	std::string Response;
+	Response.push_back( ( char ) 0x80 );
+	Response.push_back( ( char ) OpCode );
+	Response.push_back( ( char ) Result );
+	WaveSynthetic_QueueIndication( *Handle, Characteristic, Response );
+}
+
+static std::shared_ptr< WavePeripheral > WaveSynthetic_MakePeripheral( WaveBluetoothBackend& Backend, WaveSynthetic_AdapterHandle& Adapter, int Kind, int Index )
+{
+	static const char* KindNames[ WAVESYNTHETIC_KIND_NUM ] = { "HR", "CSC", "Power", "Trainer", "FTMS Trainer" };
+	static const char* KindServices[ WAVESYNTHETIC_KIND_NUM ] = { s_WaveSynthetic_HRM_ServiceUUID, s_WaveSynthetic_CSC_ServiceUUID, s_WaveSynthetic_PS_ServiceUUID, s_WaveSynthetic_PS_ServiceUUID, s_WaveSynthetic_FTMS_ServiceUUID };
+
+	auto Handle = std::make_shared< WaveSynthetic_PeripheralHandle >();
+	Handle->Adapter = &Adapter;
+	Handle->Kind = Kind;
+	Handle->Index = Index;
+
+	char TempStr[64];
+	auto Peripheral = std::make_shared< WavePeripheral >();
+	Peripheral->Handle = Handle;
+	Peripheral->Interface = WaveBackendSynthetic_GetInterface();
+	Peripheral->Capture = Backend.Capture;
+	snprintf( TempStr, sizeof( TempStr ), "Synthetic %s %d", KindNames[ Kind ], Index );
+	Peripheral->UIName = TempStr;
+	snprintf( TempStr, sizeof( TempStr ), "5e:%02x:%02x:%02x:%02x:%02x", Kind, ( Index >> 24 ) & 0xff, ( Index >> 16 ) & 0xff, ( Index >> 8 ) & 0xff, Index & 0xff );
+	Peripheral->UIAddress = TempStr;
+	Peripheral->Services.push_back( KindServices[ Kind ] );
+	return Peripheral;
+}
+
+static void WaveSynthetic_Init( WaveBluetoothBackend& Backend, int AdapterIndex )
+{
+	auto Adapter = std::make_shared< WaveSynthetic_AdapterHandle >();
+	Adapter->Options = Backend.Options.SyntheticFleet;
+
+	int KindCounts[ WAVESYNTHETIC_KIND_NUM ] = { Adapter->Options.NumHR, Adapter->Options.NumCSC, Adapter->Options.NumPower, Adapter->Options.NumTrainer, Adapter->Options.NumFTMSTrainer };
+	for ( int Kind = 0; Kind < WAVESYNTHETIC_KIND_NUM; Kind++ ) {
+		for ( int i = 0; i < KindCounts[ Kind ]; i++ ) {
+			Adapter->Fleet.push_back( WaveSynthetic_MakePeripheral( Backend, *Adapter, Kind, i ) );
+		}
+	}
+	WAVECONTROL_LOG( "WaveBackend_Init: Created synthetic fleet of %d peripherals at %.1f Hz.\n", ( int ) Adapter->Fleet.size(), Adapter->Options.NotifyRateHz );
+
+	Adapter->EmitterThread = std::thread( WaveSynthetic_EmitterThread_Entry, Adapter.get() );
+	Backend.Adapter = Adapter;
+}
+
+static void WaveSynthetic_Shutdown( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveSynthetic_AdapterHandle* >( Backend.Adapter.get() );
+	Adapter->StopEmitter();
+	for ( auto& Peripheral : Adapter->Fleet ) {
+		WaveSynthetic_Disconnect( *Peripheral );
+	}
+}
+
+static void WaveSynthetic_ScanStart( WaveBluetoothBackend& Backend )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveSynthetic_AdapterHandle* >( Backend.Adapter.get() );
+	Backend.ScannedPeripheralsMutex.lock();
+	for ( auto& Peripheral : Adapter->Fleet ) {
+		if ( Backend.ScannedPeripherals.find( Peripheral->UIAddress ) == Backend.ScannedPeripherals.end() ) {
+			Backend.ScannedPeripherals[ Peripheral->UIAddress ] = Peripheral;
+		}
+	}
+	Backend.ScannedPeripheralsMutex.unlock();
+	WAVECONTROL_LOG( "    FOUND %d synthetic peripherals\n", ( int ) Adapter->Fleet.size() );
+}
+
+static void WaveSynthetic_ScanStop( WaveBluetoothBackend& Backend )
+{
+}
+
+static void WaveSynthetic_GetStats( WaveBluetoothBackend& Backend, WaveBackendStats& Stats )
+{
+	if ( !Backend.Adapter.get() )
+		return;
+
+	auto Adapter = static_cast< WaveSynthetic_AdapterHandle* >( Backend.Adapter.get() );
+	Stats.NumPeripherals = Adapter->Fleet.size();
+	Stats.NumSubscriptions = Adapter->NumSubscriptions;
+	Stats.NotificationsSent = Adapter->NotificationsSent;
+	Stats.NotificationBytesSent = Adapter->NotificationBytesSent;
+	Stats.CommandsReceived = Adapter->CommandsReceived;
+}
+
+static const WaveBackendInterface s_WaveBackend_SyntheticInterface =
+{
+	"Synthetic",
+	WaveSynthetic_IsConnected,
+	WaveSynthetic_IsConnectable,
+	WaveSynthetic_Connect,
+	WaveSynthetic_Disconnect,
+	WaveSynthetic_HasService,
+	WaveSynthetic_HasCharacteristic,
+	WaveSynthetic_Notify,
+	WaveSynthetic_Indicate,
+	WaveSynthetic_WriteCommand,
+	WaveSynthetic_WriteRequest,
+	WaveSynthetic_Init,
+	WaveSynthetic_Shutdown,
+	WaveSynthetic_ScanStart,
+	WaveSynthetic_ScanStop,
+	WaveSynthetic_GetStats
+};
+
+const WaveBackendInterface* WaveBackendSynthetic_GetInterface()
+{
+	return &s_WaveBackend_SyntheticInterface;
+}
@@ -0,0 +1,915 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// WaveBench times the hot paths of route loading, route lookup, simulation and sensor packet parsing,
+// over synthetic routes from 1k to 1M points plus any real GPX files given on the command line.
+// Results are written as JSON ( ns/op, allocs/op, peak RSS ) so runs can be diffed for regressions.
+//
+//     WaveBench.exe [--out results.json] [--max-points N] [--min-time-ms N] [--gpx route.gpx]...
+//
+
+#define _USE_MATH_DEFINES
+#include "WaveControl.h"
+#include "WaveDevice.h"
+#include "WaveGPX.h"
+#include "WaveSimulation.h"
+#include "WaveCommandQueue.h"
+#include "WaveControlWheelSizeList.h"
+
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define WAVEBENCH_DEFAULT_MIN_TIME_MS 250
+#define WAVEBENCH_DEFAULT_MAX_POINTS 1000000
+#define WAVEBENCH_QUERY_BATCH 4096
+#define WAVEBENCH_PACKET_BATCH 1024
+#define WAVEBENCH_SIM_BATCH 1024
+#define WAVEBENCH_DIRECTORY_FILES 32
+#define WAVEBENCH_DIRECTORY_POINTS 20000
+
+// ----- Allocation tracking -----
+
+static std::atomic< uint64_t > s_WaveBench_NumAllocs = 0;
+
+void* operator new( size_t Size )
+{
+	s_WaveBench_NumAllocs.fetch_add( 1, std::memory_order_relaxed );
+	void* Ptr = malloc( Size ? Size : 1 );
+	if ( !Ptr )
+		throw std::bad_alloc();
+	return Ptr;
+}
+
+void* operator new[]( size_t Size )
+{
+	return operator new( Size );
+}
+
+void operator delete( void* Ptr ) noexcept
+{
+	free( Ptr );
+}
+
+void operator delete[]( void* Ptr ) noexcept
+{
+	free( Ptr );
+}
+
+void operator delete( void* Ptr, size_t Size ) noexcept
+{
+	( void ) Size;
+	free( Ptr );
+}
+
+void operator delete[]( void* Ptr, size_t Size ) noexcept
+{
+	( void ) Size;
+	free( Ptr );
+}
+
+static uint64_t WaveBench_GetPeakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS Counters;
+	if ( GetProcessMemoryInfo( GetCurrentProcess(), &Counters, sizeof( Counters ) ) ) {
+		return Counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage Usage;
+	getrusage( RUSAGE_SELF, &Usage );
+	return ( uint64_t ) Usage.ru_maxrss * 1024;
+#endif
+}
+
+// ----- Timing -----
+
+struct WaveBenchResult
+{
+	std::string Name;
+	std::string Input;
+	uint64_t Points = 0;
+	uint64_t Iterations = 0;
+	double NSPerOp = 0.0;
+	double AllocsPerOp = 0.0;
+	uint64_t PeakRSS = 0;
+};
+
+struct WaveBenchContext
+{
+	std::vector< WaveBenchResult > Results;
+	int MinTimeMS = WAVEBENCH_DEFAULT_MIN_TIME_MS;
+	uint64_t MaxPoints = WAVEBENCH_DEFAULT_MAX_POINTS;
+	std::vector< std::string > GPXFiles;
+};
+
+// Keeps the optimiser from throwing away results we never look at.
+static volatile double s_WaveBench_Sink = 0.0;
+
+// Calls Func until MinTimeMS has passed ( at least once ). Func performs OpsPerCall operations per call.
+static void WaveBench_Run( WaveBenchContext& Context, const std::string& Name, const std::string& Input, uint64_t Points, uint64_t OpsPerCall, std::function< void() > Func )
+{
+	using namespace std::chrono;
+
+	uint64_t Iterations = 0;
+	uint64_t Allocs = 0;
+	nanoseconds Elapsed( 0 );
+	while ( Iterations == 0 || Elapsed < milliseconds( Context.MinTimeMS ) ) {
+		uint64_t AllocsBefore = s_WaveBench_NumAllocs.load( std::memory_order_relaxed );
+		auto TimeBefore = steady_clock::now();
+		Func();
+		Elapsed += steady_clock::now() - TimeBefore;
+		Allocs += s_WaveBench_NumAllocs.load( std::memory_order_relaxed ) - AllocsBefore;
+		Iterations++;
+	}
+
+	WaveBenchResult Result;
+	Result.Name = Name;
+	Result.Input = Input;
+	Result.Points = Points;
+	Result.Iterations = Iterations * OpsPerCall;
+	Result.NSPerOp = ( double ) Elapsed.count() / ( double ) Result.Iterations;
+	Result.AllocsPerOp = ( double ) Allocs / ( double ) Result.Iterations;
+	Result.PeakRSS = WaveBench_GetPeakRSS();
+	Context.Results.push_back( Result );
+
+	std::cerr << Name << " [" << Input << ", " << Points << " pts]: " << Result.NSPerOp << " ns/op, " << Result.AllocsPerOp << " allocs/op\n";
+}
+
+// ----- Inputs -----
+
+// Rolling hills wound around a loop, roughly 5m between points. Shape doesn't matter much, but it should be
+// hilly enough that grade lookups do real work.
+static void WaveBench_MakeSyntheticRecord( WaveGPX& WRS, FWaveGPXRecord& Record, uint64_t NumPoints )
+{
+	FWaveGPXRoute Info;
+	Info.Name = "WaveBench Synthetic";
+	WRS.RecordStart( Record, Info );
+
+	Record.Route.Points.reserve( NumPoints );
+	Record.Time.reserve( NumPoints );
+	Record.Power.reserve( NumPoints );
+	Record.Cadence.reserve( NumPoints );
+	Record.HR.reserve( NumPoints );
+
+	const double MetersPerDegree = 111111.0;
+	const double BaseLat = 37.8324;
+	const double BaseLon = -122.4795;
+	auto StartTime = std::chrono::system_clock::now();
+
+	FWaveGPXRoute Reference;
+	double East = 0.0, North = 0.0, Heading = 0.0;
+	for ( uint64_t i = 0; i < NumPoints; i++ ) {
+		Heading += 0.01 * sin( i * 0.0013 );
+		East += 5.0 * cos( Heading );
+		North += 5.0 * sin( Heading );
+
+		FWaveGPXPoint P;
+		P.Lat = BaseLat + North / MetersPerDegree;
+		P.Lon = BaseLon + East / ( MetersPerDegree * cos( BaseLat * M_PI / 180.0 ) );
+		P.Alt = 100.0 + 60.0 * sin( i * 0.002 ) + 8.0 * sin( i * 0.031 );
+
+		if ( i == 0 ) {
+			Reference.Points.push_back( P );
+		}
+		WaveRouteUtil_FillENUFromLLA( Reference, P );
+		if ( i > 0 ) {
+			auto& Prev = Record.Route.Points.back();
+			P.Dist = Prev.Dist + sqrt( pow( P.East - Prev.East, 2.0 ) + pow( P.North - Prev.North, 2.0 ) + pow( P.Up - Prev.Up, 2.0 ) );
+		}
+
+		WRS.RecordAddPoint(
+			Record, P, StartTime + std::chrono::seconds( i ),
+			( float ) ( 180 + i % 70 ), ( float ) ( 85 + i % 10 ), ( float ) ( 130 + i % 30 )
+		);
+	}
+}
+
+// Spread of lookup distances. Random order defeats caching, sweep order is what a ride actually does.
+static std::vector< float > WaveBench_MakeQueries( const FWaveGPXRoute& Route, bool Sweep )
+{
+	std::vector< float > Queries( WAVEBENCH_QUERY_BATCH );
+	float Length = Route.Points.size() ? ( float ) Route.Points.back().Dist : 0.0f;
+	uint32_t Seed = 0x5eed;
+	for ( int i = 0; i < WAVEBENCH_QUERY_BATCH; i++ ) {
+		if ( Sweep ) {
+			Queries[i] = Length * ( float ) i / WAVEBENCH_QUERY_BATCH;
+		} else {
+			Seed = Seed * 1664525u + 1013904223u;
+			Queries[i] = Length * ( float ) ( Seed >> 8 ) / ( float ) ( 1 << 24 );
+		}
+	}
+	return Queries;
+}
+
+// ----- Benchmarks -----
+
+static void WaveBench_RouteLookups( WaveBenchContext& Context, const FWaveGPXRoute& Route, const std::string& Input )
+{
+	// Grade lookups on Route go through its grade profile, this is how they went before. Spline lookups fit the
+	// segment they land on instead of using the stored one.
+	FWaveGPXRoute NoProfileRoute = Route;
+	NoProfileRoute.GradeProfile = FWaveGPXGradeProfile();
+	NoProfileRoute.Spline = FWaveGPXSpline();
+
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		auto Suffix = std::string( Sweep ? "/Sweep" : "/Random" );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindENUPosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindENUPosAtDist( Route, Dist ).Up;
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindGradePosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindGradePosAtDist( Route, Dist );
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindGradePosAtDist/NoProfile" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindGradePosAtDist( NoProfileRoute, Dist );
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindPointAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			int64_t Sum = 0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindPointAtDist( Route, Dist );
+			}
+			s_WaveBench_Sink = ( double ) Sum;
+		} );
+	}
+
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		auto Suffix = std::string( Sweep ? "/Sweep" : "/Random" );
+
+		WaveRouteCursor Cursor( Route );
+		WaveBench_Run( Context, "WaveRouteCursor::SetDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Cursor.SetDist( Dist );
+				Sum += Cursor.GetPosition().Up + Cursor.GetGrade();
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindSplinePosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				auto Sample = WaveRouteUtil_FindSplinePosAtDist( Route, Dist );
+				Sum += Sample.Position.Up + Sample.Grade + Sample.Curvature;
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindSplinePosAtDist/NoSpline" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				auto Sample = WaveRouteUtil_FindSplinePosAtDist( NoProfileRoute, Dist );
+				Sum += Sample.Position.Up + Sample.Grade + Sample.Curvature;
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+	}
+
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		auto Suffix = std::string( Sweep ? "/Sweep" : "/Random" );
+
+		std::vector< double > Alt( Queries.size() ), East( Queries.size() ), North( Queries.size() );
+		std::vector< float > Grade( Queries.size() );
+		WaveBench_Run( Context, "WaveRouteUtil_SampleRoute" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			WaveRouteUtil_SampleRoute( Route, Queries.data(), Queries.size(), Alt.data(), Grade.data(), East.data(), North.data() );
+			s_WaveBench_Sink = Alt.back() + Grade.back();
+		} );
+	}
+
+	std::vector< FWaveGPXPoint > ConvertedPoints = Route.Points;
+	WaveBench_Run( Context, "WaveRouteUtil_FillENUFromLLA/Batch", Input, Route.Points.size(), Route.Points.size(), [&]()
+	{
+		WaveRouteUtil_FillENUFromLLA( Route, ConvertedPoints.data(), ConvertedPoints.size() );
+		s_WaveBench_Sink = ConvertedPoints.back().East;
+	} );
+	WaveBench_Run( Context, "WaveRouteUtil_FillLLAFromENU/Batch", Input, Route.Points.size(), Route.Points.size(), [&]()
+	{
+		WaveRouteUtil_FillLLAFromENU( Route, ConvertedPoints.data(), ConvertedPoints.size() );
+		s_WaveBench_Sink = ConvertedPoints.back().Lat;
+	} );
+
+	FWaveGPXGradeProfile Profile;
+	WaveBench_Run( Context, "WaveRouteUtil_BuildGradeProfile", Input, Route.Points.size(), 1, [&]()
+	{
+		WaveRouteUtil_BuildGradeProfile( Route, Profile );
+		s_WaveBench_Sink = ( double ) Profile.BucketPoint.size();
+	} );
+
+	FWaveGPXSpline Spline;
+	WaveBench_Run( Context, "WaveRouteUtil_BuildSpline", Input, Route.Points.size(), 1, [&]()
+	{
+		WaveRouteUtil_BuildSpline( Route, Spline );
+		s_WaveBench_Sink = ( double ) Spline.Segments.size();
+	} );
+
+	FWaveGPXLODPyramid Pyramid;
+	WaveBench_Run( Context, "WaveRouteUtil_BuildLODPyramid", Input, Route.Points.size(), 1, [&]()
+	{
+		WaveRouteUtil_BuildLODPyramid( Route, Pyramid );
+		s_WaveBench_Sink = ( double ) Pyramid.Levels.size();
+	} );
+
+	// An 80 column elevation strip per call, of the whole route and of a 1km window sliding along it.
+	FWaveGPXLODBucket Pixels[80];
+	WaveBench_Run( Context, "WaveRouteUtil_GetLODView/Whole", Input, Route.Points.size(), 80, [&]()
+	{
+		WaveRouteUtil_GetLODView( Pyramid, 0.0f, Route.Stat_Length, Pixels, 80 );
+		s_WaveBench_Sink = Pixels[79].AvgAlt;
+	} );
+	float WindowStart = 0.0f;
+	WaveBench_Run( Context, "WaveRouteUtil_GetLODView/Window", Input, Route.Points.size(), 80, [&]()
+	{
+		WaveRouteUtil_GetLODView( Pyramid, WindowStart, WindowStart + 1000.0f, Pixels, 80 );
+		WindowStart = WindowStart < Route.Stat_Length ? WindowStart + 37.0f : 0.0f;
+		s_WaveBench_Sink = Pixels[79].AvgAlt;
+	} );
+
+	FWaveGPXResampledRoute Resampled;
+	WaveBench_Run( Context, "WaveRouteUtil_ResampleRoute", Input, Route.Points.size(), 1, [&]()
+	{
+		WaveRouteUtil_ResampleRoute( Route, Resampled, 1.0f );
+		s_WaveBench_Sink = ( double ) Resampled.Points.size();
+	} );
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		auto Suffix = std::string( Sweep ? "/Resampled/Sweep" : "/Resampled/Random" );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindENUPosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindENUPosAtDist( Resampled, Dist ).Up;
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindGradePosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindGradePosAtDist( Resampled, Dist );
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindPointAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			int64_t Sum = 0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindPointAtDist( Route, Resampled, Dist );
+			}
+			s_WaveBench_Sink = ( double ) Sum;
+		} );
+	}
+
+	FWaveGPXCompactRoute CompactRoute;
+	WaveRouteUtil_MakeCompactRoute( Route, CompactRoute );
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		auto Suffix = std::string( Sweep ? "/Compact/Sweep" : "/Compact/Random" );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindENUPosAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindENUPosAtDist( CompactRoute, Dist ).Up;
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindPointAtDist" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			int64_t Sum = 0;
+			for ( auto Dist : Queries ) {
+				Sum += WaveRouteUtil_FindPointAtDist( CompactRoute, Dist );
+			}
+			s_WaveBench_Sink = ( double ) Sum;
+		} );
+	}
+
+	FWaveGPXRoute IndexedRoute = Route;
+	WaveBench_Run( Context, "WaveRouteUtil_BuildSpatialIndex", Input, Route.Points.size(), 1, [&]()
+	{
+		WaveRouteUtil_BuildSpatialIndex( IndexedRoute );
+		s_WaveBench_Sink = ( double ) IndexedRoute.SpatialIndex.Segments.size();
+	} );
+	for ( int Sweep = 0; Sweep < 2; Sweep++ ) {
+		// Positions a few metres off the route, like a rider's GPS fix.
+		auto Queries = WaveBench_MakeQueries( Route, Sweep != 0 );
+		std::vector< FWaveGPXPoint > Positions;
+		for ( auto Dist : Queries ) {
+			auto Point = WaveRouteUtil_FindENUPosAtDist( Route, Dist );
+			Point.East += 4.0;
+			Point.North -= 3.0;
+			Positions.push_back( Point );
+		}
+		auto Suffix = std::string( Sweep ? "/Sweep" : "/Random" );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindNearestDistOnRoute" + Suffix, Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( auto& Point : Positions ) {
+				Sum += WaveRouteUtil_FindNearestDistOnRoute( IndexedRoute, Point.East, Point.North );
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+
+		WaveBench_Run( Context, "WaveRouteUtil_FindNearestDistOnRoute" + Suffix + "/Hint", Input, Route.Points.size(), Queries.size(), [&]()
+		{
+			double Sum = 0.0;
+			for ( size_t i = 0; i < Positions.size(); i++ ) {
+				Sum += WaveRouteUtil_FindNearestDistOnRoute( IndexedRoute, Positions[i].East, Positions[i].North, Queries[i] );
+			}
+			s_WaveBench_Sink = Sum;
+		} );
+	}
+}
+
+// Load with the lookup structures built, so WaveBench_RouteLookups times the fast paths and the load times include them.
+static void WaveBench_BuildRouteLookups( WaveGPX& WRS )
+{
+	WRS.LoadOptions.BuildSpatialIndex = true;
+	WRS.LoadOptions.BuildGradeProfile = true;
+	WRS.LoadOptions.BuildLODPyramid = true;
+	WRS.LoadOptions.BuildSpline = true;
+}
+
+// Same load again, but through the route cache. The first load writes the cache, so it isn't timed.
+static void WaveBench_LoadCached( WaveBenchContext& Context, const std::string& FileName, const std::string& Input, uint64_t Points )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.UseRouteCache = true;
+	WaveBench_BuildRouteLookups( WRS );
+	WRS.LoadRouteGPX( Route, FileName );
+
+	WaveBench_Run( Context, "WaveGPX::LoadRouteGPX/Cached", Input, Points, 1, [&]()
+	{
+		FWaveGPXRoute LoadedRoute;
+		WRS.LoadRouteGPX( LoadedRoute, FileName );
+		s_WaveBench_Sink = LoadedRoute.Stat_Length;
+	} );
+}
+
+static void WaveBench_GPXFile( WaveBenchContext& Context, const std::string& FileName )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.UseRouteCache = false;
+	WaveBench_BuildRouteLookups( WRS );
+	if ( !WRS.LoadRouteGPX( Route, FileName ) ) {
+		std::cerr << "Failed to load " << FileName << ", skipping.\n";
+		return;
+	}
+
+	WaveBench_Run( Context, "WaveGPX::LoadRouteGPX", FileName, Route.Points.size(), 1, [&]()
+	{
+		FWaveGPXRoute LoadedRoute;
+		WRS.LoadRouteGPX( LoadedRoute, FileName );
+		s_WaveBench_Sink = LoadedRoute.Stat_Length;
+	} );
+	WaveBench_LoadCached( Context, FileName, FileName, Route.Points.size() );
+	WaveBench_RouteLookups( Context, Route, FileName );
+}
+
+static void WaveBench_SyntheticRoute( WaveBenchContext& Context, uint64_t NumPoints )
+{
+	WaveGPX WRS;
+	FWaveGPXRecord Record;
+	WaveBench_MakeSyntheticRecord( WRS, Record, NumPoints );
+
+	auto TempFile = ( std::filesystem::temp_directory_path() / "WaveBench_Synthetic.gpx" ).string();
+	WaveBench_Run( Context, "WaveGPX::RecordFinish", "synthetic", NumPoints, 1, [&]()
+	{
+		WRS.RecordFinish( Record, TempFile );
+	} );
+
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.UseRouteCache = false;
+	WaveBench_BuildRouteLookups( WRS );
+	WaveBench_Run( Context, "WaveGPX::LoadRouteGPX", "synthetic", NumPoints, 1, [&]()
+	{
+		WRS.LoadRouteGPX( Route, TempFile );
+		s_WaveBench_Sink = Route.Stat_Length;
+	} );
+	WaveBench_LoadCached( Context, TempFile, "synthetic", NumPoints );
+	std::filesystem::remove( TempFile );
+	std::filesystem::remove( WaveGPXCache_GetFileName( TempFile ) );
+
+	std::vector< FWaveGPXPoint > SimplifiedPoints;
+	WaveBench_Run( Context, "WaveRouteUtil_SimplifyPoints", "synthetic", NumPoints, 1, [&]()
+	{
+		auto Report = WaveRouteUtil_SimplifyPoints( Route.Points, SimplifiedPoints, 1.0f, 0.5f );
+		s_WaveBench_Sink = Report.NumPointsRemoved;
+	} );
+
+	WaveBench_RouteLookups( Context, Route, "synthetic" );
+}
+
+static void WaveBench_RouteDirectory( WaveBenchContext& Context )
+{
+	WaveGPX WRS;
+	FWaveGPXRecord Record;
+	WaveBench_MakeSyntheticRecord( WRS, Record, WAVEBENCH_DIRECTORY_POINTS );
+
+	auto Directory = std::filesystem::temp_directory_path() / "WaveBench_Routes";
+	std::filesystem::create_directories( Directory );
+	for ( int i = 0; i < WAVEBENCH_DIRECTORY_FILES; i++ ) {
+		WRS.RecordFinish( Record, ( Directory / ( "Route" + std::to_string( i ) + ".gpx" ) ).string() );
+	}
+
+	WRS.LoadOptions.UseRouteCache = false;
+	int MaxThreads = std::max( 1, ( int ) std::thread::hardware_concurrency() );
+	for ( int NumThreads = 1; ; NumThreads = std::min( NumThreads * 2, MaxThreads ) ) {
+		WaveBench_Run( Context, "WaveGPX::LoadRouteDirectory/" + std::to_string( NumThreads ) + "T", "synthetic",
+			WAVEBENCH_DIRECTORY_POINTS * WAVEBENCH_DIRECTORY_FILES, WAVEBENCH_DIRECTORY_FILES, [&]()
+		{
+			WRS.ClearLoadedRoutes();
+			s_WaveBench_Sink = WRS.LoadRouteDirectory( Directory.string(), nullptr, nullptr, NumThreads );
+		} );
+		if ( NumThreads == MaxThreads )
+			break;
+	}
+	WaveBench_Run( Context, "WaveGPX::ScanRouteDirectory", "synthetic",
+		WAVEBENCH_DIRECTORY_POINTS * WAVEBENCH_DIRECTORY_FILES, WAVEBENCH_DIRECTORY_FILES, [&]()
+	{
+		WRS.ClearCatalog();
+		s_WaveBench_Sink = WRS.ScanRouteDirectory( Directory.string() );
+	} );
+	std::filesystem::remove_all( Directory );
+}
+
+// Each conversion one point at a time, then the whole lot in one batch call, on points spread over a few km.
+static void WaveBench_Geodetic( WaveBenchContext& Context, uint64_t NumPoints )
+{
+	FWaveGPXGeoFrame Frame;
+	WaveGPXGeo_InitFrame( Frame, 37.83, -122.48, 100.0 );
+
+	std::vector< double > Lat( NumPoints ), Lon( NumPoints ), Alt( NumPoints );
+	std::vector< double > X( NumPoints ), Y( NumPoints ), Z( NumPoints );
+	std::vector< double > East( NumPoints ), North( NumPoints ), Up( NumPoints );
+	std::vector< double > OutA( NumPoints ), OutB( NumPoints ), OutC( NumPoints );
+	for ( uint64_t i = 0; i < NumPoints; i++ ) {
+		Lat[i] = 37.83 + 0.02 * sin( i * 0.0001 );
+		Lon[i] = -122.48 + 0.02 * cos( i * 0.00013 );
+		Alt[i] = 100.0 + 50.0 * sin( i * 0.001 );
+	}
+	WaveGPXGeo_LLAToECEF( Lat.data(), Lon.data(), Alt.data(), X.data(), Y.data(), Z.data(), NumPoints );
+	WaveGPXGeo_LLAToENU( Frame, Lat.data(), Lon.data(), Alt.data(), East.data(), North.data(), Up.data(), NumPoints );
+
+	auto Bench = [&]( const std::string& Name, const double* A, const double* B, const double* C, auto Single, auto Batch )
+	{
+		WaveBench_Run( Context, Name + "/Scalar", "synthetic", NumPoints, NumPoints, [&]()
+		{
+			for ( uint64_t i = 0; i < NumPoints; i++ ) {
+				Single( A[i], B[i], C[i], OutA[i], OutB[i], OutC[i] );
+			}
+			s_WaveBench_Sink = OutA[ NumPoints - 1 ];
+		} );
+		WaveBench_Run( Context, Name + "/Batch", "synthetic", NumPoints, NumPoints, [&]()
+		{
+			Batch( A, B, C, OutA.data(), OutB.data(), OutC.data() );
+			s_WaveBench_Sink = OutA[ NumPoints - 1 ];
+		} );
+	};
+	Bench( "WaveGPXGeo_LLAToECEF", Lat.data(), Lon.data(), Alt.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_LLAToECEF( A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_LLAToECEF( A, B, C, D, E, F, NumPoints ); } );
+	Bench( "WaveGPXGeo_ECEFToLLA", X.data(), Y.data(), Z.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_ECEFToLLA( A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_ECEFToLLA( A, B, C, D, E, F, NumPoints ); } );
+	Bench( "WaveGPXGeo_ECEFToENU", X.data(), Y.data(), Z.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_ECEFToENU( Frame, A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_ECEFToENU( Frame, A, B, C, D, E, F, NumPoints ); } );
+	Bench( "WaveGPXGeo_ENUToECEF", East.data(), North.data(), Up.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_ENUToECEF( Frame, A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_ENUToECEF( Frame, A, B, C, D, E, F, NumPoints ); } );
+	Bench( "WaveGPXGeo_LLAToENU", Lat.data(), Lon.data(), Alt.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_LLAToENU( Frame, A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_LLAToENU( Frame, A, B, C, D, E, F, NumPoints ); } );
+	Bench( "WaveGPXGeo_ENUToLLA", East.data(), North.data(), Up.data(),
+		[&]( double A, double B, double C, double& D, double& E, double& F ) { WaveGPXGeo_ENUToLLA( Frame, A, B, C, D, E, F ); },
+		[&]( const double* A, const double* B, const double* C, double* D, double* E, double* F ) { WaveGPXGeo_ENUToLLA( Frame, A, B, C, D, E, F, NumPoints ); } );
+}
+
+static void WaveBench_Simulation( WaveBenchContext& Context )
+{
+	WaveSimulation Sim;
+	int Step = 0;
+	WaveBench_Run( Context, "WaveSimulation::Update", "synthetic", 0, WAVEBENCH_SIM_BATCH, [&]()
+	{
+		for ( int i = 0; i < WAVEBENCH_SIM_BATCH; i++, Step++ ) {
+			Sim.Grade = 8.0f * sinf( Step * 0.001f );
+			Sim.Update( 1.0f / 60.0f );
+		}
+		s_WaveBench_Sink = Sim.GetPosition();
+	} );
+}
+
+static void WaveBench_SensorParsing( WaveBenchContext& Context )
+{
+	WavePeripheralTable PeripheralTable;
+	auto ReadState = std::make_shared< WaveCycleSensorReadState >();
+
+	// Packets as the sensors send them, with the counters moving so CSC does its full update.
+	std::vector< std::string > HRPackets, HR16Packets, CSCPackets, PowerPackets;
+	for ( int i = 0; i < WAVEBENCH_PACKET_BATCH; i++ ) {
+		uint32_t WheelRevs = i * 3;
+		uint16_t WheelTime = ( uint16_t ) ( i * 1024 );
+		uint16_t CrankRevs = ( uint16_t ) i;
+		uint16_t CrankTime = ( uint16_t ) ( i * 700 );
+		uint16_t Power = ( uint16_t ) ( 150 + i % 200 );
+		uint16_t PowerFlags = 0;
+
+		HRPackets.push_back( std::string( { 0x06, ( char ) ( 120 + i % 60 ) } ) );
+		HR16Packets.push_back( std::string( { 0x07, ( char ) ( 120 + i % 60 ), 0x00 } ) );
+
+		std::string CSC( 11, '\0' );
+		CSC[0] = 0x03;
+		memcpy( &CSC[1], &WheelRevs, 4 );
+		memcpy( &CSC[5], &WheelTime, 2 );
+		memcpy( &CSC[7], &CrankRevs, 2 );
+		memcpy( &CSC[9], &CrankTime, 2 );
+		CSCPackets.push_back( CSC );
+
+		std::string PowerPacket( 4, '\0' );
+		memcpy( &PowerPacket[0], &PowerFlags, 2 );
+		memcpy( &PowerPacket[2], &Power, 2 );
+		PowerPackets.push_back( PowerPacket );
+	}
+
+	WaveHRMonitor HR( &PeripheralTable );
+	HR.ReadState = ReadState;
+	WaveBench_Run( Context, "WaveHRMonitor::ParseMeasurement", "uint8", 0, WAVEBENCH_PACKET_BATCH, [&]()
+	{
+		for ( auto& Packet : HRPackets ) {
+			HR.ParseMeasurement( Packet );
+		}
+		s_WaveBench_Sink = ReadState->HR_BPM;
+	} );
+	WaveBench_Run( Context, "WaveHRMonitor::ParseMeasurement", "uint16", 0, WAVEBENCH_PACKET_BATCH, [&]()
+	{
+		for ( auto& Packet : HR16Packets ) {
+			HR.ParseMeasurement( Packet );
+		}
+		s_WaveBench_Sink = ReadState->HR_BPM;
+	} );
+
+	WaveControl_WheelSizeData WheelSize;
+	WheelSize.WheelCircumferenceMM = 2105.0f;
+	WaveCadenceSpeedSensor CSC( &PeripheralTable );
+	CSC.ReadState = ReadState;
+	CSC.SetWheelSizeData( WheelSize );
+	WaveBench_Run( Context, "WaveCadenceSpeedSensor::ParseMeasurement", "wheel+crank", 0, WAVEBENCH_PACKET_BATCH, [&]()
+	{
+		for ( auto& Packet : CSCPackets ) {
+			CSC.ParseMeasurement( Packet );
+		}
+		s_WaveBench_Sink = ReadState->Speed + ReadState->Cadence;
+	} );
+
+	WavePowerSensor PowerSensor( &PeripheralTable );
+	PowerSensor.ReadState = ReadState;
+	WaveBench_Run( Context, "WavePowerSensor::ParseMeasurement", "power", 0, WAVEBENCH_PACKET_BATCH, [&]()
+	{
+		for ( auto& Packet : PowerPackets ) {
+			PowerSensor.ParseMeasurement( Packet );
+		}
+		s_WaveBench_Sink = ReadState->Power;
+	} );
+}
+
+// Whole notification path at a realistic aggregate rate: backend callback, decode, snapshot publish, history push
+// and worker wake + tick. Paced by the synthetic fleet, so ns/op is wall time per notification, not cost; the
+// number that matters here is allocs/op, which should be 0 once the devices are set up.
+static void WaveBench_NotificationPath( WaveBenchContext& Context, float AggregateRateHz )
+{
+	using namespace std::chrono;
+
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+	Options.SyntheticFleet.NumHR = 1;
+	Options.SyntheticFleet.NumCSC = 1;
+	Options.SyntheticFleet.NumPower = 1;
+	Options.SyntheticFleet.NumTrainer = 0;
+	Options.SyntheticFleet.NotifyRateHz = AggregateRateHz / 3.0f;
+	Options.SyntheticFleet.NotifyJitterMS = 0.1f;
+
+	WaveControl W( Options );
+	W.ScanStart();
+	std::this_thread::sleep_for( milliseconds( 100 ) );
+	for ( auto& P : W.ListPeripherals() ) {
+		if ( P.first.find( "HR" ) != std::string::npos ) W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_HR, P.second );
+		if ( P.first.find( "CSC" ) != std::string::npos ) W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_SPEED, P.second );
+		if ( P.first.find( "Power" ) != std::string::npos ) W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_POWER, P.second );
+	}
+	W.ScanStop();
+
+	// Let connection and subscription setup settle before measuring.
+	std::this_thread::sleep_for( milliseconds( 500 ) );
+
+	auto NotificationsBefore = W.GetStats().Backend.NotificationsSent;
+	uint64_t AllocsBefore = s_WaveBench_NumAllocs.load( std::memory_order_relaxed );
+	auto TimeBefore = steady_clock::now();
+	std::this_thread::sleep_for( milliseconds( Context.MinTimeMS > 1000 ? Context.MinTimeMS : 1000 ) );
+	auto Elapsed = steady_clock::now() - TimeBefore;
+	uint64_t Allocs = s_WaveBench_NumAllocs.load( std::memory_order_relaxed ) - AllocsBefore;
+	auto Notifications = W.GetStats().Backend.NotificationsSent - NotificationsBefore;
+	if ( !Notifications )
+		Notifications = 1;
+
+	WaveBenchResult Result;
+	Result.Name = "WaveControl notification path";
+	Result.Input = "synthetic " + std::to_string( ( int ) AggregateRateHz ) + " Hz";
+	Result.Iterations = Notifications;
+	Result.NSPerOp = ( double ) duration_cast< nanoseconds >( Elapsed ).count() / ( double ) Notifications;
+	Result.AllocsPerOp = ( double ) Allocs / ( double ) Notifications;
+	Result.PeakRSS = WaveBench_GetPeakRSS();
+	Context.Results.push_back( Result );
+
+	std::cerr << Result.Name << " [" << Result.Input << "]: " << Notifications << " notifications, " << Result.AllocsPerOp << " allocs/op\n";
+}
+
+static void WaveBench_CommandQueue( WaveBenchContext& Context )
+{
+	auto Queue = std::make_unique< WaveCommandQueue >();
+	std::string Address = "5e:00:00:00:00:00";
+	uint64_t Sum = 0;
+	WaveBench_Run( Context, "WaveCommandQueue::Push+Drain", "single thread", 0, WAVECONTROL_COMMAND_QUEUE_SIZE, [&]()
+	{
+		for ( int i = 0; i < WAVECONTROL_COMMAND_QUEUE_SIZE; i++ ) {
+			Queue->Push( [&Sum, &Address, i]() { Sum += Address.size() + i; } );
+		}
+		Queue->Drain();
+		s_WaveBench_Sink = ( double ) Sum;
+	} );
+}
+
+// ----- Output -----
+
+static std::string WaveBench_JSONString( const std::string& Value )
+{
+	std::string Ret = "\"";
+	for ( char C : Value ) {
+		if ( C == '"' || C == '\\' ) {
+			Ret += '\\';
+			Ret += C;
+		} else if ( ( unsigned char ) C < 0x20 ) {
+			char Temp[8];
+			snprintf( Temp, sizeof( Temp ), "\\u%04x", ( unsigned int ) C );
+			Ret += Temp;
+		} else {
+			Ret += C;
+		}
+	}
+	return Ret + "\"";
+}
+
+static std::string WaveBench_ToJSON( WaveBenchContext& Context )
+{
+	std::vector< std::string > Warnings;
+#ifndef NDEBUG
+	Warnings.push_back( "Built without NDEBUG. Asserts are enabled and timings are not representative." );
+#endif
+
+	std::ostringstream JSON;
+	JSON.precision( 6 );
+	JSON << std::fixed;
+	JSON << "{\n";
+#ifdef NDEBUG
+	JSON << "\t\"build\": \"release\",\n";
+#else
+	JSON << "\t\"build\": \"debug\",\n";
+#endif
+	JSON << "\t\"warnings\": [";
+	for ( size_t i = 0; i < Warnings.size(); i++ ) {
+		JSON << ( i ? ", " : "" ) << WaveBench_JSONString( Warnings[i] );
+	}
+	JSON << "],\n";
+	JSON << "\t\"peak_rss_bytes\": " << WaveBench_GetPeakRSS() << ",\n";
+	JSON << "\t\"results\": [\n";
+	for ( size_t i = 0; i < Context.Results.size(); i++ ) {
+		auto& Result = Context.Results[i];
+		JSON << "\t\t{ ";
+		JSON << "\"name\": " << WaveBench_JSONString( Result.Name ) << ", ";
+		JSON << "\"input\": " << WaveBench_JSONString( Result.Input ) << ", ";
+		JSON << "\"points\": " << Result.Points << ", ";
+		JSON << "\"iterations\": " << Result.Iterations << ", ";
+		JSON << "\"ns_per_op\": " << Result.NSPerOp << ", ";
+		JSON << "\"allocs_per_op\": " << Result.AllocsPerOp << ", ";
+		JSON << "\"peak_rss_bytes\": " << Result.PeakRSS;
+		JSON << " }" << ( i == Context.Results.size() - 1 ? "\n" : ",\n" );
+	}
+	JSON << "\t]\n";
+	JSON << "}\n";
+	return JSON.str();
+}
+
+int main( int argc, char* argv[] )
+{
+	WaveBenchContext Context;
+	std::string OutFile;
+	for ( int i = 1; i < argc; i++ ) {
+		std::string Arg = argv[i];
+		if ( Arg == "--out" && i + 1 < argc ) {
+			OutFile = argv[++i];
+		} else if ( Arg == "--max-points" && i + 1 < argc ) {
+			Context.MaxPoints = strtoull( argv[++i], nullptr, 10 );
+		} else if ( Arg == "--min-time-ms" && i + 1 < argc ) {
+			Context.MinTimeMS = atoi( argv[++i] );
+		} else if ( Arg == "--gpx" && i + 1 < argc ) {
+			Context.GPXFiles.push_back( argv[++i] );
+		} else {
+			std::cerr << "Usage: WaveBench [--out results.json] [--max-points N] [--min-time-ms N] [--gpx route.gpx]...\n";
+			return 1;
+		}
+	}
+
+	// Logging would dominate the GPX timings otherwise.
+	WaveControlSetLogCallback( []( const char* ) {} );
+
+	WaveBench_Simulation( Context );
+	WaveBench_SensorParsing( Context );
+	WaveBench_NotificationPath( Context, 1000.0f );
+	WaveBench_CommandQueue( Context );
+	for ( auto& FileName : Context.GPXFiles ) {
+		WaveBench_GPXFile( Context, FileName );
+	}
+	for ( uint64_t NumPoints = 1000; NumPoints <= Context.MaxPoints; NumPoints *= 10 ) {
+		WaveBench_SyntheticRoute( Context, NumPoints );
+	}
+	WaveBench_RouteDirectory( Context );
+	WaveBench_Geodetic( Context, Context.MaxPoints );
+
+	auto JSON = WaveBench_ToJSON( Context );
+	if ( OutFile.length() ) {
+		std::ofstream FileStream( OutFile );
+		if ( !FileStream.is_open() ) {
+			std::cerr << "Failed to write " << OutFile << "\n";
+			return 1;
+		}
+		FileStream << JSON;
+	} else {
+		std::cout << JSON;
+	}
+	return 0;
+}
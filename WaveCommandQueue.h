@@ -0,0 +1,204 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Captures bigger than this won't fit in a WaveCommand and fail to compile. Enough for this + a few values + a std::string.
+#define WAVECONTROL_COMMAND_STORAGE_SIZE 64
+
+// Must be a power of two.
+#define WAVECONTROL_COMMAND_QUEUE_SIZE 256
+
+// A void() callable stored inline, so queueing it never touches the heap.
+class WaveCommand
+{
+	alignas( std::max_align_t ) unsigned char Storage[ WAVECONTROL_COMMAND_STORAGE_SIZE ];
+	void ( *Operation )( void* Storage, bool Invoke ) = nullptr;
+
+public:
+	WaveCommand() = default;
+	WaveCommand( const WaveCommand& ) = delete;
+	WaveCommand& operator=( const WaveCommand& ) = delete;
+
+	~WaveCommand()
+	{
+		this->Reset();
+	}
+
+	template< typename Func >
+	void Set( Func&& Command )
+	{
+		using FuncType = std::decay_t< Func >;
+		static_assert( sizeof( FuncType ) <= WAVECONTROL_COMMAND_STORAGE_SIZE, "Command captures too much for WaveCommand storage." );
+		static_assert( alignof( FuncType ) <= alignof( std::max_align_t ), "Command is over-aligned for WaveCommand storage." );
+
+		this->Reset();
+		new ( this->Storage ) FuncType( std::forward< Func >( Command ) );
+		this->Operation = []( void* Storage, bool Invoke )
+		{
+			auto& Command = *static_cast< FuncType* >( Storage );
+			if ( Invoke ) {
+				Command();
+			}
+			Command.~FuncType();
+		};
+	}
+
+	// Runs the command and destroys it.
+	void Run()
+	{
+		auto Op = this->Operation;
+		this->Operation = nullptr;
+		if ( Op ) {
+			Op( this->Storage, true );
+		}
+	}
+
+	// Destroys the command without running it.
+	void Reset()
+	{
+		auto Op = this->Operation;
+		this->Operation = nullptr;
+		if ( Op ) {
+			Op( this->Storage, false );
+		}
+	}
+};
+
+// Multiple producer, single consumer queue of WaveCommands. Bounded ring of preallocated slots with per-slot sequence
+// numbers ( Vyukov style ), so producers only ever CAS and never wait on the consumer or each other.
+// If the ring fills up ( worker stuck in a long connect, say ) commands spill into a mutex protected overflow list
+// rather than blocking the producer. Order is kept per producer either way.
+//
+class WaveCommandQueue
+{
+	struct Slot
+	{
+		std::atomic< size_t > Sequence;
+		WaveCommand Command;
+	};
+
+	Slot Slots[ WAVECONTROL_COMMAND_QUEUE_SIZE ];
+	alignas( 64 ) std::atomic< size_t > EnqueuePos = 0;
+	alignas( 64 ) size_t DequeuePos = 0;
+
+	std::atomic< bool > Overflowing = false;
+	std::mutex OverflowMutex;
+	std::vector< std::function< void() > > Overflow;
+	std::vector< std::function< void() > > OverflowDrain;
+	std::atomic< uint64_t > NumOverflowed = 0;
+
+	size_t DrainRing( size_t UntilPos, bool WaitForWriters )
+	{
+		size_t NumRun = 0;
+		while ( this->DequeuePos < UntilPos ) {
+			auto& S = this->Slots[ this->DequeuePos & ( WAVECONTROL_COMMAND_QUEUE_SIZE - 1 ) ];
+			if ( S.Sequence.load( std::memory_order_acquire ) != this->DequeuePos + 1 ) {
+				if ( !WaitForWriters )
+					break;
+				std::this_thread::yield();
+				continue;
+			}
+			S.Command.Run();
+			S.Sequence.store( this->DequeuePos + WAVECONTROL_COMMAND_QUEUE_SIZE, std::memory_order_release );
+			this->DequeuePos++;
+			NumRun++;
+		}
+		return NumRun;
+	}
+
+public:
+	WaveCommandQueue()
+	{
+		static_assert( ( WAVECONTROL_COMMAND_QUEUE_SIZE & ( WAVECONTROL_COMMAND_QUEUE_SIZE - 1 ) ) == 0, "Queue size must be a power of two." );
+		for ( size_t i = 0; i < WAVECONTROL_COMMAND_QUEUE_SIZE; i++ ) {
+			this->Slots[i].Sequence.store( i, std::memory_order_relaxed );
+		}
+	}
+
+	// Safe to call from any thread.
+	template< typename Func >
+	void Push( Func&& Command )
+	{
+		if ( !this->Overflowing.load( std::memory_order_acquire ) ) {
+			size_t Pos = this->EnqueuePos.load( std::memory_order_relaxed );
+			while ( true ) {
+				auto& S = this->Slots[ Pos & ( WAVECONTROL_COMMAND_QUEUE_SIZE - 1 ) ];
+				size_t Sequence = S.Sequence.load( std::memory_order_acquire );
+				intptr_t Diff = ( intptr_t ) Sequence - ( intptr_t ) Pos;
+				if ( Diff == 0 ) {
+					if ( this->EnqueuePos.compare_exchange_weak( Pos, Pos + 1, std::memory_order_relaxed ) ) {
+						S.Command.Set( std::forward< Func >( Command ) );
+						S.Sequence.store( Pos + 1, std::memory_order_release );
+						return;
+					}
+				} else if ( Diff < 0 ) {
+					break; // Full.
+				} else {
+					Pos = this->EnqueuePos.load( std::memory_order_relaxed );
+				}
+			}
+		}
+
+		std::lock_guard< std::mutex > OverflowLock( this->OverflowMutex );
+		this->Overflow.push_back( std::forward< Func >( Command ) );
+		this->Overflowing.store( true, std::memory_order_release );
+		this->NumOverflowed++;
+	}
+
+	// Consumer thread only. Runs every queued command in place, oldest first. Returns number of commands run.
+	size_t Drain()
+	{
+		size_t NumRun = this->DrainRing( SIZE_MAX, false );
+
+		if ( this->Overflowing.load( std::memory_order_acquire ) ) {
+			this->OverflowMutex.lock();
+			this->OverflowDrain.swap( this->Overflow );
+			this->Overflowing.store( false, std::memory_order_release );
+			size_t OverflowPos = this->EnqueuePos.load( std::memory_order_relaxed );
+			this->OverflowMutex.unlock();
+
+			// Anything a producer put in the ring before spilling over has to run first, even if it was
+			// still being written when we drained above.
+			NumRun += this->DrainRing( OverflowPos, true );
+			for ( auto& Command : this->OverflowDrain ) {
+				Command();
+				NumRun++;
+			}
+			this->OverflowDrain.clear();
+		}
+		return NumRun;
+	}
+
+	uint64_t GetNumOverflowed()
+	{
+		return this->NumOverflowed;
+	}
+};
@@ -55,14 +55,23 @@ void FullRouteSimulationDemo( WaveControl& w )
 
 	WaveGPX WRS;
 	FWaveGPXRoute Route;
+	WRS.LoadOptions.UseRouteCache = true;
+	WRS.LoadOptions.BuildSpline = true;
+	WRS.LoadOptions.BuildLODPyramid = true;
 	WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" );
 
+	// The rider's position and the trainer's gradient come from the route's spline, followed along by a cursor.
+	WaveRouteCursor RouteCursor( Route );
+
+	// Elevation strip columns, summarised from the route's LOD pyramid each frame.
+	FWaveGPXLODBucket ElevMapColumns[80];
+
 	auto SensorReadState = w.GetSensorReadState();
 	auto SensorWriteState = w.GetSensorWriteState();
 	SensorWriteState->TotalWeight = Sim.RiderWeight + Sim.BikeWeight;
 	SensorWriteState->RollingResistance = Sim.TireCrr;
 
-	int FrameIdx = INT_MAX, RecordFrameIdx = INT_MAX;
+	int RecordFrameIdx = INT_MAX;
 	float VAM = 0.0f, PrevAlt = FLT_MAX;
 	int FrameTimeMS = 33;
 
@@ -82,8 +91,9 @@ void FullRouteSimulationDemo( WaveControl& w )
 		Sim.RiderPower = SensorReadState->Power;
 		// Sim.RiderPower = 4000.0f;
 		Sim.Update( FrameTimeMS / 1000.0f );
-		auto CurrentSimulationPos = WaveRouteUtil_FindENUPosAtDist( Route, Sim.GetPosition() );
-		auto Gradient = WaveRouteUtil_FindGradePosAtDist( Route, Sim.GetPosition() );
+		RouteCursor.SetDist( Sim.GetPosition() );
+		auto CurrentSimulationPos = RouteCursor.GetSplineSample().Position;
+		auto Gradient = RouteCursor.GetSplineSample().Grade;
 		
 		Sim.Grade = Gradient;
 		Sim.Altitude = CurrentSimulationPos.Alt;
@@ -155,16 +165,15 @@ void FullRouteSimulationDemo( WaveControl& w )
 				}
 			}
 		}
+		WaveRouteUtil_GetLODView( Route, 0.0f, Route.Stat_Length, ElevMapColumns, 80 );
 		for ( int i = 0; i < 80; i++ ) {
-			float Dist = ( i / 79.0f ) * Route.Stat_Length;
-			
-			auto MapPos = WaveRouteUtil_FindENUPosAtDist( Route, Dist );
-			auto MapPosGradient = WaveRouteUtil_FindGradePosAtDist( Route, Dist, 10.0f );
+			double MapAlt = ElevMapColumns[i].AvgAlt;
+			float MapPosGradient = ElevMapColumns[i].AvgGrade;
 			
 			int MapZ = 0; float MapZFrac = 0.0f;
 			float AltRange = Route.Stat_HighestAlt - Route.Stat_LowestAlt;
 			if ( AltRange > 0.001f ) {
-				float MapZf = ( ( MapPos.Alt - Route.Stat_LowestAlt ) / ( Route.Stat_HighestAlt - Route.Stat_LowestAlt ) ) * 10.0f;
+				float MapZf = ( ( MapAlt - Route.Stat_LowestAlt ) / ( Route.Stat_HighestAlt - Route.Stat_LowestAlt ) ) * 10.0f;
 				MapZ = ( int ) MapZf;
 				MapZFrac = MapZf - MapZ;
 			}
@@ -186,13 +195,8 @@ void FullRouteSimulationDemo( WaveControl& w )
 
 		std::cout << setposx( 0 ) << setposy( 34 );
 
-		// Rate limit changes to gradient to not spam too much.
-		if ( FrameIdx++ > 20 ) {
-			FrameIdx = 0;
-
-			// Halve descent gradient to reduce noise.
-			SensorWriteState->Gradient = ( Gradient < 0.0f ) ? ( Gradient * 0.5f ) : Gradient;
-		}
+		// Halve descent gradient to reduce noise. The trainer's command scheduler takes care of rate limiting.
+		SensorWriteState->Gradient = ( Gradient < 0.0f ) ? ( Gradient * 0.5f ) : Gradient;
 
 		// Calculate VAM.
 		float InstantVAM = ( CurrentSimulationPos.Alt - PrevAlt ) / ( FrameTimeMS / ( 3600.f * 1000.0f ) );
@@ -204,7 +208,11 @@ void FullRouteSimulationDemo( WaveControl& w )
 		// Record current point.
 		if ( RecordFrameIdx++ > 25 ) {
 			RecordFrameIdx = 0;
-			WRS.RecordAddPoint( Record, CurrentSimulationPos, std::chrono::system_clock::now(), SensorReadState->Power, SensorReadState->Cadence, SensorReadState->HR_BPM );
+			// The spline only gives ENU.
+			auto RecordPos = CurrentSimulationPos;
+			WaveRouteUtil_FillLLAFromENU( Route, RecordPos );
+			RecordPos.Alt = CurrentSimulationPos.Alt;
+			WRS.RecordAddPoint( Record, RecordPos, std::chrono::system_clock::now(), SensorReadState->Power, SensorReadState->Cadence, SensorReadState->HR_BPM );
 		}
 
 		// Step ride when we get to the end.
@@ -152,8 +152,16 @@ void WaveControl::WorkerThread_ChooseDeviceForUsage( int Usage, std::string UIAd
 			ChosenDevices[Usage]->PeripheralHandleID = HandleID;
 			ChosenDevices[Usage]->ReadState = this->SensorReadState;
 			ChosenDevices[Usage]->WriteState = this->SensorWriteState;
+			ChosenDevices[Usage]->SnapshotBuffer = this->SensorSnapshotBuffer;
+			ChosenDevices[Usage]->History = this->SensorHistory;
+			ChosenDevices[Usage]->OnNotification = [this]() { this->WorkThread_Wake(); };
 			ChosenDevices[Usage]->Enabled = true;
 
+			auto Trainer = dynamic_cast< WaveTrainerDevice* >( ChosenDevices[Usage].get() );
+			if ( Trainer ) {
+				Trainer->SetCommandCounters( this->TrainerCommandCounters );
+			}
+
 			break;
 		}
 	}
@@ -166,12 +174,12 @@ void WaveControl::WorkerThread_Update()
 {
 	assert( std::this_thread::get_id() == this->WorkThreadID );
 
+	auto TimeNow = std::chrono::steady_clock::now();
+
 	// Auto stop scanning at some point.
-	if ( this->WorkThreadScanning && this->WorkThreadScanningAutostopFrames != INT_MAX ) {
-		if ( this->WorkThreadScanningAutostopFrames-- <= 0 ) {
-			this->WorkThreadScanningAutostopFrames = INT_MAX;
-			this->WorkerThread_ScanStop();
-		}
+	if ( this->WorkThreadScanning && TimeNow >= this->WorkThreadScanningAutostopTime ) {
+		this->WorkThreadScanningAutostopTime = std::chrono::steady_clock::time_point::max();
+		this->WorkerThread_ScanStop();
 	}
 
 	// Propagate sensor metainformation.
@@ -183,55 +191,96 @@ void WaveControl::WorkerThread_Update()
 	if ( CadenceSensor ) {
 		CadenceSensor->SetWheelSizeData( this->PrivateData->ChosenWheelSize );
 	}
+	auto Trainer = dynamic_cast< WaveTrainerDevice* >( ChosenDevices[ WAVECONTROL_DEVICE_TRAINER ].get() );
+	if ( Trainer ) {
+		// FTMS trainers report their own speed / cadence / power; use them for whatever has no dedicated sensor.
+		int FieldMask = WAVECONTROL_SENSORFIELD_ALL;
+		if ( ChosenDevices[ WAVECONTROL_DEVICE_HR ].get() ) FieldMask &= ~WAVECONTROL_SENSORFIELD_HR;
+		if ( ChosenDevices[ WAVECONTROL_DEVICE_SPEED ].get() ) FieldMask &= ~WAVECONTROL_SENSORFIELD_SPEED;
+		if ( ChosenDevices[ WAVECONTROL_DEVICE_CADENCE ].get() ) FieldMask &= ~WAVECONTROL_SENSORFIELD_CADENCE;
+		if ( ChosenDevices[ WAVECONTROL_DEVICE_POWER ].get() ) FieldMask &= ~WAVECONTROL_SENSORFIELD_POWER;
+		Trainer->SetReadFieldMask( FieldMask );
+	}
 
 	// Step sensors
+	bool HasActiveDevices = false;
 	for ( auto& ChosenDevice : ChosenDevices ) {
 		if ( !ChosenDevice.get() || !ChosenDevice->Enabled )
 			continue;
 		ChosenDevice->Update();
+		HasActiveDevices = true;
 	}
 
 	// Step peripheral table.
 	this->PeripheralTable.Update();
+
+	// Connected devices need polling for reconnects and write state changes. With nothing chosen, we can sleep until woken.
+	this->WorkThreadHousekeepingTime = HasActiveDevices ?
+		TimeNow + std::chrono::milliseconds( WAVECONTROL_WORKER_HOUSEKEEPING_MS ) :
+		std::chrono::steady_clock::time_point::max();
+}
+
+std::chrono::steady_clock::time_point WaveControl::WorkerThread_NextDeadline()
+{
+	auto Deadline = this->WorkThreadHousekeepingTime;
+	if ( this->WorkThreadScanning && this->WorkThreadScanningAutostopTime < Deadline ) {
+		Deadline = this->WorkThreadScanningAutostopTime;
+	}
+	return Deadline;
 }
 
 void WaveControl::WorkThread_Entry()
 {
 	WAVECONTROL_LOG( "Workthread starting!\n" );
 	WorkThreadID = std::this_thread::get_id();
-	WaveBackend_Init( this->Backend );
+	WaveBackend_Init( this->Backend, this->Backend.Options.AdapterIndex );
+
+	while ( true ) {
+		// Sleep until there's queued work, a notification, or the next deadline.
+		auto Deadline = this->WorkerThread_NextDeadline();
+		if ( Deadline == std::chrono::steady_clock::time_point::max() ) {
+			this->WorkThreadWakeSemaphore.acquire();
+		} else {
+			this->WorkThreadWakeSemaphore.try_acquire_until( Deadline );
+		}
+
+		// Soak up any other wakes that came in meanwhile. Whatever they were for gets drained below, and
+		// anything pushed after this point signals again.
+		while ( this->WorkThreadWakeSemaphore.try_acquire() ) {}
+		if ( this->WorkerThreadExit )
+			break;
 
-	while ( !this->WorkerThreadExit ) {
-		this->WorkThreadQueueMutex.lock();
-		auto CallbackWorkQueue = this->WorkThreadQueue;
-		this->WorkThreadQueue.clear();
-		this->WorkThreadQueueMutex.unlock();
+		auto TickStartTime = std::chrono::steady_clock::now();
 
-		for ( auto& Func : CallbackWorkQueue ) {
-			Func();
-		}
+		this->WorkThreadQueue.Drain();
 
 		WorkerThread_Update();
-		std::this_thread::sleep_for( std::chrono::milliseconds( 32 ) );
+
+		uint64_t TickNS = std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - TickStartTime ).count();
+		this->WorkerTicks++;
+		this->WorkerTickTotalNS += TickNS;
+		if ( TickNS > this->WorkerTickMaxNS ) {
+			this->WorkerTickMaxNS = TickNS;
+		}
 	}
 }
 
-void WaveControl::WorkThread_Do( std::function< void() > Func )
+void WaveControl::WorkThread_Wake()
 {
-	assert( Func );
-	assert( std::this_thread::get_id() != this->WorkThreadID );
-	this->WorkThreadQueueMutex.lock();
-	this->WorkThreadQueue.push_back( Func );
-	this->WorkThreadQueueMutex.unlock();
+	this->WorkThreadWakeSemaphore.release();
 }
 
 // ---------------------------------------------------------------------- WaveControl -----------------------------------------------------------------------------
 
-WaveControl::WaveControl()
+WaveControl::WaveControl( const WaveBackendOptions& BackendOptions )
 {
+	this->Backend.Options = BackendOptions;
 	this->PrivateData = std::make_unique< WaveControlPrivateData >();
 	this->SensorReadState = std::make_shared< WaveCycleSensorReadState >();
 	this->SensorWriteState = std::make_shared< WaveCycleSensorWriteState >();
+	this->SensorSnapshotBuffer = std::make_shared< WaveCycleSensorSnapshotBuffer >();
+	this->SensorHistory = std::make_shared< WaveCycleSensorHistory >();
+	this->TrainerCommandCounters = std::make_shared< WaveTrainerCommandCounters >();
 
 	WaveControl_InitialiseWheelSizes( this->PrivateData->WheelSizeData );
 
@@ -249,6 +298,7 @@ WaveControl::WaveControl()
 WaveControl::~WaveControl()
 {
 	this->WorkerThreadExit = true;
+	this->WorkThread_Wake();
 	this->WorkThread->join();
 	this->WorkThread.reset( nullptr );
 	
@@ -260,13 +310,18 @@ WaveControl::~WaveControl()
 
 void WaveControl::ScanStart( int AutoStopFrames )
 {
-	WorkThread_Do( [this, AutoStopFrames](){ this->WorkThreadScanningAutostopFrames = AutoStopFrames; } );
-	WorkThread_Do( std::bind( &WaveControl::WorkerThread_ScanStart, this ) );
+	WorkThread_Do( [this, AutoStopFrames]()
+	{
+		this->WorkThreadScanningAutostopTime = ( AutoStopFrames == INT_MAX ) ?
+			std::chrono::steady_clock::time_point::max() :
+			std::chrono::steady_clock::now() + std::chrono::milliseconds( ( int64_t ) AutoStopFrames * WAVECONTROL_WORKER_HOUSEKEEPING_MS );
+	} );
+	WorkThread_Do( [this]() { this->WorkerThread_ScanStart(); } );
 }
 
 void WaveControl::ScanStop()
 {
-	WorkThread_Do( std::bind( &WaveControl::WorkerThread_ScanStop, this ) );
+	WorkThread_Do( [this]() { this->WorkerThread_ScanStop(); } );
 }
 
 std::vector< std::pair< std::string, std::string > > WaveControl::ListPeripherals()
@@ -283,7 +338,7 @@ std::vector< std::pair< std::string, std::string > > WaveControl::ListPeripheral
 
 void WaveControl::ChooseDeviceForUsage( int Usage, std::string UIAddress )
 {
-	WorkThread_Do( std::bind( &WaveControl::WorkerThread_ChooseDeviceForUsage, this, Usage, UIAddress ) );
+	WorkThread_Do( [this, Usage, UIAddress = std::move( UIAddress )]() { this->WorkerThread_ChooseDeviceForUsage( Usage, UIAddress ); } );
 }
 
 int WaveControl::DoesDeviceAdvertiseUsage( int Usage, std::string UIAddress, std::string ServiceID )
@@ -318,7 +373,40 @@ std::shared_ptr< WaveCycleSensorReadState > WaveControl::GetSensorReadState()
 {
 	return this->SensorReadState;
 }
+WaveCycleSensorSnapshot WaveControl::GetSensorSnapshot()
+{
+	return this->SensorSnapshotBuffer->Read();
+}
+
+uint64_t WaveControl::GetSensorSnapshotVersion()
+{
+	return this->SensorSnapshotBuffer->GetVersion();
+}
+
+int WaveControl::DrainSensorSamples( int Metric, uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples )
+{
+	return this->SensorHistory->Drain( Metric, SinceVersion, Samples, MaxSamples );
+}
+
 std::shared_ptr< WaveCycleSensorWriteState > WaveControl::GetSensorWriteState()
 {
 	return this->SensorWriteState;
+}
+
+void WaveControl::SetSensorWriteState( const WaveCycleSensorWriteState& WriteState )
+{
+	*this->SensorWriteState = WriteState;
+	this->WorkThread_Wake();
+}
+
+WaveControlStats WaveControl::GetStats()
+{
+	WaveControlStats Stats;
+	Stats.WorkerTicks = this->WorkerTicks;
+	Stats.WorkerTickTotalNS = this->WorkerTickTotalNS;
+	Stats.WorkerTickMaxNS = this->WorkerTickMaxNS;
+	Stats.CommandQueueOverflows = this->WorkThreadQueue.GetNumOverflowed();
+	Stats.TrainerCommands = this->TrainerCommandCounters->Load();
+	WaveBackend_GetStats( this->Backend, Stats.Backend );
+	return Stats;
 }
\ No newline at end of file
@@ -21,23 +21,43 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <climits>
+#include <cassert>
 
 #include <thread>
 #include <vector>
 #include <string>
 #include <memory>
 #include <mutex>
+#include <semaphore>
+#include <chrono>
 #include <functional>
+#include <atomic>
 
 #include "WaveBackend.h"
 #include "WaveDevice.h"
+#include "WaveCommandQueue.h"
 
 #define WAVECONTROL_LOG WaveControlLog
 #define WAVECONTROL_DEFAULT_BLUETOOTH_ADAPTER 0
 #define WAVECONTROL_MAGIC_ID 0xcd70fb4a
 
+// How often the worker services connected devices ( reconnects, trainer state sync ) when nothing else wakes it.
+// Scan auto-stop frames are counted in units of this.
+#define WAVECONTROL_WORKER_HOUSEKEEPING_MS 32
+
 struct WaveControlPrivateData;
 
+struct WaveControlStats
+{
+	uint64_t WorkerTicks = 0;
+	uint64_t WorkerTickTotalNS = 0;
+	uint64_t WorkerTickMaxNS = 0;
+	uint64_t CommandQueueOverflows = 0;
+	WaveTrainerCommandStats TrainerCommands;
+	WaveBackendStats Backend;
+};
+
 void WaveControlLog( const char* fmt, ... );
 void WaveControlSetLogCallback( std::function< void( const char* ) > Callback );
 
@@ -50,15 +70,22 @@ class WaveControl
 	std::unique_ptr< WaveDeviceBase > ChosenDevices[ WAVECONTROL_DEVICE_NUM ];
 	std::shared_ptr< WaveCycleSensorReadState > SensorReadState;
 	std::shared_ptr< WaveCycleSensorWriteState > SensorWriteState;
+	std::shared_ptr< WaveCycleSensorSnapshotBuffer > SensorSnapshotBuffer;
+	std::shared_ptr< WaveCycleSensorHistory > SensorHistory;
+	std::shared_ptr< WaveTrainerCommandCounters > TrainerCommandCounters;
 
 	// Worker thread handling.
 	std::unique_ptr< std::thread > WorkThread;
 	std::thread::id WorkThreadID;
-	std::vector< std::function< void() > > WorkThreadQueue;
-	std::mutex WorkThreadQueueMutex;
-	bool WorkerThreadExit = false;
+	WaveCommandQueue WorkThreadQueue;
+	std::counting_semaphore<> WorkThreadWakeSemaphore{ 0 };
+	std::atomic< bool > WorkerThreadExit = false;
 	bool WorkThreadScanning = false;
-	int WorkThreadScanningAutostopFrames = INT_MAX;
+	std::chrono::steady_clock::time_point WorkThreadScanningAutostopTime = std::chrono::steady_clock::time_point::max();
+	std::chrono::steady_clock::time_point WorkThreadHousekeepingTime = std::chrono::steady_clock::time_point::max();
+	std::atomic< uint64_t > WorkerTicks = 0;
+	std::atomic< uint64_t > WorkerTickTotalNS = 0;
+	std::atomic< uint64_t > WorkerTickMaxNS = 0;
 
 protected:
 	std::unique_ptr< WaveDeviceBase > MakeDeviceForUsage( int Usage );
@@ -71,12 +98,24 @@ protected:
 
 	void WorkerThread_Update();
 
+	std::chrono::steady_clock::time_point WorkerThread_NextDeadline();
+
 	void WorkThread_Entry();
 
-	void WorkThread_Do( std::function< void() > Func );
+	// Queues Func to run on the worker. Never blocks or allocates, so it's fine to call from a render loop.
+	template< typename Func >
+	void WorkThread_Do( Func&& Command )
+	{
+		assert( std::this_thread::get_id() != this->WorkThreadID );
+		this->WorkThreadQueue.Push( std::forward< Func >( Command ) );
+		this->WorkThread_Wake();
+	}
+
+	// Wakes the worker up for a tick ahead of its next deadline. Safe to call from any thread.
+	void WorkThread_Wake();
 
 public:
-	WaveControl();
+	WaveControl( const WaveBackendOptions& BackendOptions = WaveBackendOptions() );
 	virtual ~WaveControl();
 	uint32_t MagicID = WAVECONTROL_MAGIC_ID;
 
@@ -95,7 +134,24 @@ public:
 
 	std::shared_ptr< WaveCycleSensorReadState > GetSensorReadState();
 
+	// Tear-free copy of the read state, safe to call from any thread at any rate.
+	WaveCycleSensorSnapshot GetSensorSnapshot();
+
+	// Cheap check for new sensor data, compare against WaveCycleSensorSnapshot::Version.
+	uint64_t GetSensorSnapshotVersion();
+
+	// Every sample of Metric ( WAVECONTROL_SENSORMETRIC_* ) newer than SinceVersion, oldest first, up to MaxSamples.
+	// Returns the number written. Only the last WAVECONTROL_SENSOR_SAMPLE_HISTORY samples are kept.
+	int DrainSensorSamples( int Metric, uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples );
+
 	std::shared_ptr< WaveCycleSensorWriteState > GetSensorWriteState();
+
+	// Same as writing through GetSensorWriteState(), but the trainer sees the change right away instead of
+	// at the next housekeeping tick.
+	void SetSensorWriteState( const WaveCycleSensorWriteState& WriteState );
+
+	// Worker thread tick cost and backend traffic counters, for profiling and load testing.
+	WaveControlStats GetStats();
 };
 
 
@@ -18,6 +18,10 @@ OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWA
 */
 
 #include <cassert>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "WaveControlDLL.h"
 
@@ -25,7 +29,8 @@ OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWA
 #include "WaveGPX.h"
 #include "WaveSimulation.h"
 
-#pragma optimize("", off);
+#define WAVEGPX_LOADJOB_MAGIC_ID 0x10adf11e
+#define WAVEGPX_CURSOR_MAGIC_ID 0xc0a5e1
 
 void WaveControlDLL_SetLogCallback( void ( *Callback ) ( const char* ) )
 {
@@ -113,7 +118,31 @@ void WaveControlDLL_SetSensorWriteState( WaveControlPtr Cntl, WaveCycleSensorWri
 	assert( W && W->MagicID == WAVECONTROL_MAGIC_ID );
 	assert( WriteState );
 	assert( sizeof( WaveCycleSensorWriteStateDLL ) == sizeof( WaveCycleSensorWriteState ) );
-	*W->GetSensorWriteState() = *reinterpret_cast<WaveCycleSensorWriteState*>( WriteState );
+	W->SetSensorWriteState( *reinterpret_cast<WaveCycleSensorWriteState*>( WriteState ) );
+}
+
+void WaveControlDLL_GetSensorSnapshot( WaveControlPtr Cntl, WaveCycleSensorSnapshotDLL* Snapshot )
+{
+	auto W = ( WaveControl* ) Cntl;
+	assert( W && W->MagicID == WAVECONTROL_MAGIC_ID );
+	assert( Snapshot );
+	static_assert( sizeof( WaveCycleSensorSnapshotDLL ) == sizeof( WaveCycleSensorSnapshot ), "Snapshot layout mismatch." );
+	*reinterpret_cast<WaveCycleSensorSnapshot*>( Snapshot ) = W->GetSensorSnapshot();
+}
+
+uint64_t WaveControlDLL_GetSensorSnapshotVersion( WaveControlPtr Cntl )
+{
+	auto W = ( WaveControl* ) Cntl;
+	assert( W && W->MagicID == WAVECONTROL_MAGIC_ID );
+	return W->GetSensorSnapshotVersion();
+}
+
+int WaveControlDLL_DrainSensorSamples( WaveControlPtr Cntl, int Metric, uint64_t SinceVersion, WaveSensorSampleDLL* Samples, int MaxSamples )
+{
+	auto W = ( WaveControl* ) Cntl;
+	assert( W && W->MagicID == WAVECONTROL_MAGIC_ID );
+	static_assert( sizeof( WaveSensorSampleDLL ) == sizeof( WaveSensorSample ), "Sample layout mismatch." );
+	return W->DrainSensorSamples( Metric, SinceVersion, reinterpret_cast<WaveSensorSample*>( Samples ), MaxSamples );
 }
 
 // --------------------------------------------------------------------------------------------------------------------------
@@ -207,7 +236,10 @@ void WaveSimulationDLL_SetState( WaveSimulationPtr Sim, WaveSimulationStateDLL*
 
 WaveGPXPtr WaveGPXDLL_Init( void )
 {
-	return ( WaveSimulationPtr ) new WaveGPX();
+	// Frontends load the same route library every session, so let them skip the XML parse.
+	auto G = new WaveGPX();
+	G->LoadOptions.UseRouteCache = true;
+	return ( WaveSimulationPtr ) G;
 }
 
 void WaveGPXDLL_Release( WaveGPXPtr GPX )
@@ -217,6 +249,8 @@ void WaveGPXDLL_Release( WaveGPXPtr GPX )
 	delete G;
 }
 
+static void WaveGPXDLL_FillRoute( WaveGPXRouteDLL* Route, const FWaveGPXRoute* Temp );
+
 int WaveGPXDLL_LoadRouteGPX( WaveGPXPtr GPX, WaveGPXRouteDLL* Route, const char* FileName )
 {
 	auto G = ( WaveGPX* ) GPX;
@@ -232,6 +266,12 @@ int WaveGPXDLL_LoadRouteGPX( WaveGPXPtr GPX, WaveGPXRouteDLL* Route, const char*
 	if ( !G->LoadRouteGPX( *Temp, FileName ) )
 		return 0;
 
+	WaveGPXDLL_FillRoute( Route, Temp );
+	return 1;
+}
+
+static void WaveGPXDLL_FillRoute( WaveGPXRouteDLL* Route, const FWaveGPXRoute* Temp )
+{
 	Route->Name = Temp->Name.c_str();
 	Route->Description = Temp->Description.c_str();
 	Route->Author = Temp->Author.c_str();
@@ -246,8 +286,6 @@ int WaveGPXDLL_LoadRouteGPX( WaveGPXPtr GPX, WaveGPXRouteDLL* Route, const char*
 	Route->Stat_DifficultyScore = Temp->Stat_DifficultyScore;
 	Route->Stat_HighestAlt = Temp->Stat_HighestAlt;
 	Route->Stat_LowestAlt = Temp->Stat_LowestAlt;
-
-	return 1;
 }
 
 void WaveGPXDLL_ReleaseRouteGPX( WaveGPXRouteDLL* Route )
@@ -259,6 +297,245 @@ void WaveGPXDLL_ReleaseRouteGPX( WaveGPXRouteDLL* Route )
 	}
 }
 
+int WaveGPXDLL_LoadCompactRouteGPX( WaveGPXPtr GPX, WaveGPXCompactRouteDLL* Route, const char* FileName )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+
+	FWaveGPXCompactRoute* Temp = ( FWaveGPXCompactRoute* ) Route->InternalObject;
+	if ( !Route->InternalObject ) {
+		Temp = new FWaveGPXCompactRoute();
+		Route->InternalObject = ( FWaveGPXCompactRoute* ) Temp;
+	}
+
+	if ( !G->LoadRouteGPX( *Temp, FileName ) )
+		return 0;
+
+	Route->Name = Temp->Name.c_str();
+	Route->Description = Temp->Description.c_str();
+	Route->Author = Temp->Author.c_str();
+	Route->SourceFile = Temp->SourceFile.c_str();
+
+	Route->NumPoints = Temp->GetNumPoints();
+	Route->Lat = Temp->Lat.data();
+	Route->Lon = Temp->Lon.data();
+	Route->Alt = Temp->Alt.data();
+	Route->East = Temp->East.data();
+	Route->North = Temp->North.data();
+	Route->Up = Temp->Up.data();
+	Route->Dist = Temp->Dist.data();
+
+	Route->ChunkSize = WAVEGPX_COMPACT_CHUNK_SIZE;
+	Route->NumChunks = ( int ) Temp->ChunkDist.size();
+	Route->ChunkEast = Temp->ChunkEast.data();
+	Route->ChunkNorth = Temp->ChunkNorth.data();
+	Route->ChunkUp = Temp->ChunkUp.data();
+	Route->ChunkDist = Temp->ChunkDist.data();
+
+	Route->Stat_Elev = Temp->Stat_Elev;
+	Route->Stat_Length = Temp->Stat_Length;
+	Route->Stat_HillinessRating = Temp->Stat_HillinessRating;
+	Route->Stat_DifficultyScore = Temp->Stat_DifficultyScore;
+	Route->Stat_HighestAlt = Temp->Stat_HighestAlt;
+	Route->Stat_LowestAlt = Temp->Stat_LowestAlt;
+	return 1;
+}
+
+void WaveGPXDLL_ReleaseCompactRouteGPX( WaveGPXCompactRouteDLL* Route )
+{
+	if ( Route->InternalObject ) {
+		FWaveGPXCompactRoute* Temp = ( FWaveGPXCompactRoute* ) Route->InternalObject;
+		delete Temp;
+		Route->InternalObject = nullptr;
+	}
+}
+
+// Runs WaveGPX::LoadRouteDirectory on its own thread, so the frontend can poll progress without blocking.
+struct WaveGPXDLL_LoadJob
+{
+	uint32_t MagicID = WAVEGPX_LOADJOB_MAGIC_ID;
+	std::thread Thread;
+	std::atomic< bool > Cancel = false;
+	std::atomic< bool > Done = false;
+	std::atomic< int > NumFiles = 0;
+	std::atomic< int > NumLoaded = 0;
+	std::atomic< int > NumFailed = 0;
+
+	// Deque, so the strings handed out by GetFailedFile stay put as more are added.
+	std::mutex FailedFilesMutex;
+	std::deque< std::string > FailedFiles;
+};
+
+static WaveGPXLoadJobPtr WaveGPXDLL_StartLoadJob( WaveGPXPtr GPX, const char* Path, bool ScanOnly )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+	assert( Path );
+
+	auto Job = new WaveGPXDLL_LoadJob();
+	Job->Thread = std::thread( [G, Job, ScanOnly, DirectoryPath = std::string( Path )]()
+	{
+		auto Callback = [Job]( const FWaveGPXLoadProgress& Progress )
+		{
+			if ( !Progress.Success ) {
+				std::lock_guard< std::mutex > FailedFilesLock( Job->FailedFilesMutex );
+				Job->FailedFiles.push_back( Progress.FileName );
+			}
+			Job->NumFiles = Progress.NumFiles;
+			Job->NumLoaded = Progress.NumLoaded;
+			Job->NumFailed = Progress.NumFailed;
+		};
+		if ( ScanOnly ) {
+			G->ScanRouteDirectory( DirectoryPath, Callback, &Job->Cancel );
+		} else {
+			G->LoadRouteDirectory( DirectoryPath, Callback, &Job->Cancel );
+		}
+		Job->Done = true;
+	} );
+	return Job;
+}
+
+WaveGPXLoadJobPtr WaveGPXDLL_LoadRouteDirectoryStart( WaveGPXPtr GPX, const char* Path )
+{
+	return WaveGPXDLL_StartLoadJob( GPX, Path, false );
+}
+
+WaveGPXLoadJobPtr WaveGPXDLL_ScanRouteDirectoryStart( WaveGPXPtr GPX, const char* Path )
+{
+	return WaveGPXDLL_StartLoadJob( GPX, Path, true );
+}
+
+int WaveGPXDLL_LoadRouteDirectoryPoll( WaveGPXLoadJobPtr LoadJob, WaveGPXLoadProgressDLL* Progress )
+{
+	auto Job = ( WaveGPXDLL_LoadJob* ) LoadJob;
+	assert( Job && Job->MagicID == WAVEGPX_LOADJOB_MAGIC_ID );
+
+	// Read Done first, so a finished job never reports stale counts.
+	bool Done = Job->Done;
+	if ( Progress ) {
+		Progress->NumFiles = Job->NumFiles;
+		Progress->NumLoaded = Job->NumLoaded;
+		Progress->NumFailed = Job->NumFailed;
+		Progress->Done = Done;
+	}
+	return Done;
+}
+
+void WaveGPXDLL_LoadRouteDirectoryCancel( WaveGPXLoadJobPtr LoadJob )
+{
+	auto Job = ( WaveGPXDLL_LoadJob* ) LoadJob;
+	assert( Job && Job->MagicID == WAVEGPX_LOADJOB_MAGIC_ID );
+	Job->Cancel = true;
+}
+
+const char* WaveGPXDLL_LoadRouteDirectoryGetFailedFile( WaveGPXLoadJobPtr LoadJob, int Index )
+{
+	auto Job = ( WaveGPXDLL_LoadJob* ) LoadJob;
+	assert( Job && Job->MagicID == WAVEGPX_LOADJOB_MAGIC_ID );
+
+	std::lock_guard< std::mutex > FailedFilesLock( Job->FailedFilesMutex );
+	if ( Index < 0 || Index >= ( int ) Job->FailedFiles.size() )
+		return nullptr;
+	return Job->FailedFiles[ Index ].c_str();
+}
+
+void WaveGPXDLL_LoadRouteDirectoryRelease( WaveGPXLoadJobPtr LoadJob )
+{
+	auto Job = ( WaveGPXDLL_LoadJob* ) LoadJob;
+	assert( Job && Job->MagicID == WAVEGPX_LOADJOB_MAGIC_ID );
+	Job->Cancel = true;
+	if ( Job->Thread.joinable() ) {
+		Job->Thread.join();
+	}
+	delete Job;
+}
+
+int WaveGPXDLL_GetNumLoadedRoutes( WaveGPXPtr GPX )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+	return ( int ) G->GetLoadedRoutes().size();
+}
+
+int WaveGPXDLL_GetLoadedRoute( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+
+	auto& LoadedRoutes = G->GetLoadedRoutes();
+	if ( Index < 0 || Index >= ( int ) LoadedRoutes.size() )
+		return 0;
+
+	FWaveGPXRoute* Temp = ( FWaveGPXRoute* ) Route->InternalObject;
+	if ( !Route->InternalObject ) {
+		Temp = new FWaveGPXRoute();
+		Route->InternalObject = ( FWaveGPXRoute* ) Temp;
+	}
+	*Temp = LoadedRoutes[ Index ];
+	WaveGPXDLL_FillRoute( Route, Temp );
+	return 1;
+}
+
+int WaveGPXDLL_GetNumCatalogEntries( WaveGPXPtr GPX )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+	return ( int ) G->GetCatalog().size();
+}
+
+int WaveGPXDLL_GetCatalogEntry( WaveGPXPtr GPX, int Index, WaveGPXCatalogEntryDLL* Entry )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+
+	auto& Catalog = G->GetCatalog();
+	if ( Index < 0 || Index >= ( int ) Catalog.size() )
+		return 0;
+
+	auto& CatalogEntry = Catalog[ Index ];
+	Entry->Name = CatalogEntry.Name.c_str();
+	Entry->Description = CatalogEntry.Description.c_str();
+	Entry->Author = CatalogEntry.Author.c_str();
+	Entry->SourceFile = CatalogEntry.SourceFile.c_str();
+	Entry->NumPoints = CatalogEntry.NumPoints;
+
+	Entry->Stat_Elev = CatalogEntry.Stat_Elev;
+	Entry->Stat_Length = CatalogEntry.Stat_Length;
+	Entry->Stat_HillinessRating = CatalogEntry.Stat_HillinessRating;
+	Entry->Stat_DifficultyScore = CatalogEntry.Stat_DifficultyScore;
+	Entry->Stat_HighestAlt = CatalogEntry.Stat_HighestAlt;
+	Entry->Stat_LowestAlt = CatalogEntry.Stat_LowestAlt;
+	return 1;
+}
+
+int WaveGPXDLL_LoadCatalogRoute( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+
+	auto& Catalog = G->GetCatalog();
+	if ( Index < 0 || Index >= ( int ) Catalog.size() )
+		return 0;
+
+	FWaveGPXRoute* Temp = ( FWaveGPXRoute* ) Route->InternalObject;
+	if ( !Route->InternalObject ) {
+		Temp = new FWaveGPXRoute();
+		Route->InternalObject = ( FWaveGPXRoute* ) Temp;
+	}
+	if ( !G->LoadCatalogRoute( *Temp, Catalog[ Index ] ) )
+		return 0;
+
+	WaveGPXDLL_FillRoute( Route, Temp );
+	return 1;
+}
+
+void WaveGPXDLL_ClearCatalog( WaveGPXPtr GPX )
+{
+	auto G = ( WaveGPX* ) GPX;
+	assert( G && G->MagicID == WaveGPX_MAGIC_ID );
+	G->ClearCatalog();
+}
+
 WaveGPXRecordPtr WaveGPXDLL_CreateRecord( WaveGPXPtr GPX )
 {
 	auto G = ( WaveGPX* ) GPX;
@@ -327,4 +604,97 @@ void WaveGPXDLL_FillLLAFromENU( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point )
 	auto PointInternal = ( FWaveGPXPoint* ) Point;
 	auto RouteSrcInfo = ( const FWaveGPXRoute* ) Route->InternalObject;
 	WaveRouteUtil_FillLLAFromENU( *RouteSrcInfo, *PointInternal );
+}
+
+void WaveGPXDLL_FillENUFromLLAArray( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints )
+{
+	assert( sizeof( WaveGPXPointDLL ) == sizeof( FWaveGPXPoint ) );
+	auto RouteSrcInfo = ( const FWaveGPXRoute* ) Route->InternalObject;
+	WaveRouteUtil_FillENUFromLLA( *RouteSrcInfo, ( FWaveGPXPoint* ) Points, NumPoints );
+}
+
+void WaveGPXDLL_FillLLAFromENUArray( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints )
+{
+	assert( sizeof( WaveGPXPointDLL ) == sizeof( FWaveGPXPoint ) );
+	auto RouteSrcInfo = ( const FWaveGPXRoute* ) Route->InternalObject;
+	WaveRouteUtil_FillLLAFromENU( *RouteSrcInfo, ( FWaveGPXPoint* ) Points, NumPoints );
+}
+
+void WaveGPXDLL_LLAToENU( WaveGPXRouteDLL* Route, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, int Count )
+{
+	FWaveGPXGeoFrame TempFrame;
+	auto& Frame = WaveRouteUtil_GetGeoFrame( *( const FWaveGPXRoute* ) Route->InternalObject, TempFrame );
+	WaveGPXGeo_LLAToENU( Frame, Lat, Lon, Alt, East, North, Up, Count );
+}
+
+void WaveGPXDLL_ENUToLLA( WaveGPXRouteDLL* Route, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, int Count )
+{
+	FWaveGPXGeoFrame TempFrame;
+	auto& Frame = WaveRouteUtil_GetGeoFrame( *( const FWaveGPXRoute* ) Route->InternalObject, TempFrame );
+	WaveGPXGeo_ENUToLLA( Frame, East, North, Up, Lat, Lon, Alt, Count );
+}
+
+float WaveGPXDLL_FindNearestDistOnRoute( WaveGPXRouteDLL* Route, double East, double North, float HintDist, float* OffRouteDist )
+{
+	auto RouteInternal = ( const FWaveGPXRoute* ) Route->InternalObject;
+	return WaveRouteUtil_FindNearestDistOnRoute( *RouteInternal, East, North, HintDist, OffRouteDist );
+}
+
+struct WaveGPXDLL_RouteCursor
+{
+	WaveGPXDLL_RouteCursor( const FWaveGPXRoute& Route, float GradeSmoothness )
+		: Cursor( Route, GradeSmoothness )
+	{
+	}
+
+	uint32_t MagicID = WAVEGPX_CURSOR_MAGIC_ID;
+	WaveRouteCursor Cursor;
+};
+
+WaveGPXRouteCursorPtr WaveGPXDLL_CreateRouteCursor( WaveGPXRouteDLL* Route, float GradeSmoothness )
+{
+	auto RouteInternal = ( const FWaveGPXRoute* ) Route->InternalObject;
+	return new WaveGPXDLL_RouteCursor( *RouteInternal, GradeSmoothness );
+}
+
+void WaveGPXDLL_ReleaseRouteCursor( WaveGPXRouteCursorPtr Cursor )
+{
+	auto C = ( WaveGPXDLL_RouteCursor* ) Cursor;
+	assert( C && C->MagicID == WAVEGPX_CURSOR_MAGIC_ID );
+	delete C;
+}
+
+void WaveGPXDLL_RouteCursorSetDist( WaveGPXRouteCursorPtr Cursor, float Dist, WaveGPXRouteCursorStateDLL* State )
+{
+	auto C = ( WaveGPXDLL_RouteCursor* ) Cursor;
+	assert( C && C->MagicID == WAVEGPX_CURSOR_MAGIC_ID );
+	assert( sizeof( WaveGPXPointDLL ) == sizeof( FWaveGPXPoint ) );
+	C->Cursor.SetDist( Dist );
+	if ( State ) {
+		State->Position = *reinterpret_cast< const WaveGPXPointDLL* >( &C->Cursor.GetPosition() );
+		State->Grade = C->Cursor.GetGrade();
+		State->Heading = C->Cursor.GetHeading();
+		State->PointIndex = C->Cursor.GetPointIndex();
+	}
+}
+
+void WaveGPXDLL_RouteCursorGetSplineSample( WaveGPXRouteCursorPtr Cursor, WaveGPXSplineSampleDLL* Sample )
+{
+	auto C = ( WaveGPXDLL_RouteCursor* ) Cursor;
+	assert( C && C->MagicID == WAVEGPX_CURSOR_MAGIC_ID );
+	assert( sizeof( WaveGPXSplineSampleDLL ) == sizeof( FWaveGPXSplineSample ) );
+	*Sample = *reinterpret_cast< const WaveGPXSplineSampleDLL* >( &C->Cursor.GetSplineSample() );
+}
+
+void WaveGPXDLL_SampleRoute( WaveGPXRouteDLL* Route, const float* Dists, int NumDists, float GradeSmoothness, double* Alt, float* Grade, double* East, double* North )
+{
+	auto RouteInternal = ( const FWaveGPXRoute* ) Route->InternalObject;
+	WaveRouteUtil_SampleRoute( *RouteInternal, Dists, NumDists, Alt, Grade, East, North, GradeSmoothness );
+}
+
+void WaveGPXDLL_GetRouteLODView( WaveGPXRouteDLL* Route, float StartDist, float EndDist, int NumPixels, WaveGPXLODBucketDLL* Pixels )
+{
+	assert( sizeof( WaveGPXLODBucketDLL ) == sizeof( FWaveGPXLODBucket ) );
+	auto RouteInternal = ( const FWaveGPXRoute* ) Route->InternalObject;
+	WaveRouteUtil_GetLODView( *RouteInternal, StartDist, EndDist, reinterpret_cast< FWaveGPXLODBucket* >( Pixels ), NumPixels );
 }
\ No newline at end of file
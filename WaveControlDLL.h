@@ -48,6 +48,12 @@ extern "C" {
 
 	__declspec( dllexport ) void WaveControlDLL_SetSensorWriteState( WaveControlPtr Cntl, WaveCycleSensorWriteStateDLL* WriteState );
 
+	__declspec( dllexport ) void WaveControlDLL_GetSensorSnapshot( WaveControlPtr Cntl, WaveCycleSensorSnapshotDLL* Snapshot );
+
+	__declspec( dllexport ) uint64_t WaveControlDLL_GetSensorSnapshotVersion( WaveControlPtr Cntl );
+
+	__declspec( dllexport ) int WaveControlDLL_DrainSensorSamples( WaveControlPtr Cntl, int Metric, uint64_t SinceVersion, WaveSensorSampleDLL* Samples, int MaxSamples );
+
 	// --------------------------------------------------------------------------------------------------------------------------
 
 	__declspec( dllexport ) WaveSimulationPtr WaveSimulationDLL_Init( void );
@@ -78,6 +84,34 @@ extern "C" {
 
 	__declspec( dllexport ) void WaveGPXDLL_ReleaseRouteGPX( WaveGPXRouteDLL* Route );
 
+	__declspec( dllexport ) int WaveGPXDLL_LoadCompactRouteGPX( WaveGPXPtr GPX, WaveGPXCompactRouteDLL* Route, const char* FileName );
+
+	__declspec( dllexport ) void WaveGPXDLL_ReleaseCompactRouteGPX( WaveGPXCompactRouteDLL* Route );
+
+	__declspec( dllexport ) WaveGPXLoadJobPtr WaveGPXDLL_LoadRouteDirectoryStart( WaveGPXPtr GPX, const char* Path );
+
+	__declspec( dllexport ) int WaveGPXDLL_LoadRouteDirectoryPoll( WaveGPXLoadJobPtr Job, WaveGPXLoadProgressDLL* Progress );
+
+	__declspec( dllexport ) void WaveGPXDLL_LoadRouteDirectoryCancel( WaveGPXLoadJobPtr Job );
+
+	__declspec( dllexport ) const char* WaveGPXDLL_LoadRouteDirectoryGetFailedFile( WaveGPXLoadJobPtr Job, int Index );
+
+	__declspec( dllexport ) void WaveGPXDLL_LoadRouteDirectoryRelease( WaveGPXLoadJobPtr Job );
+
+	__declspec( dllexport ) int WaveGPXDLL_GetNumLoadedRoutes( WaveGPXPtr GPX );
+
+	__declspec( dllexport ) int WaveGPXDLL_GetLoadedRoute( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route );
+
+	__declspec( dllexport ) WaveGPXLoadJobPtr WaveGPXDLL_ScanRouteDirectoryStart( WaveGPXPtr GPX, const char* Path );
+
+	__declspec( dllexport ) int WaveGPXDLL_GetNumCatalogEntries( WaveGPXPtr GPX );
+
+	__declspec( dllexport ) int WaveGPXDLL_GetCatalogEntry( WaveGPXPtr GPX, int Index, WaveGPXCatalogEntryDLL* Entry );
+
+	__declspec( dllexport ) int WaveGPXDLL_LoadCatalogRoute( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route );
+
+	__declspec( dllexport ) void WaveGPXDLL_ClearCatalog( WaveGPXPtr GPX );
+
 	__declspec( dllexport ) WaveGPXRecordPtr WaveGPXDLL_CreateRecord( WaveGPXPtr GPX );
 
 	__declspec( dllexport ) void WaveGPXDLL_ReleaseRecord( WaveGPXPtr GPX, WaveGPXRecordPtr Rec );
@@ -91,5 +125,27 @@ extern "C" {
 	__declspec( dllexport ) void WaveGPXDLL_FillENUFromLLA( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point );
 
 	__declspec( dllexport ) void WaveGPXDLL_FillLLAFromENU( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point );
+
+	__declspec( dllexport ) void WaveGPXDLL_FillENUFromLLAArray( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints );
+
+	__declspec( dllexport ) void WaveGPXDLL_FillLLAFromENUArray( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints );
+
+	__declspec( dllexport ) void WaveGPXDLL_LLAToENU( WaveGPXRouteDLL* Route, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, int Count );
+
+	__declspec( dllexport ) void WaveGPXDLL_ENUToLLA( WaveGPXRouteDLL* Route, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, int Count );
+
+	__declspec( dllexport ) float WaveGPXDLL_FindNearestDistOnRoute( WaveGPXRouteDLL* Route, double East, double North, float HintDist, float* OffRouteDist );
+
+	__declspec( dllexport ) WaveGPXRouteCursorPtr WaveGPXDLL_CreateRouteCursor( WaveGPXRouteDLL* Route, float GradeSmoothness );
+
+	__declspec( dllexport ) void WaveGPXDLL_ReleaseRouteCursor( WaveGPXRouteCursorPtr Cursor );
+
+	__declspec( dllexport ) void WaveGPXDLL_RouteCursorSetDist( WaveGPXRouteCursorPtr Cursor, float Dist, WaveGPXRouteCursorStateDLL* State );
+
+	__declspec( dllexport ) void WaveGPXDLL_RouteCursorGetSplineSample( WaveGPXRouteCursorPtr Cursor, WaveGPXSplineSampleDLL* Sample );
+
+	__declspec( dllexport ) void WaveGPXDLL_SampleRoute( WaveGPXRouteDLL* Route, const float* Dists, int NumDists, float GradeSmoothness, double* Alt, float* Grade, double* East, double* North );
+
+	__declspec( dllexport ) void WaveGPXDLL_GetRouteLODView( WaveGPXRouteDLL* Route, float StartDist, float EndDist, int NumPixels, WaveGPXLODBucketDLL* Pixels );
 }
 
@@ -33,6 +33,26 @@ extern "C" {
 		float Power = -1.0f; // Watts
 	};
 
+	// Keep in sync with WaveDevice.h!
+	struct WaveCycleSensorSnapshotDLL
+	{
+		uint64_t Version = 0;
+		WaveCycleSensorReadStateDLL State;
+		uint64_t HR_TimeNS = 0;
+		uint64_t Speed_TimeNS = 0;
+		uint64_t Cadence_TimeNS = 0;
+		uint64_t Power_TimeNS = 0;
+		uint64_t ReadTimeNS = 0;
+	};
+
+	// Keep in sync with WaveDevice.h!
+	struct WaveSensorSampleDLL
+	{
+		uint64_t Version = 0;
+		uint64_t TimeNS = 0;
+		float Value = 0.0f;
+	};
+
 	// Keep in sync with WaveDevice.h!
 	struct WaveCycleSensorWriteStateDLL
 	{
@@ -41,6 +61,7 @@ extern "C" {
 		float WindResistance = 0.6f; // 0.01 Kg/m
 		float WindSpeed = 0.0f; // m/s
 		float Gradient = 0.0f; // %
+		float TargetPower = 0.0f; // Watts. ERG mode when > 0; the trainer holds this power and ignores the simulation.
 	};
 
 	struct WaveControlDLL
@@ -69,6 +90,12 @@ extern "C" {
 		WaveCycleSensorWriteStateDLL( *GetSensorWriteState )( WaveControlPtr Cntl );
 
 		void ( *SetSensorWriteState )( WaveControlPtr Cntl, WaveCycleSensorWriteStateDLL* WriteState );
+
+		void ( *GetSensorSnapshot )( WaveControlPtr Cntl, WaveCycleSensorSnapshotDLL* Snapshot );
+
+		uint64_t ( *GetSensorSnapshotVersion )( WaveControlPtr Cntl );
+
+		int ( *DrainSensorSamples )( WaveControlPtr Cntl, int Metric, uint64_t SinceVersion, WaveSensorSampleDLL* Samples, int MaxSamples );
 	};
 
 	// --------------------------------------------------------------------------------------------------------------------------
@@ -115,6 +142,8 @@ extern "C" {
 
 	typedef void* WaveGPXPtr;
 	typedef void* WaveGPXRecordPtr;
+	typedef void* WaveGPXLoadJobPtr;
+	typedef void* WaveGPXRouteCursorPtr;
 
 	struct WaveGPXPointDLL
 	{
@@ -151,6 +180,98 @@ extern "C" {
 		void* InternalObject = nullptr;
 	};
 
+	// Structure of arrays route. East / North / Up / Dist of point i are relative to Chunk*[ i / ChunkSize ].
+	// Lat / Lon are in units of 1e-7 degrees.
+	struct WaveGPXCompactRouteDLL
+	{
+		// Owned by DLL memory. Do not touch!
+		const char* Name;
+		const char* Description;
+		const char* Author;
+		const char* SourceFile;
+
+		// Owned by DLL memory. Do not touch!
+		int NumPoints;
+		const int32_t* Lat;
+		const int32_t* Lon;
+		const float* Alt;
+		const float* East;
+		const float* North;
+		const float* Up;
+		const float* Dist;
+
+		// Owned by DLL memory. Do not touch!
+		int ChunkSize;
+		int NumChunks;
+		const double* ChunkEast;
+		const double* ChunkNorth;
+		const double* ChunkUp;
+		const double* ChunkDist;
+
+		float Stat_Elev = 0.0f;
+		float Stat_Length = 1.0f;
+		float Stat_HillinessRating = 0.0f;
+		float Stat_DifficultyScore = 0.0f;
+		float Stat_HighestAlt = 0.0f;
+		float Stat_LowestAlt = 0.0f;
+
+		void* InternalObject = nullptr;
+	};
+
+	struct WaveGPXCatalogEntryDLL
+	{
+		// Owned by DLL memory, valid until the catalog is cleared or rescanned. Do not touch!
+		const char* Name;
+		const char* Description;
+		const char* Author;
+		const char* SourceFile;
+		int NumPoints;
+
+		float Stat_Elev = 0.0f;
+		float Stat_Length = 1.0f;
+		float Stat_HillinessRating = 0.0f;
+		float Stat_DifficultyScore = 0.0f;
+		float Stat_HighestAlt = 0.0f;
+		float Stat_LowestAlt = 0.0f;
+	};
+
+	struct WaveGPXRouteCursorStateDLL
+	{
+		WaveGPXPointDLL Position;
+		float Grade = 0.0f;
+		float Heading = 0.0f;
+		int PointIndex = 0;
+	};
+
+	struct WaveGPXSplineSampleDLL
+	{
+		WaveGPXPointDLL Position;
+		double TangentEast = 0.0;
+		double TangentNorth = 0.0;
+		double TangentUp = 0.0;
+		float Curvature = 0.0f;
+		float Grade = 0.0f;
+		float Heading = 0.0f;
+	};
+
+	struct WaveGPXLODBucketDLL
+	{
+		float MinAlt = 0.0f;
+		float MaxAlt = 0.0f;
+		float AvgAlt = 0.0f;
+		float MinGrade = 0.0f;
+		float MaxGrade = 0.0f;
+		float AvgGrade = 0.0f;
+	};
+
+	struct WaveGPXLoadProgressDLL
+	{
+		int NumFiles = 0;
+		int NumLoaded = 0;
+		int NumFailed = 0;
+		int Done = 0;
+	};
+
 	struct WaveGPXDLL
 	{
 		WaveGPXPtr (*Init) ( void );
@@ -161,6 +282,39 @@ extern "C" {
 
 		void (*ReleaseRouteGPX) ( WaveGPXRouteDLL* Route );
 
+		int (*LoadCompactRouteGPX) ( WaveGPXPtr GPX, WaveGPXCompactRouteDLL* Route, const char* FileName );
+
+		void (*ReleaseCompactRouteGPX) ( WaveGPXCompactRouteDLL* Route );
+
+		// Loads every .gpx under Path in the background, into the GPX object's loaded routes. Poll until Done, then
+		// fetch routes with GetLoadedRoute. Release cancels the job if it is still running.
+		WaveGPXLoadJobPtr (*LoadRouteDirectoryStart) ( WaveGPXPtr GPX, const char* Path );
+
+		int (*LoadRouteDirectoryPoll) ( WaveGPXLoadJobPtr Job, WaveGPXLoadProgressDLL* Progress );
+
+		void (*LoadRouteDirectoryCancel) ( WaveGPXLoadJobPtr Job );
+
+		// Owned by DLL memory, valid until the job is released. Returns null past the last failed file.
+		const char* (*LoadRouteDirectoryGetFailedFile) ( WaveGPXLoadJobPtr Job, int Index );
+
+		void (*LoadRouteDirectoryRelease) ( WaveGPXLoadJobPtr Job );
+
+		int (*GetNumLoadedRoutes) ( WaveGPXPtr GPX );
+
+		int (*GetLoadedRoute) ( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route );
+
+		// Same as LoadRouteDirectoryStart, but only reads names and stats into the GPX object's catalog. Use
+		// LoadCatalogRoute to load the full route the rider picks.
+		WaveGPXLoadJobPtr (*ScanRouteDirectoryStart) ( WaveGPXPtr GPX, const char* Path );
+
+		int (*GetNumCatalogEntries) ( WaveGPXPtr GPX );
+
+		int (*GetCatalogEntry) ( WaveGPXPtr GPX, int Index, WaveGPXCatalogEntryDLL* Entry );
+
+		int (*LoadCatalogRoute) ( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route );
+
+		void (*ClearCatalog) ( WaveGPXPtr GPX );
+
 		WaveGPXRecordPtr (*CreateRecord) ( WaveGPXPtr GPX );
 
 		void (*ReleaseRecord) ( WaveGPXPtr GPX, WaveGPXRecordPtr Rec );
@@ -174,6 +328,39 @@ extern "C" {
 		void (*FillENUFromLLA) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point );
 
 		void (*FillLLAFromENU) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point );
+
+		// Batch conversions in the route's ENU frame, either in place on an array of points or between separate
+		// arrays of Count values.
+		void (*FillENUFromLLAArray) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints );
+
+		void (*FillLLAFromENUArray) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints );
+
+		void (*LLAToENU) ( WaveGPXRouteDLL* Route, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, int Count );
+
+		void (*ENUToLLA) ( WaveGPXRouteDLL* Route, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, int Count );
+
+		// Distance along the route nearest to East / North. Pass the rider's last distance as HintDist ( or -1 ) to
+		// pick the right pass where the route overlaps itself.
+		float (*FindNearestDistOnRoute) ( WaveGPXRouteDLL* Route, double East, double North, float HintDist, float* OffRouteDist );
+
+		// One cursor per rider. Route must stay loaded until the cursor is released. Each SetDist fills State with
+		// the position, grade and heading at Dist.
+		WaveGPXRouteCursorPtr (*CreateRouteCursor) ( WaveGPXRouteDLL* Route, float GradeSmoothness );
+
+		void (*ReleaseRouteCursor) ( WaveGPXRouteCursorPtr Cursor );
+
+		void (*RouteCursorSetDist) ( WaveGPXRouteCursorPtr Cursor, float Dist, WaveGPXRouteCursorStateDLL* State );
+
+		// Position, tangent, curvature, grade and heading from the route's spline, at the cursor's last SetDist.
+		void (*RouteCursorGetSplineSample) ( WaveGPXRouteCursorPtr Cursor, WaveGPXSplineSampleDLL* Sample );
+
+		// Alt, Grade, East and North at each of Dists in one pass, for drawing elevation profiles and the like.
+		// Sorted Dists are fastest. Pass null for any output that isn't needed.
+		void (*SampleRoute) ( WaveGPXRouteDLL* Route, const float* Dists, int NumDists, float GradeSmoothness, double* Alt, float* Grade, double* East, double* North );
+
+		// Lowest, highest and average altitude and grade over each of NumPixels equal stretches from StartDist to
+		// EndDist, for elevation profiles at any zoom. Costs the same however long the route is.
+		void (*GetRouteLODView) ( WaveGPXRouteDLL* Route, float StartDist, float EndDist, int NumPixels, WaveGPXLODBucketDLL* Pixels );
 	};
 
 }
@@ -204,6 +391,9 @@ inline bool WaveControl_LoadDLL( WaveControl_LoadDLLInterface& I, WaveControlDLL
 	W->GetSensorReadState = ( WaveCycleSensorReadStateDLL( * ) ( WaveControlPtr Cntl ) ) I.GetFunc( LibHandle, "WaveControlDLL_GetSensorReadState" );
 	W->GetSensorWriteState = ( WaveCycleSensorWriteStateDLL( * )( WaveControlPtr Cntl ) ) I.GetFunc( LibHandle, "WaveControlDLL_GetSensorWriteState" );
 	W->SetSensorWriteState = ( void ( * )( WaveControlPtr Cntl, WaveCycleSensorWriteStateDLL * WriteState ) ) I.GetFunc( LibHandle, "WaveControlDLL_SetSensorWriteState" );
+	W->GetSensorSnapshot = ( void ( * )( WaveControlPtr Cntl, WaveCycleSensorSnapshotDLL * Snapshot ) ) I.GetFunc( LibHandle, "WaveControlDLL_GetSensorSnapshot" );
+	W->GetSensorSnapshotVersion = ( uint64_t ( * )( WaveControlPtr Cntl ) ) I.GetFunc( LibHandle, "WaveControlDLL_GetSensorSnapshotVersion" );
+	W->DrainSensorSamples = ( int ( * )( WaveControlPtr Cntl, int Metric, uint64_t SinceVersion, WaveSensorSampleDLL * Samples, int MaxSamples ) ) I.GetFunc( LibHandle, "WaveControlDLL_DrainSensorSamples" );
 
 	S->Init = ( WaveSimulationPtr( * )( void ) ) I.GetFunc( LibHandle, "WaveSimulationDLL_Init" );
 	S->Release = ( void( * )( WaveSimulationPtr Sim ) ) I.GetFunc( LibHandle, "WaveSimulationDLL_Release" );
@@ -219,6 +409,20 @@ inline bool WaveControl_LoadDLL( WaveControl_LoadDLLInterface& I, WaveControlDLL
 	G->Release = ( void (*) ( WaveGPXPtr GPX ) ) I.GetFunc( LibHandle, "WaveGPXDLL_Release");
 	G->LoadRouteGPX = ( int (*) ( WaveGPXPtr GPX, WaveGPXRouteDLL* Route, const char* FileName ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteGPX");
 	G->ReleaseRouteGPX = ( void (*) ( WaveGPXRouteDLL* Route ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ReleaseRouteGPX");
+	G->LoadCompactRouteGPX = ( int (*) ( WaveGPXPtr GPX, WaveGPXCompactRouteDLL* Route, const char* FileName ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadCompactRouteGPX");
+	G->ReleaseCompactRouteGPX = ( void (*) ( WaveGPXCompactRouteDLL* Route ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ReleaseCompactRouteGPX");
+	G->LoadRouteDirectoryStart = ( WaveGPXLoadJobPtr (*) ( WaveGPXPtr GPX, const char* Path ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteDirectoryStart");
+	G->LoadRouteDirectoryPoll = ( int (*) ( WaveGPXLoadJobPtr Job, WaveGPXLoadProgressDLL* Progress ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteDirectoryPoll");
+	G->LoadRouteDirectoryCancel = ( void (*) ( WaveGPXLoadJobPtr Job ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteDirectoryCancel");
+	G->LoadRouteDirectoryGetFailedFile = ( const char* (*) ( WaveGPXLoadJobPtr Job, int Index ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteDirectoryGetFailedFile");
+	G->LoadRouteDirectoryRelease = ( void (*) ( WaveGPXLoadJobPtr Job ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadRouteDirectoryRelease");
+	G->GetNumLoadedRoutes = ( int (*) ( WaveGPXPtr GPX ) ) I.GetFunc( LibHandle, "WaveGPXDLL_GetNumLoadedRoutes");
+	G->GetLoadedRoute = ( int (*) ( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route ) ) I.GetFunc( LibHandle, "WaveGPXDLL_GetLoadedRoute");
+	G->ScanRouteDirectoryStart = ( WaveGPXLoadJobPtr (*) ( WaveGPXPtr GPX, const char* Path ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ScanRouteDirectoryStart");
+	G->GetNumCatalogEntries = ( int (*) ( WaveGPXPtr GPX ) ) I.GetFunc( LibHandle, "WaveGPXDLL_GetNumCatalogEntries");
+	G->GetCatalogEntry = ( int (*) ( WaveGPXPtr GPX, int Index, WaveGPXCatalogEntryDLL* Entry ) ) I.GetFunc( LibHandle, "WaveGPXDLL_GetCatalogEntry");
+	G->LoadCatalogRoute = ( int (*) ( WaveGPXPtr GPX, int Index, WaveGPXRouteDLL* Route ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LoadCatalogRoute");
+	G->ClearCatalog = ( void (*) ( WaveGPXPtr GPX ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ClearCatalog");
 	G->CreateRecord = ( WaveGPXRecordPtr (*) ( WaveGPXPtr GPX ) ) I.GetFunc( LibHandle, "WaveGPXDLL_CreateRecord");
 	G->ReleaseRecord = ( void (*) ( WaveGPXPtr GPX, WaveGPXRecordPtr Rec ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ReleaseRecord");
 	G->RecordStart = ( void (*) ( WaveGPXPtr GPX, WaveGPXRecordPtr Record, const WaveGPXRouteDLL* SrcInfo ) ) I.GetFunc( LibHandle, "WaveGPXDLL_RecordStart");
@@ -226,6 +430,17 @@ inline bool WaveControl_LoadDLL( WaveControl_LoadDLLInterface& I, WaveControlDLL
 	G->RecordFinish = ( bool (*) ( WaveGPXPtr GPX, WaveGPXRecordPtr Record, const char* FileName ) ) I.GetFunc( LibHandle, "WaveGPXDLL_RecordFinish");
 	G->FillENUFromLLA = ( void (*) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point ) ) I.GetFunc( LibHandle, "WaveGPXDLL_FillENUFromLLA");
 	G->FillLLAFromENU = ( void (*) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Point ) ) I.GetFunc( LibHandle, "WaveGPXDLL_FillLLAFromENU");
+	G->FillENUFromLLAArray = ( void (*) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints ) ) I.GetFunc( LibHandle, "WaveGPXDLL_FillENUFromLLAArray");
+	G->FillLLAFromENUArray = ( void (*) ( WaveGPXRouteDLL* Route, WaveGPXPointDLL* Points, int NumPoints ) ) I.GetFunc( LibHandle, "WaveGPXDLL_FillLLAFromENUArray");
+	G->LLAToENU = ( void (*) ( WaveGPXRouteDLL* Route, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, int Count ) ) I.GetFunc( LibHandle, "WaveGPXDLL_LLAToENU");
+	G->ENUToLLA = ( void (*) ( WaveGPXRouteDLL* Route, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, int Count ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ENUToLLA");
+	G->FindNearestDistOnRoute = ( float (*) ( WaveGPXRouteDLL* Route, double East, double North, float HintDist, float* OffRouteDist ) ) I.GetFunc( LibHandle, "WaveGPXDLL_FindNearestDistOnRoute");
+	G->CreateRouteCursor = ( WaveGPXRouteCursorPtr (*) ( WaveGPXRouteDLL* Route, float GradeSmoothness ) ) I.GetFunc( LibHandle, "WaveGPXDLL_CreateRouteCursor");
+	G->ReleaseRouteCursor = ( void (*) ( WaveGPXRouteCursorPtr Cursor ) ) I.GetFunc( LibHandle, "WaveGPXDLL_ReleaseRouteCursor");
+	G->RouteCursorSetDist = ( void (*) ( WaveGPXRouteCursorPtr Cursor, float Dist, WaveGPXRouteCursorStateDLL* State ) ) I.GetFunc( LibHandle, "WaveGPXDLL_RouteCursorSetDist");
+	G->RouteCursorGetSplineSample = ( void (*) ( WaveGPXRouteCursorPtr Cursor, WaveGPXSplineSampleDLL* Sample ) ) I.GetFunc( LibHandle, "WaveGPXDLL_RouteCursorGetSplineSample");
+	G->SampleRoute = ( void (*) ( WaveGPXRouteDLL* Route, const float* Dists, int NumDists, float GradeSmoothness, double* Alt, float* Grade, double* East, double* North ) ) I.GetFunc( LibHandle, "WaveGPXDLL_SampleRoute");
+	G->GetRouteLODView = ( void (*) ( WaveGPXRouteDLL* Route, float StartDist, float EndDist, int NumPixels, WaveGPXLODBucketDLL* Pixels ) ) I.GetFunc( LibHandle, "WaveGPXDLL_GetRouteLODView");
 
 	return true;
 }
\ No newline at end of file
@@ -18,6 +18,10 @@
 */
 
 #include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <thread>
 #include <iostream>
 #include <iomanip> // For std::setfill
 
@@ -27,6 +31,135 @@
 
 #include "WaveControlWheelSizeList.h"
 
+// ---------------------------------------------------------- WaveCycleSensorSnapshotBuffer ----------------------------------------------------
+
+uint64_t WaveControl_GetTimeNS()
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+WaveCycleSensorSnapshotBuffer::WaveCycleSensorSnapshotBuffer()
+{
+	static_assert( sizeof( WaveCycleSensorSnapshot ) % sizeof( uint64_t ) == 0, "Snapshot must be a whole number of words." );
+	uint64_t Temp[ NumWords ];
+	memcpy( Temp, &this->WriteSnapshot, sizeof( Temp ) );
+	for ( int i = 0; i < NumWords; i++ ) {
+		this->Words[i].store( Temp[i], std::memory_order_relaxed );
+	}
+}
+
+void WaveCycleSensorSnapshotBuffer::Publish( int FieldMask, const WaveCycleSensorReadState& State, uint64_t TimeNS )
+{
+	if ( !FieldMask )
+		return;
+
+	std::lock_guard< std::mutex > WriteLock( this->WriteMutex );
+	auto& Snapshot = this->WriteSnapshot;
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_HR ) {
+		Snapshot.State.HR_BPM = State.HR_BPM;
+		Snapshot.State.HR_SensorContact = State.HR_SensorContact;
+		Snapshot.HR_TimeNS = TimeNS;
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_SPEED ) {
+		Snapshot.State.Speed = State.Speed;
+		Snapshot.Speed_TimeNS = TimeNS;
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_CADENCE ) {
+		Snapshot.State.Cadence = State.Cadence;
+		Snapshot.Cadence_TimeNS = TimeNS;
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_POWER ) {
+		Snapshot.State.Power = State.Power;
+		Snapshot.Power_TimeNS = TimeNS;
+	}
+
+	uint64_t Sequence = this->Sequence.load( std::memory_order_relaxed );
+	Snapshot.Version = Sequence / 2 + 1;
+
+	uint64_t Temp[ NumWords ];
+	memcpy( Temp, &Snapshot, sizeof( Temp ) );
+
+	// Odd sequence marks the write in progress.
+	this->Sequence.store( Sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	for ( int i = 0; i < NumWords; i++ ) {
+		this->Words[i].store( Temp[i], std::memory_order_relaxed );
+	}
+	this->Sequence.store( Sequence + 2, std::memory_order_release );
+}
+
+WaveCycleSensorSnapshot WaveCycleSensorSnapshotBuffer::Read()
+{
+	uint64_t Temp[ NumWords ];
+	while ( true ) {
+		uint64_t SequenceBefore = this->Sequence.load( std::memory_order_acquire );
+		if ( SequenceBefore & 1 ) {
+			std::this_thread::yield();
+			continue;
+		}
+		for ( int i = 0; i < NumWords; i++ ) {
+			Temp[i] = this->Words[i].load( std::memory_order_relaxed );
+		}
+		std::atomic_thread_fence( std::memory_order_acquire );
+		if ( this->Sequence.load( std::memory_order_relaxed ) == SequenceBefore )
+			break;
+	}
+
+	WaveCycleSensorSnapshot Snapshot;
+	memcpy( &Snapshot, Temp, sizeof( Temp ) );
+	Snapshot.ReadTimeNS = WaveControl_GetTimeNS();
+	return Snapshot;
+}
+
+// ---------------------------------------------------------- WaveCycleSensorHistory ----------------------------------------------------
+
+void WaveSensorSampleRing::Push( uint64_t TimeNS, float Value )
+{
+	std::lock_guard< std::mutex > RingLock( this->Mutex );
+	auto& Sample = this->Samples[ this->NextVersion % WAVECONTROL_SENSOR_SAMPLE_HISTORY ];
+	Sample.Version = this->NextVersion++;
+	Sample.TimeNS = TimeNS;
+	Sample.Value = Value;
+}
+
+int WaveSensorSampleRing::Drain( uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples )
+{
+	assert( Samples || MaxSamples <= 0 );
+	std::lock_guard< std::mutex > RingLock( this->Mutex );
+
+	uint64_t OldestVersion = ( this->NextVersion > WAVECONTROL_SENSOR_SAMPLE_HISTORY ) ? this->NextVersion - WAVECONTROL_SENSOR_SAMPLE_HISTORY : 1;
+	uint64_t Version = ( SinceVersion + 1 > OldestVersion ) ? SinceVersion + 1 : OldestVersion;
+
+	int NumSamples = 0;
+	for ( ; Version < this->NextVersion && NumSamples < MaxSamples; Version++ ) {
+		Samples[ NumSamples++ ] = this->Samples[ Version % WAVECONTROL_SENSOR_SAMPLE_HISTORY ];
+	}
+	return NumSamples;
+}
+
+void WaveCycleSensorHistory::Push( int FieldMask, const WaveCycleSensorReadState& State, uint64_t TimeNS )
+{
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_HR ) {
+		this->Rings[ WAVECONTROL_SENSORMETRIC_HR ].Push( TimeNS, ( float ) State.HR_BPM );
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_SPEED ) {
+		this->Rings[ WAVECONTROL_SENSORMETRIC_SPEED ].Push( TimeNS, State.Speed );
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_CADENCE ) {
+		this->Rings[ WAVECONTROL_SENSORMETRIC_CADENCE ].Push( TimeNS, State.Cadence );
+	}
+	if ( FieldMask & WAVECONTROL_SENSORFIELD_POWER ) {
+		this->Rings[ WAVECONTROL_SENSORMETRIC_POWER ].Push( TimeNS, State.Power );
+	}
+}
+
+int WaveCycleSensorHistory::Drain( int Metric, uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples )
+{
+	if ( Metric < 0 || Metric >= WAVECONTROL_SENSORMETRIC_NUM )
+		return 0;
+	return this->Rings[ Metric ].Drain( SinceVersion, Samples, MaxSamples );
+}
+
 // ---------------------------------------------------------- WavePeripheralTable ----------------------------------------------------
 
 WavePeripheralTable::WavePeripheralTable()
@@ -179,6 +312,161 @@ void WavePeripheralTable::MarkServiceConnected( uint64_t HandleID, const std::st
 	Data->ServicesConnected[ ServiceUUID ] = Connected;
 }
 
+// ---------------------------------------------------------- Measurement decoding ----------------------------------------------------
+
+bool WaveDecode_HRMeasurement( std::string_view Bytes, WaveHRMeasurement& Out )
+{
+	static const uint8_t HRM_uint16_measurement_mask = 0x01;
+	static const uint8_t HRM_contact_detected_mask = 0x02;
+	static const uint8_t HRM_contact_supported_mask = 0x04;
+	static const uint8_t HRM_energy_expended_present_mask = 0x08;
+	static const uint8_t HRM_rr_interval_present_mask = 0x10;
+
+	WaveByteReader Reader( Bytes );
+	uint8_t Flags = Reader.ReadU8();
+	Out.BPM = ( Flags & HRM_uint16_measurement_mask ) ? Reader.ReadU16() : Reader.ReadU8();
+
+	// Contact status is only meaningful when the sensor says it supports it.
+	Out.ContactSupported = ( Flags & HRM_contact_supported_mask ) ? true : false;
+	Out.ContactDetected = Out.ContactSupported && ( Flags & HRM_contact_detected_mask );
+
+	Out.HasEnergyExpended = ( Flags & HRM_energy_expended_present_mask ) ? true : false;
+	if ( Out.HasEnergyExpended ) {
+		Out.EnergyExpended = Reader.ReadU16();
+	}
+
+	Out.NumRRIntervals = 0;
+	if ( Flags & HRM_rr_interval_present_mask ) {
+		while ( Reader.GetRemaining() >= 2 && Out.NumRRIntervals < WAVECONTROL_HRM_MAX_RR_INTERVALS ) {
+			Out.RRIntervals[ Out.NumRRIntervals++ ] = Reader.ReadU16();
+		}
+	}
+	return !Reader.IsOverrun();
+}
+
+bool WaveDecode_CSCMeasurement( std::string_view Bytes, WaveCSCMeasurement& Out )
+{
+	static const uint8_t CSC_wheel_rev_mask = 0x01;
+	static const uint8_t CSC_crank_rev_mask = 0x02;
+
+	WaveByteReader Reader( Bytes );
+	uint8_t Flags = Reader.ReadU8();
+
+	Out.HasWheel = ( Flags & CSC_wheel_rev_mask ) ? true : false;
+	if ( Out.HasWheel ) {
+		Out.WheelRevs = Reader.ReadU32();
+		Out.LastWheelTime = Reader.ReadU16();
+	}
+
+	Out.HasCrank = ( Flags & CSC_crank_rev_mask ) ? true : false;
+	if ( Out.HasCrank ) {
+		Out.CrankRevs = Reader.ReadU16();
+		Out.LastCrankTime = Reader.ReadU16();
+	}
+	return !Reader.IsOverrun();
+}
+
+bool WaveDecode_PowerMeasurement( std::string_view Bytes, WavePowerMeasurement& Out )
+{
+	static const uint16_t CP_pedal_power_balance_mask = 0x01;
+	static const uint16_t CP_accumulated_torque_mask = 0x04;
+	static const uint16_t CP_wheel_rev_mask = 0x10;
+	static const uint16_t CP_crank_rev_mask = 0x20;
+
+	WaveByteReader Reader( Bytes );
+	Out.Flags = Reader.ReadU16();
+	Out.Power = Reader.ReadS16();
+
+	Out.HasPedalBalance = ( Out.Flags & CP_pedal_power_balance_mask ) ? true : false;
+	if ( Out.HasPedalBalance ) {
+		Out.PedalBalance = Reader.ReadU8();
+	}
+
+	Out.HasAccumulatedTorque = ( Out.Flags & CP_accumulated_torque_mask ) ? true : false;
+	if ( Out.HasAccumulatedTorque ) {
+		Out.AccumulatedTorque = Reader.ReadU16();
+	}
+
+	Out.HasWheel = ( Out.Flags & CP_wheel_rev_mask ) ? true : false;
+	if ( Out.HasWheel ) {
+		Out.WheelRevs = Reader.ReadU32();
+		Out.LastWheelTime = Reader.ReadU16();
+	}
+
+	Out.HasCrank = ( Out.Flags & CP_crank_rev_mask ) ? true : false;
+	if ( Out.HasCrank ) {
+		Out.CrankRevs = Reader.ReadU16();
+		Out.LastCrankTime = Reader.ReadU16();
+	}
+	return !Reader.IsOverrun();
+}
+
+bool WaveDecode_IndoorBikeData( std::string_view Bytes, WaveIndoorBikeData& Out )
+{
+	static const uint16_t IBD_more_data_mask = 0x0001; // Inverted: instantaneous speed is present when clear.
+	static const uint16_t IBD_average_speed_mask = 0x0002;
+	static const uint16_t IBD_cadence_mask = 0x0004;
+	static const uint16_t IBD_average_cadence_mask = 0x0008;
+	static const uint16_t IBD_total_distance_mask = 0x0010;
+	static const uint16_t IBD_resistance_level_mask = 0x0020;
+	static const uint16_t IBD_power_mask = 0x0040;
+	static const uint16_t IBD_average_power_mask = 0x0080;
+	static const uint16_t IBD_expended_energy_mask = 0x0100;
+	static const uint16_t IBD_heart_rate_mask = 0x0200;
+
+	WaveByteReader Reader( Bytes );
+	Out.Flags = Reader.ReadU16();
+
+	Out.HasSpeed = ( Out.Flags & IBD_more_data_mask ) ? false : true;
+	if ( Out.HasSpeed ) {
+		Out.Speed = Reader.ReadU16();
+	}
+	if ( Out.Flags & IBD_average_speed_mask ) {
+		Reader.Skip( 2 );
+	}
+
+	Out.HasCadence = ( Out.Flags & IBD_cadence_mask ) ? true : false;
+	if ( Out.HasCadence ) {
+		Out.Cadence = Reader.ReadU16();
+	}
+	if ( Out.Flags & IBD_average_cadence_mask ) {
+		Reader.Skip( 2 );
+	}
+	if ( Out.Flags & IBD_total_distance_mask ) {
+		Reader.Skip( 3 );
+	}
+	if ( Out.Flags & IBD_resistance_level_mask ) {
+		Reader.Skip( 2 );
+	}
+
+	Out.HasPower = ( Out.Flags & IBD_power_mask ) ? true : false;
+	if ( Out.HasPower ) {
+		Out.Power = Reader.ReadS16();
+	}
+	if ( Out.Flags & IBD_average_power_mask ) {
+		Reader.Skip( 2 );
+	}
+	if ( Out.Flags & IBD_expended_energy_mask ) {
+		Reader.Skip( 5 );
+	}
+
+	Out.HasHeartRate = ( Out.Flags & IBD_heart_rate_mask ) ? true : false;
+	if ( Out.HasHeartRate ) {
+		Out.HeartRate = Reader.ReadU8();
+	}
+	return !Reader.IsOverrun();
+}
+
+bool WaveDecode_FTMSControlPointResponse( std::string_view Bytes, WaveFTMSControlPointResponse& Out )
+{
+	WaveByteReader Reader( Bytes );
+	if ( Reader.ReadU8() != WAVECONTROL_FTMS_OPCODE_RESPONSE )
+		return false;
+	Out.RequestOpCode = Reader.ReadU8();
+	Out.Result = Reader.ReadU8();
+	return !Reader.IsOverrun();
+}
+
 // ------------------------------------------------ WaveDevice -------------------------------------------------
 
 WaveDeviceBase::WaveDeviceBase( WavePeripheralTable* PTable )
@@ -203,6 +491,20 @@ std::shared_ptr< WavePeripheral > WaveDeviceBase::GetPeripheralFromTableInternal
 	return this->PeripheralTable->GetPeripheral( this->PeripheralHandleID );
 }
 
+void WaveDeviceBase::PublishReadState( int FieldMask )
+{
+	if ( !FieldMask )
+		return;
+
+	uint64_t TimeNS = WaveControl_GetTimeNS();
+	if ( this->SnapshotBuffer ) {
+		this->SnapshotBuffer->Publish( FieldMask, *this->ReadState, TimeNS );
+	}
+	if ( this->History ) {
+		this->History->Push( FieldMask, *this->ReadState, TimeNS );
+	}
+}
+
 void WaveDeviceBase::Update()
 {
 	if ( this->NeedToReferencePeripheral ) {
@@ -217,6 +519,19 @@ WaveHRMonitor::WaveHRMonitor( WavePeripheralTable* PTable )
 {
 }
 
+void WaveHRMonitor::ParseMeasurement( std::string_view Bytes )
+{
+	WaveHRMeasurement Measurement;
+	if ( !WaveDecode_HRMeasurement( Bytes, Measurement ) )
+		return;
+
+	ReadState->HR_SensorContact = Measurement.ContactDetected;
+	ReadState->HR_BPM = Measurement.BPM;
+	this->PublishReadState( WAVECONTROL_SENSORFIELD_HR );
+
+	// WAVECONTROL_LOG( "[HRM] %d BPM, %s\n", State->HR_BPM, State->HR_SensorContact ? "Contact" : "No contact" );
+}
+
 void WaveHRMonitor::Update()
 {
 	WaveDeviceBase::Update();
@@ -227,37 +542,20 @@ void WaveHRMonitor::Update()
 	if ( !WavePeripheral_IsConnected( *Data ) )
 		return;
 
-	static const char* HRM_ServiceUUID = "0000180d-0000-1000-8000-00805f9b34fb";
-	static const char* HRM_CharUUID = "00002a37-0000-1000-8000-00805f9b34fb";
+	static const std::string HRM_ServiceUUID = "0000180d-0000-1000-8000-00805f9b34fb";
+	static const std::string HRM_CharUUID = "00002a37-0000-1000-8000-00805f9b34fb";
 
 	bool NeedSetup = !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, HRM_ServiceUUID );
 	if ( NeedSetup ) {
 		WavePeripheral_Notify(
 			*Data,
 			HRM_ServiceUUID, HRM_CharUUID,
-			[&]( std::string Bytes )
+			[&]( std::string_view Bytes )
 			{
-				if ( Bytes.size() <= 0)
-					return;
-
-				uint8_t Flags = Bytes[0];
-
-				static const uint8_t HRM_uint16_measurement_mask = 0x01;
-				static const uint8_t HRM_contact_detected_mask = 0x06;
-				static const uint8_t HRM_energy_expended_present_mask = 0x08;
-				static const uint8_t HRM_rr_interval_present_mask = 0x10;
-
-				ReadState->HR_SensorContact = ( Flags & HRM_contact_detected_mask ) ? true : false;
-
-				if ( Flags & HRM_uint16_measurement_mask ) {
-					assert( Bytes.size() >= 3 );
-					ReadState->HR_BPM = ( reinterpret_cast< uint16_t* >( &Bytes[1] ) )[0];
-				} else {
-					assert( Bytes.size() >= 2 );
-					ReadState->HR_BPM = Bytes[1];
+				this->ParseMeasurement( Bytes );
+				if ( this->OnNotification ) {
+					this->OnNotification();
 				}
-
-				// WAVECONTROL_LOG( "[HRM] %d BPM, %s\n", State->HR_BPM, State->HR_SensorContact ? "Contact" : "No contact" );
 			}
 		);
 		this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, HRM_ServiceUUID );
@@ -270,8 +568,9 @@ WaveCadenceSpeedSensor::WaveCadenceSpeedSensor( WavePeripheralTable* PTable )
 	WheelSize = std::make_unique< WaveControl_WheelSizeData > ();
 }
 
-void WaveCadenceSpeedSensor::UpdateCSCFromData()
+int WaveCadenceSpeedSensor::UpdateCSCFromData()
 {
+	int FieldMask = 0;
 	uint32_t WheelRevsDelta = WheelRevs - Prev_WheelRevs;
 	uint32_t LastWheelTimeDelta = LastWheelTime - Prev_LastWheelTime;
 	uint32_t CrankRevsDelta = CrankRevs - Prev_CrankRevs;
@@ -285,6 +584,7 @@ void WaveCadenceSpeedSensor::UpdateCSCFromData()
 			float Speed = DistanceTravelledM / LastWheelTimeSeconds;
 			Speed *= ( 3600.0f / 1000.0f );
 			ReadState->Speed = Speed;
+			FieldMask |= WAVECONTROL_SENSORFIELD_SPEED;
 		}
 	}
 
@@ -293,6 +593,7 @@ void WaveCadenceSpeedSensor::UpdateCSCFromData()
 		if ( LastCrankTimeSeconds > 0.000001f ) {
 			float Cadence = ( ( float ) CrankRevsDelta * 60.0f ) / LastCrankTimeSeconds;
 			ReadState->Cadence = Cadence;
+			FieldMask |= WAVECONTROL_SENSORFIELD_CADENCE;
 		}
 	}
 
@@ -300,6 +601,7 @@ void WaveCadenceSpeedSensor::UpdateCSCFromData()
 	Prev_LastWheelTime = LastWheelTime;
 	Prev_CrankRevs = CrankRevs;
 	Prev_LastCrankTime = LastCrankTime;
+	return FieldMask;
 }
 
 
@@ -308,6 +610,28 @@ void WaveCadenceSpeedSensor::SetWheelSizeData( WaveControl_WheelSizeData& WheelS
 	WheelSize.get()[0] = WheelSizeData;
 }
 
+void WaveCadenceSpeedSensor::ParseMeasurement( std::string_view Bytes )
+{
+	WaveCSCMeasurement Measurement;
+	if ( !WaveDecode_CSCMeasurement( Bytes, Measurement ) )
+		return;
+
+	if ( Measurement.HasWheel ) {
+		WheelRevs = Measurement.WheelRevs;
+		LastWheelTime = Measurement.LastWheelTime;
+	}
+
+	if ( Measurement.HasCrank ) {
+		CrankRevs = Measurement.CrankRevs;
+		LastCrankTime = Measurement.LastCrankTime;
+	}
+
+	this->PublishReadState( this->UpdateCSCFromData() );
+
+	//WAVECONTROL_LOG( "Speed %.2f Km/Hr Cadence %.2f RPM\n", Speed, Cadence );
+	//WAVECONTROL_LOG( "WheelRevs %d LastWheelTime %d CrankRevs %d LastCrankTime %d\n", WheelRevs, LastWheelTime, CrankRevs, LastCrankTime );
+}
+
 void WaveCadenceSpeedSensor::Update()
 {
 	WaveDeviceBase::Update();
@@ -318,8 +642,8 @@ void WaveCadenceSpeedSensor::Update()
 	if ( !WavePeripheral_IsConnected( *Data ) )
 		return;
 
-	static const char* CSC_ServiceUUID = "00001816-0000-1000-8000-00805f9b34fb";
-	static const char* CSC_MeasurementUUID = "00002a5b-0000-1000-8000-00805f9b34fb";
+	static const std::string CSC_ServiceUUID = "00001816-0000-1000-8000-00805f9b34fb";
+	static const std::string CSC_MeasurementUUID = "00002a5b-0000-1000-8000-00805f9b34fb";
 	
 	bool NeedSetup = !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, CSC_ServiceUUID );
 	if ( NeedSetup ) {
@@ -327,35 +651,12 @@ void WaveCadenceSpeedSensor::Update()
 			*Data,
 			CSC_ServiceUUID,
 			CSC_MeasurementUUID,
-			[&]( std::string Bytes )
+			[&]( std::string_view Bytes )
 			{
-				if ( Bytes.size() <= 0 )
-					return;
-
-				uint8_t Flags = Bytes[0];
-
-				static const uint8_t CSC_wheel_rev_mask = 1;
-				static const uint8_t CSC_crank_rev_mask = 2;
-
-				int Offset = 1;
-
-				if ( Flags & CSC_wheel_rev_mask ) {
-					assert( Bytes.size() >= Offset + 6 );
-					WheelRevs = ( reinterpret_cast< uint32_t* >( &Bytes[Offset] ) )[0];
-					LastWheelTime = ( reinterpret_cast< uint16_t* >( &Bytes[Offset + 4] ) )[0];
-					Offset += 6;
-				}
-
-				if ( Flags & CSC_crank_rev_mask ) {
-					assert( Bytes.size() >= Offset + 4 );
-					CrankRevs = ( reinterpret_cast< uint16_t* >( &Bytes[Offset] ) )[0];
-					LastCrankTime = ( reinterpret_cast< uint16_t* >( &Bytes[Offset + 2] ) )[0];
+				this->ParseMeasurement( Bytes );
+				if ( this->OnNotification ) {
+					this->OnNotification();
 				}
-
-				this->UpdateCSCFromData();
-
-				//WAVECONTROL_LOG( "Speed %.2f Km/Hr Cadence %.2f RPM\n", Speed, Cadence );
-				//WAVECONTROL_LOG( "WheelRevs %d LastWheelTime %d CrankRevs %d LastCrankTime %d\n", WheelRevs, LastWheelTime, CrankRevs, LastCrankTime );
 			}
 		);
 		this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, CSC_ServiceUUID );
@@ -367,6 +668,18 @@ WavePowerSensor::WavePowerSensor( WavePeripheralTable* PTable )
 {
 }
 
+void WavePowerSensor::ParseMeasurement( std::string_view Bytes )
+{
+	WavePowerMeasurement Measurement;
+	if ( !WaveDecode_PowerMeasurement( Bytes, Measurement ) )
+		return;
+
+	ReadState->Power = ( float ) Measurement.Power;
+	this->PublishReadState( WAVECONTROL_SENSORFIELD_POWER );
+
+	//WAVECONTROL_LOG( "Power %.2lf Watts\n", State->Power );
+}
+
 void WavePowerSensor::Update()
 {
 	WaveDeviceBase::Update();
@@ -377,40 +690,233 @@ void WavePowerSensor::Update()
 	if ( !WavePeripheral_IsConnected( *Data ) )
 		return;
 
-	static const char* PS_ServiceUUID = "00001818-0000-1000-8000-00805f9b34fb";
-	static const char* PS_MeasurementUUID = "00002a63-0000-1000-8000-00805f9b34fb";
+	static const std::string PS_ServiceUUID = "00001818-0000-1000-8000-00805f9b34fb";
+	static const std::string PS_MeasurementUUID = "00002a63-0000-1000-8000-00805f9b34fb";
+	static const std::string PS_ConnectedKey = PS_ServiceUUID + " " + PS_MeasurementUUID;
 
-	bool NeedSetup = !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, std::string( PS_ServiceUUID ) + " " + PS_MeasurementUUID );
+	bool NeedSetup = !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, PS_ConnectedKey );
 	if ( NeedSetup ) {
 		WavePeripheral_Notify(
 			*Data,
 			PS_ServiceUUID,
 			PS_MeasurementUUID,   
-			[&]( std::string Bytes )
+			[&]( std::string_view Bytes )
 			{
-				if ( Bytes.size() <= 0 )
-					return;
-
-				uint16_t Flags = ( reinterpret_cast< uint16_t* >( &Bytes[0] ) )[0];
-				uint16_t InstaneousPower = ( reinterpret_cast< uint16_t* >( &Bytes[2] ) )[0];
-				ReadState->Power = ( float ) InstaneousPower;
-
-				//WAVECONTROL_LOG( "Power %.2lf Watts\n", State->Power );
+				this->ParseMeasurement( Bytes );
+				if ( this->OnNotification ) {
+					this->OnNotification();
+				}
 			}
 		); 
-		this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, std::string( PS_ServiceUUID ) + " " + PS_MeasurementUUID );
+		this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, PS_ConnectedKey );
+	}
+}
+
+// ---------------------------------------------------------- WaveTrainerCommandScheduler ----------------------------------------------------
+
+WaveTrainerCommandStats WaveTrainerCommandCounters::Load() const
+{
+	WaveTrainerCommandStats Stats;
+	Stats.Sent = this->Sent;
+	Stats.Merged = this->Merged;
+	Stats.Dropped = this->Dropped;
+	Stats.Acked = this->Acked;
+	Stats.Failed = this->Failed;
+	Stats.TimedOut = this->TimedOut;
+	Stats.LatencyTotalNS = this->LatencyTotalNS;
+	Stats.LatencyMaxNS = this->LatencyMaxNS;
+	return Stats;
+}
+
+WaveTrainerCommandScheduler::WaveTrainerCommandScheduler()
+{
+	this->Counters = std::make_shared< WaveTrainerCommandCounters >();
+}
+
+void WaveTrainerCommandScheduler::SetMinIntervalMS( int IntervalMS )
+{
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	this->MinIntervalMS = IntervalMS;
+}
+
+void WaveTrainerCommandScheduler::Submit( int Type, const std::string& Service, const std::string& Characteristic, bool WithResponse, const std::string& Payload )
+{
+	assert( Type >= 0 && Type < WAVECONTROL_TRAINERCOMMAND_NUM );
+	assert( Payload.size() );
+
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	auto& Cmd = this->Commands[ Type ];
+	if ( Cmd.Pending ) {
+		// Keep the original submit time, so latency covers the whole time the caller has been waiting.
+		this->Counters->Merged++;
+	} else {
+		Cmd.SubmitTime = std::chrono::steady_clock::now();
+	}
+	Cmd.Pending = true;
+	Cmd.WithResponse = WithResponse;
+	Cmd.Service = Service;
+	Cmd.Characteristic = Characteristic;
+	Cmd.Payload = Payload;
+}
+
+void WaveTrainerCommandScheduler::Cancel( int Type )
+{
+	assert( Type >= 0 && Type < WAVECONTROL_TRAINERCOMMAND_NUM );
+
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	if ( this->Commands[ Type ].Pending ) {
+		this->Commands[ Type ].Pending = false;
+		this->Counters->Merged++;
+	}
+}
+
+void WaveTrainerCommandScheduler::Pump( WavePeripheral& Data )
+{
+	auto TimeNow = std::chrono::steady_clock::now();
+	Command Cmd;
+	{
+		std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+		if ( this->InFlight ) {
+			if ( TimeNow - this->LastSendTime < std::chrono::milliseconds( WAVECONTROL_TRAINERCOMMAND_ACK_TIMEOUT_MS ) )
+				return;
+			this->InFlight = false;
+			this->Counters->TimedOut++;
+		}
+		if ( TimeNow - this->LastSendTime < std::chrono::milliseconds( this->MinIntervalMS ) )
+			return;
+
+		int Type = 0;
+		while ( Type < WAVECONTROL_TRAINERCOMMAND_NUM && !this->Commands[ Type ].Pending ) {
+			Type++;
+		}
+		if ( Type == WAVECONTROL_TRAINERCOMMAND_NUM )
+			return;
+
+		Cmd = this->Commands[ Type ];
+		this->Commands[ Type ].Pending = false;
+		this->InFlight = true;
+		this->InFlightOpCode = ( uint8_t ) Cmd.Payload[0];
+		this->InFlightSubmitTime = Cmd.SubmitTime;
+		this->LastSendTime = TimeNow;
+	}
+
+	// The ack can come back before the write call returns, so everything above has to be in place first.
+	this->Counters->Sent++;
+	if ( Cmd.WithResponse ) {
+		WavePeripheral_WriteRequest( Data, Cmd.Service, Cmd.Characteristic, Cmd.Payload );
+	} else {
+		WavePeripheral_WriteCommand( Data, Cmd.Service, Cmd.Characteristic, Cmd.Payload );
+	}
+}
+
+void WaveTrainerCommandScheduler::OnAck( uint8_t OpCode, bool Success )
+{
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	if ( !this->InFlight || OpCode != this->InFlightOpCode )
+		return;
+	this->InFlight = false;
+
+	uint64_t LatencyNS = std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - this->InFlightSubmitTime ).count();
+	if ( Success ) {
+		this->Counters->Acked++;
+	} else {
+		this->Counters->Failed++;
 	}
+	this->Counters->LatencyTotalNS += LatencyNS;
+	uint64_t PrevMaxNS = this->Counters->LatencyMaxNS;
+	while ( LatencyNS > PrevMaxNS && !this->Counters->LatencyMaxNS.compare_exchange_weak( PrevMaxNS, LatencyNS ) ) {}
 }
 
-static const char* s_WaveTrainerDevice_PS_WahooBrakeServiceUUID = "00001818-0000-1000-8000-00805f9b34fb";
-static const char* s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID = "a026e005-0a7d-4ab3-97fa-f1500f9feb8b";
+void WaveTrainerCommandScheduler::Reset()
+{
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	for ( auto& Cmd : this->Commands ) {
+		if ( Cmd.Pending ) {
+			Cmd.Pending = false;
+			this->Counters->Dropped++;
+		}
+	}
+	this->InFlight = false;
+}
+
+bool WaveTrainerCommandScheduler::IsIdle()
+{
+	std::lock_guard< std::mutex > SchedulerLock( this->Mutex );
+	if ( this->InFlight )
+		return false;
+	for ( auto& Cmd : this->Commands ) {
+		if ( Cmd.Pending )
+			return false;
+	}
+	return true;
+}
+
+static const std::string s_WaveTrainerDevice_PS_WahooBrakeServiceUUID = "00001818-0000-1000-8000-00805f9b34fb";
+static const std::string s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID = "a026e005-0a7d-4ab3-97fa-f1500f9feb8b";
+static const std::string s_WaveTrainerDevice_PS_WahooBrakeConnectedKey = s_WaveTrainerDevice_PS_WahooBrakeServiceUUID + " " + s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID;
+
+static const std::string s_WaveTrainerDevice_FTMS_ServiceUUID = "00001826-0000-1000-8000-00805f9b34fb";
+static const std::string s_WaveTrainerDevice_FTMS_IndoorBikeDataUUID = "00002ad2-0000-1000-8000-00805f9b34fb";
+static const std::string s_WaveTrainerDevice_FTMS_ControlPointUUID = "00002ad9-0000-1000-8000-00805f9b34fb";
+static const std::string s_WaveTrainerDevice_FTMS_StatusUUID = "00002ada-0000-1000-8000-00805f9b34fb";
 
 WaveTrainerDevice::WaveTrainerDevice( WavePeripheralTable* PTable )
 	: WaveDeviceBase( PTable )
 {
 }
 
-void WaveTrainerDevice::WriteSimulationParametersToDevice( WavePeripheral& Data )
+void WaveTrainerDevice::SetReadFieldMask( int FieldMask )
+{
+	this->ReadFieldMask = FieldMask;
+}
+
+void WaveTrainerDevice::SetCommandCounters( std::shared_ptr< WaveTrainerCommandCounters > Counters )
+{
+	this->CommandScheduler.Counters = Counters;
+}
+
+void WaveTrainerDevice::SetCommandMinIntervalMS( int IntervalMS )
+{
+	this->CommandScheduler.SetMinIntervalMS( IntervalMS );
+}
+
+int WaveTrainerDevice::GetTrainerControlMode() const
+{
+	return this->TrainerControlMode;
+}
+
+int WaveTrainerDevice::GetFTMSControlState() const
+{
+	return this->FTMS_ControlState;
+}
+
+uint64_t WaveTrainerDevice::GetFTMSNumAcks() const
+{
+	return this->FTMS_NumAcks;
+}
+
+uint64_t WaveTrainerDevice::GetFTMSNumFailedAcks() const
+{
+	return this->FTMS_NumFailedAcks;
+}
+
+static int16_t WaveTrainerDevice_ToS16( float Value )
+{
+	return ( int16_t ) std::clamp( Value, -32768.0f, 32767.0f );
+}
+
+static uint8_t WaveTrainerDevice_ToU8( float Value )
+{
+	return ( uint8_t ) std::clamp( Value + 0.5f, 0.0f, 255.0f );
+}
+
+void WaveTrainerDevice::WriteFTMSControlPoint( int Type, const std::string& Cmdbuf )
+{
+	// The control point only accepts write with response.
+	this->CommandScheduler.Submit( Type, s_WaveTrainerDevice_FTMS_ServiceUUID, s_WaveTrainerDevice_FTMS_ControlPointUUID, true, Cmdbuf );
+}
+
+void WaveTrainerDevice::WriteSimulationParametersToDevice()
 {
 	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_WAHOO ) {
 		uint32_t Weight = this->WriteState->TotalWeight * 100.0f;
@@ -426,11 +932,28 @@ void WaveTrainerDevice::WriteSimulationParametersToDevice( WavePeripheral& Data
 		Cmdbuf[5] = ( char ) WindCwr;
 		Cmdbuf[6] = ( char ) ( WindCwr >> 8 );
 
-		WavePeripheral_WriteCommand( Data, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID, Cmdbuf );
+		this->CommandScheduler.Submit( WAVECONTROL_TRAINERCOMMAND_SIMULATION, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID, false, Cmdbuf );
+	} else if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_FTMS ) {
+		// FTMS has no rider weight; the trainer works that out itself. Grade travels with the rest of the parameters.
+		int16_t WindSpeed = WaveTrainerDevice_ToS16( this->WriteState->WindSpeed * 1000.0f ); // 0.001 m/s
+		int16_t Grade = WaveTrainerDevice_ToS16( this->WriteState->Gradient * 100.0f ); // 0.01 %
+		uint8_t RollingCrr = WaveTrainerDevice_ToU8( this->WriteState->RollingResistance * 10000.0f ); // 0.0001
+		uint8_t WindCw = WaveTrainerDevice_ToU8( this->WriteState->WindResistance * 100.0f ); // 0.01 Kg/m
+
+		std::string Cmdbuf; Cmdbuf.resize(7);
+		Cmdbuf[0] = WAVECONTROL_FTMS_OPCODE_SET_SIMULATION_PARAMETERS;
+		Cmdbuf[1] = ( char ) WindSpeed;
+		Cmdbuf[2] = ( char ) ( WindSpeed >> 8 );
+		Cmdbuf[3] = ( char ) Grade;
+		Cmdbuf[4] = ( char ) ( Grade >> 8 );
+		Cmdbuf[5] = ( char ) RollingCrr;
+		Cmdbuf[6] = ( char ) WindCw;
+
+		this->WriteFTMSControlPoint( WAVECONTROL_TRAINERCOMMAND_SIMULATION, Cmdbuf );
 	}
 }
 
-void WaveTrainerDevice::WriteCurrentGradeToDevice( WavePeripheral& Data )
+void WaveTrainerDevice::WriteCurrentGradeToDevice()
 {
 	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_WAHOO ) {
 		int16_t Gradient = ( this->WriteState->Gradient / 100.0f + 1.0f ) * 32768;
@@ -440,10 +963,196 @@ void WaveTrainerDevice::WriteCurrentGradeToDevice( WavePeripheral& Data )
 		Cmdbuf[1] = ( reinterpret_cast< char* >( &Gradient ) )[0];
 		Cmdbuf[2] = ( reinterpret_cast< char* >( &Gradient ) )[1];
 		
-		WavePeripheral_WriteCommand( Data, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID, Cmdbuf );
+		this->CommandScheduler.Submit( WAVECONTROL_TRAINERCOMMAND_GRADE, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID, false, Cmdbuf );
+	} else if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_FTMS ) {
+		this->WriteSimulationParametersToDevice();
 	}
 }
 
+void WaveTrainerDevice::WriteTargetPowerToDevice()
+{
+	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_WAHOO ) {
+		uint16_t TargetPower = ( uint16_t ) std::clamp( this->WriteState->TargetPower, 0.0f, 65535.0f );
+
+		std::string Cmdbuf; Cmdbuf.resize(3);
+		Cmdbuf[0] = 0x42; // Set ERG mode command.
+		Cmdbuf[1] = ( char ) TargetPower;
+		Cmdbuf[2] = ( char ) ( TargetPower >> 8 );
+
+		this->CommandScheduler.Submit( WAVECONTROL_TRAINERCOMMAND_TARGET_POWER, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID, false, Cmdbuf );
+	} else if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_FTMS ) {
+		int16_t TargetPower = WaveTrainerDevice_ToS16( this->WriteState->TargetPower );
+
+		std::string Cmdbuf; Cmdbuf.resize(3);
+		Cmdbuf[0] = WAVECONTROL_FTMS_OPCODE_SET_TARGET_POWER;
+		Cmdbuf[1] = ( char ) TargetPower;
+		Cmdbuf[2] = ( char ) ( TargetPower >> 8 );
+
+		this->WriteFTMSControlPoint( WAVECONTROL_TRAINERCOMMAND_TARGET_POWER, Cmdbuf );
+	}
+}
+
+void WaveTrainerDevice::ParseIndoorBikeData( std::string_view Bytes )
+{
+	WaveIndoorBikeData BikeData;
+	if ( !WaveDecode_IndoorBikeData( Bytes, BikeData ) )
+		return;
+
+	// Dedicated sensors win; we only fill in what nobody else is measuring.
+	int AllowedFieldMask = this->ReadFieldMask;
+	int FieldMask = 0;
+	if ( BikeData.HasSpeed && ( AllowedFieldMask & WAVECONTROL_SENSORFIELD_SPEED ) ) {
+		ReadState->Speed = BikeData.Speed * 0.01f;
+		FieldMask |= WAVECONTROL_SENSORFIELD_SPEED;
+	}
+	if ( BikeData.HasCadence && ( AllowedFieldMask & WAVECONTROL_SENSORFIELD_CADENCE ) ) {
+		ReadState->Cadence = BikeData.Cadence * 0.5f;
+		FieldMask |= WAVECONTROL_SENSORFIELD_CADENCE;
+	}
+	if ( BikeData.HasPower && ( AllowedFieldMask & WAVECONTROL_SENSORFIELD_POWER ) ) {
+		ReadState->Power = ( float ) BikeData.Power;
+		FieldMask |= WAVECONTROL_SENSORFIELD_POWER;
+	}
+	if ( BikeData.HasHeartRate && ( AllowedFieldMask & WAVECONTROL_SENSORFIELD_HR ) ) {
+		ReadState->HR_BPM = BikeData.HeartRate;
+		FieldMask |= WAVECONTROL_SENSORFIELD_HR;
+	}
+	this->PublishReadState( FieldMask );
+}
+
+void WaveTrainerDevice::ParseFTMSControlPointResponse( std::string_view Bytes )
+{
+	WaveFTMSControlPointResponse Response;
+	if ( !WaveDecode_FTMSControlPointResponse( Bytes, Response ) )
+		return;
+
+	this->FTMS_NumAcks++;
+	this->CommandScheduler.OnAck( Response.RequestOpCode, Response.Result == WAVECONTROL_FTMS_RESULT_SUCCESS );
+	if ( Response.Result == WAVECONTROL_FTMS_RESULT_SUCCESS ) {
+		if ( Response.RequestOpCode == WAVECONTROL_FTMS_OPCODE_REQUEST_CONTROL ) {
+			this->FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_GRANTED;
+		}
+		return;
+	}
+
+	this->FTMS_NumFailedAcks++;
+	WAVECONTROL_LOG( "FTMS control point op 0x%02x failed with result 0x%02x.\n", Response.RequestOpCode, Response.Result );
+	if ( Response.RequestOpCode == WAVECONTROL_FTMS_OPCODE_REQUEST_CONTROL || Response.Result == WAVECONTROL_FTMS_RESULT_CONTROL_NOT_PERMITTED ) {
+		// Refused, or someone else took over. Ask again after the back off.
+		this->FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_NONE;
+	}
+}
+
+void WaveTrainerDevice::ParseFTMSStatus( std::string_view Bytes )
+{
+	static const uint8_t FTMS_status_reset = 0x01;
+	static const uint8_t FTMS_status_control_permission_lost = 0xff;
+
+	WaveByteReader Reader( Bytes );
+	uint8_t Status = Reader.ReadU8();
+	if ( Reader.IsOverrun() )
+		return;
+	if ( Status == FTMS_status_reset || Status == FTMS_status_control_permission_lost ) {
+		this->FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_NONE;
+	}
+}
+
+void WaveTrainerDevice::ParseWahooResponse( std::string_view Bytes )
+{
+	static const uint8_t Wahoo_response_success = 0x01;
+
+	// Success / error code, then the op code being answered.
+	WaveByteReader Reader( Bytes );
+	uint8_t Result = Reader.ReadU8();
+	uint8_t OpCode = Reader.ReadU8();
+	if ( Reader.IsOverrun() )
+		return;
+	this->CommandScheduler.OnAck( OpCode, Result == Wahoo_response_success );
+}
+
+void WaveTrainerDevice::SetupFTMS( WavePeripheral& Data )
+{
+	// Acks for everything we write come back through here.
+	WavePeripheral_Indicate(
+		Data,
+		s_WaveTrainerDevice_FTMS_ServiceUUID,
+		s_WaveTrainerDevice_FTMS_ControlPointUUID,
+		[&]( std::string_view Bytes )
+		{
+			this->ParseFTMSControlPointResponse( Bytes );
+			if ( this->OnNotification ) {
+				this->OnNotification();
+			}
+		}
+	);
+	if ( WavePeripheral_HasCharacteristic( Data, s_WaveTrainerDevice_FTMS_ServiceUUID, s_WaveTrainerDevice_FTMS_IndoorBikeDataUUID ) ) {
+		WavePeripheral_Notify(
+			Data,
+			s_WaveTrainerDevice_FTMS_ServiceUUID,
+			s_WaveTrainerDevice_FTMS_IndoorBikeDataUUID,
+			[&]( std::string_view Bytes )
+			{
+				this->ParseIndoorBikeData( Bytes );
+				if ( this->OnNotification ) {
+					this->OnNotification();
+				}
+			}
+		);
+	}
+	if ( WavePeripheral_HasCharacteristic( Data, s_WaveTrainerDevice_FTMS_ServiceUUID, s_WaveTrainerDevice_FTMS_StatusUUID ) ) {
+		WavePeripheral_Notify(
+			Data,
+			s_WaveTrainerDevice_FTMS_ServiceUUID,
+			s_WaveTrainerDevice_FTMS_StatusUUID,
+			[&]( std::string_view Bytes )
+			{
+				this->ParseFTMSStatus( Bytes );
+				if ( this->OnNotification ) {
+					this->OnNotification();
+				}
+			}
+		);
+	}
+
+	this->TrainerControlMode = WAVECONTROL_TRAINERCONTROL_FTMS;
+	this->FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_NONE;
+	this->FTMS_ControlWasGranted = false;
+	this->FTMS_ControlRetryTime = std::chrono::steady_clock::time_point();
+	this->CommandScheduler.Reset();
+	this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, s_WaveTrainerDevice_FTMS_ServiceUUID );
+}
+
+// Runs the Request Control handshake. Returns true once we're allowed to write to the control point.
+bool WaveTrainerDevice::UpdateFTMSControl()
+{
+	auto TimeNow = std::chrono::steady_clock::now();
+	int ControlState = this->FTMS_ControlState;
+
+	if ( ControlState == WAVECONTROL_FTMS_CONTROL_GRANTED ) {
+		if ( !this->FTMS_ControlWasGranted ) {
+			// Fresh control: the trainer knows nothing about our state, so start it and send everything.
+			this->FTMS_ControlWasGranted = true;
+			this->WriteFTMSControlPoint( WAVECONTROL_TRAINERCOMMAND_START, std::string( 1, ( char ) WAVECONTROL_FTMS_OPCODE_START_RESUME ) );
+			WriteStateCache.reset( nullptr );
+		}
+		return true;
+	}
+
+	if ( this->FTMS_ControlWasGranted ) {
+		// Lost control; anything queued would just be refused.
+		this->FTMS_ControlWasGranted = false;
+		this->CommandScheduler.Reset();
+	}
+	if ( TimeNow < this->FTMS_ControlRetryTime )
+		return false;
+
+	// Nothing asked yet, refused, or the ack never came.
+	this->FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_REQUESTED;
+	this->FTMS_ControlRetryTime = TimeNow + std::chrono::milliseconds( WAVECONTROL_FTMS_CONTROL_RETRY_MS );
+	this->WriteFTMSControlPoint( WAVECONTROL_TRAINERCOMMAND_REQUEST_CONTROL, std::string( 1, ( char ) WAVECONTROL_FTMS_OPCODE_REQUEST_CONTROL ) );
+	return false;
+}
+
 void WaveTrainerDevice::Update()
 {
 	WaveDeviceBase::Update();
@@ -451,10 +1160,12 @@ void WaveTrainerDevice::Update()
 	auto Data = this->GetPeripheralFromTableInternal();
 	if ( !Data || !WavePeripheral_IsConnectable( *Data ) )
 		return;
-	if ( !WavePeripheral_IsConnected( *Data ) )
+	if ( !WavePeripheral_IsConnected( *Data ) ) {
+		this->CommandScheduler.Reset();
 		return;
+	}
 
-	bool NeedWahooBrakeControlSetup = !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, std::string( s_WaveTrainerDevice_PS_WahooBrakeServiceUUID ) + " " + s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID );
+	bool NeedWahooBrakeControlSetup = this->TrainerControlMode != WAVECONTROL_TRAINERCONTROL_FTMS && !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, s_WaveTrainerDevice_PS_WahooBrakeConnectedKey );
 	if ( NeedWahooBrakeControlSetup ) {
 		
 		bool SupportsWahooBrakeControl = WavePeripheral_HasCharacteristic( *Data, s_WaveTrainerDevice_PS_WahooBrakeServiceUUID, s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID );
@@ -465,37 +1176,81 @@ void WaveTrainerDevice::Update()
 				*Data,
 				s_WaveTrainerDevice_PS_WahooBrakeServiceUUID,
 				s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID,   
-				[&]( std::string Bytes ){}
+				[&]( std::string_view Bytes )
+				{
+					this->ParseWahooResponse( Bytes );
+					if ( this->OnNotification ) {
+						this->OnNotification();
+					}
+				}
 			); 
 			this->TrainerControlMode = WAVECONTROL_TRAINERCONTROL_WAHOO;
-			this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, std::string( s_WaveTrainerDevice_PS_WahooBrakeServiceUUID ) + " " + s_WaveTrainerDevice_PS_WahooBrakeExtensionUUID );
+			this->PeripheralTable->MarkServiceConnected( this->PeripheralHandleID, s_WaveTrainerDevice_PS_WahooBrakeConnectedKey );
 			WriteStateCache.reset( nullptr );
 		}
 	}
 
+	// Trainers without the Wahoo extension go through the standard Fitness Machine Service.
+	bool NeedFTMSSetup = this->TrainerControlMode != WAVECONTROL_TRAINERCONTROL_WAHOO && !this->PeripheralTable->IsServiceConnected( this->PeripheralHandleID, s_WaveTrainerDevice_FTMS_ServiceUUID );
+	if ( NeedFTMSSetup && WavePeripheral_HasCharacteristic( *Data, s_WaveTrainerDevice_FTMS_ServiceUUID, s_WaveTrainerDevice_FTMS_ControlPointUUID ) ) {
+		this->SetupFTMS( *Data );
+	}
+
 	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_UNKNOWN )
 		return;
+	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_FTMS && !this->UpdateFTMSControl() ) {
+		this->CommandScheduler.Pump( *Data );
+		return;
+	}
 
 	bool NeedsWriteSimulationParametersToDevice = false;
 	bool NeedsWriteGradientToDevice = false;
+	bool NeedsWriteTargetPowerToDevice = false;
+	bool ERGMode = this->WriteState->TargetPower > 0.0f;
 
 	if ( !WriteStateCache.get() ) {
 		WriteStateCache = std::make_unique< WaveCycleSensorWriteState >();
-		NeedsWriteSimulationParametersToDevice = true;
-		NeedsWriteGradientToDevice = true;
+		NeedsWriteSimulationParametersToDevice = !ERGMode;
+		NeedsWriteGradientToDevice = !ERGMode;
+		NeedsWriteTargetPowerToDevice = ERGMode;
+	} else if ( WriteStateCache->TargetPower != this->WriteState->TargetPower ) {
+		// Entering or changing ERG sends the new target; leaving it puts the simulation back.
+		NeedsWriteTargetPowerToDevice = ERGMode;
+		NeedsWriteSimulationParametersToDevice = !ERGMode;
+		NeedsWriteGradientToDevice = !ERGMode;
+	} else if ( ERGMode ) {
+		// The trainer holds power on its own; simulation changes would only knock it out of ERG.
 	} else if ( WriteStateCache->TotalWeight != this->WriteState->TotalWeight || WriteStateCache->RollingResistance != this->WriteState->RollingResistance ||
 			WriteStateCache->WindResistance != this->WriteState->WindResistance || WriteStateCache->WindSpeed != this->WriteState->WindSpeed ) {
 		NeedsWriteSimulationParametersToDevice = true;
+		NeedsWriteGradientToDevice = WriteStateCache->Gradient != this->WriteState->Gradient;
 	} else if ( WriteStateCache->Gradient != this->WriteState->Gradient ) {
 		NeedsWriteGradientToDevice = true;
 	}
 
+	if ( this->TrainerControlMode == WAVECONTROL_TRAINERCONTROL_FTMS && NeedsWriteSimulationParametersToDevice ) {
+		// Same command on FTMS, don't send it twice.
+		NeedsWriteGradientToDevice = false;
+	}
+
+	// Whatever the other mode had queued up is moot now.
+	if ( NeedsWriteTargetPowerToDevice ) {
+		this->CommandScheduler.Cancel( WAVECONTROL_TRAINERCOMMAND_SIMULATION );
+		this->CommandScheduler.Cancel( WAVECONTROL_TRAINERCOMMAND_GRADE );
+	} else if ( NeedsWriteSimulationParametersToDevice || NeedsWriteGradientToDevice ) {
+		this->CommandScheduler.Cancel( WAVECONTROL_TRAINERCOMMAND_TARGET_POWER );
+	}
+
 	if ( NeedsWriteSimulationParametersToDevice ) {
-		this->WriteSimulationParametersToDevice( *Data );
+		this->WriteSimulationParametersToDevice();
 	}
 	if ( NeedsWriteGradientToDevice ) {
-		this->WriteCurrentGradeToDevice( *Data );
+		this->WriteCurrentGradeToDevice();
 	}
+	if ( NeedsWriteTargetPowerToDevice ) {
+		this->WriteTargetPowerToDevice();
+	}
+	this->CommandScheduler.Pump( *Data );
 
 	*WriteStateCache = *this->WriteState;
-}
\ No newline at end of file
+}
@@ -23,7 +23,12 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <chrono>
 #include <unordered_map>
 
 #define WAVECONTROL_DEVICE_HR 0
@@ -51,6 +56,96 @@ struct WaveCycleSensorReadState
 	float Power = -1.0f; // Watts
 };
 
+#define WAVECONTROL_SENSORFIELD_HR 0x1
+#define WAVECONTROL_SENSORFIELD_SPEED 0x2
+#define WAVECONTROL_SENSORFIELD_CADENCE 0x4
+#define WAVECONTROL_SENSORFIELD_POWER 0x8
+#define WAVECONTROL_SENSORFIELD_ALL 0xf
+
+// Consistent copy of WaveCycleSensorReadState. Times are steady clock nanoseconds, 0 if the field never arrived.
+// Keep in sync with WaveControlDLLImport.h!
+struct WaveCycleSensorSnapshot
+{
+	uint64_t Version = 0;
+	WaveCycleSensorReadState State;
+	uint64_t HR_TimeNS = 0;
+	uint64_t Speed_TimeNS = 0;
+	uint64_t Cadence_TimeNS = 0;
+	uint64_t Power_TimeNS = 0;
+	uint64_t ReadTimeNS = 0; // When this copy was taken, for working out sample age.
+};
+
+// Seqlock around WaveCycleSensorSnapshot. Sensor callbacks publish from their own threads, readers never lock
+// and never see a half-written snapshot.
+class WaveCycleSensorSnapshotBuffer
+{
+	static const int NumWords = sizeof( WaveCycleSensorSnapshot ) / sizeof( uint64_t );
+
+	std::atomic< uint64_t > Sequence = 0;
+	std::atomic< uint64_t > Words[ NumWords ];
+
+	std::mutex WriteMutex;
+	WaveCycleSensorSnapshot WriteSnapshot;
+
+public:
+	WaveCycleSensorSnapshotBuffer();
+
+	// Copies the fields in FieldMask ( WAVECONTROL_SENSORFIELD_* ) out of State and bumps the version.
+	void Publish( int FieldMask, const WaveCycleSensorReadState& State, uint64_t TimeNS );
+
+	WaveCycleSensorSnapshot Read();
+
+	inline uint64_t GetVersion()
+	{
+		return this->Sequence.load( std::memory_order_acquire ) / 2;
+	}
+};
+
+#define WAVECONTROL_SENSORMETRIC_HR 0
+#define WAVECONTROL_SENSORMETRIC_SPEED 1
+#define WAVECONTROL_SENSORMETRIC_CADENCE 2
+#define WAVECONTROL_SENSORMETRIC_POWER 3
+#define WAVECONTROL_SENSORMETRIC_NUM 4
+
+// Samples kept per metric. At 4 Hz that's a little over 4 minutes.
+#define WAVECONTROL_SENSOR_SAMPLE_HISTORY 1024
+
+// Keep in sync with WaveControlDLLImport.h!
+struct WaveSensorSample
+{
+	uint64_t Version = 0; // Per metric, starts at 1 and goes up by one each sample. Gaps mean the ring wrapped.
+	uint64_t TimeNS = 0;
+	float Value = 0.0f;
+};
+
+// Fixed size ring of every sample that arrived for one metric, so nothing between two polls is lost.
+class WaveSensorSampleRing
+{
+	std::mutex Mutex;
+	WaveSensorSample Samples[ WAVECONTROL_SENSOR_SAMPLE_HISTORY ];
+	uint64_t NextVersion = 1;
+
+public:
+	void Push( uint64_t TimeNS, float Value );
+
+	// Copies samples newer than SinceVersion into Samples, oldest first. Returns number copied.
+	// Pass the last Version you got back in as SinceVersion to continue where you left off.
+	int Drain( uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples );
+};
+
+class WaveCycleSensorHistory
+{
+	WaveSensorSampleRing Rings[ WAVECONTROL_SENSORMETRIC_NUM ];
+
+public:
+	// Pushes a sample for each field in FieldMask ( WAVECONTROL_SENSORFIELD_* ).
+	void Push( int FieldMask, const WaveCycleSensorReadState& State, uint64_t TimeNS );
+
+	int Drain( int Metric, uint64_t SinceVersion, WaveSensorSample* Samples, int MaxSamples );
+};
+
+uint64_t WaveControl_GetTimeNS();
+
 // Keep in sync with WaveControlDLLImport.h!
 struct WaveCycleSensorWriteState
 {
@@ -59,6 +154,7 @@ struct WaveCycleSensorWriteState
 	float WindResistance = 0.6f; // 0.01 Kg/m
 	float WindSpeed = 0.0f; // m/s
 	float Gradient = 0.0f; // %
+	float TargetPower = 0.0f; // Watts. ERG mode when > 0; the trainer holds this power and ignores the simulation.
 };
 
 class WavePeripheralTable
@@ -89,6 +185,158 @@ public:
 	void MarkServiceConnected( uint64_t HandleID, const std::string& ServiceUUID, bool Connected = true );
 };
 
+// ------------------------------------------------ Measurement decoding -------------------------------------------------
+
+// Little endian reader over a notification payload. Reads byte by byte straight out of the backend's buffer, so there
+// are no copies or unaligned loads. Reading past the end returns zero and latches IsOverrun().
+class WaveByteReader
+{
+	std::string_view Bytes;
+	size_t Offset = 0;
+	bool Overrun = false;
+
+public:
+	WaveByteReader( std::string_view InBytes ) : Bytes( InBytes ) {}
+
+	uint8_t ReadU8()
+	{
+		if ( Offset + 1 > Bytes.size() ) {
+			Overrun = true;
+			return 0;
+		}
+		return ( uint8_t ) Bytes[ Offset++ ];
+	}
+
+	uint16_t ReadU16()
+	{
+		if ( Offset + 2 > Bytes.size() ) {
+			Overrun = true;
+			return 0;
+		}
+		uint16_t Value = ( uint16_t ) ( ( uint8_t ) Bytes[ Offset ] | ( ( uint8_t ) Bytes[ Offset + 1 ] << 8 ) );
+		Offset += 2;
+		return Value;
+	}
+
+	int16_t ReadS16() { return ( int16_t ) this->ReadU16(); }
+
+	uint32_t ReadU24()
+	{
+		uint32_t Low = this->ReadU16();
+		uint32_t High = this->ReadU8();
+		return Low | ( High << 16 );
+	}
+
+	uint32_t ReadU32()
+	{
+		uint32_t Low = this->ReadU16();
+		uint32_t High = this->ReadU16();
+		return Low | ( High << 16 );
+	}
+
+	void Skip( size_t Count )
+	{
+		if ( Offset + Count > Bytes.size() ) {
+			Overrun = true;
+			Offset = Bytes.size();
+			return;
+		}
+		Offset += Count;
+	}
+
+	size_t GetRemaining() const { return Offset < Bytes.size() ? Bytes.size() - Offset : 0; }
+	bool IsOverrun() const { return Overrun; }
+};
+
+// Max RR intervals that fit in a default MTU Heart Rate Measurement packet.
+#define WAVECONTROL_HRM_MAX_RR_INTERVALS 9
+
+// Heart Rate Measurement ( 0x2A37 ).
+struct WaveHRMeasurement
+{
+	uint16_t BPM = 0;
+	bool ContactSupported = false;
+	bool ContactDetected = false;
+	bool HasEnergyExpended = false;
+	uint16_t EnergyExpended = 0; // Kilo Joules
+	int NumRRIntervals = 0;
+	uint16_t RRIntervals[ WAVECONTROL_HRM_MAX_RR_INTERVALS ] = {}; // 1/1024th of a second.
+};
+
+// CSC Measurement ( 0x2A5B ).
+struct WaveCSCMeasurement
+{
+	bool HasWheel = false;
+	uint32_t WheelRevs = 0;
+	uint16_t LastWheelTime = 0; // 1/1024th of a second.
+	bool HasCrank = false;
+	uint16_t CrankRevs = 0;
+	uint16_t LastCrankTime = 0; // 1/1024th of a second.
+};
+
+// Cycling Power Measurement ( 0x2A63 ). Only the fields up to crank revolution data are decoded.
+struct WavePowerMeasurement
+{
+	uint16_t Flags = 0;
+	int16_t Power = 0; // Watts
+	bool HasPedalBalance = false;
+	uint8_t PedalBalance = 0; // 1/2 percent.
+	bool HasAccumulatedTorque = false;
+	uint16_t AccumulatedTorque = 0; // 1/32 Newton metre.
+	bool HasWheel = false;
+	uint32_t WheelRevs = 0;
+	uint16_t LastWheelTime = 0; // 1/2048th of a second.
+	bool HasCrank = false;
+	uint16_t CrankRevs = 0;
+	uint16_t LastCrankTime = 0; // 1/1024th of a second.
+};
+
+// FTMS Indoor Bike Data ( 0x2AD2 ). Fields after heart rate are not decoded.
+struct WaveIndoorBikeData
+{
+	uint16_t Flags = 0;
+	bool HasSpeed = false;
+	uint16_t Speed = 0; // 0.01 Km / Hr
+	bool HasCadence = false;
+	uint16_t Cadence = 0; // 0.5 RPM
+	bool HasPower = false;
+	int16_t Power = 0; // Watts
+	bool HasHeartRate = false;
+	uint8_t HeartRate = 0; // BPM
+};
+
+#define WAVECONTROL_FTMS_OPCODE_REQUEST_CONTROL 0x00
+#define WAVECONTROL_FTMS_OPCODE_RESET 0x01
+#define WAVECONTROL_FTMS_OPCODE_SET_TARGET_POWER 0x05
+#define WAVECONTROL_FTMS_OPCODE_START_RESUME 0x07
+#define WAVECONTROL_FTMS_OPCODE_SET_SIMULATION_PARAMETERS 0x11
+#define WAVECONTROL_FTMS_OPCODE_RESPONSE 0x80
+
+#define WAVECONTROL_FTMS_RESULT_SUCCESS 0x01
+#define WAVECONTROL_FTMS_RESULT_NOT_SUPPORTED 0x02
+#define WAVECONTROL_FTMS_RESULT_INVALID_PARAMETER 0x03
+#define WAVECONTROL_FTMS_RESULT_FAILED 0x04
+#define WAVECONTROL_FTMS_RESULT_CONTROL_NOT_PERMITTED 0x05
+
+// Fitness Machine Control Point ( 0x2AD9 ) response, indicated after every write.
+struct WaveFTMSControlPointResponse
+{
+	uint8_t RequestOpCode = 0;
+	uint8_t Result = 0;
+};
+
+// These return false and leave Out partially filled if the packet is shorter than its flags say it should be.
+bool WaveDecode_HRMeasurement( std::string_view Bytes, WaveHRMeasurement& Out );
+
+bool WaveDecode_CSCMeasurement( std::string_view Bytes, WaveCSCMeasurement& Out );
+
+bool WaveDecode_PowerMeasurement( std::string_view Bytes, WavePowerMeasurement& Out );
+
+bool WaveDecode_IndoorBikeData( std::string_view Bytes, WaveIndoorBikeData& Out );
+
+// Also returns false if the packet isn't a response.
+bool WaveDecode_FTMSControlPointResponse( std::string_view Bytes, WaveFTMSControlPointResponse& Out );
+
 // ------------------------------------------------ WaveDevice -------------------------------------------------
 
 class WaveDeviceBase
@@ -102,10 +350,17 @@ public:
 	bool NeedToReferencePeripheral = true;
 	std::shared_ptr< WaveCycleSensorReadState > ReadState;
 	std::shared_ptr< WaveCycleSensorWriteState > WriteState;
+	std::shared_ptr< WaveCycleSensorSnapshotBuffer > SnapshotBuffer;
+	std::shared_ptr< WaveCycleSensorHistory > History;
+
+	// Called from the backend thread after each notification is handled.
+	std::function< void() > OnNotification;
 
 protected:
 	std::shared_ptr< WavePeripheral > GetPeripheralFromTableInternal();
 
+	void PublishReadState( int FieldMask );
+
 public:
 	WaveDeviceBase( WavePeripheralTable* PTable );
 	virtual ~WaveDeviceBase();
@@ -116,6 +371,7 @@ class WaveHRMonitor : public WaveDeviceBase
 {
 public:
 	WaveHRMonitor( WavePeripheralTable* PTable );
+	void ParseMeasurement( std::string_view Bytes );
 	virtual void Update() override;
 };
 
@@ -134,13 +390,16 @@ class WaveCadenceSpeedSensor : public WaveDeviceBase
 	std::unique_ptr< WaveControl_WheelSizeData > WheelSize;
 
 protected:
-	void UpdateCSCFromData();
+	// Returns the WAVECONTROL_SENSORFIELD_* fields that changed.
+	int UpdateCSCFromData();
 
 public:
 	WaveCadenceSpeedSensor( WavePeripheralTable* PTable );
 
 	void SetWheelSizeData( WaveControl_WheelSizeData& WheelSizeData );
 
+	void ParseMeasurement( std::string_view Bytes );
+
 	virtual void Update() override;
 };
 
@@ -148,19 +407,151 @@ class WavePowerSensor : public WaveDeviceBase
 {
 public:
 	WavePowerSensor( WavePeripheralTable* PTable );
+	void ParseMeasurement( std::string_view Bytes );
 	virtual void Update() override;
 };
 
+// ------------------------------------------------ Trainer command scheduling -------------------------------------------------
+
+// Command types. Each has one slot, so a newer value replaces one that hasn't gone out yet. Lower types go out first.
+#define WAVECONTROL_TRAINERCOMMAND_REQUEST_CONTROL 0
+#define WAVECONTROL_TRAINERCOMMAND_START 1
+#define WAVECONTROL_TRAINERCOMMAND_SIMULATION 2
+#define WAVECONTROL_TRAINERCOMMAND_GRADE 3
+#define WAVECONTROL_TRAINERCOMMAND_TARGET_POWER 4
+#define WAVECONTROL_TRAINERCOMMAND_NUM 5
+
+// Minimum gap between two writes to the same trainer, so per-frame updates don't flood its BLE write queue.
+#define WAVECONTROL_TRAINERCOMMAND_MIN_INTERVAL_MS 250
+
+// Stop waiting for an ack after this long and move on to the next command.
+#define WAVECONTROL_TRAINERCOMMAND_ACK_TIMEOUT_MS 1000
+
+// Keep in sync with WaveTrainerCommandCounters::Load().
+struct WaveTrainerCommandStats
+{
+	uint64_t Sent = 0;
+	uint64_t Merged = 0; // Replaced by a newer command of the same type before going out.
+	uint64_t Dropped = 0; // Still pending when the link or control was lost.
+	uint64_t Acked = 0;
+	uint64_t Failed = 0; // Acked with an error.
+	uint64_t TimedOut = 0; // No ack within WAVECONTROL_TRAINERCOMMAND_ACK_TIMEOUT_MS.
+	uint64_t LatencyTotalNS = 0; // First submit to ack, over Acked + Failed commands.
+	uint64_t LatencyMaxNS = 0;
+};
+
+// Shared between the trainer device and WaveControl::GetStats(), which reads them from another thread.
+struct WaveTrainerCommandCounters
+{
+	std::atomic< uint64_t > Sent = 0;
+	std::atomic< uint64_t > Merged = 0;
+	std::atomic< uint64_t > Dropped = 0;
+	std::atomic< uint64_t > Acked = 0;
+	std::atomic< uint64_t > Failed = 0;
+	std::atomic< uint64_t > TimedOut = 0;
+	std::atomic< uint64_t > LatencyTotalNS = 0;
+	std::atomic< uint64_t > LatencyMaxNS = 0;
+
+	WaveTrainerCommandStats Load() const;
+};
+
+// Per trainer write scheduler. Commands coalesce per type ( last value wins ), only one is in flight waiting on its
+// ack at a time, and writes are spaced at least the minimum interval apart. Submit / Pump / Reset are called from the
+// worker thread, OnAck from the backend thread.
+class WaveTrainerCommandScheduler
+{
+	struct Command
+	{
+		bool Pending = false;
+		bool WithResponse = false;
+		std::string Service;
+		std::string Characteristic;
+		std::string Payload;
+		std::chrono::steady_clock::time_point SubmitTime;
+	};
+
+	std::mutex Mutex;
+	Command Commands[ WAVECONTROL_TRAINERCOMMAND_NUM ];
+	bool InFlight = false;
+	uint8_t InFlightOpCode = 0;
+	std::chrono::steady_clock::time_point InFlightSubmitTime;
+	std::chrono::steady_clock::time_point LastSendTime;
+	int MinIntervalMS = WAVECONTROL_TRAINERCOMMAND_MIN_INTERVAL_MS;
+
+public:
+	std::shared_ptr< WaveTrainerCommandCounters > Counters;
+
+	WaveTrainerCommandScheduler();
+
+	void SetMinIntervalMS( int IntervalMS );
+
+	// The first payload byte is the op code the ack is matched against.
+	void Submit( int Type, const std::string& Service, const std::string& Characteristic, bool WithResponse, const std::string& Payload );
+
+	// Drops a pending command that has been made moot, eg. a target power after leaving ERG. Counts as merged.
+	void Cancel( int Type );
+
+	// Writes the next pending command if the trainer is ready for it.
+	void Pump( WavePeripheral& Data );
+
+	void OnAck( uint8_t OpCode, bool Success );
+
+	// Forget everything pending and in flight, eg. on disconnect.
+	void Reset();
+
+	bool IsIdle();
+};
+
+// FTMS control handshake state.
+#define WAVECONTROL_FTMS_CONTROL_NONE 0
+#define WAVECONTROL_FTMS_CONTROL_REQUESTED 1
+#define WAVECONTROL_FTMS_CONTROL_GRANTED 2
+
+// How long to wait for a Request Control ack, or to back off after being refused, before asking again.
+#define WAVECONTROL_FTMS_CONTROL_RETRY_MS 1000
+
 class WaveTrainerDevice : public WaveDeviceBase
 {
 	std::unique_ptr< WaveCycleSensorWriteState > WriteStateCache;
 	int TrainerControlMode = WAVECONTROL_TRAINERCONTROL_UNKNOWN;
 
+	// WAVECONTROL_SENSORFIELD_* the trainer's own data is allowed to write into ReadState.
+	std::atomic< int > ReadFieldMask = 0;
+
+	// Control point acks arrive on the backend thread; the rest is worker thread only.
+	std::atomic< int > FTMS_ControlState = WAVECONTROL_FTMS_CONTROL_NONE;
+	bool FTMS_ControlWasGranted = false;
+	std::chrono::steady_clock::time_point FTMS_ControlRetryTime;
+	std::atomic< uint64_t > FTMS_NumAcks = 0;
+	std::atomic< uint64_t > FTMS_NumFailedAcks = 0;
+
+	WaveTrainerCommandScheduler CommandScheduler;
+
 protected:
-	void WriteSimulationParametersToDevice( WavePeripheral& Data );
-	void WriteCurrentGradeToDevice( WavePeripheral& Data );
+	// These queue on CommandScheduler; Update() pumps it.
+	void WriteSimulationParametersToDevice();
+	void WriteCurrentGradeToDevice();
+	void WriteTargetPowerToDevice();
+	void WriteFTMSControlPoint( int Type, const std::string& Cmdbuf );
+
+	void SetupFTMS( WavePeripheral& Data );
+	bool UpdateFTMSControl();
 
 public:
 	WaveTrainerDevice( WavePeripheralTable* PTable );
+
+	void SetReadFieldMask( int FieldMask );
+	void SetCommandCounters( std::shared_ptr< WaveTrainerCommandCounters > Counters );
+	void SetCommandMinIntervalMS( int IntervalMS );
+	int GetTrainerControlMode() const;
+	int GetFTMSControlState() const;
+	uint64_t GetFTMSNumAcks() const;
+	uint64_t GetFTMSNumFailedAcks() const;
+
+	void ParseIndoorBikeData( std::string_view Bytes );
+	void ParseFTMSControlPointResponse( std::string_view Bytes );
+	void ParseFTMSStatus( std::string_view Bytes );
+	void ParseWahooResponse( std::string_view Bytes );
+
 	virtual void Update() override;
 };
\ No newline at end of file
@@ -26,26 +26,39 @@
 #include <functional>
 #include <algorithm>
 #include <chrono>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <thread>
 
+#include <expat.h>
 #include <gpx/GPX.h>
-#include <gpx/Parser.h>
 #include <gpx/Writer.h>
-#include <gpx/Report.h>
-#include <gpx/ReportCerr.h>
-#include <geodetic_conv.hpp>
 #include <date.h>
 
 #include <Eigen/Core>
 #include <Eigen/Eigen>
 typedef Eigen::Vector3d WVec3;
+
+#define WAVEGPX_STREAM_BUFFER_SIZE ( 64 * 1024 )
+
+// Segments WaveRouteCursor walks before deciding a jump is big enough to search for instead.
+#define WAVEGPX_CURSOR_MAX_WALK 64
+// Distances WaveRouteUtil_SampleRoute locates before lerping them, sized so its scratch fits on the stack.
+#define WAVEGPX_SAMPLE_BLOCK 256
+#define WAVEGPX_STREAM_MAX_DEPTH 32
+#define WAVEGPX_STREAM_RESERVE_SAMPLE 64
+#define WAVEGPX_SIMPLIFY_MAX_ATTEMPTS 4
+
 inline WVec3 WaveGPX_PointToVec(const FWaveGPXPoint& P)
 {
 	return WVec3( P.East, P.North, P.Up );
 }
 
-static double WaveLerp( double A, float B, double t )
+static double WaveLerp( double A, double B, double t )
 {
-	return A * ( 1.0f - t ) + B * t;
+	return A * ( 1.0 - t ) + B * t;
 }
 
 WaveGPX::WaveGPX()
@@ -56,146 +69,668 @@ WaveGPX::~WaveGPX()
 {
 }
 
-#pragma optimize("", off);
+// Elements the streaming loader cares about. Anything else is skipped, along with everything inside it.
+enum WaveGPXElement : uint8_t
+{
+	WAVEGPX_ELEMENT_OTHER = 0,
+	WAVEGPX_ELEMENT_GPX,
+	WAVEGPX_ELEMENT_METADATA,
+	WAVEGPX_ELEMENT_AUTHOR,
+	WAVEGPX_ELEMENT_NAME,
+	WAVEGPX_ELEMENT_DESC,
+	WAVEGPX_ELEMENT_TRK,
+	WAVEGPX_ELEMENT_TRKSEG,
+	WAVEGPX_ELEMENT_TRKPT,
+	WAVEGPX_ELEMENT_ELE,
+};
+
+// Running route stats, fed one point at a time. Shared by CalcRouteStats and catalog scans so both give exactly
+// the same numbers.
+struct WaveGPXStatAccumulator
+{
+	FWaveGPXPoint PrevPoint;
+	int NumPoints = 0;
+
+	float Stat_Elev = 0.0f;
+	float Stat_Length = 0.0f;
+	float Stat_HillinessRating = 0.0f;
+	float Stat_DifficultyScore = 0.0f;
+	float Stat_HighestAlt = 0.0f;
+	float Stat_LowestAlt = 0.0f;
+
+	// Fills in Point.Dist.
+	void AddPoint( FWaveGPXPoint& Point )
+	{
+		if ( NumPoints++ == 0 ) {
+			Point.Dist = 0.0;
+			Stat_HighestAlt = Point.Alt;
+			Stat_LowestAlt = Point.Alt;
+			PrevPoint = Point;
+			return;
+		}
 
+		auto PrevPointVector = WaveGPX_PointToVec( PrevPoint );
+		auto CurrPointVector = WaveGPX_PointToVec( Point );
+		auto Dist = (CurrPointVector - PrevPointVector).norm();
+		auto Elev = CurrPointVector.z() - PrevPointVector.z();
+		Point.Dist = PrevPoint.Dist + Dist;
 
-bool WaveGPX::LoadRouteGPX( FWaveGPXRoute& Route, const std::string FileName )
+		Stat_Length += ( float ) Dist;
+		Stat_Elev += ( Elev > 0 ) ? ( float ) Elev : 0.0f;
+		Stat_HighestAlt = ( Point.Alt > Stat_HighestAlt ) ? Point.Alt : Stat_HighestAlt;
+		Stat_LowestAlt = ( Point.Alt <= Stat_LowestAlt ) ? Point.Alt : Stat_LowestAlt;
+		PrevPoint = Point;
+	}
+
+	void Finish()
+	{
+		// Hilliness rating is a heuristic taken from Western Wheelers club system, which I believe
+		// is quite intuitive:
+		//     https://westernwheelersbicycleclub.wildapricot.org/page-1374754
+		//
+		float LengthMiles = Stat_Length * 0.000621371f;
+		float ElevFeet = Stat_Elev * 3.28084;
+		if ( LengthMiles > 0.000001f ) {
+			Stat_HillinessRating = ( ElevFeet / LengthMiles ) / 25.0f;
+		}
+	}
+
+	// Works for both FWaveGPXRoute and FWaveGPXCatalogEntry.
+	template< typename T >
+	void Store( T& Out ) const
+	{
+		Out.Stat_Elev = Stat_Elev;
+		Out.Stat_Length = Stat_Length;
+		Out.Stat_HillinessRating = Stat_HillinessRating;
+		Out.Stat_DifficultyScore = Stat_DifficultyScore;
+		Out.Stat_HighestAlt = Stat_HighestAlt;
+		Out.Stat_LowestAlt = Stat_LowestAlt;
+	}
+};
+
+// State for the expat callbacks. Track points go straight into Route.Points as their closing tag is seen, so the
+// only per-point work is a couple of strcmps, three from_chars and the ENU conversion. Text is reused between
+// elements and never shrinks, so after the first few points nothing here allocates. Catalog scans and compact
+// loads set Stats instead of Route, and points are folded into the stats and CompactRoute ( if set ) instead.
+struct WaveGPXStreamState
+{
+	XML_Parser Parser = nullptr;
+	FWaveGPXRoute* Route = nullptr;
+	WaveGPXStatAccumulator* Stats = nullptr;
+	FWaveGPXCompactRoute* CompactRoute = nullptr;
+
+	// ENU frame at the first point.
+	FWaveGPXGeoFrame Frame;
+
+	WaveGPXElement Stack[ WAVEGPX_STREAM_MAX_DEPTH ];
+	int Depth = 0;
+
+	std::string Text;
+	bool CollectText = false;
+
+	FWaveGPXPoint Point;
+	int NumTracks = 0;
+
+	std::string Version;
+	bool HasMetadata = false;
+	std::string MetadataName;
+	std::string MetadataDesc;
+	std::string AuthorName;
+	bool AuthorHasName = false;
+	bool AuthorHasChildren = false;
+	std::string TrackName;
+};
+
+static const char* WaveGPX_LocalName( const XML_Char* Name )
+{
+	auto Colon = strrchr( Name, ':' );
+	return Colon ? Colon + 1 : Name;
+}
+
+static double WaveGPX_ParseDouble( const char* Begin, const char* End )
+{
+	while ( Begin < End && isspace( ( unsigned char ) *Begin ) ) Begin++;
+	if ( Begin < End && *Begin == '+' ) Begin++;
+
+	double Ret = 0.0;
+	std::from_chars( Begin, End, Ret );
+	return Ret;
+}
+
+static double WaveGPX_ParseDouble( const std::string& Value )
 {
-	std::ifstream FileStream( FileName );
+	return WaveGPX_ParseDouble( Value.data(), Value.data() + Value.size() );
+}
+
+static std::string WaveGPX_Trim( const std::string& Value )
+{
+	auto Begin = Value.find_first_not_of( " \t\r\n" );
+	if ( Begin == std::string::npos )
+		return "";
+	auto End = Value.find_last_not_of( " \t\r\n" );
+	return Value.substr( Begin, End - Begin + 1 );
+}
+
+static WaveGPXElement WaveGPX_ClassifyElement( WaveGPXElement Parent, int Depth, const char* Name )
+{
+	switch ( Parent ) {
+		case WAVEGPX_ELEMENT_TRKSEG:
+			return !strcmp( Name, "trkpt" ) ? WAVEGPX_ELEMENT_TRKPT : WAVEGPX_ELEMENT_OTHER;
+		case WAVEGPX_ELEMENT_TRKPT:
+			return !strcmp( Name, "ele" ) ? WAVEGPX_ELEMENT_ELE : WAVEGPX_ELEMENT_OTHER;
+		case WAVEGPX_ELEMENT_TRK:
+			if ( !strcmp( Name, "trkseg" ) ) return WAVEGPX_ELEMENT_TRKSEG;
+			if ( !strcmp( Name, "name" ) ) return WAVEGPX_ELEMENT_NAME;
+			return WAVEGPX_ELEMENT_OTHER;
+		case WAVEGPX_ELEMENT_GPX:
+			if ( !strcmp( Name, "trk" ) ) return WAVEGPX_ELEMENT_TRK;
+			if ( !strcmp( Name, "metadata" ) ) return WAVEGPX_ELEMENT_METADATA;
+			return WAVEGPX_ELEMENT_OTHER;
+		case WAVEGPX_ELEMENT_METADATA:
+			if ( !strcmp( Name, "name" ) ) return WAVEGPX_ELEMENT_NAME;
+			if ( !strcmp( Name, "desc" ) ) return WAVEGPX_ELEMENT_DESC;
+			if ( !strcmp( Name, "author" ) ) return WAVEGPX_ELEMENT_AUTHOR;
+			return WAVEGPX_ELEMENT_OTHER;
+		case WAVEGPX_ELEMENT_AUTHOR:
+			return !strcmp( Name, "name" ) ? WAVEGPX_ELEMENT_NAME : WAVEGPX_ELEMENT_OTHER;
+		default:
+			break;
+	}
+	if ( Depth == 0 && !strcmp( Name, "gpx" ) )
+		return WAVEGPX_ELEMENT_GPX;
+	return WAVEGPX_ELEMENT_OTHER;
+}
+
+static void XMLCALL WaveGPX_StreamStartElement( void* UserData, const XML_Char* Name, const XML_Char** Atts )
+{
+	auto& State = *( WaveGPXStreamState* ) UserData;
+
+	// Everything below an element we skip is skipped too, as is anything nested deeper than we keep track of.
+	WaveGPXElement Parent = WAVEGPX_ELEMENT_OTHER;
+	if ( State.Depth > 0 && State.Depth <= WAVEGPX_STREAM_MAX_DEPTH ) {
+		Parent = State.Stack[ State.Depth - 1 ];
+	}
+	WaveGPXElement Element = WAVEGPX_ELEMENT_OTHER;
+	if ( State.Depth == 0 || Parent != WAVEGPX_ELEMENT_OTHER ) {
+		Element = WaveGPX_ClassifyElement( Parent, State.Depth, WaveGPX_LocalName( Name ) );
+	}
+
+	if ( Parent == WAVEGPX_ELEMENT_METADATA ) {
+		State.HasMetadata = true;
+	} else if ( Parent == WAVEGPX_ELEMENT_AUTHOR ) {
+		State.AuthorHasChildren = true;
+	}
+
+	switch ( Element ) {
+		case WAVEGPX_ELEMENT_GPX:
+			for ( int i = 0; Atts[i]; i += 2 ) {
+				if ( !strcmp( Atts[i], "version" ) ) State.Version = Atts[i + 1];
+			}
+			break;
+		case WAVEGPX_ELEMENT_TRK:
+			State.NumTracks++;
+			break;
+		case WAVEGPX_ELEMENT_TRKSEG:
+			// Only the first track is loaded.
+			if ( State.NumTracks > 1 ) Element = WAVEGPX_ELEMENT_OTHER;
+			break;
+		case WAVEGPX_ELEMENT_TRKPT:
+			State.Point = FWaveGPXPoint();
+			for ( int i = 0; Atts[i]; i += 2 ) {
+				auto AttName = WaveGPX_LocalName( Atts[i] );
+				auto AttValue = Atts[i + 1];
+				if ( !strcmp( AttName, "lat" ) ) State.Point.Lat = WaveGPX_ParseDouble( AttValue, AttValue + strlen( AttValue ) );
+				else if ( !strcmp( AttName, "lon" ) ) State.Point.Lon = WaveGPX_ParseDouble( AttValue, AttValue + strlen( AttValue ) );
+			}
+			break;
+		case WAVEGPX_ELEMENT_AUTHOR:
+			State.AuthorHasChildren = false;
+			break;
+		default:
+			break;
+	}
+
+	State.Text.clear();
+	State.CollectText = ( Element == WAVEGPX_ELEMENT_NAME || Element == WAVEGPX_ELEMENT_DESC || Element == WAVEGPX_ELEMENT_ELE || Element == WAVEGPX_ELEMENT_AUTHOR );
+
+	if ( State.Depth < WAVEGPX_STREAM_MAX_DEPTH ) {
+		State.Stack[ State.Depth ] = Element;
+	}
+	State.Depth++;
+}
+
+static void XMLCALL WaveGPX_StreamEndElement( void* UserData, const XML_Char* Name )
+{
+	auto& State = *( WaveGPXStreamState* ) UserData;
+
+	State.Depth--;
+	if ( State.Depth >= WAVEGPX_STREAM_MAX_DEPTH )
+		return;
+	WaveGPXElement Element = State.Stack[ State.Depth ];
+	WaveGPXElement Parent = State.Depth ? State.Stack[ State.Depth - 1 ] : WAVEGPX_ELEMENT_OTHER;
+
+	switch ( Element ) {
+		case WAVEGPX_ELEMENT_ELE:
+			State.Point.Alt = WaveGPX_ParseDouble( State.Text );
+			break;
+		case WAVEGPX_ELEMENT_TRKPT:
+		{
+			auto& P = State.Point;
+
+			// Full routes convert all their points to ENU in one batch once they're loaded.
+			if ( State.Route ) {
+				State.Route->Points.push_back( P );
+			} else {
+				// Convert LLA waypoint to ENU.
+				if ( !State.Frame.Valid ) {
+					WaveGPXGeo_InitFrame( State.Frame, P.Lat, P.Lon, P.Alt );
+				}
+				WaveGPXGeo_LLAToENU( State.Frame, P.Lat, P.Lon, P.Alt, P.East, P.North, P.Up );
+				State.Stats->AddPoint( P );
+				if ( State.CompactRoute ) {
+					State.CompactRoute->AddPoint( P );
+				}
+			}
+			break;
+		}
+		case WAVEGPX_ELEMENT_NAME:
+			if ( Parent == WAVEGPX_ELEMENT_METADATA ) {
+				State.MetadataName = State.Text;
+			} else if ( Parent == WAVEGPX_ELEMENT_AUTHOR ) {
+				State.AuthorName = State.Text;
+				State.AuthorHasName = true;
+			} else if ( Parent == WAVEGPX_ELEMENT_TRK && State.NumTracks == 1 ) {
+				State.TrackName = State.Text;
+			}
+			break;
+		case WAVEGPX_ELEMENT_DESC:
+			State.MetadataDesc = State.Text;
+			break;
+		case WAVEGPX_ELEMENT_AUTHOR:
+			// GPX 1.1 puts the author's name in a child element, but our own recordings write it as plain text.
+			if ( !State.AuthorHasName && !State.AuthorHasChildren ) {
+				State.AuthorName = WaveGPX_Trim( State.Text );
+			}
+			break;
+		default:
+			break;
+	}
+	State.CollectText = false;
+}
+
+static void XMLCALL WaveGPX_StreamCharacterData( void* UserData, const XML_Char* Data, int Length )
+{
+	auto& State = *( WaveGPXStreamState* ) UserData;
+	if ( State.CollectText ) {
+		State.Text.append( Data, Length );
+	}
+}
+
+// Runs the whole file through the expat callbacks. ContentHash, if set, is updated with every byte read.
+static bool WaveGPX_ParseStream( WaveGPXStreamState& State, const std::string& FileName, uint64_t* ContentHash )
+{
+	std::ifstream FileStream( FileName, std::ios::in | std::ios::binary );
 
 	if( !FileStream.is_open() ) {
 		WAVECONTROL_LOG( "ERROR: Failed to open file %s!\n", FileName.c_str() );
 		return false;
 	}
 
-	// Parse the GPX file format using gpxlib library.
-	gpx::ReportCerr GPXError;
-	gpx::Parser GPXParser( &GPXError );
-	gpx::GPX* GPXRoot = GPXParser.parse( FileStream );
-	if( !GPXRoot ) {
+	FileStream.seekg( 0, std::ios::end );
+	uint64_t FileSize = ( uint64_t ) FileStream.tellg();
+	FileStream.seekg( 0, std::ios::beg );
+
+	// Parse the GPX file with expat directly, a block at a time. Building gpxlib's DOM costs an allocation per
+	// element and keeps the whole file in memory as nodes, which dominated loading on long routes.
+	State.Text.reserve( 256 );
+	State.Parser = XML_ParserCreate( nullptr );
+	XML_SetUserData( State.Parser, &State );
+	XML_SetElementHandler( State.Parser, WaveGPX_StreamStartElement, WaveGPX_StreamEndElement );
+	XML_SetCharacterDataHandler( State.Parser, WaveGPX_StreamCharacterData );
+
+	bool Reserved = !State.Route;
+	bool Success = true;
+	while ( true ) {
+		void* Buffer = XML_GetBuffer( State.Parser, WAVEGPX_STREAM_BUFFER_SIZE );
+		if ( !Buffer ) {
+			Success = false;
+			break;
+		}
+		FileStream.read( ( char* ) Buffer, WAVEGPX_STREAM_BUFFER_SIZE );
+		int BytesRead = ( int ) FileStream.gcount();
+		bool IsFinal = BytesRead < WAVEGPX_STREAM_BUFFER_SIZE;
+		if ( ContentHash ) {
+			*ContentHash = WaveGPXCache_HashBytes( *ContentHash, Buffer, BytesRead );
+		}
+		if ( XML_ParseBuffer( State.Parser, BytesRead, IsFinal ) == XML_STATUS_ERROR ) {
+			Success = false;
+			break;
+		}
+
+		// Once we've seen enough points to know how many bytes each takes in this file, reserve for the rest
+		// so the vector doesn't keep doubling ( and briefly holding two copies ) on long routes.
+		if ( !Reserved && State.Route->Points.size() >= WAVEGPX_STREAM_RESERVE_SAMPLE ) {
+			auto& Points = State.Route->Points;
+			uint64_t BytesParsed = ( uint64_t ) XML_GetCurrentByteIndex( State.Parser );
+			if ( BytesParsed > 0 ) {
+				double PointsPerByte = ( double ) Points.size() / ( double ) BytesParsed;
+				Points.reserve( ( size_t ) ( FileSize * PointsPerByte * 1.05 ) + WAVEGPX_STREAM_RESERVE_SAMPLE );
+			}
+			Reserved = true;
+		}
+
+		if ( IsFinal )
+			break;
+	}
+
+	if ( !Success ) {
 		WAVECONTROL_LOG(
 			"ERROR: GPX Parse failure due to %s on line %d col %d!\n",
-			GPXParser.errorText().c_str(),
-			GPXParser.errorLineNumber(),
-			GPXParser.errorColumnNumber()
+			XML_ErrorString( XML_GetErrorCode( State.Parser ) ),
+			( int ) XML_GetCurrentLineNumber( State.Parser ),
+			( int ) XML_GetCurrentColumnNumber( State.Parser )
 		);
-		return false;
 	}
+	XML_ParserFree( State.Parser );
+	State.Parser = nullptr;
+	return Success;
+}
 
-	WAVECONTROL_LOG( "GPX Version: %s\n", GPXRoot->version().getValue().c_str() );
-
+// Works for both FWaveGPXRoute and FWaveGPXCatalogEntry.
+template< typename T >
+static void WaveGPX_FillMetadata( const WaveGPXStreamState& State, T& Out )
+{
 	// Read metadata from the GPX file.
-	if ( GPXRoot->metadata().hasElements() ) {
-		Route.Name = GPXRoot->metadata().name().getValue();
-		Route.Description = GPXRoot->metadata().desc().getValue();
-		Route.Author = GPXRoot->metadata().author().name().getValue();
+	if ( State.HasMetadata ) {
+		Out.Name = State.MetadataName;
+		Out.Description = State.MetadataDesc;
+		Out.Author = State.AuthorName;
 	} else {
-		Route.Name = "";
-		Route.Description = "";
-		Route.Author = "Unknown";
+		Out.Name = "";
+		Out.Description = "";
+		Out.Author = "Unknown";
 	}
-	Route.SourceFile = FileName;
-	Route.Points.clear();
-
-	// Read waypoint from the GPX file.
 
-	auto ConvertGPXDecimalToDouble = []( gpx::Decimal& Val ) -> double
-	{
-		double Ret = 0.0;
-		sscanf_s( Val.getValue().c_str(), "%lf", &Ret);
-		return Ret;
-	};
-
-	geodetic_converter::GeodeticConverter GConverter;
-
-	bool ReferencePointInitialised = false;
-	auto AppendPointsToRoute = [&]( std::list< gpx::WPT* >& Points )
-	{
-		for( auto& Point : Points ) {
-			FWaveGPXPoint P;
-
-			// Convert string LLA to double.
-			P.Lat = ConvertGPXDecimalToDouble( Point->lat() );
-			P.Lon = ConvertGPXDecimalToDouble( Point->lon() );
-			P.Alt = ConvertGPXDecimalToDouble( Point->ele() );
-
-			// Convert LLA waypoint to ENU.
-			if ( !ReferencePointInitialised ) {
-				GConverter.initialiseReference( P.Lat, P.Lon, P.Alt );
-				ReferencePointInitialised = true;
-			}
-			GConverter.geodetic2Enu( P.Lat, P.Lon, P.Alt, &P.East, &P.North, &P.Up );
+	if ( !Out.Name.length() ) {
+		// No metadata, use the first track's name as the route name.
+		Out.Name = State.TrackName;
+	}
+	if ( !Out.Name.length() ) {
+		// No metadata, or track name, use the file name as final fallback.
+		Out.Name = Out.SourceFile;
+	}
+}
 
-			// WAVECONTROL_LOG( "Point %lf %lf %lf ( %lf %lf %lf )!\n", P.Lat, P.Lon, P.Alt, P.East, P.North, P.Up );
-			Route.Points.push_back( P );
-		}
-	};
+// Simplifies Route.Points with LoadOptions' tolerances, halving them until the length and climbing stats are within
+// SimplifyMaxStatError of the original.
+static void WaveGPX_SimplifyRoute( FWaveGPXRoute& Route, const FWaveGPXLoadOptions& LoadOptions )
+{
+	WaveGPXStatAccumulator Original;
+	for ( auto& Point : Route.Points ) {
+		Original.AddPoint( Point );
+	}
 
-	auto& GPXTracks = GPXRoot->trks().list();
-	for( auto& Track : GPXTracks ) {
+	float HorizontalTolerance = LoadOptions.SimplifyHorizontalTolerance;
+	float VerticalTolerance = LoadOptions.SimplifyVerticalTolerance;
+	std::vector< FWaveGPXPoint > SimplifiedPoints;
+	for ( int Attempt = 0; Attempt < WAVEGPX_SIMPLIFY_MAX_ATTEMPTS; Attempt++ ) {
+		auto Report = WaveRouteUtil_SimplifyPoints( Route.Points, SimplifiedPoints, HorizontalTolerance, VerticalTolerance );
 
-		if ( !Route.Name.length() ) {
-			// No metadata, use the first track's name as the route name.
-			Route.Name = Track->name().getValue();
+		WaveGPXStatAccumulator Simplified;
+		for ( auto& Point : SimplifiedPoints ) {
+			Simplified.AddPoint( Point );
 		}
-
-		auto& Segments = Track->trksegs().list();
-		for( auto& Segment : Segments ) {
-			auto& Points = Segment->trkpts().list();
-			AppendPointsToRoute( Points );
+		float LengthError = fabsf( Simplified.Stat_Length - Original.Stat_Length ) / std::max( Original.Stat_Length, 1.0f );
+		float ElevError = fabsf( Simplified.Stat_Elev - Original.Stat_Elev ) / std::max( Original.Stat_Elev, 1.0f );
+		if ( LengthError <= LoadOptions.SimplifyMaxStatError && ElevError <= LoadOptions.SimplifyMaxStatError ) {
+			WAVECONTROL_LOG( "Simplified %d points to %d, max deviation %.2f M horizontal %.2f M vertical.\n",
+				Report.NumPointsBefore, Report.NumPointsBefore - Report.NumPointsRemoved, Report.MaxHorizontalDeviation, Report.MaxVerticalDeviation );
+			Route.Points.swap( SimplifiedPoints );
+			return;
 		}
+		HorizontalTolerance *= 0.5f;
+		VerticalTolerance *= 0.5f;
+	}
+	WAVECONTROL_LOG( "Simplification changed route stats too much, keeping all %d points.\n", ( int ) Route.Points.size() );
+}
 
-		break;
+// Lookup structures aren't cached, they are quick to rebuild from the points.
+static void WaveGPX_BuildLookups( FWaveGPXRoute& Route, const FWaveGPXLoadOptions& LoadOptions )
+{
+	Route.GeoFrame = FWaveGPXGeoFrame();
+	if ( Route.Points.size() ) {
+		WaveGPXGeo_InitFrame( Route.GeoFrame, Route.Points[0].Lat, Route.Points[0].Lon, Route.Points[0].Alt );
 	}
-	FileStream.close();
+	if ( LoadOptions.BuildSpatialIndex ) {
+		WaveRouteUtil_BuildSpatialIndex( Route );
+	} else {
+		Route.SpatialIndex = FWaveGPXSpatialIndex();
+	}
+	if ( LoadOptions.BuildGradeProfile ) {
+		WaveRouteUtil_BuildGradeProfile( Route, Route.GradeProfile );
+	} else {
+		Route.GradeProfile = FWaveGPXGradeProfile();
+	}
+	if ( LoadOptions.BuildLODPyramid ) {
+		WaveRouteUtil_BuildLODPyramid( Route, Route.LODPyramid );
+	} else {
+		Route.LODPyramid = FWaveGPXLODPyramid();
+	}
+	if ( LoadOptions.BuildSpline ) {
+		WaveRouteUtil_BuildSpline( Route, Route.Spline );
+	} else {
+		Route.Spline = FWaveGPXSpline();
+	}
+}
 
-	if ( !Route.Name.length() ) {
-		// No metadata, or track name, use the file name as final fallback.
-		Route.Name = Route.SourceFile;
+bool WaveGPX::LoadRouteGPX( FWaveGPXRoute& Route, const std::string FileName )
+{
+	if ( LoadOptions.UseRouteCache && WaveGPXCache_Load( Route, FileName, LoadOptions ) ) {
+		WAVECONTROL_LOG( "Loaded %s ( %d points ) from route cache.\n", Route.Name.c_str(), ( int ) Route.Points.size() );
+		WaveGPX_BuildLookups( Route, LoadOptions );
+		return true;
 	}
+
+	Route.SourceFile = FileName;
+	Route.Points.clear();
+
+	WaveGPXStreamState State;
+	State.Route = &Route;
+	uint64_t ContentHash = WAVEGPX_CACHE_HASH_SEED;
+	if ( !WaveGPX_ParseStream( State, FileName, LoadOptions.UseRouteCache ? &ContentHash : nullptr ) )
+		return false;
+	WaveRouteUtil_FillENUFromLLA( Route, Route.Points.data(), Route.Points.size() );
+
+	WAVECONTROL_LOG( "GPX Version: %s\n", State.Version.c_str() );
+	WaveGPX_FillMetadata( State, Route );
 	WAVECONTROL_LOG( "Name: %s\n" , Route.Name.c_str() );
 	WAVECONTROL_LOG( "Desc: %s\n" , Route.Description.c_str() );
 	WAVECONTROL_LOG( "Author: %s\n" , Route.Author.c_str() );
+	if ( LoadOptions.Simplify ) {
+		WaveGPX_SimplifyRoute( Route, LoadOptions );
+	}
 	this->CalcRouteStats( Route );
+	WaveGPX_BuildLookups( Route, LoadOptions );
 
+	if ( LoadOptions.UseRouteCache ) {
+		WaveGPXCache_Save( Route, FileName, ContentHash, LoadOptions );
+	}
 	return true;
 }
 
-void WaveGPX::CalcRouteStats( FWaveGPXRoute& Route )
+bool WaveGPX::LoadRouteGPX( FWaveGPXCompactRoute& Route, const std::string FileName )
 {
-	Route.Stat_Elev = 0.0f;
-	Route.Stat_Length = 0.0f;
-	Route.Stat_HillinessRating = 0.0f;
-	Route.Stat_DifficultyScore = 0.0f;
-	Route.Stat_HighestAlt = Route.Points.size() ? Route.Points[0].Alt : 0.0f;
-	Route.Stat_LowestAlt = Route.Points.size() ? Route.Points[0].Alt : 0.0f;
+	// Simplifying needs the whole route at once, so that goes through a full size route too.
+	FWaveGPXRoute FullRoute;
+	if ( LoadOptions.Simplify ) {
+		if ( !LoadRouteGPX( FullRoute, FileName ) )
+			return false;
+		WaveRouteUtil_MakeCompactRoute( FullRoute, Route );
+		return true;
+	}
+	if ( LoadOptions.UseRouteCache && WaveGPXCache_Load( FullRoute, FileName, LoadOptions ) ) {
+		WaveRouteUtil_MakeCompactRoute( FullRoute, Route );
+		return true;
+	}
 
-	for ( int i = 1; i < Route.Points.size(); i++ ) {
-		auto& PrevPoint = Route.Points[ i - 1 ];
-		auto& CurrPoint = Route.Points[ i ];
+	Route = FWaveGPXCompactRoute();
+	Route.SourceFile = FileName;
 
-		auto PrevPointVector = WaveGPX_PointToVec( PrevPoint );
-		auto CurrPointVector = WaveGPX_PointToVec( CurrPoint );
-		auto Dist = (CurrPointVector - PrevPointVector).norm();
-		auto Elev = CurrPointVector.z() - PrevPointVector.z();
-		CurrPoint.Dist = PrevPoint.Dist + Dist;
+	WaveGPXStatAccumulator Stats;
+	WaveGPXStreamState State;
+	State.Stats = &Stats;
+	State.CompactRoute = &Route;
+	if ( !WaveGPX_ParseStream( State, FileName, nullptr ) )
+		return false;
+
+	WaveGPX_FillMetadata( State, Route );
+	Stats.Finish();
+	Stats.Store( Route );
+	return true;
+}
+
+bool WaveGPX::ScanRouteGPX( FWaveGPXCatalogEntry& Entry, const std::string FileName )
+{
+	// A valid route cache already has the stats in its header, so there is no need to touch the points.
+	if ( LoadOptions.UseRouteCache && WaveGPXCache_LoadCatalogEntry( Entry, FileName, LoadOptions ) )
+		return true;
+
+	Entry.SourceFile = FileName;
+
+	WaveGPXStatAccumulator Stats;
+	WaveGPXStreamState State;
+	State.Stats = &Stats;
+	if ( !WaveGPX_ParseStream( State, FileName, nullptr ) )
+		return false;
 
-		Route.Stat_Length += ( float ) Dist;
-		Route.Stat_Elev += ( Elev > 0 ) ? ( float ) Elev : 0.0f;
-		Route.Stat_HighestAlt = ( CurrPoint.Alt > Route.Stat_HighestAlt ) ? CurrPoint.Alt : Route.Stat_HighestAlt;
-		Route.Stat_LowestAlt = ( CurrPoint.Alt <= Route.Stat_LowestAlt ) ? CurrPoint.Alt : Route.Stat_LowestAlt;
+	WaveGPX_FillMetadata( State, Entry );
+	Stats.Finish();
+	Stats.Store( Entry );
+	Entry.NumPoints = Stats.NumPoints;
+	return true;
+}
+
+bool WaveGPX::LoadCatalogRoute( FWaveGPXRoute& Route, const FWaveGPXCatalogEntry& Entry )
+{
+	return LoadRouteGPX( Route, Entry.SourceFile );
+}
+
+// Every .gpx file under Path, sorted.
+static std::vector< std::string > WaveGPX_ListRouteFiles( const std::string& Path )
+{
+	std::vector< std::string > FileNames;
+	std::error_code Error;
+	for ( auto Itr = std::filesystem::recursive_directory_iterator( Path, Error ); !Error && Itr != std::filesystem::recursive_directory_iterator(); Itr.increment( Error ) ) {
+		if ( !Itr->is_regular_file( Error ) )
+			continue;
+		auto Extension = Itr->path().extension().string();
+		std::transform( Extension.begin(), Extension.end(), Extension.begin(), []( char C ) { return ( char ) tolower( ( unsigned char ) C ); } );
+		if ( Extension == ".gpx" ) {
+			FileNames.push_back( Itr->path().string() );
+		}
 	}
-	
-	// Hilliness rating is a heuristic taken from Western Wheelers club system, which I believe
-	// is quite intuitive:
-	//     https://westernwheelersbicycleclub.wildapricot.org/page-1374754
-	//
-	float LengthMiles = Route.Stat_Length * 0.000621371f;
-	float ElevFeet = Route.Stat_Elev * 3.28084;
-	if ( LengthMiles > 0.000001f ) {
-		Route.Stat_HillinessRating = ( ElevFeet / LengthMiles ) / 25.0f;
+	if ( Error ) {
+		WAVECONTROL_LOG( "ERROR: Failed to list route directory %s: %s\n", Path.c_str(), Error.message().c_str() );
 	}
+	std::sort( FileNames.begin(), FileNames.end() );
+	return FileNames;
+}
+
+// Calls LoadFile( Index ) for every file on a pool of NumThreads workers, and sets Loaded[ Index ] to its result.
+static FWaveGPXLoadProgress WaveGPX_ProcessFiles( const std::vector< std::string >& FileNames, std::vector< char >& Loaded, std::function< bool( int FileIndex ) > LoadFile, WaveGPXLoadCallback Callback, const std::atomic< bool >* Cancel, int NumThreads )
+{
+	if ( NumThreads <= 0 ) {
+		NumThreads = ( int ) std::thread::hardware_concurrency();
+	}
+	NumThreads = std::max( 1, std::min( NumThreads, ( int ) FileNames.size() ) );
+
+	// Each worker takes the next file off the list, so a few huge routes don't leave the other threads idle.
+	Loaded.assign( FileNames.size(), 0 );
+	std::atomic< int > NextFile = 0;
+	std::mutex ProgressMutex;
+	FWaveGPXLoadProgress Progress;
+	Progress.NumFiles = ( int ) FileNames.size();
+
+	auto Worker = [&]()
+	{
+		while ( !Cancel || !Cancel->load() ) {
+			int FileIndex = NextFile.fetch_add( 1 );
+			if ( FileIndex >= ( int ) FileNames.size() )
+				break;
+
+			bool Success = LoadFile( FileIndex );
+			Loaded[ FileIndex ] = Success;
+
+			std::lock_guard< std::mutex > ProgressLock( ProgressMutex );
+			Progress.FileName = FileNames[ FileIndex ];
+			Progress.Success = Success;
+			( Success ? Progress.NumLoaded : Progress.NumFailed )++;
+			if ( Callback ) {
+				Callback( Progress );
+			}
+		}
+	};
+
+	std::vector< std::thread > Threads;
+	for ( int i = 1; i < NumThreads; i++ ) {
+		Threads.emplace_back( Worker );
+	}
+	Worker();
+	for ( auto& Thread : Threads ) {
+		Thread.join();
+	}
+	return Progress;
+}
+
+int WaveGPX::LoadRouteDirectory( const std::string& Path, WaveGPXLoadCallback Callback, const std::atomic< bool >* Cancel, int NumThreads )
+{
+	auto FileNames = WaveGPX_ListRouteFiles( Path );
+	std::vector< FWaveGPXRoute > Routes( FileNames.size() );
+	std::vector< char > Loaded;
+	auto Progress = WaveGPX_ProcessFiles( FileNames, Loaded, [&]( int FileIndex )
+	{
+		return LoadRouteGPX( Routes[ FileIndex ], FileNames[ FileIndex ] );
+	}, Callback, Cancel, NumThreads );
+
+	for ( int i = 0; i < ( int ) Routes.size(); i++ ) {
+		if ( Loaded[i] ) {
+			LoadedRoutes.push_back( std::move( Routes[i] ) );
+		}
+	}
+	WAVECONTROL_LOG( "Loaded %d of %d routes from %s.\n", Progress.NumLoaded, Progress.NumFiles, Path.c_str() );
+	return Progress.NumLoaded;
+}
 
+int WaveGPX::ScanRouteDirectory( const std::string& Path, WaveGPXLoadCallback Callback, const std::atomic< bool >* Cancel, int NumThreads )
+{
+	auto FileNames = WaveGPX_ListRouteFiles( Path );
+	std::vector< FWaveGPXCatalogEntry > Entries( FileNames.size() );
+	std::vector< char > Loaded;
+	auto Progress = WaveGPX_ProcessFiles( FileNames, Loaded, [&]( int FileIndex )
+	{
+		return ScanRouteGPX( Entries[ FileIndex ], FileNames[ FileIndex ] );
+	}, Callback, Cancel, NumThreads );
+
+	for ( int i = 0; i < ( int ) Entries.size(); i++ ) {
+		if ( Loaded[i] ) {
+			Catalog.push_back( std::move( Entries[i] ) );
+		}
+	}
+	WAVECONTROL_LOG( "Scanned %d of %d routes from %s.\n", Progress.NumLoaded, Progress.NumFiles, Path.c_str() );
+	return Progress.NumLoaded;
+}
+
+void WaveGPX::CalcRouteStats( FWaveGPXRoute& Route )
+{
+	WaveGPXStatAccumulator Stats;
+	for ( auto& Point : Route.Points ) {
+		Stats.AddPoint( Point );
+	}
+	Stats.Finish();
+	Stats.Store( Route );
+
+	float LengthMiles = Route.Stat_Length * 0.000621371f;
+	float ElevFeet = Route.Stat_Elev * 3.28084;
 	WAVECONTROL_LOG( "Length: %.1f KM ( %.1f Miles )\n" , Route.Stat_Length / 1000.0f, LengthMiles );
 	WAVECONTROL_LOG( "Elevation: %.1f M ( %.1f Feet )\n" , Route.Stat_Elev, ElevFeet );
 	WAVECONTROL_LOG( "Hilliness Rating: %.1f\n" , Route.Stat_HillinessRating );
@@ -308,6 +843,7 @@ bool WaveGPX::RecordFinish( FWaveGPXRecord& Record, const std::string FileName )
 	gpx::Writer GPXWriter;
 	GPXWriter.write( FileStream, GPXRoot.get(), true );
 	FileStream.close();
+	return true;
 }
 
 int WaveRouteUtil_FindPointAtDist( const FWaveGPXRoute& Route, float Dist )
@@ -330,20 +866,11 @@ int WaveRouteUtil_FindPointAtDist( const FWaveGPXRoute& Route, float Dist )
 	return ( Itr - Route.Points.begin() - 1 );
 }
 
-FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXRoute& Route, float Dist )
+// Point at Dist on the segment starting at Index, exactly as WaveRouteUtil_FindENUPosAtDist returns it.
+static FWaveGPXPoint WaveGPX_PointOnSegment( const FWaveGPXRoute& Route, int Index, float Dist, const FWaveGPXGeoFrame& Frame )
 {
 	FWaveGPXPoint Point;
-	
-	if ( Route.Points.size() <= 0 ) {
-		return Point;
-	}
 
-	auto Index = WaveRouteUtil_FindPointAtDist( Route, Dist );
-	if ( Index < 0 || Index >= Route.Points.size() ) {
-		Point.Dist = -1.0f;
-		return Point;
-	}
-	
 	if ( Index == Route.Points.size() - 1 || Dist < Route.Points[Index].Dist )
 	{
 		Point.East = Route.Points[Index].East;
@@ -366,43 +893,459 @@ FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXRoute& Route, float
 	Point.Lon = WaveLerp( Route.Points[Index].Lon, Route.Points[Index + 1].Lon, InterpX );
 	Point.Alt = WaveLerp( Route.Points[Index].Alt, Route.Points[Index + 1].Alt, InterpX );
 
-	// Convert ENU waypoint back to LLA.
-	geodetic_converter::GeodeticConverter GConverter;
-	GConverter.initialiseReference( Route.Points[0].Lat, Route.Points[0].Lon, Route.Points[0].Alt );
-	GConverter.geodetic2Enu( Point.Lat, Point.Lon, Point.Alt, &Point.East, &Point.North, &Point.Up );
+	WaveGPXGeo_LLAToENU( Frame, Point.Lat, Point.Lon, Point.Alt, Point.East, Point.North, Point.Up );
 
 	return Point;
 }
 
+float WaveRouteUtil_GradeBetween( const FWaveGPXPoint& PosA, const FWaveGPXPoint& PosB )
+{
+	auto HorizontalDist = sqrt( pow( PosA.East - PosB.East, 2.0 ) + pow( PosA.North - PosB.North, 2.0 ) );
+
+	double ElevationChange = PosB.Alt - PosA.Alt;
+	double HorizontalDistanceCovered = ( HorizontalDist <= 0.0001f ) ? 0.0001f : HorizontalDist;
+	double Grade = ElevationChange / HorizontalDistanceCovered;
+
+	return Grade * 100.0f;
+}
+
+FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXRoute& Route, float Dist )
+{
+	FWaveGPXPoint Point;
+	
+	if ( Route.Points.size() <= 0 ) {
+		return Point;
+	}
+
+	auto Index = WaveRouteUtil_FindPointAtDist( Route, Dist );
+	if ( Index < 0 || Index >= Route.Points.size() ) {
+		Point.Dist = -1.0f;
+		return Point;
+	}
+	FWaveGPXGeoFrame TempFrame;
+	return WaveGPX_PointOnSegment( Route, Index, Dist, WaveRouteUtil_GetGeoFrame( Route, TempFrame ) );
+}
+
 float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXRoute& Route, float Dist, float Smoothness )
 {
 	if ( Route.Points.size() <= 0 ) {
 		return 0.0f;
 	}
+	if ( Route.GradeProfile.Dist.size() == Route.Points.size() ) {
+		return WaveRouteUtil_FindGradePosAtDist( Route.GradeProfile, Dist, Smoothness );
+	}
 
 	auto PosA = WaveRouteUtil_FindENUPosAtDist( Route, Dist - Smoothness );
 	auto PosB = WaveRouteUtil_FindENUPosAtDist( Route, Dist + Smoothness );
-	auto HorizontalDist = sqrt( pow( PosA.East - PosB.East, 2.0 ) + pow( PosA.North - PosB.North, 2.0 ) );
+	return WaveRouteUtil_GradeBetween( PosA, PosB );
+}
 
-	double ElevationChange = PosB.Alt - PosA.Alt;
-	double HorizontalDistanceCovered = ( HorizontalDist <= 0.0001f ) ? 0.0001f : HorizontalDist;
-	double Grade = ElevationChange / HorizontalDistanceCovered;
+// Same index as WaveRouteUtil_FindPointAtDist, for queries that only ever move forward.
+static int WaveGPX_AdvancePointIndex( const FWaveGPXRoute& Route, int Index, float Dist )
+{
+	while ( Index + 1 < ( int ) Route.Points.size() && Route.Points[ Index + 1 ].Dist < Dist ) {
+		Index++;
+	}
+	return Index;
+}
 
-	return Grade * 100.0f;
+void WaveRouteUtil_BuildGradeProfile( const FWaveGPXRoute& Route, FWaveGPXGradeProfile& Profile )
+{
+	Profile = FWaveGPXGradeProfile();
+	if ( Route.Points.size() <= 0 ) {
+		return;
+	}
+
+	size_t NumPoints = Route.Points.size();
+	Profile.Dist.resize( NumPoints );
+	Profile.East.resize( NumPoints );
+	Profile.North.resize( NumPoints );
+	Profile.Alt.resize( NumPoints );
+	for ( size_t i = 0; i < NumPoints; i++ ) {
+		Profile.Dist[i] = Route.Points[i].Dist;
+		Profile.East[i] = Route.Points[i].East;
+		Profile.North[i] = Route.Points[i].North;
+		Profile.Alt[i] = Route.Points[i].Alt;
+	}
+
+	// One bucket per point on average, so finding a point from its bucket is usually a step or two.
+	double Length = Route.Points.back().Dist;
+	Profile.BucketSize = NumPoints > 1 && Length > 0.0 ? std::max( Length / ( NumPoints - 1 ), 0.01 ) : 1.0;
+	size_t NumBuckets = ( size_t ) ( Length / Profile.BucketSize ) + 1;
+	Profile.BucketPoint.resize( NumBuckets );
+	int Index = 0;
+	for ( size_t i = 0; i < NumBuckets; i++ ) {
+		Index = WaveGPX_AdvancePointIndex( Route, Index, ( float ) ( i * Profile.BucketSize ) );
+		Profile.BucketPoint[i] = Index;
+	}
+}
+
+// Same index as WaveRouteUtil_FindPointAtDist.
+static int WaveGPX_FindPointInProfile( const FWaveGPXGradeProfile& Profile, float Dist )
+{
+	double Bucket = std::clamp( Dist / Profile.BucketSize, 0.0, ( double ) ( Profile.BucketPoint.size() - 1 ) );
+	int Index = Profile.BucketPoint[ ( size_t ) Bucket ];
+	// Float rounding can put Dist just before its bucket's start.
+	while ( Index > 0 && Profile.Dist[ Index ] >= Dist ) {
+		Index--;
+	}
+	while ( Index + 1 < ( int ) Profile.Dist.size() && Profile.Dist[ Index + 1 ] < Dist ) {
+		Index++;
+	}
+	return Index;
 }
 
-void WaveRouteUtil_FillENUFromLLA( const FWaveGPXRoute& Route, FWaveGPXPoint& Point )
+// East, North and Alt as WaveGPX_PointOnSegment gives them, lerping ENU rather than converting from LLA.
+static FWaveGPXPoint WaveGPX_ProfilePointOnSegment( const FWaveGPXGradeProfile& Profile, int Index, float Dist )
 {
-	// Convert ENU waypoint back to LLA.
-	geodetic_converter::GeodeticConverter GConverter;
-	GConverter.initialiseReference( Route.Points[0].Lat, Route.Points[0].Lon, Route.Points[0].Alt );
-	GConverter.geodetic2Enu( Point.Lat, Point.Lon, Point.Alt, &Point.East, &Point.North, &Point.Up );
+	FWaveGPXPoint Point;
+	Point.Dist = Dist;
+	if ( Index == Profile.Dist.size() - 1 || Dist < Profile.Dist[ Index ] ) {
+		Point.East = Profile.East[ Index ];
+		Point.North = Profile.North[ Index ];
+		Point.Alt = Profile.Alt[ Index ];
+		return Point;
+	}
+
+	double InterpRun = Profile.Dist[ Index + 1 ] - Profile.Dist[ Index ];
+	double InterpX = ( Dist - Profile.Dist[ Index ] ) / ( InterpRun > 0.01f ? InterpRun : 0.01f );
+	Point.East = Profile.East[ Index ] + ( Profile.East[ Index + 1 ] - Profile.East[ Index ] ) * InterpX;
+	Point.North = Profile.North[ Index ] + ( Profile.North[ Index + 1 ] - Profile.North[ Index ] ) * InterpX;
+	Point.Alt = WaveLerp( Profile.Alt[ Index ], Profile.Alt[ Index + 1 ], InterpX );
+	return Point;
 }
 
-void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint& Point )
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXGradeProfile& Profile, float Dist, float Smoothness )
 {
-	// Convert ENU waypoint back to LLA.
-	geodetic_converter::GeodeticConverter GConverter;
-	GConverter.initialiseReference( Route.Points[0].Lat, Route.Points[0].Lon, Route.Points[0].Alt );
-	GConverter.enu2Geodetic( Point.East, Point.North, Point.Up, &Point.Lat, &Point.Lon, &Point.Alt );
-}
\ No newline at end of file
+	if ( Profile.Dist.size() <= 0 ) {
+		return 0.0f;
+	}
+
+	float DistA = Dist - Smoothness;
+	float DistB = Dist + Smoothness;
+	auto PosA = WaveGPX_ProfilePointOnSegment( Profile, WaveGPX_FindPointInProfile( Profile, DistA ), DistA );
+	auto PosB = WaveGPX_ProfilePointOnSegment( Profile, WaveGPX_FindPointInProfile( Profile, DistB ), DistB );
+	return WaveRouteUtil_GradeBetween( PosA, PosB );
+}
+
+void WaveRouteUtil_ResampleRoute( const FWaveGPXRoute& Route, FWaveGPXResampledRoute& Resampled, float Spacing, float GradeSmoothness )
+{
+	Resampled = FWaveGPXResampledRoute();
+	Resampled.Spacing = Spacing;
+	Resampled.GradeSmoothness = GradeSmoothness;
+	if ( Route.Points.size() <= 0 || Spacing <= 0.0f ) {
+		return;
+	}
+
+	// One past the end, so lookups right at the end of the route still have a sample either side.
+	size_t NumSamples = ( size_t ) ( Route.Points.back().Dist / Spacing ) + 2;
+	Resampled.Points.resize( NumSamples );
+	Resampled.Grade.resize( NumSamples );
+	Resampled.PointIndex.resize( NumSamples );
+
+	FWaveGPXGeoFrame TempFrame;
+	auto& Frame = WaveRouteUtil_GetGeoFrame( Route, TempFrame );
+
+	// Match whichever way WaveRouteUtil_FindGradePosAtDist( Route ) works out grade.
+	bool HasGradeProfile = Route.GradeProfile.Dist.size() == Route.Points.size();
+
+	// Sample, grade behind and grade ahead positions all only move forward, so one pass over the route does it.
+	int Index = 0, IndexBehind = 0, IndexAhead = 0;
+	for ( size_t i = 0; i < NumSamples; i++ ) {
+		float Dist = ( float ) ( i * ( double ) Spacing );
+		float DistBehind = Dist - GradeSmoothness;
+		float DistAhead = Dist + GradeSmoothness;
+		Index = WaveGPX_AdvancePointIndex( Route, Index, Dist );
+		IndexBehind = WaveGPX_AdvancePointIndex( Route, IndexBehind, DistBehind );
+		IndexAhead = WaveGPX_AdvancePointIndex( Route, IndexAhead, DistAhead );
+
+		Resampled.Points[i] = WaveGPX_PointOnSegment( Route, Index, Dist, Frame );
+		Resampled.PointIndex[i] = Index;
+		if ( HasGradeProfile ) {
+			Resampled.Grade[i] = WaveRouteUtil_FindGradePosAtDist( Route.GradeProfile, Dist, GradeSmoothness );
+		} else {
+			Resampled.Grade[i] = WaveRouteUtil_GradeBetween(
+				WaveGPX_PointOnSegment( Route, IndexBehind, DistBehind, Frame ),
+				WaveGPX_PointOnSegment( Route, IndexAhead, DistAhead, Frame )
+			);
+		}
+	}
+}
+
+// Sample at or before Dist, and how far Dist is towards the next one.
+static size_t WaveGPX_FindSample( const FWaveGPXResampledRoute& Resampled, float Dist, double& InterpX )
+{
+	double Sample = std::clamp( Dist / ( double ) Resampled.Spacing, 0.0, ( double ) ( Resampled.Points.size() - 1 ) );
+	size_t Index = std::min( ( size_t ) Sample, Resampled.Points.size() - 2 );
+	InterpX = Sample - Index;
+	return Index;
+}
+
+int WaveRouteUtil_FindPointAtDist( const FWaveGPXRoute& Route, const FWaveGPXResampledRoute& Resampled, float Dist )
+{
+	if ( Resampled.Points.size() < 2 ) {
+		return WaveRouteUtil_FindPointAtDist( Route, Dist );
+	}
+
+	// Start from the last sample before Dist, then it's usually no more than a step or two forward.
+	double InterpX;
+	size_t Sample = WaveGPX_FindSample( Resampled, Dist, InterpX );
+	while ( Sample > 0 && ( float ) ( Sample * ( double ) Resampled.Spacing ) > Dist ) {
+		Sample--;
+	}
+	return WaveGPX_AdvancePointIndex( Route, Resampled.PointIndex[ Sample ], Dist );
+}
+
+FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXResampledRoute& Resampled, float Dist )
+{
+	if ( Resampled.Points.size() < 2 ) {
+		return FWaveGPXPoint();
+	}
+
+	double InterpX;
+	size_t Index = WaveGPX_FindSample( Resampled, Dist, InterpX );
+	auto& A = Resampled.Points[ Index ];
+	auto& B = Resampled.Points[ Index + 1 ];
+
+	FWaveGPXPoint Point;
+	Point.Lat = A.Lat + ( B.Lat - A.Lat ) * InterpX;
+	Point.Lon = A.Lon + ( B.Lon - A.Lon ) * InterpX;
+	Point.Alt = A.Alt + ( B.Alt - A.Alt ) * InterpX;
+	Point.East = A.East + ( B.East - A.East ) * InterpX;
+	Point.North = A.North + ( B.North - A.North ) * InterpX;
+	Point.Up = A.Up + ( B.Up - A.Up ) * InterpX;
+	Point.Dist = Dist;
+	return Point;
+}
+
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXResampledRoute& Resampled, float Dist )
+{
+	if ( Resampled.Grade.size() < 2 ) {
+		return 0.0f;
+	}
+
+	double InterpX;
+	size_t Index = WaveGPX_FindSample( Resampled, Dist, InterpX );
+	return ( float ) ( Resampled.Grade[ Index ] + ( Resampled.Grade[ Index + 1 ] - Resampled.Grade[ Index ] ) * InterpX );
+}
+
+// Dist / East / North / Alt of each route point as separate arrays, either the grade profile's or strided through
+// Route.Points.
+struct WaveGPXPointArrays
+{
+	const double* Dist = nullptr;
+	const double* East = nullptr;
+	const double* North = nullptr;
+	const double* Alt = nullptr;
+	size_t Stride = 1;
+	int NumPoints = 0;
+};
+
+static WaveGPXPointArrays WaveGPX_GetPointArrays( const FWaveGPXRoute& Route )
+{
+	static_assert( sizeof( FWaveGPXPoint ) % sizeof( double ) == 0, "FWaveGPXPoint must be all doubles" );
+
+	WaveGPXPointArrays Arrays;
+	Arrays.NumPoints = ( int ) Route.Points.size();
+	if ( Route.GradeProfile.Dist.size() == Route.Points.size() ) {
+		Arrays.Dist = Route.GradeProfile.Dist.data();
+		Arrays.East = Route.GradeProfile.East.data();
+		Arrays.North = Route.GradeProfile.North.data();
+		Arrays.Alt = Route.GradeProfile.Alt.data();
+	} else {
+		Arrays.Dist = &Route.Points[0].Dist;
+		Arrays.East = &Route.Points[0].East;
+		Arrays.North = &Route.Points[0].North;
+		Arrays.Alt = &Route.Points[0].Alt;
+		Arrays.Stride = sizeof( FWaveGPXPoint ) / sizeof( double );
+	}
+	return Arrays;
+}
+
+// Last point in [ Low, High ] before Dist, or Low if there isn't one.
+static int WaveGPX_SearchPointArrays( const WaveGPXPointArrays& Points, int Low, int High, float Dist )
+{
+	while ( Low < High ) {
+		int Mid = ( Low + High + 1 ) / 2;
+		if ( Points.Dist[ Mid * Points.Stride ] < Dist ) {
+			Low = Mid;
+		} else {
+			High = Mid - 1;
+		}
+	}
+	return Low;
+}
+
+// Where each of Dists + Offset falls, as WaveGPX_ProfilePointOnSegment works it out: the points either side and how
+// far along between them. Both points are the same one when it's clamped. Returns the last index, to carry on from.
+static int WaveGPX_LocateDists( const WaveGPXPointArrays& Points, int Index, const float* Dists, size_t NumDists, float Offset, int* IndexA, int* IndexB, double* InterpX )
+{
+	auto PointDist = [ & ]( int i ) { return Points.Dist[ i * Points.Stride ]; };
+	for ( size_t n = 0; n < NumDists; n++ ) {
+		float Dist = Dists[ n ] + Offset;
+		if ( Index > 0 && PointDist( Index ) >= Dist ) {
+			// Out of order, so search back rather than walk.
+			Index = WaveGPX_SearchPointArrays( Points, 0, Index, Dist );
+		} else if ( Index + 1 < Points.NumPoints && PointDist( Index + 1 ) < Dist ) {
+			// Gallop forward, so samples far apart on a dense route don't walk every point between them.
+			int Step = 1;
+			Index++;
+			while ( Index + Step < Points.NumPoints && PointDist( Index + Step ) < Dist ) {
+				Index += Step;
+				Step *= 2;
+			}
+			Index = WaveGPX_SearchPointArrays( Points, Index, std::min( Index + Step, Points.NumPoints ) - 1, Dist );
+		}
+
+		IndexA[ n ] = Index;
+		if ( Index == Points.NumPoints - 1 || Dist < PointDist( Index ) ) {
+			IndexB[ n ] = Index;
+			InterpX[ n ] = 0.0;
+		} else {
+			double InterpRun = PointDist( Index + 1 ) - PointDist( Index );
+			IndexB[ n ] = Index + 1;
+			InterpX[ n ] = ( Dist - PointDist( Index ) ) / ( InterpRun > 0.01f ? InterpRun : 0.01f );
+		}
+	}
+	return Index;
+}
+
+// Lerps Values at each located distance. No branches, so the compiler can vectorise it.
+static void WaveGPX_LerpValues( const double* Values, size_t Stride, const int* IndexA, const int* IndexB, const double* InterpX, size_t NumDists, double* Out )
+{
+	for ( size_t n = 0; n < NumDists; n++ ) {
+		double A = Values[ IndexA[ n ] * Stride ];
+		double B = Values[ IndexB[ n ] * Stride ];
+		Out[ n ] = A + ( B - A ) * InterpX[ n ];
+	}
+}
+
+// As WaveGPX_LerpValues, but through WaveLerp so Alt comes out bit for bit as WaveGPX_PointOnSegment has it.
+static void WaveGPX_LerpAlts( const double* Values, size_t Stride, const int* IndexA, const int* IndexB, const double* InterpX, size_t NumDists, double* Out )
+{
+	for ( size_t n = 0; n < NumDists; n++ ) {
+		Out[ n ] = WaveLerp( Values[ IndexA[ n ] * Stride ], Values[ IndexB[ n ] * Stride ], InterpX[ n ] );
+	}
+}
+
+void WaveRouteUtil_SampleRoute( const FWaveGPXRoute& Route, const float* Dists, size_t NumDists, double* Alt, float* Grade, double* East, double* North, float GradeSmoothness )
+{
+	if ( Route.Points.size() <= 0 ) {
+		for ( size_t n = 0; n < NumDists; n++ ) {
+			if ( Alt ) Alt[ n ] = 0.0;
+			if ( Grade ) Grade[ n ] = 0.0f;
+			if ( East ) East[ n ] = 0.0;
+			if ( North ) North[ n ] = 0.0;
+		}
+		return;
+	}
+
+	auto Points = WaveGPX_GetPointArrays( Route );
+
+	int IndexA[ WAVEGPX_SAMPLE_BLOCK ], IndexB[ WAVEGPX_SAMPLE_BLOCK ];
+	double InterpX[ WAVEGPX_SAMPLE_BLOCK ];
+	double BehindEast[ WAVEGPX_SAMPLE_BLOCK ], BehindNorth[ WAVEGPX_SAMPLE_BLOCK ], BehindAlt[ WAVEGPX_SAMPLE_BLOCK ];
+	double AheadEast[ WAVEGPX_SAMPLE_BLOCK ], AheadNorth[ WAVEGPX_SAMPLE_BLOCK ], AheadAlt[ WAVEGPX_SAMPLE_BLOCK ];
+
+	// Sample, grade behind and grade ahead positions each keep their own place on the route between blocks.
+	int Index = 0, IndexBehind = 0, IndexAhead = 0;
+	for ( size_t Start = 0; Start < NumDists; Start += WAVEGPX_SAMPLE_BLOCK ) {
+		size_t Count = std::min( NumDists - Start, ( size_t ) WAVEGPX_SAMPLE_BLOCK );
+		const float* BlockDists = Dists + Start;
+
+		if ( Alt || East || North ) {
+			Index = WaveGPX_LocateDists( Points, Index, BlockDists, Count, 0.0f, IndexA, IndexB, InterpX );
+			if ( Alt ) WaveGPX_LerpAlts( Points.Alt, Points.Stride, IndexA, IndexB, InterpX, Count, Alt + Start );
+			if ( East ) WaveGPX_LerpValues( Points.East, Points.Stride, IndexA, IndexB, InterpX, Count, East + Start );
+			if ( North ) WaveGPX_LerpValues( Points.North, Points.Stride, IndexA, IndexB, InterpX, Count, North + Start );
+		}
+
+		if ( Grade ) {
+			IndexBehind = WaveGPX_LocateDists( Points, IndexBehind, BlockDists, Count, -GradeSmoothness, IndexA, IndexB, InterpX );
+			WaveGPX_LerpAlts( Points.Alt, Points.Stride, IndexA, IndexB, InterpX, Count, BehindAlt );
+			WaveGPX_LerpValues( Points.East, Points.Stride, IndexA, IndexB, InterpX, Count, BehindEast );
+			WaveGPX_LerpValues( Points.North, Points.Stride, IndexA, IndexB, InterpX, Count, BehindNorth );
+
+			IndexAhead = WaveGPX_LocateDists( Points, IndexAhead, BlockDists, Count, GradeSmoothness, IndexA, IndexB, InterpX );
+			WaveGPX_LerpAlts( Points.Alt, Points.Stride, IndexA, IndexB, InterpX, Count, AheadAlt );
+			WaveGPX_LerpValues( Points.East, Points.Stride, IndexA, IndexB, InterpX, Count, AheadEast );
+			WaveGPX_LerpValues( Points.North, Points.Stride, IndexA, IndexB, InterpX, Count, AheadNorth );
+
+			FWaveGPXPoint PosBehind, PosAhead;
+			for ( size_t n = 0; n < Count; n++ ) {
+				PosBehind.East = BehindEast[ n ];
+				PosBehind.North = BehindNorth[ n ];
+				PosBehind.Alt = BehindAlt[ n ];
+				PosAhead.East = AheadEast[ n ];
+				PosAhead.North = AheadNorth[ n ];
+				PosAhead.Alt = AheadAlt[ n ];
+				Grade[ Start + n ] = WaveRouteUtil_GradeBetween( PosBehind, PosAhead );
+			}
+		}
+	}
+}
+
+// Same index as WaveRouteUtil_FindPointAtDist, walking from Index. Big jumps fall back to a search.
+static int WaveGPX_MovePointIndex( const FWaveGPXRoute& Route, int Index, float Dist )
+{
+	auto& Points = Route.Points;
+	Index = std::clamp( Index, 0, ( int ) Points.size() - 1 );
+	for ( int Step = 0; Step < WAVEGPX_CURSOR_MAX_WALK; Step++ ) {
+		if ( Index > 0 && Points[ Index ].Dist >= Dist ) {
+			Index--;
+		} else if ( Index + 1 < ( int ) Points.size() && Points[ Index + 1 ].Dist < Dist ) {
+			Index++;
+		} else {
+			return Index;
+		}
+	}
+	return WaveRouteUtil_FindPointAtDist( Route, Dist );
+}
+
+WaveRouteCursor::WaveRouteCursor( const FWaveGPXRoute& InRoute, float InGradeSmoothness )
+	: Route( &InRoute )
+	, GradeSmoothness( InGradeSmoothness )
+{
+	FWaveGPXGeoFrame TempFrame;
+	Frame = WaveRouteUtil_GetGeoFrame( InRoute, TempFrame );
+	SetDist( 0.0f );
+}
+
+void WaveRouteCursor::SetDist( float InDist )
+{
+	Dist = InDist;
+	if ( Route->Points.size() <= 0 ) {
+		return;
+	}
+
+	float DistBehind = Dist - GradeSmoothness;
+	float DistAhead = Dist + GradeSmoothness;
+	PointIndex = WaveGPX_MovePointIndex( *Route, PointIndex, Dist );
+	IndexBehind = WaveGPX_MovePointIndex( *Route, IndexBehind, DistBehind );
+	IndexAhead = WaveGPX_MovePointIndex( *Route, IndexAhead, DistAhead );
+
+	Position = WaveGPX_PointOnSegment( *Route, PointIndex, Dist, Frame );
+
+	// Grade the same way WaveRouteUtil_FindGradePosAtDist would.
+	FWaveGPXPoint PosBehind, PosAhead;
+	if ( Route->GradeProfile.Dist.size() == Route->Points.size() ) {
+		PosBehind = WaveGPX_ProfilePointOnSegment( Route->GradeProfile, IndexBehind, DistBehind );
+		PosAhead = WaveGPX_ProfilePointOnSegment( Route->GradeProfile, IndexAhead, DistAhead );
+	} else {
+		PosBehind = WaveGPX_PointOnSegment( *Route, IndexBehind, DistBehind, Frame );
+		PosAhead = WaveGPX_PointOnSegment( *Route, IndexAhead, DistAhead, Frame );
+	}
+	Grade = WaveRouteUtil_GradeBetween( PosBehind, PosAhead );
+
+	// Over the grade window too, so stops where the GPS left a pile of points in one spot don't spin it round.
+	double HeadingEast = PosAhead.East - PosBehind.East;
+	double HeadingNorth = PosAhead.North - PosBehind.North;
+	if ( HeadingEast != 0.0 || HeadingNorth != 0.0 ) {
+		Heading = ( float ) ( atan2( HeadingEast, HeadingNorth ) * 180.0 / 3.14159265358979323846 );
+		if ( Heading < 0.0f ) {
+			Heading += 360.0f;
+		}
+	}
+
+	SplineSample = WaveRouteUtil_EvalSpline( *Route, PointIndex, Dist );
+}
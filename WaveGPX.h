@@ -22,9 +22,21 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <atomic>
+#include <functional>
 
 #define WaveGPX_MAGIC_ID 0xf20ae21
 
+// Default grid cell size for FWaveGPXSpatialIndex, in metres.
+#define WAVEGPX_SPATIAL_CELL_SIZE 50.0f
+
+// Default size of the finest FWaveGPXLODPyramid buckets, in metres. With the default grade smoothness, a bucket's
+// grade is then what WaveRouteUtil_FindGradePosAtDist gives at its middle, to within the rounding of a float Dist.
+#define WAVEGPX_LOD_MIN_BUCKET_SIZE 5.0f
+
+// Starting value for WaveGPXCache_HashBytes.
+#define WAVEGPX_CACHE_HASH_SEED 0xcbf29ce484222325ull
+
 struct FWaveGPXPoint
 {
 	double Lat = 0.0f;
@@ -38,6 +50,135 @@ struct FWaveGPXPoint
 	double Dist = 0.0f;
 };
 
+// Local ENU frame at a reference point, with the ECEF origin and rotations geodetic_converter::GeodeticConverter
+// works out when it is given a reference. Plain doubles, so this header doesn't need Eigen.
+struct FWaveGPXGeoFrame
+{
+	bool Valid = false;
+
+	double OriginLat = 0.0;
+	double OriginLon = 0.0;
+	double OriginAlt = 0.0;
+	double OriginECEF[3] = {};
+
+	// Row major.
+	double ECEFToNED[9] = {};
+	double NEDToECEF[9] = {};
+};
+
+// A route segment ( point Segment to Segment + 1 ) as seen from one grid cell, relative to the cell's corner.
+struct FWaveGPXSpatialSegment
+{
+	float StartEast = 0.0f;
+	float StartNorth = 0.0f;
+	float EndEast = 0.0f;
+	float EndNorth = 0.0f;
+	uint32_t Segment = 0;
+};
+
+// Uniform grid over a route's segments, for finding the nearest point on the route to a position. Only cells the
+// route passes through are stored, sorted by key, so the grid can cover any area. Each cell keeps its own copy of
+// the segment ends so a search doesn't have to hop around Points.
+struct FWaveGPXSpatialIndex
+{
+	float CellSize = 0.0f;
+	size_t NumPoints = 0;
+
+	// Segments crossing cell CellKeys[i] are Segments[ CellStart[i] ] to Segments[ CellStart[i + 1] - 1 ].
+	std::vector< uint64_t > CellKeys;
+	std::vector< uint32_t > CellStart;
+	std::vector< FWaveGPXSpatialSegment > Segments;
+
+	int MinCellX = 0, MinCellY = 0;
+	int MaxCellX = -1, MaxCellY = -1;
+};
+
+// Per point Dist, East, North and Alt of a route in flat arrays, plus a table from distance to point so the
+// segment at any distance is found without a search. Built by WaveRouteUtil_BuildGradeProfile.
+struct FWaveGPXGradeProfile
+{
+	// Bucket b covers distances from b * BucketSize, and BucketPoint[b] is
+	// WaveRouteUtil_FindPointAtDist( Route, b * BucketSize ).
+	double BucketSize = 1.0;
+	std::vector< int > BucketPoint;
+
+	std::vector< double > Dist;
+	std::vector< double > East;
+	std::vector< double > North;
+	std::vector< double > Alt;
+};
+
+// Lowest, highest and distance weighted average altitude and grade over a stretch of route.
+struct FWaveGPXLODBucket
+{
+	float MinAlt = 0.0f;
+	float MaxAlt = 0.0f;
+	float AvgAlt = 0.0f;
+	float MinGrade = 0.0f;
+	float MaxGrade = 0.0f;
+	float AvgGrade = 0.0f;
+};
+
+// Altitude and grade of a route summarised over distance buckets at every power of two size, for elevation profiles
+// and zoomable previews. Levels[0] has buckets of BucketSize metres, and each level after it half as many buckets of
+// twice the size, down to one covering the whole route. Built by WaveRouteUtil_BuildLODPyramid.
+struct FWaveGPXLODPyramid
+{
+	double BucketSize = 1.0;
+	double Length = 0.0;
+	size_t NumPoints = 0;
+	std::vector< std::vector< FWaveGPXLODBucket > > Levels;
+};
+
+// Cubics for East, North, Up and Alt from one route point to the next, in metres along the route from Dist. Each
+// axis is Value + C[0] t + C[1] t^2 + C[2] t^3.
+struct FWaveGPXSplineSegment
+{
+	double Dist = 0.0;
+	double East = 0.0;
+	double North = 0.0;
+	double Up = 0.0;
+	double Alt = 0.0;
+
+	float EastCoeffs[3] = {};
+	float NorthCoeffs[3] = {};
+	float UpCoeffs[3] = {};
+	float AltCoeffs[3] = {};
+	float Length = 0.0f;
+};
+
+// Smooth curve through a route's points, parameterised by distance along the route. East, North and Up use
+// Catmull-Rom tangents ( weighted for uneven point spacing ), and Alt monotone ( Fritsch-Butland ) tangents so it
+// never overshoots the points either side. Position, direction and grade are continuous through the points, while
+// curvature can step at them. Built by WaveRouteUtil_BuildSpline.
+struct FWaveGPXSpline
+{
+	size_t NumPoints = 0;
+
+	// Segments[i] runs from Points[i] to Points[i + 1].
+	std::vector< FWaveGPXSplineSegment > Segments;
+};
+
+// The route's spline at a distance. Position has Dist, East, North, Up and Alt, but not Lat / Lon.
+struct FWaveGPXSplineSample
+{
+	FWaveGPXPoint Position;
+
+	// Unit vector along the route, in ENU. Zero, as are Curvature and Heading, where the route stops in one spot.
+	double TangentEast = 0.0;
+	double TangentNorth = 0.0;
+	double TangentUp = 0.0;
+
+	// 1 / turning radius in metres, positive turning left, ignoring altitude.
+	float Curvature = 0.0f;
+
+	// Rise over horizontal run as a percentage, the way WaveRouteUtil_FindGradePosAtDist measures it.
+	float Grade = 0.0f;
+
+	// Degrees clockwise from north.
+	float Heading = 0.0f;
+};
+
 struct FWaveGPXRoute
 {
 	std::string Name;
@@ -53,8 +194,167 @@ struct FWaveGPXRoute
 	float Stat_DifficultyScore = 0.0f;
 	float Stat_HighestAlt = 0.0f;
 	float Stat_LowestAlt = 0.0f;
+
+	// ENU frame at Points[0], set up on load. See WaveRouteUtil_GetGeoFrame.
+	FWaveGPXGeoFrame GeoFrame;
+
+	// Built on load if LoadOptions.BuildSpatialIndex is set, see WaveRouteUtil_BuildSpatialIndex.
+	FWaveGPXSpatialIndex SpatialIndex;
+
+	// Built on load if LoadOptions.BuildGradeProfile is set. WaveRouteUtil_FindGradePosAtDist uses it when it
+	// matches Points.
+	FWaveGPXGradeProfile GradeProfile;
+
+	// Built on load if LoadOptions.BuildLODPyramid is set. WaveRouteUtil_GetLODView uses it when it matches Points.
+	FWaveGPXLODPyramid LODPyramid;
+
+	// Built on load if LoadOptions.BuildSpline is set. WaveRouteUtil_EvalSpline uses it when it matches Points.
+	FWaveGPXSpline Spline;
 };
 
+// Points per ENU origin in FWaveGPXCompactRoute. Small enough that float ENU offsets stay sub-millimetre.
+#define WAVEGPX_COMPACT_CHUNK_SIZE 256
+
+// Lat / Lon are stored as int32 in units of 1e-7 degrees, about a centimetre.
+#define WAVEGPX_COMPACT_DEGREE_SCALE 1e7
+
+// Structure of arrays version of FWaveGPXRoute, 28 bytes per point instead of 56. East / North / Up / Dist are
+// stored as floats relative to the first point of their WAVEGPX_COMPACT_CHUNK_SIZE chunk. Use GetPoint to read
+// a point back as FWaveGPXPoint.
+struct FWaveGPXCompactRoute
+{
+	std::string Name;
+	std::string Description;
+	std::string Author;
+	std::string SourceFile;
+
+	// One per point.
+	std::vector< int32_t > Lat;
+	std::vector< int32_t > Lon;
+	std::vector< float > Alt;
+	std::vector< float > East;
+	std::vector< float > North;
+	std::vector< float > Up;
+	std::vector< float > Dist;
+
+	// One per chunk.
+	std::vector< double > ChunkEast;
+	std::vector< double > ChunkNorth;
+	std::vector< double > ChunkUp;
+	std::vector< double > ChunkDist;
+
+	float Stat_Elev = 0.0f;
+	float Stat_Length = 1.0f;
+	float Stat_HillinessRating = 0.0f;
+	float Stat_DifficultyScore = 0.0f;
+	float Stat_HighestAlt = 0.0f;
+	float Stat_LowestAlt = 0.0f;
+
+	inline int GetNumPoints() const
+	{
+		return ( int ) Dist.size();
+	}
+
+	inline double GetDist( int Index ) const
+	{
+		return ChunkDist[ Index / WAVEGPX_COMPACT_CHUNK_SIZE ] + Dist[ Index ];
+	}
+
+	FWaveGPXPoint GetPoint( int Index ) const;
+
+	// Appends Point, which must already have its ENU and Dist filled in.
+	void AddPoint( const FWaveGPXPoint& Point );
+};
+
+// A route resampled every Spacing metres along Dist, so lookups by distance are an index calculation and a lerp
+// instead of a binary search. Built by WaveRouteUtil_ResampleRoute.
+struct FWaveGPXResampledRoute
+{
+	float Spacing = 1.0f;
+	float GradeSmoothness = 2.5f;
+
+	// What WaveRouteUtil_FindENUPosAtDist / WaveRouteUtil_FindGradePosAtDist give at i * Spacing.
+	std::vector< FWaveGPXPoint > Points;
+	std::vector< float > Grade;
+
+	// What WaveRouteUtil_FindPointAtDist gives at i * Spacing, to map back to the original route's points.
+	std::vector< int > PointIndex;
+};
+
+// Just enough of a route to list it in a route browser, without any of its points. Use
+// WaveGPX::LoadCatalogRoute to load the full route once it's picked.
+struct FWaveGPXCatalogEntry
+{
+	std::string Name;
+	std::string Description;
+	std::string Author;
+	std::string SourceFile;
+	int NumPoints = 0;
+
+	float Stat_Elev = 0.0f;
+	float Stat_Length = 1.0f;
+	float Stat_HillinessRating = 0.0f;
+	float Stat_DifficultyScore = 0.0f;
+	float Stat_HighestAlt = 0.0f;
+	float Stat_LowestAlt = 0.0f;
+};
+
+struct FWaveGPXLoadOptions
+{
+	// Keep a binary copy of each loaded route next to its GPX file ( see WaveGPXCache.cpp ), and load from that
+	// instead of parsing XML while it is still valid. Off by default, since it writes into the route's directory.
+	bool UseRouteCache = false;
+
+	// The lookup structures below are off by default, since together they take several times the memory of Points
+	// and a route library rarely needs them for more than the route being ridden. Without them the lookups fall back
+	// to slower paths with the same answers, except grades, which move by a few parts in a million since the grade
+	// profile lerps ENU where the route lerps LLA ( see WaveRouteUtil_BuildGradeProfile ).
+
+	// Build FWaveGPXRoute::SpatialIndex, for WaveRouteUtil_FindNearestDistOnRoute.
+	bool BuildSpatialIndex = false;
+
+	// Build FWaveGPXRoute::GradeProfile, for WaveRouteUtil_FindGradePosAtDist.
+	bool BuildGradeProfile = false;
+
+	// Build FWaveGPXRoute::LODPyramid, for WaveRouteUtil_GetLODView.
+	bool BuildLODPyramid = false;
+
+	// Build FWaveGPXRoute::Spline, for WaveRouteUtil_EvalSpline and WaveRouteCursor::GetSplineSample.
+	bool BuildSpline = false;
+
+	// Drop points that lie within SimplifyHorizontalTolerance metres ( across the route ) and
+	// SimplifyVerticalTolerance metres ( in altitude ) of the simplified route, after ENU conversion and before
+	// stats are calculated. If that changes Stat_Length or Stat_Elev by more than SimplifyMaxStatError ( as a
+	// fraction ), the tolerances are halved and it tries again.
+	bool Simplify = false;
+	float SimplifyHorizontalTolerance = 1.0f;
+	float SimplifyVerticalTolerance = 0.5f;
+	float SimplifyMaxStatError = 0.02f;
+};
+
+struct FWaveGPXSimplifyReport
+{
+	int NumPointsBefore = 0;
+	int NumPointsRemoved = 0;
+
+	// Furthest any removed point is from the simplified route.
+	float MaxHorizontalDeviation = 0.0f;
+	float MaxVerticalDeviation = 0.0f;
+};
+
+// Reported by LoadRouteDirectory once per file, whether it loaded or not.
+struct FWaveGPXLoadProgress
+{
+	std::string FileName;
+	bool Success = false;
+
+	int NumFiles = 0;
+	int NumLoaded = 0;
+	int NumFailed = 0;
+};
+
+typedef std::function< void( const FWaveGPXLoadProgress& Progress ) > WaveGPXLoadCallback;
+
 struct FWaveGPXRecord
 {
 	FWaveGPXRoute Route;
@@ -69,6 +369,7 @@ struct FWaveGPXRecord
 class WaveGPX
 {
 	std::vector< FWaveGPXRoute > LoadedRoutes;
+	std::vector< FWaveGPXCatalogEntry > Catalog;
 	FWaveGPXRoute RideRoute;
 
 protected:
@@ -78,9 +379,38 @@ public:
 	WaveGPX();
 	virtual ~WaveGPX();
 	uint32_t MagicID = WaveGPX_MAGIC_ID;
+	FWaveGPXLoadOptions LoadOptions;
 
 	bool LoadRouteGPX( FWaveGPXRoute& Route, const std::string FileName );
 
+	// Streams the GPX file straight into compact form, so the full size route is never held in memory ( unless
+	// it comes from the route cache ).
+	bool LoadRouteGPX( FWaveGPXCompactRoute& Route, const std::string FileName );
+
+	// Loads every .gpx file under Path on a pool of NumThreads workers ( 0 for one per core ), and appends the ones
+	// that loaded to LoadedRoutes, sorted by file name. Callback is called as each file finishes, from the worker
+	// threads but never concurrently. Setting Cancel stops workers picking up new files. Returns number loaded.
+	int LoadRouteDirectory( const std::string& Path, WaveGPXLoadCallback Callback = nullptr, const std::atomic< bool >* Cancel = nullptr, int NumThreads = 0 );
+
+	// Reads a route's name and stats in a single streaming pass, without keeping its points. Points aren't
+	// simplified, so with LoadOptions.Simplify the stats can differ from a full load by SimplifyMaxStatError.
+	bool ScanRouteGPX( FWaveGPXCatalogEntry& Entry, const std::string FileName );
+
+	// Same as LoadRouteDirectory, but scans each file with ScanRouteGPX and appends to Catalog.
+	int ScanRouteDirectory( const std::string& Path, WaveGPXLoadCallback Callback = nullptr, const std::atomic< bool >* Cancel = nullptr, int NumThreads = 0 );
+
+	bool LoadCatalogRoute( FWaveGPXRoute& Route, const FWaveGPXCatalogEntry& Entry );
+
+	inline const std::vector< FWaveGPXCatalogEntry >& GetCatalog()
+	{
+		return Catalog;
+	}
+
+	inline void ClearCatalog()
+	{
+		Catalog.clear();
+	}
+
 	inline const std::vector< FWaveGPXRoute >& GetLoadedRoutes()
 	{
 		return LoadedRoutes;
@@ -110,15 +440,179 @@ public:
 
 };
 
+// Binary route cache. Load fails if there is no cache for FileName or it no longer matches the GPX file.
+std::string WaveGPXCache_GetFileName( const std::string& FileName );
+// Options is part of the key, since simplification changes the points stored.
+bool WaveGPXCache_Load( FWaveGPXRoute& Route, const std::string& FileName, const FWaveGPXLoadOptions& Options = FWaveGPXLoadOptions() );
+bool WaveGPXCache_LoadCatalogEntry( FWaveGPXCatalogEntry& Entry, const std::string& FileName, const FWaveGPXLoadOptions& Options = FWaveGPXLoadOptions() );
+bool WaveGPXCache_Save( const FWaveGPXRoute& Route, const std::string& FileName, uint64_t SourceHash, const FWaveGPXLoadOptions& Options = FWaveGPXLoadOptions() );
+uint64_t WaveGPXCache_HashBytes( uint64_t Hash, const void* Data, size_t Size );
+
+// Douglas-Peucker over ENU, keeping any point further than HorizontalTolerance from the simplified line in the
+// East / North plane, or further than VerticalTolerance from it in altitude. First and last points are always kept.
+FWaveGPXSimplifyReport WaveRouteUtil_SimplifyPoints( const std::vector< FWaveGPXPoint >& Points, std::vector< FWaveGPXPoint >& SimplifiedPoints, float HorizontalTolerance, float VerticalTolerance );
+
+void WaveRouteUtil_MakeCompactRoute( const FWaveGPXRoute& Route, FWaveGPXCompactRoute& CompactRoute );
+
+void WaveRouteUtil_ExpandCompactRoute( const FWaveGPXCompactRoute& CompactRoute, FWaveGPXRoute& Route );
+
 int WaveRouteUtil_FindPointAtDist( const FWaveGPXRoute& Route, float Dist );
+int WaveRouteUtil_FindPointAtDist( const FWaveGPXCompactRoute& Route, float Dist );
 
 // Uses simple linear interpolation, which is good for demo apps and testing purposes.
 //
 FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXRoute& Route, float Dist );
+FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXCompactRoute& Route, float Dist );
+
+// Rise from PosA to PosB over the horizontal run between them, as a percentage.
+float WaveRouteUtil_GradeBetween( const FWaveGPXPoint& PosA, const FWaveGPXPoint& PosB );
 
 // Uses simple central difference with linear interpolation, which is good for demo apps and testing purposes.
 float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXRoute& Route, float Dist, float Smoothness = 2.5f );
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXGradeProfile& Profile, float Dist, float Smoothness = 2.5f );
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXCompactRoute& Route, float Dist, float Smoothness = 2.5f );
+
+// Profile gives the route's own grades at any Smoothness ( to a few parts in a million, since it lerps ENU where the
+// route lerps LLA ), without a search or an LLA to ENU conversion per call.
+void WaveRouteUtil_BuildGradeProfile( const FWaveGPXRoute& Route, FWaveGPXGradeProfile& Profile );
+
+// Builds Resampled from Route in a single pass. Spacing trades memory for how closely lookups between samples follow
+// the original route's corners.
+void WaveRouteUtil_ResampleRoute( const FWaveGPXRoute& Route, FWaveGPXResampledRoute& Resampled, float Spacing = 1.0f, float GradeSmoothness = 2.5f );
+
+// Same result as WaveRouteUtil_FindPointAtDist( Route, Dist ), starting from the nearest sample.
+int WaveRouteUtil_FindPointAtDist( const FWaveGPXRoute& Route, const FWaveGPXResampledRoute& Resampled, float Dist );
+
+// Lerps between the two nearest samples. Exact at sample distances.
+FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXResampledRoute& Resampled, float Dist );
+
+// Grade with Resampled.GradeSmoothness, lerped between the two nearest samples.
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXResampledRoute& Resampled, float Dist );
+
+// Fills East / North / Alt / Grade at each of Dists, in one forward pass over the route when Dists are sorted ( they
+// don't have to be, it's just slower ). Alt is what WaveRouteUtil_FindENUPosAtDist gives and Grade is what
+// WaveRouteUtil_FindGradePosAtDist gives with a grade profile, while East / North lerp the points' own ENU rather than
+// their LLA, so differ from WaveRouteUtil_FindENUPosAtDist by the earth's curvature across a segment ( under half a
+// millimetre on the test routes ). Any of the outputs can be null.
+void WaveRouteUtil_SampleRoute( const FWaveGPXRoute& Route, const float* Dists, size_t NumDists, double* Alt, float* Grade, double* East, double* North, float GradeSmoothness = 2.5f );
+
+// Level 0 buckets are MinBucketSize metres, or longer if the route's points are further apart than that on average.
+// Altitude is exact over the points between bucket edges, and a level 0 bucket's grade is from its start to its end.
+void WaveRouteUtil_BuildLODPyramid( const FWaveGPXRoute& Route, FWaveGPXLODPyramid& Pyramid, float MinBucketSize = WAVEGPX_LOD_MIN_BUCKET_SIZE );
+
+// Summarises StartDist to EndDist into NumPixels equal stretches, each from the few buckets of the coarsest level whose
+// buckets are no bigger than a pixel, so the cost doesn't depend on the route's length. Min / Max can take in up to a
+// bucket either side of a pixel, and pixels off the end of the route take the bucket at that end. The route version
+// builds a temporary pyramid if Route.LODPyramid doesn't match it.
+void WaveRouteUtil_GetLODView( const FWaveGPXLODPyramid& Pyramid, float StartDist, float EndDist, FWaveGPXLODBucket* Pixels, size_t NumPixels );
+void WaveRouteUtil_GetLODView( const FWaveGPXRoute& Route, float StartDist, float EndDist, FWaveGPXLODBucket* Pixels, size_t NumPixels );
+
+void WaveRouteUtil_BuildSpline( const FWaveGPXRoute& Route, FWaveGPXSpline& Spline );
+
+// The spline at Dist on the segment starting at point Segment ( as WaveRouteUtil_FindPointAtDist gives it ), clamped
+// to the ends of the route. Each segment only depends on the points either side of it, so without Route.Spline the one
+// segment is fitted on the spot, with the same result.
+FWaveGPXSplineSample WaveRouteUtil_EvalSpline( const FWaveGPXRoute& Route, int Segment, float Dist );
+FWaveGPXSplineSample WaveRouteUtil_FindSplinePosAtDist( const FWaveGPXRoute& Route, float Dist );
+
+void WaveRouteUtil_BuildSpatialIndex( FWaveGPXRoute& Route, float CellSize = WAVEGPX_SPATIAL_CELL_SIZE );
+
+// Distance along the route of the nearest point on it to East / North, ignoring altitude. Searches the grid cells
+// around the position, so the cost depends on how busy the route is locally rather than its length. Pass the last
+// answer as HintDist ( or negative for none ) when tracking a moving position, so where the route passes the
+// same spot twice it picks the pass closest to HintDist. Falls back to checking every segment if Route has no
+// spatial index, or one built for a different set of points.
+float WaveRouteUtil_FindNearestDistOnRoute( const FWaveGPXRoute& Route, double East, double North, float HintDist = -1.0f, float* OffRouteDist = nullptr );
+
+// Route.GeoFrame, or if that isn't set up for Route.Points[0] ( a route built by hand, say ), Temp set up for it.
+const FWaveGPXGeoFrame& WaveRouteUtil_GetGeoFrame( const FWaveGPXRoute& Route, FWaveGPXGeoFrame& Temp );
 
 void WaveRouteUtil_FillENUFromLLA( const FWaveGPXRoute& Route, FWaveGPXPoint& Point );
+void WaveRouteUtil_FillENUFromLLA( const FWaveGPXRoute& Route, FWaveGPXPoint* Points, size_t NumPoints );
+
+void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint& Point );
+void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint* Points, size_t NumPoints );
+
+// Same results ( to well under a micrometre ) as geodetic_converter::GeodeticConverter referenced at the frame's
+// origin. The single point and batch versions give exactly the same results.
+void WaveGPXGeo_InitFrame( FWaveGPXGeoFrame& Frame, double Lat, double Lon, double Alt );
+void WaveGPXGeo_LLAToENU( const FWaveGPXGeoFrame& Frame, double Lat, double Lon, double Alt, double& East, double& North, double& Up );
+void WaveGPXGeo_ENUToLLA( const FWaveGPXGeoFrame& Frame, double East, double North, double Up, double& Lat, double& Lon, double& Alt );
+void WaveGPXGeo_LLAToECEF( double Lat, double Lon, double Alt, double& X, double& Y, double& Z );
+void WaveGPXGeo_ECEFToLLA( double X, double Y, double Z, double& Lat, double& Lon, double& Alt );
+void WaveGPXGeo_ECEFToENU( const FWaveGPXGeoFrame& Frame, double X, double Y, double Z, double& East, double& North, double& Up );
+void WaveGPXGeo_ENUToECEF( const FWaveGPXGeoFrame& Frame, double East, double North, double Up, double& X, double& Y, double& Z );
+
+// Batch versions, converting Count points between separate arrays ( in place is fine ). These do two or four points
+// at a time with SSE2 or AVX, whichever the CPU has, and give the same results on either.
+void WaveGPXGeo_LLAToENU( const FWaveGPXGeoFrame& Frame, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, size_t Count );
+void WaveGPXGeo_ENUToLLA( const FWaveGPXGeoFrame& Frame, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, size_t Count );
+void WaveGPXGeo_LLAToECEF( const double* Lat, const double* Lon, const double* Alt, double* X, double* Y, double* Z, size_t Count );
+void WaveGPXGeo_ECEFToLLA( const double* X, const double* Y, const double* Z, double* Lat, double* Lon, double* Alt, size_t Count );
+void WaveGPXGeo_ECEFToENU( const FWaveGPXGeoFrame& Frame, const double* X, const double* Y, const double* Z, double* East, double* North, double* Up, size_t Count );
+void WaveGPXGeo_ENUToECEF( const FWaveGPXGeoFrame& Frame, const double* East, const double* North, const double* Up, double* X, double* Y, double* Z, size_t Count );
+
+// Follows a distance along a route, for a rider who mostly moves forward a little each frame. Each SetDist walks
+// from the segments it was on last time instead of searching the whole route, and gives the same results as
+// WaveRouteUtil_FindPointAtDist, WaveRouteUtil_FindENUPosAtDist, WaveRouteUtil_FindGradePosAtDist and
+// WaveRouteUtil_FindSplinePosAtDist. Route must outlive the cursor and not change under it.
+class WaveRouteCursor
+{
+public:
+	WaveRouteCursor( const FWaveGPXRoute& Route, float GradeSmoothness = 2.5f );
+
+	void SetDist( float Dist );
+
+	inline float GetDist() const
+	{
+		return Dist;
+	}
 
-void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint& Point );
\ No newline at end of file
+	inline int GetPointIndex() const
+	{
+		return PointIndex;
+	}
+
+	inline const FWaveGPXPoint& GetPosition() const
+	{
+		return Position;
+	}
+
+	inline double GetAlt() const
+	{
+		return Position.Alt;
+	}
+
+	inline float GetGrade() const
+	{
+		return Grade;
+	}
+
+	// Degrees clockwise from north, over the same window as the grade.
+	inline float GetHeading() const
+	{
+		return Heading;
+	}
+
+	// Position, tangent, curvature, grade and heading from the route's spline at Dist, with no smoothing window.
+	inline const FWaveGPXSplineSample& GetSplineSample() const
+	{
+		return SplineSample;
+	}
+
+private:
+	const FWaveGPXRoute* Route = nullptr;
+	FWaveGPXGeoFrame Frame;
+	float GradeSmoothness = 2.5f;
+
+	// Segments at Dist and either end of the grade window.
+	int PointIndex = 0;
+	int IndexBehind = 0;
+	int IndexAhead = 0;
+
+	float Dist = 0.0f;
+	FWaveGPXPoint Position;
+	float Grade = 0.0f;
+	float Heading = 0.0f;
+	FWaveGPXSplineSample SplineSample;
+};
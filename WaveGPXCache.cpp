@@ -0,0 +1,368 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WaveGPX.h"
+#include "WaveControl.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Loading a route from XML means parsing, converting every point to ENU and computing stats. The route cache keeps
+// the result of all that in a file next to the GPX, laid out so loading it is a memory map and a single copy.
+//
+// File layout, native endian ( so little endian on everything we ship ):
+//     WaveGPXCacheHeader
+//     SourcePath, Name, Description, Author ( lengths in the header, no terminators )
+//     Padding to 8 bytes
+//     FWaveGPXPoint[ NumPoints ]
+//
+// The cache is keyed on the GPX file's absolute path, size, modification time and a hash of its contents. If only
+// the modification time differs ( file copied or touched ) the hash decides, and the cache is re-stamped if it
+// still matches. Loads with different simplification options don't share a cache.
+//
+
+#define WAVEGPX_CACHE_MAGIC "WAVERTE"
+#define WAVEGPX_CACHE_VERSION 2
+#define WAVEGPX_CACHE_EXTENSION ".wavecache"
+#define WAVEGPX_CACHE_HASH_PRIME 0x100000001b3ull
+#define WAVEGPX_CACHE_HASH_BUFFER_SIZE ( 64 * 1024 )
+
+struct WaveGPXCacheHeader
+{
+	char Magic[7];
+	uint8_t Version;
+	uint64_t SourceSize;
+	int64_t SourceModifiedTime;
+	uint64_t SourceHash;
+
+	uint32_t SourcePathLength;
+	uint32_t NameLength;
+	uint32_t DescriptionLength;
+	uint32_t AuthorLength;
+
+	uint64_t NumPoints;
+	uint64_t PointsOffset;
+
+	float Stat_Elev;
+	float Stat_Length;
+	float Stat_HillinessRating;
+	float Stat_DifficultyScore;
+	float Stat_HighestAlt;
+	float Stat_LowestAlt;
+
+	// All zero unless the route was simplified.
+	float SimplifyHorizontalTolerance;
+	float SimplifyVerticalTolerance;
+	float SimplifyMaxStatError;
+};
+static_assert( sizeof( FWaveGPXPoint ) == 7 * sizeof( double ), "Route cache stores points as raw doubles." );
+
+// Read only view of a whole file.
+struct WaveGPXMappedFile
+{
+	const uint8_t* Data = nullptr;
+	uint64_t Size = 0;
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#else
+	int File = -1;
+#endif
+
+	bool Open( const std::string& FileName )
+	{
+#ifdef _WIN32
+		// Share writes too, WaveGPXCache_Open re-stamps the header through its own handle while this is mapped.
+		File = CreateFileA( FileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+		if ( File == INVALID_HANDLE_VALUE )
+			return false;
+		LARGE_INTEGER FileSize;
+		if ( !GetFileSizeEx( File, &FileSize ) || FileSize.QuadPart == 0 )
+			return false;
+		Size = ( uint64_t ) FileSize.QuadPart;
+		Mapping = CreateFileMappingA( File, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( !Mapping )
+			return false;
+		Data = ( const uint8_t* ) MapViewOfFile( Mapping, FILE_MAP_READ, 0, 0, 0 );
+#else
+		File = open( FileName.c_str(), O_RDONLY );
+		if ( File < 0 )
+			return false;
+		struct stat FileStat;
+		if ( fstat( File, &FileStat ) != 0 || FileStat.st_size == 0 )
+			return false;
+		Size = ( uint64_t ) FileStat.st_size;
+		void* Mapped = mmap( nullptr, Size, PROT_READ, MAP_PRIVATE, File, 0 );
+		Data = ( Mapped == MAP_FAILED ) ? nullptr : ( const uint8_t* ) Mapped;
+#endif
+		return Data != nullptr;
+	}
+
+	~WaveGPXMappedFile()
+	{
+#ifdef _WIN32
+		if ( Data ) UnmapViewOfFile( Data );
+		if ( Mapping ) CloseHandle( Mapping );
+		if ( File != INVALID_HANDLE_VALUE ) CloseHandle( File );
+#else
+		if ( Data ) munmap( ( void* ) Data, Size );
+		if ( File >= 0 ) close( File );
+#endif
+	}
+};
+
+// FNV-1a. Not cryptographic, just enough to tell an edited GPX from a touched one.
+uint64_t WaveGPXCache_HashBytes( uint64_t Hash, const void* Data, size_t Size )
+{
+	auto Bytes = ( const uint8_t* ) Data;
+	for ( size_t i = 0; i < Size; i++ ) {
+		Hash = ( Hash ^ Bytes[i] ) * WAVEGPX_CACHE_HASH_PRIME;
+	}
+	return Hash;
+}
+
+static bool WaveGPXCache_HashFile( const std::string& FileName, uint64_t& Hash )
+{
+	std::ifstream FileStream( FileName, std::ios::in | std::ios::binary );
+	if ( !FileStream.is_open() )
+		return false;
+
+	static thread_local char Buffer[ WAVEGPX_CACHE_HASH_BUFFER_SIZE ];
+	Hash = WAVEGPX_CACHE_HASH_SEED;
+	while ( FileStream ) {
+		FileStream.read( Buffer, sizeof( Buffer ) );
+		Hash = WaveGPXCache_HashBytes( Hash, Buffer, ( size_t ) FileStream.gcount() );
+	}
+	return true;
+}
+
+static bool WaveGPXCache_StatSource( const std::string& FileName, std::string& SourcePath, uint64_t& SourceSize, int64_t& SourceModifiedTime )
+{
+	std::error_code Error;
+	auto Path = std::filesystem::absolute( FileName, Error );
+	if ( Error )
+		return false;
+	SourceSize = ( uint64_t ) std::filesystem::file_size( Path, Error );
+	if ( Error )
+		return false;
+	SourceModifiedTime = ( int64_t ) std::filesystem::last_write_time( Path, Error ).time_since_epoch().count();
+	if ( Error )
+		return false;
+	SourcePath = Path.lexically_normal().string();
+	return true;
+}
+
+std::string WaveGPXCache_GetFileName( const std::string& FileName )
+{
+	return FileName + WAVEGPX_CACHE_EXTENSION;
+}
+
+// Simplification settings as stored in the header.
+static void WaveGPXCache_GetSimplifyKey( const FWaveGPXLoadOptions& Options, float Key[3] )
+{
+	Key[0] = Options.Simplify ? Options.SimplifyHorizontalTolerance : 0.0f;
+	Key[1] = Options.Simplify ? Options.SimplifyVerticalTolerance : 0.0f;
+	Key[2] = Options.Simplify ? Options.SimplifyMaxStatError : 0.0f;
+}
+
+// Maps FileName's cache and checks it still matches FileName. On success Strings points at the route name.
+static bool WaveGPXCache_Open( const std::string& FileName, const FWaveGPXLoadOptions& Options, WaveGPXMappedFile& Cache, WaveGPXCacheHeader& Header, const char*& Strings )
+{
+	std::string SourcePath;
+	uint64_t SourceSize = 0;
+	int64_t SourceModifiedTime = 0;
+	if ( !WaveGPXCache_StatSource( FileName, SourcePath, SourceSize, SourceModifiedTime ) )
+		return false;
+
+	auto CacheFileName = WaveGPXCache_GetFileName( FileName );
+	if ( !Cache.Open( CacheFileName ) || Cache.Size < sizeof( WaveGPXCacheHeader ) )
+		return false;
+
+	memcpy( &Header, Cache.Data, sizeof( Header ) );
+	if ( memcmp( Header.Magic, WAVEGPX_CACHE_MAGIC, sizeof( Header.Magic ) ) || Header.Version != WAVEGPX_CACHE_VERSION ) {
+		WAVECONTROL_LOG( "Route cache %s is from another version, ignoring.\n", CacheFileName.c_str() );
+		return false;
+	}
+
+	float SimplifyKey[3];
+	WaveGPXCache_GetSimplifyKey( Options, SimplifyKey );
+	if ( Header.SimplifyHorizontalTolerance != SimplifyKey[0] || Header.SimplifyVerticalTolerance != SimplifyKey[1] || Header.SimplifyMaxStatError != SimplifyKey[2] )
+		return false;
+
+	uint64_t StringsSize = ( uint64_t ) Header.SourcePathLength + Header.NameLength + Header.DescriptionLength + Header.AuthorLength;
+	if ( sizeof( Header ) + StringsSize > Header.PointsOffset ||
+		Header.PointsOffset > Cache.Size ||
+		Header.NumPoints > ( Cache.Size - Header.PointsOffset ) / sizeof( FWaveGPXPoint ) ) {
+		WAVECONTROL_LOG( "ERROR: Route cache %s is truncated!\n", CacheFileName.c_str() );
+		return false;
+	}
+
+	Strings = ( const char* ) Cache.Data + sizeof( Header );
+	if ( Header.SourceSize != SourceSize || SourcePath.compare( 0, std::string::npos, Strings, Header.SourcePathLength ) != 0 )
+		return false;
+
+	if ( Header.SourceModifiedTime != SourceModifiedTime ) {
+		uint64_t SourceHash = 0;
+		if ( !WaveGPXCache_HashFile( FileName, SourceHash ) || SourceHash != Header.SourceHash )
+			return false;
+
+		// Same contents, so the cache is still good. Re-stamp it so we don't hash the file every time.
+		std::fstream CacheStream( CacheFileName, std::ios::in | std::ios::out | std::ios::binary );
+		if ( CacheStream.is_open() ) {
+			CacheStream.seekp( offsetof( WaveGPXCacheHeader, SourceModifiedTime ) );
+			CacheStream.write( ( const char* ) &SourceModifiedTime, sizeof( SourceModifiedTime ) );
+		}
+	}
+	Strings += Header.SourcePathLength;
+	return true;
+}
+
+// Works for both FWaveGPXRoute and FWaveGPXCatalogEntry.
+template< typename T >
+static void WaveGPXCache_FillInfo( const WaveGPXCacheHeader& Header, const char* Strings, T& Out )
+{
+	Out.Name.assign( Strings, Header.NameLength );
+	Strings += Header.NameLength;
+	Out.Description.assign( Strings, Header.DescriptionLength );
+	Strings += Header.DescriptionLength;
+	Out.Author.assign( Strings, Header.AuthorLength );
+
+	Out.Stat_Elev = Header.Stat_Elev;
+	Out.Stat_Length = Header.Stat_Length;
+	Out.Stat_HillinessRating = Header.Stat_HillinessRating;
+	Out.Stat_DifficultyScore = Header.Stat_DifficultyScore;
+	Out.Stat_HighestAlt = Header.Stat_HighestAlt;
+	Out.Stat_LowestAlt = Header.Stat_LowestAlt;
+}
+
+bool WaveGPXCache_Load( FWaveGPXRoute& Route, const std::string& FileName, const FWaveGPXLoadOptions& Options )
+{
+	WaveGPXMappedFile Cache;
+	WaveGPXCacheHeader Header;
+	const char* Strings = nullptr;
+	if ( !WaveGPXCache_Open( FileName, Options, Cache, Header, Strings ) )
+		return false;
+
+	WaveGPXCache_FillInfo( Header, Strings, Route );
+	Route.SourceFile = FileName;
+
+	auto Points = ( const FWaveGPXPoint* ) ( Cache.Data + Header.PointsOffset );
+	Route.Points.assign( Points, Points + Header.NumPoints );
+	return true;
+}
+
+bool WaveGPXCache_LoadCatalogEntry( FWaveGPXCatalogEntry& Entry, const std::string& FileName, const FWaveGPXLoadOptions& Options )
+{
+	// Only the header and strings get paged in, the points are never touched.
+	WaveGPXMappedFile Cache;
+	WaveGPXCacheHeader Header;
+	const char* Strings = nullptr;
+	if ( !WaveGPXCache_Open( FileName, Options, Cache, Header, Strings ) )
+		return false;
+
+	WaveGPXCache_FillInfo( Header, Strings, Entry );
+	Entry.SourceFile = FileName;
+	Entry.NumPoints = ( int ) Header.NumPoints;
+	return true;
+}
+
+bool WaveGPXCache_Save( const FWaveGPXRoute& Route, const std::string& FileName, uint64_t SourceHash, const FWaveGPXLoadOptions& Options )
+{
+	WaveGPXCacheHeader Header;
+	memset( &Header, 0, sizeof( Header ) );
+
+	std::string SourcePath;
+	if ( !WaveGPXCache_StatSource( FileName, SourcePath, Header.SourceSize, Header.SourceModifiedTime ) )
+		return false;
+
+	memcpy( Header.Magic, WAVEGPX_CACHE_MAGIC, sizeof( Header.Magic ) );
+	Header.Version = WAVEGPX_CACHE_VERSION;
+	Header.SourceHash = SourceHash;
+	Header.SourcePathLength = ( uint32_t ) SourcePath.size();
+	Header.NameLength = ( uint32_t ) Route.Name.size();
+	Header.DescriptionLength = ( uint32_t ) Route.Description.size();
+	Header.AuthorLength = ( uint32_t ) Route.Author.size();
+	Header.NumPoints = Route.Points.size();
+
+	uint64_t StringsSize = ( uint64_t ) Header.SourcePathLength + Header.NameLength + Header.DescriptionLength + Header.AuthorLength;
+	Header.PointsOffset = ( sizeof( Header ) + StringsSize + 7 ) & ~7ull;
+
+	Header.Stat_Elev = Route.Stat_Elev;
+	Header.Stat_Length = Route.Stat_Length;
+	Header.Stat_HillinessRating = Route.Stat_HillinessRating;
+	Header.Stat_DifficultyScore = Route.Stat_DifficultyScore;
+	Header.Stat_HighestAlt = Route.Stat_HighestAlt;
+	Header.Stat_LowestAlt = Route.Stat_LowestAlt;
+
+	float SimplifyKey[3];
+	WaveGPXCache_GetSimplifyKey( Options, SimplifyKey );
+	Header.SimplifyHorizontalTolerance = SimplifyKey[0];
+	Header.SimplifyVerticalTolerance = SimplifyKey[1];
+	Header.SimplifyMaxStatError = SimplifyKey[2];
+
+	// Write to a temporary and rename over the old cache, so nobody ever maps a half written file.
+	auto CacheFileName = WaveGPXCache_GetFileName( FileName );
+	auto TempFileName = CacheFileName + ".tmp" + std::to_string( std::hash< std::thread::id >()( std::this_thread::get_id() ) );
+	{
+		std::ofstream FileStream( TempFileName, std::ios::out | std::ios::binary | std::ios::trunc );
+		if ( !FileStream.is_open() ) {
+			WAVECONTROL_LOG( "Failed to write route cache %s, continuing without.\n", CacheFileName.c_str() );
+			return false;
+		}
+
+		static const char Padding[8] = {};
+		FileStream.write( ( const char* ) &Header, sizeof( Header ) );
+		FileStream.write( SourcePath.data(), SourcePath.size() );
+		FileStream.write( Route.Name.data(), Route.Name.size() );
+		FileStream.write( Route.Description.data(), Route.Description.size() );
+		FileStream.write( Route.Author.data(), Route.Author.size() );
+		FileStream.write( Padding, Header.PointsOffset - sizeof( Header ) - StringsSize );
+		FileStream.write( ( const char* ) Route.Points.data(), Route.Points.size() * sizeof( FWaveGPXPoint ) );
+		if ( !FileStream ) {
+			WAVECONTROL_LOG( "Failed to write route cache %s, continuing without.\n", CacheFileName.c_str() );
+			FileStream.close();
+			std::filesystem::remove( TempFileName );
+			return false;
+		}
+	}
+
+	std::error_code Error;
+	std::filesystem::rename( TempFileName, CacheFileName, Error );
+	if ( Error ) {
+		WAVECONTROL_LOG( "Failed to write route cache %s, continuing without.\n", CacheFileName.c_str() );
+		std::filesystem::remove( TempFileName, Error );
+		return false;
+	}
+	return true;
+}
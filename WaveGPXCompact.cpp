@@ -0,0 +1,183 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WaveGPX.h"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+FWaveGPXPoint FWaveGPXCompactRoute::GetPoint( int Index ) const
+{
+	int Chunk = Index / WAVEGPX_COMPACT_CHUNK_SIZE;
+
+	FWaveGPXPoint Point;
+	Point.Lat = Lat[ Index ] / WAVEGPX_COMPACT_DEGREE_SCALE;
+	Point.Lon = Lon[ Index ] / WAVEGPX_COMPACT_DEGREE_SCALE;
+	Point.Alt = Alt[ Index ];
+	Point.East = ChunkEast[ Chunk ] + East[ Index ];
+	Point.North = ChunkNorth[ Chunk ] + North[ Index ];
+	Point.Up = ChunkUp[ Chunk ] + Up[ Index ];
+	Point.Dist = ChunkDist[ Chunk ] + Dist[ Index ];
+	return Point;
+}
+
+void FWaveGPXCompactRoute::AddPoint( const FWaveGPXPoint& Point )
+{
+	// First point of each chunk becomes its origin.
+	if ( GetNumPoints() % WAVEGPX_COMPACT_CHUNK_SIZE == 0 ) {
+		ChunkEast.push_back( Point.East );
+		ChunkNorth.push_back( Point.North );
+		ChunkUp.push_back( Point.Up );
+		ChunkDist.push_back( Point.Dist );
+	}
+
+	Lat.push_back( ( int32_t ) lround( Point.Lat * WAVEGPX_COMPACT_DEGREE_SCALE ) );
+	Lon.push_back( ( int32_t ) lround( Point.Lon * WAVEGPX_COMPACT_DEGREE_SCALE ) );
+	Alt.push_back( ( float ) Point.Alt );
+	East.push_back( ( float ) ( Point.East - ChunkEast.back() ) );
+	North.push_back( ( float ) ( Point.North - ChunkNorth.back() ) );
+	Up.push_back( ( float ) ( Point.Up - ChunkUp.back() ) );
+	Dist.push_back( ( float ) ( Point.Dist - ChunkDist.back() ) );
+}
+
+void WaveRouteUtil_MakeCompactRoute( const FWaveGPXRoute& Route, FWaveGPXCompactRoute& CompactRoute )
+{
+	CompactRoute = FWaveGPXCompactRoute();
+	CompactRoute.Name = Route.Name;
+	CompactRoute.Description = Route.Description;
+	CompactRoute.Author = Route.Author;
+	CompactRoute.SourceFile = Route.SourceFile;
+
+	size_t NumPoints = Route.Points.size();
+	size_t NumChunks = ( NumPoints + WAVEGPX_COMPACT_CHUNK_SIZE - 1 ) / WAVEGPX_COMPACT_CHUNK_SIZE;
+	CompactRoute.Lat.reserve( NumPoints );
+	CompactRoute.Lon.reserve( NumPoints );
+	CompactRoute.Alt.reserve( NumPoints );
+	CompactRoute.East.reserve( NumPoints );
+	CompactRoute.North.reserve( NumPoints );
+	CompactRoute.Up.reserve( NumPoints );
+	CompactRoute.Dist.reserve( NumPoints );
+	CompactRoute.ChunkEast.reserve( NumChunks );
+	CompactRoute.ChunkNorth.reserve( NumChunks );
+	CompactRoute.ChunkUp.reserve( NumChunks );
+	CompactRoute.ChunkDist.reserve( NumChunks );
+	for ( auto& Point : Route.Points ) {
+		CompactRoute.AddPoint( Point );
+	}
+
+	CompactRoute.Stat_Elev = Route.Stat_Elev;
+	CompactRoute.Stat_Length = Route.Stat_Length;
+	CompactRoute.Stat_HillinessRating = Route.Stat_HillinessRating;
+	CompactRoute.Stat_DifficultyScore = Route.Stat_DifficultyScore;
+	CompactRoute.Stat_HighestAlt = Route.Stat_HighestAlt;
+	CompactRoute.Stat_LowestAlt = Route.Stat_LowestAlt;
+}
+
+void WaveRouteUtil_ExpandCompactRoute( const FWaveGPXCompactRoute& CompactRoute, FWaveGPXRoute& Route )
+{
+	Route = FWaveGPXRoute();
+	Route.Name = CompactRoute.Name;
+	Route.Description = CompactRoute.Description;
+	Route.Author = CompactRoute.Author;
+	Route.SourceFile = CompactRoute.SourceFile;
+
+	Route.Points.resize( CompactRoute.GetNumPoints() );
+	for ( int i = 0; i < CompactRoute.GetNumPoints(); i++ ) {
+		Route.Points[i] = CompactRoute.GetPoint( i );
+	}
+
+	Route.Stat_Elev = CompactRoute.Stat_Elev;
+	Route.Stat_Length = CompactRoute.Stat_Length;
+	Route.Stat_HillinessRating = CompactRoute.Stat_HillinessRating;
+	Route.Stat_DifficultyScore = CompactRoute.Stat_DifficultyScore;
+	Route.Stat_HighestAlt = CompactRoute.Stat_HighestAlt;
+	Route.Stat_LowestAlt = CompactRoute.Stat_LowestAlt;
+}
+
+int WaveRouteUtil_FindPointAtDist( const FWaveGPXCompactRoute& Route, float Dist )
+{
+	// Same result as the FWaveGPXRoute version. Find the chunk first, so the search over points only touches
+	// one chunk's worth of floats.
+	int NumPoints = Route.GetNumPoints();
+	auto ChunkItr = std::lower_bound( Route.ChunkDist.begin(), Route.ChunkDist.end(), ( double ) Dist );
+	int Chunk = std::max( 0, ( int ) ( ChunkItr - Route.ChunkDist.begin() ) - 1 );
+
+	int Begin = Chunk * WAVEGPX_COMPACT_CHUNK_SIZE;
+	int End = std::min( Begin + WAVEGPX_COMPACT_CHUNK_SIZE, NumPoints );
+	while ( Begin < End ) {
+		int Mid = ( Begin + End ) / 2;
+		if ( Route.GetDist( Mid ) < Dist ) {
+			Begin = Mid + 1;
+		} else {
+			End = Mid;
+		}
+	}
+
+	if ( Begin >= NumPoints ) {
+		return NumPoints - 1;
+	}
+	if ( Begin == 0 ) {
+		return 0;
+	}
+	return Begin - 1;
+}
+
+FWaveGPXPoint WaveRouteUtil_FindENUPosAtDist( const FWaveGPXCompactRoute& Route, float Dist )
+{
+	FWaveGPXPoint Point;
+
+	if ( Route.GetNumPoints() <= 0 ) {
+		return Point;
+	}
+
+	auto Index = WaveRouteUtil_FindPointAtDist( Route, Dist );
+	auto PointA = Route.GetPoint( Index );
+	if ( Index == Route.GetNumPoints() - 1 || Dist < PointA.Dist ) {
+		Point = PointA;
+		Point.Dist = Dist;
+		return Point;
+	}
+
+	// ENU is interpolated directly rather than converted from the interpolated LLA. Over one segment the
+	// difference is far below the quantisation.
+	auto PointB = Route.GetPoint( Index + 1 );
+	double InterpRun = PointB.Dist - PointA.Dist;
+	double InterpX = ( Dist - PointA.Dist ) / ( InterpRun > 0.01f ? InterpRun : 0.01f );
+
+	Point.Lat = PointA.Lat + ( PointB.Lat - PointA.Lat ) * InterpX;
+	Point.Lon = PointA.Lon + ( PointB.Lon - PointA.Lon ) * InterpX;
+	Point.Alt = PointA.Alt + ( PointB.Alt - PointA.Alt ) * InterpX;
+	Point.East = PointA.East + ( PointB.East - PointA.East ) * InterpX;
+	Point.North = PointA.North + ( PointB.North - PointA.North ) * InterpX;
+	Point.Up = PointA.Up + ( PointB.Up - PointA.Up ) * InterpX;
+	Point.Dist = Dist;
+	return Point;
+}
+
+float WaveRouteUtil_FindGradePosAtDist( const FWaveGPXCompactRoute& Route, float Dist, float Smoothness )
+{
+	if ( Route.GetNumPoints() <= 0 ) {
+		return 0.0f;
+	}
+
+	auto PosA = WaveRouteUtil_FindENUPosAtDist( Route, Dist - Smoothness );
+	auto PosB = WaveRouteUtil_FindENUPosAtDist( Route, Dist + Smoothness );
+	return WaveRouteUtil_GradeBetween( PosA, PosB );
+}
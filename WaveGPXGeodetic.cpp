@@ -0,0 +1,633 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WaveGPX.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( _M_X64 ) || defined( __SSE2__ )
+#define WAVEGPX_GEO_SSE2
+#include <emmintrin.h>
+#endif
+
+// MSVC lets any function use AVX intrinsics and we pick at runtime, other compilers only when the whole build does.
+#if defined( WAVEGPX_GEO_SSE2 ) && ( defined( _MSC_VER ) || defined( __AVX__ ) )
+#define WAVEGPX_GEO_AVX
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Same WGS84 parameters and maths as geodetic_converter::GeodeticConverter, with the reference point's setup done
+// once per frame rather than once per converter. Conversions run on SIMD lanes with their own sin / cos / atan / cbrt,
+// and agree with the converter to well under a micrometre.
+#define WAVEGPX_GEO_PI 3.14159265358979323846
+#define WAVEGPX_GEO_SEMIMAJOR_AXIS 6378137.0
+#define WAVEGPX_GEO_SEMIMINOR_AXIS 6356752.3142
+#define WAVEGPX_GEO_FIRST_ECCENTRICITY_SQUARED ( 6.69437999014 * 0.001 )
+#define WAVEGPX_GEO_SECOND_ECCENTRICITY_SQUARED ( 6.73949674228 * 0.001 )
+
+// Pi / 2 in three parts for the sin / cos range reduction. The first two have few enough bits that multiplying
+// them by a small whole number is exact.
+#define WAVEGPX_GEO_PIO2_1 1.57079632673412561417e+00
+#define WAVEGPX_GEO_PIO2_2 6.07710050630396597660e-11
+#define WAVEGPX_GEO_PIO2_3 2.02226624879595063154e-21
+
+// Adding then subtracting 1.5 * 2^52 rounds a double to the nearest whole number, without needing SSE4.1.
+#define WAVEGPX_GEO_ROUND_MAGIC 6755399441055744.0
+
+// Points the AoS batch conversions copy out into separate arrays at a time.
+#define WAVEGPX_GEO_BLOCK 256
+
+static double WaveGPXGeo_DegToRad( double Degrees )
+{
+	return ( Degrees / 180.0 ) * WAVEGPX_GEO_PI;
+}
+
+static double WaveGPXGeo_RadToDeg( double Radians )
+{
+	return ( Radians / WAVEGPX_GEO_PI ) * 180.0;
+}
+
+// J. Zhu, "Conversion of Earth-centered Earth-fixed coordinates to geodetic coordinates," IEEE Transactions on
+// Aerospace and Electronic Systems, vol. 30, pp. 957-961, 1994. With the standard library's maths, for points the
+// faster version can't handle.
+static void WaveGPXGeo_ECEFToLLALibm( double X, double Y, double Z, double& Lat, double& Lon, double& Alt )
+{
+	const double A = WAVEGPX_GEO_SEMIMAJOR_AXIS;
+	const double B = WAVEGPX_GEO_SEMIMINOR_AXIS;
+	const double E2 = WAVEGPX_GEO_FIRST_ECCENTRICITY_SQUARED;
+
+	double R = sqrt( X * X + Y * Y );
+	double Esq = A * A - B * B;
+	double F = 54 * B * B * Z * Z;
+	double G = R * R + ( 1 - E2 ) * Z * Z - E2 * Esq;
+	double C = ( E2 * E2 * F * R * R ) / pow( G, 3 );
+	double S = cbrt( 1 + C + sqrt( C * C + 2 * C ) );
+	double P = F / ( 3 * pow( ( S + 1 / S + 1 ), 2 ) * G * G );
+	double Q = sqrt( 1 + 2 * E2 * E2 * P );
+	double R0 = -( P * E2 * R ) / ( 1 + Q )
+		+ sqrt( 0.5 * A * A * ( 1 + 1.0 / Q ) - P * ( 1 - E2 ) * Z * Z / ( Q * ( 1 + Q ) ) - 0.5 * P * R * R );
+	double U = sqrt( pow( ( R - E2 * R0 ), 2 ) + Z * Z );
+	double V = sqrt( pow( ( R - E2 * R0 ), 2 ) + ( 1 - E2 ) * Z * Z );
+	double Z0 = B * B * Z / ( A * V );
+	Alt = U * ( 1 - B * B / ( A * V ) );
+	Lat = WaveGPXGeo_RadToDeg( atan( ( Z + WAVEGPX_GEO_SECOND_ECCENTRICITY_SQUARED * Z0 ) / R ) );
+	Lon = WaveGPXGeo_RadToDeg( atan2( Y, X ) );
+}
+
+// Rotation from ECEF to NED at LatRad / LonRad, row major.
+static void WaveGPXGeo_MakeNedRotation( double LatRad, double LonRad, double* M )
+{
+	const double SinLat = sin( LatRad );
+	const double SinLon = sin( LonRad );
+	const double CosLat = cos( LatRad );
+	const double CosLon = cos( LonRad );
+
+	M[0] = -SinLat * CosLon;
+	M[1] = -SinLat * SinLon;
+	M[2] = CosLat;
+	M[3] = -SinLon;
+	M[4] = CosLon;
+	M[5] = 0.0;
+	M[6] = CosLat * CosLon;
+	M[7] = CosLat * SinLon;
+	M[8] = SinLat;
+}
+
+// ----- Lanes -----
+
+// Each lane type has the arithmetic operators, comparisons giving a Mask, and the few functions below. Plain double
+// is the lane type where there is no SIMD at all.
+template< typename T > struct WaveGPXGeoLanes;
+
+template<> struct WaveGPXGeoLanes< double >
+{
+	static const int Width = 1;
+	static double Load( const double* P ) { return *P; }
+	static void Store( double* P, double V ) { *P = V; }
+};
+
+static double WaveGPXGeo_Sqrt( double V ) { return sqrt( V ); }
+static double WaveGPXGeo_Abs( double V ) { return fabs( V ); }
+static double WaveGPXGeo_Select( bool Mask, double A, double B ) { return Mask ? A : B; }
+static int WaveGPXGeo_MaskBits( bool Mask ) { return Mask ? 1 : 0; }
+
+#ifdef WAVEGPX_GEO_SSE2
+struct WaveGPXGeoSSE2
+{
+	__m128d V;
+	WaveGPXGeoSSE2() {}
+	WaveGPXGeoSSE2( __m128d In ) : V( In ) {}
+	WaveGPXGeoSSE2( double In ) : V( _mm_set1_pd( In ) ) {}
+};
+
+struct WaveGPXGeoSSE2Mask
+{
+	__m128d V;
+};
+
+template<> struct WaveGPXGeoLanes< WaveGPXGeoSSE2 >
+{
+	static const int Width = 2;
+	static WaveGPXGeoSSE2 Load( const double* P ) { return _mm_loadu_pd( P ); }
+	static void Store( double* P, WaveGPXGeoSSE2 V ) { _mm_storeu_pd( P, V.V ); }
+};
+
+static WaveGPXGeoSSE2 operator+( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return _mm_add_pd( A.V, B.V ); }
+static WaveGPXGeoSSE2 operator-( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return _mm_sub_pd( A.V, B.V ); }
+static WaveGPXGeoSSE2 operator*( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return _mm_mul_pd( A.V, B.V ); }
+static WaveGPXGeoSSE2 operator/( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return _mm_div_pd( A.V, B.V ); }
+static WaveGPXGeoSSE2 operator-( WaveGPXGeoSSE2 A ) { return _mm_xor_pd( A.V, _mm_set1_pd( -0.0 ) ); }
+static WaveGPXGeoSSE2Mask operator<( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return { _mm_cmplt_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator>( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return { _mm_cmpgt_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator<=( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return { _mm_cmple_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator>=( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return { _mm_cmpge_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator==( WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return { _mm_cmpeq_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator&( WaveGPXGeoSSE2Mask A, WaveGPXGeoSSE2Mask B ) { return { _mm_and_pd( A.V, B.V ) }; }
+static WaveGPXGeoSSE2Mask operator|( WaveGPXGeoSSE2Mask A, WaveGPXGeoSSE2Mask B ) { return { _mm_or_pd( A.V, B.V ) }; }
+
+static WaveGPXGeoSSE2 WaveGPXGeo_Sqrt( WaveGPXGeoSSE2 V ) { return _mm_sqrt_pd( V.V ); }
+static WaveGPXGeoSSE2 WaveGPXGeo_Abs( WaveGPXGeoSSE2 V ) { return _mm_andnot_pd( _mm_set1_pd( -0.0 ), V.V ); }
+static WaveGPXGeoSSE2 WaveGPXGeo_Select( WaveGPXGeoSSE2Mask Mask, WaveGPXGeoSSE2 A, WaveGPXGeoSSE2 B ) { return _mm_or_pd( _mm_and_pd( Mask.V, A.V ), _mm_andnot_pd( Mask.V, B.V ) ); }
+static int WaveGPXGeo_MaskBits( WaveGPXGeoSSE2Mask Mask ) { return _mm_movemask_pd( Mask.V ); }
+#endif
+
+#ifdef WAVEGPX_GEO_AVX
+struct WaveGPXGeoAVX
+{
+	__m256d V;
+	WaveGPXGeoAVX() {}
+	WaveGPXGeoAVX( __m256d In ) : V( In ) {}
+	WaveGPXGeoAVX( double In ) : V( _mm256_set1_pd( In ) ) {}
+};
+
+struct WaveGPXGeoAVXMask
+{
+	__m256d V;
+};
+
+template<> struct WaveGPXGeoLanes< WaveGPXGeoAVX >
+{
+	static const int Width = 4;
+	static WaveGPXGeoAVX Load( const double* P ) { return _mm256_loadu_pd( P ); }
+	static void Store( double* P, WaveGPXGeoAVX V ) { _mm256_storeu_pd( P, V.V ); }
+};
+
+static WaveGPXGeoAVX operator+( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return _mm256_add_pd( A.V, B.V ); }
+static WaveGPXGeoAVX operator-( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return _mm256_sub_pd( A.V, B.V ); }
+static WaveGPXGeoAVX operator*( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return _mm256_mul_pd( A.V, B.V ); }
+static WaveGPXGeoAVX operator/( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return _mm256_div_pd( A.V, B.V ); }
+static WaveGPXGeoAVX operator-( WaveGPXGeoAVX A ) { return _mm256_xor_pd( A.V, _mm256_set1_pd( -0.0 ) ); }
+static WaveGPXGeoAVXMask operator<( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return { _mm256_cmp_pd( A.V, B.V, _CMP_LT_OQ ) }; }
+static WaveGPXGeoAVXMask operator>( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return { _mm256_cmp_pd( A.V, B.V, _CMP_GT_OQ ) }; }
+static WaveGPXGeoAVXMask operator<=( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return { _mm256_cmp_pd( A.V, B.V, _CMP_LE_OQ ) }; }
+static WaveGPXGeoAVXMask operator>=( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return { _mm256_cmp_pd( A.V, B.V, _CMP_GE_OQ ) }; }
+static WaveGPXGeoAVXMask operator==( WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return { _mm256_cmp_pd( A.V, B.V, _CMP_EQ_OQ ) }; }
+static WaveGPXGeoAVXMask operator&( WaveGPXGeoAVXMask A, WaveGPXGeoAVXMask B ) { return { _mm256_and_pd( A.V, B.V ) }; }
+static WaveGPXGeoAVXMask operator|( WaveGPXGeoAVXMask A, WaveGPXGeoAVXMask B ) { return { _mm256_or_pd( A.V, B.V ) }; }
+
+static WaveGPXGeoAVX WaveGPXGeo_Sqrt( WaveGPXGeoAVX V ) { return _mm256_sqrt_pd( V.V ); }
+static WaveGPXGeoAVX WaveGPXGeo_Abs( WaveGPXGeoAVX V ) { return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), V.V ); }
+static WaveGPXGeoAVX WaveGPXGeo_Select( WaveGPXGeoAVXMask Mask, WaveGPXGeoAVX A, WaveGPXGeoAVX B ) { return _mm256_blendv_pd( B.V, A.V, Mask.V ); }
+static int WaveGPXGeo_MaskBits( WaveGPXGeoAVXMask Mask ) { return _mm256_movemask_pd( Mask.V ); }
+
+static bool WaveGPXGeo_DetectAVX()
+{
+#ifdef _MSC_VER
+	int Info[4];
+	__cpuid( Info, 1 );
+	// Needs the OS to save the upper halves of the registers as well as the CPU having them.
+	bool OSXSave = ( Info[2] & ( 1 << 27 ) ) != 0;
+	bool AVX = ( Info[2] & ( 1 << 28 ) ) != 0;
+	return OSXSave && AVX && ( _xgetbv( 0 ) & 6 ) == 6;
+#else
+	return __builtin_cpu_supports( "avx" );
+#endif
+}
+
+static const bool s_WaveGPXGeo_HasAVX = WaveGPXGeo_DetectAVX();
+#endif
+
+template< typename T >
+static T WaveGPXGeo_Poly( T X, const double* Coeffs, int NumCoeffs )
+{
+	T Sum = Coeffs[ NumCoeffs - 1 ];
+	for ( int i = NumCoeffs - 2; i >= 0; i-- ) {
+		Sum = Sum * X + Coeffs[i];
+	}
+	return Sum;
+}
+
+template< typename T >
+static T WaveGPXGeo_Round( T X )
+{
+	return ( X + WAVEGPX_GEO_ROUND_MAGIC ) - WAVEGPX_GEO_ROUND_MAGIC;
+}
+
+template< typename T >
+static T WaveGPXGeo_Floor( T X )
+{
+	T Rounded = WaveGPXGeo_Round( X );
+	return Rounded - WaveGPXGeo_Select( Rounded > X, T( 1.0 ), T( 0.0 ) );
+}
+
+// Taylor series, taken far enough that they are exact to double precision over +-pi / 4.
+static const double s_WaveGPXGeo_SinCoeffs[] = {
+	1.0, -1.0 / 6.0, 1.0 / 120.0, -1.0 / 5040.0, 1.0 / 362880.0, -1.0 / 39916800.0, 1.0 / 6227020800.0,
+	-1.0 / 1307674368000.0, 1.0 / 355687428096000.0
+};
+static const double s_WaveGPXGeo_CosCoeffs[] = {
+	1.0, -1.0 / 2.0, 1.0 / 24.0, -1.0 / 720.0, 1.0 / 40320.0, -1.0 / 3628800.0, 1.0 / 479001600.0,
+	-1.0 / 87178291200.0, 1.0 / 20922789888000.0, -1.0 / 6402373705728000.0
+};
+
+// Over +-tan( pi / 16 ).
+static const double s_WaveGPXGeo_AtanCoeffs[] = {
+	1.0, -1.0 / 3.0, 1.0 / 5.0, -1.0 / 7.0, 1.0 / 9.0, -1.0 / 11.0, 1.0 / 13.0, -1.0 / 15.0, 1.0 / 17.0,
+	-1.0 / 19.0, 1.0 / 21.0
+};
+
+template< typename T >
+static void WaveGPXGeo_SinCos( T X, T& Sin, T& Cos )
+{
+	// Take off the nearest multiple of pi / 2, in parts so none of X's precision is lost.
+	T Quadrant = WaveGPXGeo_Round( X * ( 2.0 / WAVEGPX_GEO_PI ) );
+	T R = ( ( X - Quadrant * WAVEGPX_GEO_PIO2_1 ) - Quadrant * WAVEGPX_GEO_PIO2_2 ) - Quadrant * WAVEGPX_GEO_PIO2_3;
+	T R2 = R * R;
+	T SinR = R * WaveGPXGeo_Poly( R2, s_WaveGPXGeo_SinCoeffs, 9 );
+	T CosR = WaveGPXGeo_Poly( R2, s_WaveGPXGeo_CosCoeffs, 10 );
+
+	// Which quadrant decides which of the two each one is, and its sign.
+	T Quadrant4 = Quadrant - 4.0 * WaveGPXGeo_Floor( Quadrant * 0.25 );
+	auto Swap = ( Quadrant4 == T( 1.0 ) ) | ( Quadrant4 == T( 3.0 ) );
+	T SinX = WaveGPXGeo_Select( Swap, CosR, SinR );
+	T CosX = WaveGPXGeo_Select( Swap, SinR, CosR );
+	Sin = WaveGPXGeo_Select( Quadrant4 >= T( 2.0 ), -SinX, SinX );
+	Cos = WaveGPXGeo_Select( ( Quadrant4 == T( 1.0 ) ) | ( Quadrant4 == T( 2.0 ) ), -CosX, CosX );
+}
+
+template< typename T >
+static T WaveGPXGeo_Atan2( T Y, T X )
+{
+	// Fold into atan( 0..1 ), then halve the angle twice with atan( x ) = 2 atan( x / ( 1 + sqrt( 1 + x^2 ) ) ).
+	T AbsX = WaveGPXGeo_Abs( X );
+	T AbsY = WaveGPXGeo_Abs( Y );
+	auto Swap = AbsY > AbsX;
+	T Num = WaveGPXGeo_Select( Swap, AbsX, AbsY );
+	T Den = WaveGPXGeo_Select( Swap, AbsY, AbsX );
+	T Tan = WaveGPXGeo_Select( Den > T( 0.0 ), Num / Den, T( 0.0 ) );
+	Tan = Tan / ( 1.0 + WaveGPXGeo_Sqrt( 1.0 + Tan * Tan ) );
+	Tan = Tan / ( 1.0 + WaveGPXGeo_Sqrt( 1.0 + Tan * Tan ) );
+	T Angle = 4.0 * ( Tan * WaveGPXGeo_Poly( Tan * Tan, s_WaveGPXGeo_AtanCoeffs, 11 ) );
+
+	Angle = WaveGPXGeo_Select( Swap, ( WAVEGPX_GEO_PI / 2.0 ) - Angle, Angle );
+	Angle = WaveGPXGeo_Select( X < T( 0.0 ), WAVEGPX_GEO_PI - Angle, Angle );
+	return WaveGPXGeo_Select( Y < T( 0.0 ), -Angle, Angle );
+}
+
+template< typename T >
+static void WaveGPXGeo_LLAToECEFLanes( T Lat, T Lon, T Alt, T& X, T& Y, T& Z )
+{
+	T SinLat, CosLat, SinLon, CosLon;
+	WaveGPXGeo_SinCos( Lat * ( WAVEGPX_GEO_PI / 180.0 ), SinLat, CosLat );
+	WaveGPXGeo_SinCos( Lon * ( WAVEGPX_GEO_PI / 180.0 ), SinLon, CosLon );
+	T Xi = WaveGPXGeo_Sqrt( 1.0 - WAVEGPX_GEO_FIRST_ECCENTRICITY_SQUARED * SinLat * SinLat );
+	X = ( WAVEGPX_GEO_SEMIMAJOR_AXIS / Xi + Alt ) * CosLat * CosLon;
+	Y = ( WAVEGPX_GEO_SEMIMAJOR_AXIS / Xi + Alt ) * CosLat * SinLon;
+	Z = ( WAVEGPX_GEO_SEMIMAJOR_AXIS / Xi * ( 1.0 - WAVEGPX_GEO_FIRST_ECCENTRICITY_SQUARED ) + Alt ) * SinLat;
+}
+
+// Same closed form as WaveGPXGeo_ECEFToLLALibm.
+template< typename T >
+static void WaveGPXGeo_ECEFToLLALanes( T X, T Y, T Z, T& Lat, T& Lon, T& Alt )
+{
+	const double A = WAVEGPX_GEO_SEMIMAJOR_AXIS;
+	const double B = WAVEGPX_GEO_SEMIMINOR_AXIS;
+	const double E2 = WAVEGPX_GEO_FIRST_ECCENTRICITY_SQUARED;
+	const double Esq = A * A - B * B;
+
+	T R = WaveGPXGeo_Sqrt( X * X + Y * Y );
+	T F = 54.0 * B * B * Z * Z;
+	T G = R * R + ( 1.0 - E2 ) * Z * Z - E2 * Esq;
+	T C = ( E2 * E2 * F * R * R ) / ( G * G * G );
+	T CubeOf = 1.0 + C + WaveGPXGeo_Sqrt( C * C + 2.0 * C );
+
+	// Anywhere near the surface CubeOf is only just over 1, so a few Newton steps from its series find the cube root.
+	auto Valid = ( CubeOf >= T( 1.0 ) ) & ( CubeOf <= T( 2.0 ) );
+	T Over = CubeOf - 1.0;
+	T S = 1.0 + Over * ( ( 1.0 / 3.0 ) - Over * ( 1.0 / 9.0 ) );
+	for ( int i = 0; i < 4; i++ ) {
+		S = ( 2.0 * S + CubeOf / ( S * S ) ) * ( 1.0 / 3.0 );
+	}
+
+	T SSum = S + 1.0 / S + 1.0;
+	T P = F / ( 3.0 * ( SSum * SSum ) * G * G );
+	T Q = WaveGPXGeo_Sqrt( 1.0 + 2.0 * E2 * E2 * P );
+	T R0 = -( P * E2 * R ) / ( 1.0 + Q )
+		+ WaveGPXGeo_Sqrt( 0.5 * A * A * ( 1.0 + 1.0 / Q ) - P * ( 1.0 - E2 ) * Z * Z / ( Q * ( 1.0 + Q ) ) - 0.5 * P * R * R );
+	T RE = R - E2 * R0;
+	T U = WaveGPXGeo_Sqrt( RE * RE + Z * Z );
+	T V = WaveGPXGeo_Sqrt( RE * RE + ( 1.0 - E2 ) * Z * Z );
+	T Z0 = B * B * Z / ( A * V );
+	Alt = U * ( 1.0 - B * B / ( A * V ) );
+	Lat = WaveGPXGeo_Atan2( Z + WAVEGPX_GEO_SECOND_ECCENTRICITY_SQUARED * Z0, R ) * ( 180.0 / WAVEGPX_GEO_PI );
+	Lon = WaveGPXGeo_Atan2( Y, X ) * ( 180.0 / WAVEGPX_GEO_PI );
+
+	// Deep underground, in orbit, or not a number at all. Leave those to the scalar version.
+	int ValidBits = WaveGPXGeo_MaskBits( Valid );
+	const int Width = WaveGPXGeoLanes< T >::Width;
+	if ( ValidBits != ( 1 << Width ) - 1 ) {
+		double In[3][ Width ], Out[3][ Width ];
+		WaveGPXGeoLanes< T >::Store( In[0], X );
+		WaveGPXGeoLanes< T >::Store( In[1], Y );
+		WaveGPXGeoLanes< T >::Store( In[2], Z );
+		WaveGPXGeoLanes< T >::Store( Out[0], Lat );
+		WaveGPXGeoLanes< T >::Store( Out[1], Lon );
+		WaveGPXGeoLanes< T >::Store( Out[2], Alt );
+		for ( int Lane = 0; Lane < Width; Lane++ ) {
+			if ( !( ValidBits & ( 1 << Lane ) ) ) {
+				WaveGPXGeo_ECEFToLLALibm( In[0][ Lane ], In[1][ Lane ], In[2][ Lane ], Out[0][ Lane ], Out[1][ Lane ], Out[2][ Lane ] );
+			}
+		}
+		Lat = WaveGPXGeoLanes< T >::Load( Out[0] );
+		Lon = WaveGPXGeoLanes< T >::Load( Out[1] );
+		Alt = WaveGPXGeoLanes< T >::Load( Out[2] );
+	}
+}
+
+template< typename T >
+static void WaveGPXGeo_ECEFToENULanes( const FWaveGPXGeoFrame& Frame, T X, T Y, T Z, T& East, T& North, T& Up )
+{
+	X = X - Frame.OriginECEF[0];
+	Y = Y - Frame.OriginECEF[1];
+	Z = Z - Frame.OriginECEF[2];
+
+	auto M = Frame.ECEFToNED;
+	North = M[0] * X + M[1] * Y + M[2] * Z;
+	East = M[3] * X + M[4] * Y + M[5] * Z;
+	Up = M[6] * X + M[7] * Y + M[8] * Z;
+}
+
+template< typename T >
+static void WaveGPXGeo_ENUToECEFLanes( const FWaveGPXGeoFrame& Frame, T East, T North, T Up, T& X, T& Y, T& Z )
+{
+	auto M = Frame.NEDToECEF;
+	X = M[0] * North + M[1] * East + M[2] * Up + Frame.OriginECEF[0];
+	Y = M[3] * North + M[4] * East + M[5] * Up + Frame.OriginECEF[1];
+	Z = M[6] * North + M[7] * East + M[8] * Up + Frame.OriginECEF[2];
+}
+
+// ----- Conversions -----
+
+void WaveGPXGeo_InitFrame( FWaveGPXGeoFrame& Frame, double Lat, double Lon, double Alt )
+{
+	Frame.OriginLat = Lat;
+	Frame.OriginLon = Lon;
+	Frame.OriginAlt = Alt;
+	WaveGPXGeo_LLAToECEF( Lat, Lon, Alt, Frame.OriginECEF[0], Frame.OriginECEF[1], Frame.OriginECEF[2] );
+
+	// ECEF to NED uses the geocentric latitude of the origin, NED to ECEF the geodetic one, as the converter does.
+	double LonRad = WaveGPXGeo_DegToRad( Lon );
+	double PhiP = atan2( Frame.OriginECEF[2], sqrt( pow( Frame.OriginECEF[0], 2 ) + pow( Frame.OriginECEF[1], 2 ) ) );
+	WaveGPXGeo_MakeNedRotation( PhiP, LonRad, Frame.ECEFToNED );
+
+	double NEDRotation[9];
+	WaveGPXGeo_MakeNedRotation( WaveGPXGeo_DegToRad( Lat ), LonRad, NEDRotation );
+	for ( int Row = 0; Row < 3; Row++ ) {
+		for ( int Col = 0; Col < 3; Col++ ) {
+			Frame.NEDToECEF[ Row * 3 + Col ] = NEDRotation[ Col * 3 + Row ];
+		}
+	}
+	Frame.Valid = true;
+}
+
+void WaveGPXGeo_LLAToECEF( double Lat, double Lon, double Alt, double& X, double& Y, double& Z )
+{
+	WaveGPXGeo_LLAToECEFLanes( Lat, Lon, Alt, X, Y, Z );
+}
+
+void WaveGPXGeo_ECEFToLLA( double X, double Y, double Z, double& Lat, double& Lon, double& Alt )
+{
+	WaveGPXGeo_ECEFToLLALanes( X, Y, Z, Lat, Lon, Alt );
+}
+
+void WaveGPXGeo_ECEFToENU( const FWaveGPXGeoFrame& Frame, double X, double Y, double Z, double& East, double& North, double& Up )
+{
+	WaveGPXGeo_ECEFToENULanes( Frame, X, Y, Z, East, North, Up );
+}
+
+void WaveGPXGeo_ENUToECEF( const FWaveGPXGeoFrame& Frame, double East, double North, double Up, double& X, double& Y, double& Z )
+{
+	WaveGPXGeo_ENUToECEFLanes( Frame, East, North, Up, X, Y, Z );
+}
+
+void WaveGPXGeo_LLAToENU( const FWaveGPXGeoFrame& Frame, double Lat, double Lon, double Alt, double& East, double& North, double& Up )
+{
+	double X, Y, Z;
+	WaveGPXGeo_LLAToECEF( Lat, Lon, Alt, X, Y, Z );
+	WaveGPXGeo_ECEFToENU( Frame, X, Y, Z, East, North, Up );
+}
+
+void WaveGPXGeo_ENUToLLA( const FWaveGPXGeoFrame& Frame, double East, double North, double Up, double& Lat, double& Lon, double& Alt )
+{
+	double X, Y, Z;
+	WaveGPXGeo_ENUToECEF( Frame, East, North, Up, X, Y, Z );
+	WaveGPXGeo_ECEFToLLA( X, Y, Z, Lat, Lon, Alt );
+}
+
+// Runs Func over Count points, a full set of lanes at a time.
+template< typename T, typename FuncType >
+static void WaveGPXGeo_MapLanes( const double* InA, const double* InB, const double* InC, double* OutA, double* OutB, double* OutC, size_t Count, FuncType Func )
+{
+	typedef WaveGPXGeoLanes< T > Lanes;
+	size_t i = 0;
+	for ( ; i + Lanes::Width <= Count; i += Lanes::Width ) {
+		T A, B, C;
+		Func( Lanes::Load( InA + i ), Lanes::Load( InB + i ), Lanes::Load( InC + i ), A, B, C );
+		Lanes::Store( OutA + i, A );
+		Lanes::Store( OutB + i, B );
+		Lanes::Store( OutC + i, C );
+	}
+	if ( i == Count ) {
+		return;
+	}
+
+	// Pad the last few out by repeating the last point, so they get exactly the same maths as the rest.
+	double Pad[6][ Lanes::Width ];
+	for ( int Lane = 0; Lane < Lanes::Width; Lane++ ) {
+		size_t Src = std::min( i + Lane, Count - 1 );
+		Pad[0][ Lane ] = InA[ Src ];
+		Pad[1][ Lane ] = InB[ Src ];
+		Pad[2][ Lane ] = InC[ Src ];
+	}
+	T A, B, C;
+	Func( Lanes::Load( Pad[0] ), Lanes::Load( Pad[1] ), Lanes::Load( Pad[2] ), A, B, C );
+	Lanes::Store( Pad[3], A );
+	Lanes::Store( Pad[4], B );
+	Lanes::Store( Pad[5], C );
+	for ( size_t Lane = 0; i + Lane < Count; Lane++ ) {
+		OutA[ i + Lane ] = Pad[3][ Lane ];
+		OutB[ i + Lane ] = Pad[4][ Lane ];
+		OutC[ i + Lane ] = Pad[5][ Lane ];
+	}
+}
+
+// Widest lanes the CPU has.
+template< typename FuncType >
+static void WaveGPXGeo_Map( const double* InA, const double* InB, const double* InC, double* OutA, double* OutB, double* OutC, size_t Count, FuncType Func )
+{
+#ifdef WAVEGPX_GEO_AVX
+	if ( s_WaveGPXGeo_HasAVX ) {
+		WaveGPXGeo_MapLanes< WaveGPXGeoAVX >( InA, InB, InC, OutA, OutB, OutC, Count, Func );
+		return;
+	}
+#endif
+#ifdef WAVEGPX_GEO_SSE2
+	WaveGPXGeo_MapLanes< WaveGPXGeoSSE2 >( InA, InB, InC, OutA, OutB, OutC, Count, Func );
+#else
+	WaveGPXGeo_MapLanes< double >( InA, InB, InC, OutA, OutB, OutC, Count, Func );
+#endif
+}
+
+void WaveGPXGeo_LLAToECEF( const double* Lat, const double* Lon, const double* Alt, double* X, double* Y, double* Z, size_t Count )
+{
+	WaveGPXGeo_Map( Lat, Lon, Alt, X, Y, Z, Count, []( auto InLat, auto InLon, auto InAlt, auto& OutX, auto& OutY, auto& OutZ )
+	{
+		WaveGPXGeo_LLAToECEFLanes( InLat, InLon, InAlt, OutX, OutY, OutZ );
+	} );
+}
+
+void WaveGPXGeo_ECEFToLLA( const double* X, const double* Y, const double* Z, double* Lat, double* Lon, double* Alt, size_t Count )
+{
+	WaveGPXGeo_Map( X, Y, Z, Lat, Lon, Alt, Count, []( auto InX, auto InY, auto InZ, auto& OutLat, auto& OutLon, auto& OutAlt )
+	{
+		WaveGPXGeo_ECEFToLLALanes( InX, InY, InZ, OutLat, OutLon, OutAlt );
+	} );
+}
+
+void WaveGPXGeo_ECEFToENU( const FWaveGPXGeoFrame& Frame, const double* X, const double* Y, const double* Z, double* East, double* North, double* Up, size_t Count )
+{
+	WaveGPXGeo_Map( X, Y, Z, East, North, Up, Count, [ & ]( auto InX, auto InY, auto InZ, auto& OutEast, auto& OutNorth, auto& OutUp )
+	{
+		WaveGPXGeo_ECEFToENULanes( Frame, InX, InY, InZ, OutEast, OutNorth, OutUp );
+	} );
+}
+
+void WaveGPXGeo_ENUToECEF( const FWaveGPXGeoFrame& Frame, const double* East, const double* North, const double* Up, double* X, double* Y, double* Z, size_t Count )
+{
+	WaveGPXGeo_Map( East, North, Up, X, Y, Z, Count, [ & ]( auto InEast, auto InNorth, auto InUp, auto& OutX, auto& OutY, auto& OutZ )
+	{
+		WaveGPXGeo_ENUToECEFLanes( Frame, InEast, InNorth, InUp, OutX, OutY, OutZ );
+	} );
+}
+
+void WaveGPXGeo_LLAToENU( const FWaveGPXGeoFrame& Frame, const double* Lat, const double* Lon, const double* Alt, double* East, double* North, double* Up, size_t Count )
+{
+	WaveGPXGeo_Map( Lat, Lon, Alt, East, North, Up, Count, [ & ]( auto InLat, auto InLon, auto InAlt, auto& OutEast, auto& OutNorth, auto& OutUp )
+	{
+		decltype( InLat ) X, Y, Z;
+		WaveGPXGeo_LLAToECEFLanes( InLat, InLon, InAlt, X, Y, Z );
+		WaveGPXGeo_ECEFToENULanes( Frame, X, Y, Z, OutEast, OutNorth, OutUp );
+	} );
+}
+
+void WaveGPXGeo_ENUToLLA( const FWaveGPXGeoFrame& Frame, const double* East, const double* North, const double* Up, double* Lat, double* Lon, double* Alt, size_t Count )
+{
+	WaveGPXGeo_Map( East, North, Up, Lat, Lon, Alt, Count, [ & ]( auto InEast, auto InNorth, auto InUp, auto& OutLat, auto& OutLon, auto& OutAlt )
+	{
+		decltype( InEast ) X, Y, Z;
+		WaveGPXGeo_ENUToECEFLanes( Frame, InEast, InNorth, InUp, X, Y, Z );
+		WaveGPXGeo_ECEFToLLALanes( X, Y, Z, OutLat, OutLon, OutAlt );
+	} );
+}
+
+const FWaveGPXGeoFrame& WaveRouteUtil_GetGeoFrame( const FWaveGPXRoute& Route, FWaveGPXGeoFrame& Temp )
+{
+	if ( Route.Points.empty() ) {
+		Temp = FWaveGPXGeoFrame();
+		return Temp;
+	}
+	auto& Origin = Route.Points[0];
+	auto& Frame = Route.GeoFrame;
+	if ( Frame.Valid && Frame.OriginLat == Origin.Lat && Frame.OriginLon == Origin.Lon && Frame.OriginAlt == Origin.Alt )
+		return Frame;
+	WaveGPXGeo_InitFrame( Temp, Origin.Lat, Origin.Lon, Origin.Alt );
+	return Temp;
+}
+
+void WaveRouteUtil_FillENUFromLLA( const FWaveGPXRoute& Route, FWaveGPXPoint* Points, size_t NumPoints )
+{
+	FWaveGPXGeoFrame Temp;
+	auto& Frame = WaveRouteUtil_GetGeoFrame( Route, Temp );
+	if ( !Frame.Valid )
+		return;
+	double A[ WAVEGPX_GEO_BLOCK ], B[ WAVEGPX_GEO_BLOCK ], C[ WAVEGPX_GEO_BLOCK ];
+	for ( size_t Start = 0; Start < NumPoints; Start += WAVEGPX_GEO_BLOCK ) {
+		size_t Count = std::min( NumPoints - Start, ( size_t ) WAVEGPX_GEO_BLOCK );
+		auto P = Points + Start;
+		for ( size_t i = 0; i < Count; i++ ) {
+			A[i] = P[i].Lat;
+			B[i] = P[i].Lon;
+			C[i] = P[i].Alt;
+		}
+		WaveGPXGeo_LLAToENU( Frame, A, B, C, A, B, C, Count );
+		for ( size_t i = 0; i < Count; i++ ) {
+			P[i].East = A[i];
+			P[i].North = B[i];
+			P[i].Up = C[i];
+		}
+	}
+}
+
+void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint* Points, size_t NumPoints )
+{
+	FWaveGPXGeoFrame Temp;
+	auto& Frame = WaveRouteUtil_GetGeoFrame( Route, Temp );
+	if ( !Frame.Valid )
+		return;
+	double A[ WAVEGPX_GEO_BLOCK ], B[ WAVEGPX_GEO_BLOCK ], C[ WAVEGPX_GEO_BLOCK ];
+	for ( size_t Start = 0; Start < NumPoints; Start += WAVEGPX_GEO_BLOCK ) {
+		size_t Count = std::min( NumPoints - Start, ( size_t ) WAVEGPX_GEO_BLOCK );
+		auto P = Points + Start;
+		for ( size_t i = 0; i < Count; i++ ) {
+			A[i] = P[i].East;
+			B[i] = P[i].North;
+			C[i] = P[i].Up;
+		}
+		WaveGPXGeo_ENUToLLA( Frame, A, B, C, A, B, C, Count );
+		for ( size_t i = 0; i < Count; i++ ) {
+			P[i].Lat = A[i];
+			P[i].Lon = B[i];
+			P[i].Alt = C[i];
+		}
+	}
+}
+
+void WaveRouteUtil_FillENUFromLLA( const FWaveGPXRoute& Route, FWaveGPXPoint& Point )
+{
+	WaveRouteUtil_FillENUFromLLA( Route, &Point, 1 );
+}
+
+void WaveRouteUtil_FillLLAFromENU( const FWaveGPXRoute& Route, FWaveGPXPoint& Point )
+{
+	WaveRouteUtil_FillLLAFromENU( Route, &Point, 1 );
+}
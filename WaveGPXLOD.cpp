@@ -0,0 +1,194 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "WaveGPX.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Position at Dist on the segment ending at Points[ Next ], or the last point past the end.
+static FWaveGPXPoint WaveGPXLOD_PointAtDist( const std::vector< FWaveGPXPoint >& Points, size_t Next, double Dist )
+{
+	if ( Next >= Points.size() ) {
+		return Points.back();
+	}
+
+	auto& PointA = Points[ Next - 1 ];
+	auto& PointB = Points[ Next ];
+	double InterpRun = PointB.Dist - PointA.Dist;
+	double InterpX = std::clamp( ( Dist - PointA.Dist ) / ( InterpRun > 0.01 ? InterpRun : 0.01 ), 0.0, 1.0 );
+	FWaveGPXPoint Point;
+	Point.Dist = Dist;
+	Point.East = PointA.East + ( PointB.East - PointA.East ) * InterpX;
+	Point.North = PointA.North + ( PointB.North - PointA.North ) * InterpX;
+	Point.Alt = PointA.Alt + ( PointB.Alt - PointA.Alt ) * InterpX;
+	return Point;
+}
+
+// How much of the route bucket Index covers, at BucketSize. Only the last bucket of a level can be short.
+static double WaveGPXLOD_BucketCover( const FWaveGPXLODPyramid& Pyramid, double BucketSize, size_t Index )
+{
+	return std::max( std::min( ( Index + 1 ) * BucketSize, Pyramid.Length ) - Index * BucketSize, 0.0 );
+}
+
+// Combines buckets, weighting averages by how much of the route each one stands for.
+struct WaveGPXLODAccumulator
+{
+	FWaveGPXLODBucket Bucket;
+	double AltSum = 0.0;
+	double GradeSum = 0.0;
+	double Weight = 0.0;
+	bool Empty = true;
+
+	void Add( const FWaveGPXLODBucket& Other, double OtherWeight )
+	{
+		if ( Empty ) {
+			Bucket = Other;
+			Empty = false;
+		} else {
+			Bucket.MinAlt = std::min( Bucket.MinAlt, Other.MinAlt );
+			Bucket.MaxAlt = std::max( Bucket.MaxAlt, Other.MaxAlt );
+			Bucket.MinGrade = std::min( Bucket.MinGrade, Other.MinGrade );
+			Bucket.MaxGrade = std::max( Bucket.MaxGrade, Other.MaxGrade );
+		}
+		AltSum += Other.AvgAlt * OtherWeight;
+		GradeSum += Other.AvgGrade * OtherWeight;
+		Weight += OtherWeight;
+	}
+
+	// With no weight at all ( off the end of the route, say ) the first bucket's averages stand.
+	FWaveGPXLODBucket Get() const
+	{
+		FWaveGPXLODBucket Result = Bucket;
+		if ( Weight > 0.0 ) {
+			Result.AvgAlt = ( float ) ( AltSum / Weight );
+			Result.AvgGrade = ( float ) ( GradeSum / Weight );
+		}
+		return Result;
+	}
+};
+
+void WaveRouteUtil_BuildLODPyramid( const FWaveGPXRoute& Route, FWaveGPXLODPyramid& Pyramid, float MinBucketSize )
+{
+	Pyramid = FWaveGPXLODPyramid();
+	auto& Points = Route.Points;
+	if ( Points.size() <= 0 ) {
+		return;
+	}
+
+	Pyramid.NumPoints = Points.size();
+	Pyramid.Length = std::max( Points.back().Dist, 0.0 );
+	Pyramid.BucketSize = std::max( { Pyramid.Length / Points.size(), ( double ) MinBucketSize, 0.01 } );
+	size_t NumBuckets = std::max( ( size_t ) ceil( Pyramid.Length / Pyramid.BucketSize ), ( size_t ) 1 );
+
+	// Level 0 in one walk along the points, each bucket starting where the last one ended. Altitude is linear between
+	// points, so its extremes are at points or bucket edges and its average is a sum of trapezoids.
+	std::vector< FWaveGPXLODBucket > Level( NumBuckets );
+	size_t Next = 1;
+	FWaveGPXPoint Start = Points[0];
+	for ( size_t i = 0; i < NumBuckets; i++ ) {
+		double StartDist = i * Pyramid.BucketSize;
+		double EndDist = std::min( ( i + 1 ) * Pyramid.BucketSize, Pyramid.Length );
+		auto& Bucket = Level[i];
+		Bucket.MinAlt = Bucket.MaxAlt = ( float ) Start.Alt;
+
+		double Area = 0.0, PrevDist = StartDist, PrevAlt = Start.Alt;
+		for ( ; Next < Points.size() && Points[ Next ].Dist < EndDist; Next++ ) {
+			auto& Point = Points[ Next ];
+			Area += ( Point.Alt + PrevAlt ) * 0.5 * ( Point.Dist - PrevDist );
+			Bucket.MinAlt = std::min( Bucket.MinAlt, ( float ) Point.Alt );
+			Bucket.MaxAlt = std::max( Bucket.MaxAlt, ( float ) Point.Alt );
+			PrevDist = Point.Dist;
+			PrevAlt = Point.Alt;
+		}
+		auto End = WaveGPXLOD_PointAtDist( Points, Next, EndDist );
+		Area += ( End.Alt + PrevAlt ) * 0.5 * ( EndDist - PrevDist );
+		Bucket.MinAlt = std::min( Bucket.MinAlt, ( float ) End.Alt );
+		Bucket.MaxAlt = std::max( Bucket.MaxAlt, ( float ) End.Alt );
+		Bucket.AvgAlt = ( float ) ( EndDist > StartDist ? Area / ( EndDist - StartDist ) : Start.Alt );
+		Bucket.MinGrade = Bucket.MaxGrade = Bucket.AvgGrade = WaveRouteUtil_GradeBetween( Start, End );
+		Start = End;
+	}
+	Pyramid.Levels.push_back( std::move( Level ) );
+
+	// Every level after that pairs up the buckets of the one before.
+	double BucketSize = Pyramid.BucketSize;
+	while ( Pyramid.Levels.back().size() > 1 ) {
+		auto& Below = Pyramid.Levels.back();
+		std::vector< FWaveGPXLODBucket > Above( ( Below.size() + 1 ) / 2 );
+		for ( size_t i = 0; i < Above.size(); i++ ) {
+			WaveGPXLODAccumulator Accumulator;
+			for ( size_t j = i * 2; j < std::min( i * 2 + 2, Below.size() ); j++ ) {
+				Accumulator.Add( Below[j], WaveGPXLOD_BucketCover( Pyramid, BucketSize, j ) );
+			}
+			Above[i] = Accumulator.Get();
+		}
+		Pyramid.Levels.push_back( std::move( Above ) );
+		BucketSize *= 2.0;
+	}
+}
+
+void WaveRouteUtil_GetLODView( const FWaveGPXLODPyramid& Pyramid, float StartDist, float EndDist, FWaveGPXLODBucket* Pixels, size_t NumPixels )
+{
+	if ( NumPixels <= 0 ) {
+		return;
+	}
+	if ( Pyramid.Levels.size() <= 0 ) {
+		std::fill( Pixels, Pixels + NumPixels, FWaveGPXLODBucket() );
+		return;
+	}
+
+	// The coarsest level whose buckets still fit in a pixel, so each pixel takes in at most three of them.
+	double PixelSize = ( ( double ) EndDist - StartDist ) / NumPixels;
+	size_t LevelIndex = 0;
+	double BucketSize = Pyramid.BucketSize;
+	while ( LevelIndex + 1 < Pyramid.Levels.size() && BucketSize * 2.0 <= fabs( PixelSize ) ) {
+		LevelIndex++;
+		BucketSize *= 2.0;
+	}
+	auto& Level = Pyramid.Levels[ LevelIndex ];
+
+	for ( size_t i = 0; i < NumPixels; i++ ) {
+		double PixelA = StartDist + i * PixelSize;
+		double PixelB = StartDist + ( i + 1 ) * PixelSize;
+		double Lo = std::min( PixelA, PixelB ), Hi = std::max( PixelA, PixelB );
+		size_t First = ( size_t ) std::clamp( floor( Lo / BucketSize ), 0.0, ( double ) ( Level.size() - 1 ) );
+		size_t Last = ( size_t ) std::clamp( ceil( Hi / BucketSize ) - 1.0, ( double ) First, ( double ) ( Level.size() - 1 ) );
+
+		WaveGPXLODAccumulator Accumulator;
+		for ( size_t j = First; j <= Last; j++ ) {
+			double Overlap = std::min( { Hi, ( j + 1 ) * BucketSize, Pyramid.Length } ) - std::max( Lo, j * BucketSize );
+			Accumulator.Add( Level[j], std::max( Overlap, 0.0 ) );
+		}
+		Pixels[i] = Accumulator.Get();
+	}
+}
+
+void WaveRouteUtil_GetLODView( const FWaveGPXRoute& Route, float StartDist, float EndDist, FWaveGPXLODBucket* Pixels, size_t NumPixels )
+{
+	if ( Route.LODPyramid.NumPoints == Route.Points.size() && Route.LODPyramid.Levels.size() ) {
+		WaveRouteUtil_GetLODView( Route.LODPyramid, StartDist, EndDist, Pixels, NumPixels );
+		return;
+	}
+
+	FWaveGPXLODPyramid Pyramid;
+	WaveRouteUtil_BuildLODPyramid( Route, Pyramid );
+	WaveRouteUtil_GetLODView( Pyramid, StartDist, EndDist, Pixels, NumPixels );
+}
@@ -0,0 +1,115 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WaveGPX.h"
+
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+// Distance from P to segment AB in the East / North plane.
+static double WaveGPXSimplify_HorizontalDist( const FWaveGPXPoint& P, const FWaveGPXPoint& A, const FWaveGPXPoint& B )
+{
+	double SegEast = B.East - A.East;
+	double SegNorth = B.North - A.North;
+	double SegLengthSq = SegEast * SegEast + SegNorth * SegNorth;
+	double t = 0.0;
+	if ( SegLengthSq > 0.0 ) {
+		t = ( ( P.East - A.East ) * SegEast + ( P.North - A.North ) * SegNorth ) / SegLengthSq;
+		t = std::clamp( t, 0.0, 1.0 );
+	}
+	double DiffEast = P.East - ( A.East + SegEast * t );
+	double DiffNorth = P.North - ( A.North + SegNorth * t );
+	return sqrt( DiffEast * DiffEast + DiffNorth * DiffNorth );
+}
+
+FWaveGPXSimplifyReport WaveRouteUtil_SimplifyPoints( const std::vector< FWaveGPXPoint >& Points, std::vector< FWaveGPXPoint >& SimplifiedPoints, float HorizontalTolerance, float VerticalTolerance )
+{
+	FWaveGPXSimplifyReport Report;
+	int NumPoints = ( int ) Points.size();
+	Report.NumPointsBefore = NumPoints;
+	if ( NumPoints <= 2 ) {
+		SimplifiedPoints = Points;
+		return Report;
+	}
+
+	// Altitude is checked against a straight line over horizontal distance travelled, so a climb that winds
+	// keeps its profile even where the road itself is straight enough to drop.
+	std::vector< double > HorizontalDist( NumPoints, 0.0 );
+	for ( int i = 1; i < NumPoints; i++ ) {
+		double DiffEast = Points[i].East - Points[i - 1].East;
+		double DiffNorth = Points[i].North - Points[i - 1].North;
+		HorizontalDist[i] = HorizontalDist[i - 1] + sqrt( DiffEast * DiffEast + DiffNorth * DiffNorth );
+	}
+
+	double InvHorizontalTolerance = 1.0 / std::max( HorizontalTolerance, 0.001f );
+	double InvVerticalTolerance = 1.0 / std::max( VerticalTolerance, 0.001f );
+
+	// Explicit stack rather than recursion, recorded rides can be a million points long.
+	std::vector< char > Keep( NumPoints, 0 );
+	Keep[0] = Keep[ NumPoints - 1 ] = 1;
+	std::vector< std::pair< int, int > > Stack;
+	Stack.push_back( { 0, NumPoints - 1 } );
+	while ( Stack.size() ) {
+		auto [ First, Last ] = Stack.back();
+		Stack.pop_back();
+		if ( Last - First < 2 )
+			continue;
+
+		auto& A = Points[ First ];
+		auto& B = Points[ Last ];
+		double Run = HorizontalDist[ Last ] - HorizontalDist[ First ];
+
+		int WorstIndex = -1;
+		double WorstError = 1.0;
+		double MaxHorizontal = 0.0, MaxVertical = 0.0;
+		for ( int i = First + 1; i < Last; i++ ) {
+			double t = ( Run > 0.0 ) ? ( HorizontalDist[i] - HorizontalDist[ First ] ) / Run : 0.0;
+			double Horizontal = WaveGPXSimplify_HorizontalDist( Points[i], A, B );
+			double Vertical = fabs( Points[i].Alt - ( A.Alt + ( B.Alt - A.Alt ) * t ) );
+			double Error = std::max( Horizontal * InvHorizontalTolerance, Vertical * InvVerticalTolerance );
+			if ( Error > WorstError ) {
+				WorstError = Error;
+				WorstIndex = i;
+			}
+			MaxHorizontal = std::max( MaxHorizontal, Horizontal );
+			MaxVertical = std::max( MaxVertical, Vertical );
+		}
+
+		if ( WorstIndex >= 0 ) {
+			Keep[ WorstIndex ] = 1;
+			Stack.push_back( { First, WorstIndex } );
+			Stack.push_back( { WorstIndex, Last } );
+		} else {
+			// Everything between First and Last is dropped, so this segment is the final one.
+			Report.MaxHorizontalDeviation = std::max( Report.MaxHorizontalDeviation, ( float ) MaxHorizontal );
+			Report.MaxVerticalDeviation = std::max( Report.MaxVerticalDeviation, ( float ) MaxVertical );
+		}
+	}
+
+	SimplifiedPoints.clear();
+	SimplifiedPoints.reserve( std::count( Keep.begin(), Keep.end(), 1 ) );
+	for ( int i = 0; i < NumPoints; i++ ) {
+		if ( Keep[i] ) {
+			SimplifiedPoints.push_back( Points[i] );
+		}
+	}
+	Report.NumPointsRemoved = NumPoints - ( int ) SimplifiedPoints.size();
+	return Report;
+}
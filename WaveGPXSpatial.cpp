@@ -0,0 +1,255 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WaveGPX.h"
+
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+#include <utility>
+
+// Within this many metres of the nearest, a segment closer along the route to HintDist wins.
+#define WAVEGPX_SPATIAL_HINT_TIE_DIST 2.0
+
+static uint64_t WaveGPXSpatial_CellKey( int CellX, int CellY )
+{
+	return ( ( uint64_t ) ( uint32_t ) CellX << 32 ) | ( uint64_t ) ( uint32_t ) CellY;
+}
+
+void WaveRouteUtil_BuildSpatialIndex( FWaveGPXRoute& Route, float CellSize )
+{
+	auto& Index = Route.SpatialIndex;
+	Index = FWaveGPXSpatialIndex();
+	Index.CellSize = CellSize;
+	Index.NumPoints = Route.Points.size();
+	if ( Route.Points.size() < 2 || CellSize <= 0.0f )
+		return;
+	Index.MinCellX = Index.MinCellY = INT_MAX;
+	Index.MaxCellX = Index.MaxCellY = INT_MIN;
+
+	// Walk each segment through the grid cell by cell ( Amanatides & Woo ), so long segments only land in the
+	// cells they actually cross rather than their whole bounding box.
+	std::vector< std::pair< uint64_t, uint32_t > > Entries;
+	Entries.reserve( Route.Points.size() * 2 );
+	double InvCellSize = 1.0 / CellSize;
+	for ( uint32_t i = 0; i + 1 < ( uint32_t ) Route.Points.size(); i++ ) {
+		double X0 = Route.Points[i].East * InvCellSize, Y0 = Route.Points[i].North * InvCellSize;
+		double X1 = Route.Points[i + 1].East * InvCellSize, Y1 = Route.Points[i + 1].North * InvCellSize;
+		int StartCellX = ( int ) floor( X0 ), StartCellY = ( int ) floor( Y0 );
+		int EndCellX = ( int ) floor( X1 ), EndCellY = ( int ) floor( Y1 );
+
+		double DiffX = X1 - X0, DiffY = Y1 - Y0;
+		int StepX = DiffX > 0.0 ? 1 : -1;
+		int StepY = DiffY > 0.0 ? 1 : -1;
+		double DeltaX = DiffX != 0.0 ? 1.0 / fabs( DiffX ) : DBL_MAX;
+		double DeltaY = DiffY != 0.0 ? 1.0 / fabs( DiffY ) : DBL_MAX;
+		double NextX = DiffX != 0.0 ? ( StepX > 0 ? StartCellX + 1 - X0 : X0 - StartCellX ) * DeltaX : DBL_MAX;
+		double NextY = DiffY != 0.0 ? ( StepY > 0 ? StartCellY + 1 - Y0 : Y0 - StartCellY ) * DeltaY : DBL_MAX;
+
+		int CellX = StartCellX, CellY = StartCellY;
+		int NumSteps = abs( EndCellX - CellX ) + abs( EndCellY - CellY );
+		Entries.push_back( { WaveGPXSpatial_CellKey( CellX, CellY ), i } );
+		for ( int Step = 0; Step < NumSteps; Step++ ) {
+			if ( NextX < NextY ) {
+				CellX += StepX;
+				NextX += DeltaX;
+			} else {
+				CellY += StepY;
+				NextY += DeltaY;
+			}
+			Entries.push_back( { WaveGPXSpatial_CellKey( CellX, CellY ), i } );
+		}
+
+		Index.MinCellX = std::min( { Index.MinCellX, StartCellX, EndCellX } );
+		Index.MinCellY = std::min( { Index.MinCellY, StartCellY, EndCellY } );
+		Index.MaxCellX = std::max( { Index.MaxCellX, StartCellX, EndCellX } );
+		Index.MaxCellY = std::max( { Index.MaxCellY, StartCellY, EndCellY } );
+	}
+	std::sort( Entries.begin(), Entries.end() );
+
+	Index.Segments.reserve( Entries.size() );
+	for ( size_t i = 0; i < Entries.size(); i++ ) {
+		auto Key = Entries[i].first;
+		if ( i == 0 || Key != Entries[i - 1].first ) {
+			Index.CellKeys.push_back( Key );
+			Index.CellStart.push_back( ( uint32_t ) Index.Segments.size() );
+		}
+		double CornerEast = ( int32_t ) ( Key >> 32 ) * ( double ) CellSize;
+		double CornerNorth = ( int32_t ) ( Key & 0xffffffff ) * ( double ) CellSize;
+		auto& A = Route.Points[ Entries[i].second ];
+		auto& B = Route.Points[ Entries[i].second + 1 ];
+
+		FWaveGPXSpatialSegment Segment;
+		Segment.StartEast = ( float ) ( A.East - CornerEast );
+		Segment.StartNorth = ( float ) ( A.North - CornerNorth );
+		Segment.EndEast = ( float ) ( B.East - CornerEast );
+		Segment.EndNorth = ( float ) ( B.North - CornerNorth );
+		Segment.Segment = Entries[i].second;
+		Index.Segments.push_back( Segment );
+	}
+	Index.CellStart.push_back( ( uint32_t ) Index.Segments.size() );
+}
+
+// Nearest match so far, plus every near miss that could still win a tie against it.
+struct WaveGPXSpatialQuery
+{
+	const FWaveGPXRoute* Route = nullptr;
+	float HintDist = -1.0f;
+
+	double MinOffRoute = DBL_MAX;
+	double MinDist = 0.0;
+
+	// OffRoute, Dist. Only filled when there is a hint.
+	std::vector< std::pair< double, double > >* Candidates = nullptr;
+
+	// East / North are relative to the same origin as the segment.
+	void CheckSegment( double East, double North, double StartEast, double StartNorth, double EndEast, double EndNorth, uint32_t Segment )
+	{
+		double SegEast = EndEast - StartEast;
+		double SegNorth = EndNorth - StartNorth;
+		double SegLengthSq = SegEast * SegEast + SegNorth * SegNorth;
+		double t = 0.0;
+		if ( SegLengthSq > 0.0 ) {
+			t = std::clamp( ( ( East - StartEast ) * SegEast + ( North - StartNorth ) * SegNorth ) / SegLengthSq, 0.0, 1.0 );
+		}
+		double DiffEast = East - ( StartEast + SegEast * t );
+		double DiffNorth = North - ( StartNorth + SegNorth * t );
+		double OffRouteSq = DiffEast * DiffEast + DiffNorth * DiffNorth;
+		double Radius = SearchRadius();
+		if ( OffRouteSq > Radius * Radius )
+			return;
+
+		// Only near misses get this far, so they can afford to look up the route distance.
+		double OffRoute = sqrt( OffRouteSq );
+		auto& A = Route->Points[ Segment ];
+		auto& B = Route->Points[ Segment + 1 ];
+		double Dist = A.Dist + ( B.Dist - A.Dist ) * t;
+
+		if ( OffRoute < MinOffRoute ) {
+			MinOffRoute = OffRoute;
+			MinDist = Dist;
+		}
+		if ( Candidates ) {
+			Candidates->push_back( { OffRoute, Dist } );
+		}
+	}
+
+	// Anything further than this could still win a tie.
+	double SearchRadius() const
+	{
+		return MinOffRoute + ( Candidates ? WAVEGPX_SPATIAL_HINT_TIE_DIST : 0.0 );
+	}
+
+	// Once the true nearest is known, the candidate within tie distance of it that is closest to HintDist wins.
+	// Judging ties against the final nearest rather than the best so far keeps the answer independent of the
+	// order segments were visited in.
+	void Resolve( double& OffRoute, double& Dist ) const
+	{
+		OffRoute = MinOffRoute;
+		Dist = MinDist;
+		if ( !Candidates )
+			return;
+		for ( auto& Candidate : *Candidates ) {
+			if ( Candidate.first > MinOffRoute + WAVEGPX_SPATIAL_HINT_TIE_DIST )
+				continue;
+			double HintError = fabs( Candidate.second - HintDist );
+			double BestHintError = fabs( Dist - HintDist );
+			if ( HintError < BestHintError || ( HintError == BestHintError && Candidate.first < OffRoute ) ) {
+				OffRoute = Candidate.first;
+				Dist = Candidate.second;
+			}
+		}
+	}
+};
+
+float WaveRouteUtil_FindNearestDistOnRoute( const FWaveGPXRoute& Route, double East, double North, float HintDist, float* OffRouteDist )
+{
+	// Reused between calls, so tracking a position doesn't allocate every frame.
+	static thread_local std::vector< std::pair< double, double > > Candidates;
+	Candidates.clear();
+
+	WaveGPXSpatialQuery Query;
+	Query.Route = &Route;
+	Query.HintDist = HintDist;
+	Query.Candidates = HintDist >= 0.0f ? &Candidates : nullptr;
+
+	uint32_t NumSegments = Route.Points.size() > 1 ? ( uint32_t ) Route.Points.size() - 1 : 0;
+	auto& Index = Route.SpatialIndex;
+	if ( NumSegments == 0 ) {
+		if ( Route.Points.size() ) {
+			Query.MinOffRoute = sqrt( pow( East - Route.Points[0].East, 2.0 ) + pow( North - Route.Points[0].North, 2.0 ) );
+			Query.MinDist = Route.Points[0].Dist;
+		}
+	} else if ( Index.CellKeys.empty() || Index.NumPoints != Route.Points.size() ) {
+		for ( uint32_t i = 0; i < NumSegments; i++ ) {
+			auto& A = Route.Points[i];
+			auto& B = Route.Points[i + 1];
+			Query.CheckSegment( East, North, A.East, A.North, B.East, B.North, i );
+		}
+	} else {
+		// Search outwards a ring of cells at a time. Everything outside ring R is at least
+		// ( R + distance to the edge of the query's own cell ) cells away, so stop once the best match is closer.
+		double X = East / Index.CellSize, Y = North / Index.CellSize;
+		int CellX = ( int ) floor( X ), CellY = ( int ) floor( Y );
+		double EdgeDist = std::min( { X - CellX, CellX + 1 - X, Y - CellY, CellY + 1 - Y } );
+		int MaxRing = std::max( { abs( CellX - Index.MinCellX ), abs( CellX - Index.MaxCellX ), abs( CellY - Index.MinCellY ), abs( CellY - Index.MaxCellY ) } );
+
+		auto VisitCell = [&]( int VisitX, int VisitY )
+		{
+			if ( VisitX < Index.MinCellX || VisitX > Index.MaxCellX || VisitY < Index.MinCellY || VisitY > Index.MaxCellY )
+				return;
+			auto Key = WaveGPXSpatial_CellKey( VisitX, VisitY );
+			auto Itr = std::lower_bound( Index.CellKeys.begin(), Index.CellKeys.end(), Key );
+			if ( Itr == Index.CellKeys.end() || *Itr != Key )
+				return;
+			size_t Cell = Itr - Index.CellKeys.begin();
+			double LocalEast = East - VisitX * ( double ) Index.CellSize;
+			double LocalNorth = North - VisitY * ( double ) Index.CellSize;
+			for ( uint32_t i = Index.CellStart[ Cell ]; i < Index.CellStart[ Cell + 1 ]; i++ ) {
+				auto& Segment = Index.Segments[i];
+				Query.CheckSegment( LocalEast, LocalNorth, Segment.StartEast, Segment.StartNorth, Segment.EndEast, Segment.EndNorth, Segment.Segment );
+			}
+		};
+
+		for ( int Ring = 0; Ring <= MaxRing; Ring++ ) {
+			if ( Ring == 0 ) {
+				VisitCell( CellX, CellY );
+			} else {
+				for ( int i = -Ring; i <= Ring; i++ ) {
+					VisitCell( CellX + i, CellY - Ring );
+					VisitCell( CellX + i, CellY + Ring );
+				}
+				for ( int i = -Ring + 1; i <= Ring - 1; i++ ) {
+					VisitCell( CellX - Ring, CellY + i );
+					VisitCell( CellX + Ring, CellY + i );
+				}
+			}
+			if ( Query.SearchRadius() <= ( Ring + EdgeDist ) * Index.CellSize )
+				break;
+		}
+	}
+
+	double OffRoute = 0.0, Dist = 0.0;
+	Query.Resolve( OffRoute, Dist );
+	if ( OffRouteDist ) {
+		*OffRouteDist = ( float ) OffRoute;
+	}
+	return ( float ) Dist;
+}
@@ -0,0 +1,187 @@
+/*
+	Copyright 2021 Xi Chen (hypernewbie@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+	associated documentation files (the "Software"), to deal in the Software without restriction,
+	including without limitation the rights to use, copy, modify, merge, publish, distribute,
+	sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial
+	portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+	NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+	NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+	DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT
+	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "WaveGPX.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Segments shorter than this, in metres, are GPS stops piling points in one spot, and are left flat.
+#define WAVEGPX_SPLINE_MIN_RUN 0.01
+
+// Slope of Value per metre from Points[i] to Points[i + 1].
+static double WaveGPXSpline_Secant( const std::vector< FWaveGPXPoint >& Points, size_t i, double FWaveGPXPoint::* Value )
+{
+	double Run = Points[ i + 1 ].Dist - Points[i].Dist;
+	return Run > WAVEGPX_SPLINE_MIN_RUN ? ( Points[ i + 1 ].*Value - Points[i].*Value ) / Run : 0.0;
+}
+
+// Slope of Value per metre through Points[i], from the segments either side. Where one side is a stop, the other
+// side's slope carries straight through it.
+static double WaveGPXSpline_Tangent( const std::vector< FWaveGPXPoint >& Points, size_t i, double FWaveGPXPoint::* Value, bool Monotone )
+{
+	if ( i == 0 ) {
+		return WaveGPXSpline_Secant( Points, 0, Value );
+	}
+	if ( i + 1 >= Points.size() ) {
+		return WaveGPXSpline_Secant( Points, Points.size() - 2, Value );
+	}
+
+	double RunA = Points[i].Dist - Points[ i - 1 ].Dist;
+	double RunB = Points[ i + 1 ].Dist - Points[i].Dist;
+	double SlopeA = WaveGPXSpline_Secant( Points, i - 1, Value );
+	double SlopeB = WaveGPXSpline_Secant( Points, i, Value );
+	if ( RunA <= WAVEGPX_SPLINE_MIN_RUN ) {
+		return SlopeB;
+	}
+	if ( RunB <= WAVEGPX_SPLINE_MIN_RUN ) {
+		return SlopeA;
+	}
+
+	// Fritsch-Butland: flat at peaks and dips, and otherwise a weighted harmonic mean that stays under three times
+	// either slope, which is what keeps each segment between its end values.
+	if ( Monotone ) {
+		if ( SlopeA * SlopeB <= 0.0 ) {
+			return 0.0;
+		}
+		double WeightA = 2.0 * RunB + RunA;
+		double WeightB = RunB + 2.0 * RunA;
+		return ( WeightA + WeightB ) / ( WeightA / SlopeA + WeightB / SlopeB );
+	}
+	return ( RunB * SlopeA + RunA * SlopeB ) / ( RunA + RunB );
+}
+
+// Hermite cubic from ValueA to ValueB over Run metres, leaving and arriving at the given slopes.
+static void WaveGPXSpline_Fit( double Run, double ValueA, double ValueB, double TangentA, double TangentB, float* Coeffs )
+{
+	double Slope = ( ValueB - ValueA ) / Run;
+	Coeffs[0] = ( float ) TangentA;
+	Coeffs[1] = ( float ) ( ( 3.0 * Slope - 2.0 * TangentA - TangentB ) / Run );
+	Coeffs[2] = ( float ) ( ( TangentA + TangentB - 2.0 * Slope ) / ( Run * Run ) );
+}
+
+static void WaveGPXSpline_BuildSegment( const std::vector< FWaveGPXPoint >& Points, size_t i, FWaveGPXSplineSegment& Segment )
+{
+	auto& PointA = Points[i];
+	Segment = FWaveGPXSplineSegment();
+	Segment.Dist = PointA.Dist;
+	Segment.East = PointA.East;
+	Segment.North = PointA.North;
+	Segment.Up = PointA.Up;
+	Segment.Alt = PointA.Alt;
+	if ( i + 1 >= Points.size() ) {
+		return;
+	}
+
+	auto& PointB = Points[ i + 1 ];
+	double Run = PointB.Dist - PointA.Dist;
+	Segment.Length = ( float ) std::max( Run, 0.0 );
+	if ( Run <= WAVEGPX_SPLINE_MIN_RUN ) {
+		return;
+	}
+
+	auto FitAxis = [&]( double FWaveGPXPoint::* Value, bool Monotone, float* Coeffs )
+	{
+		WaveGPXSpline_Fit( Run, PointA.*Value, PointB.*Value,
+			WaveGPXSpline_Tangent( Points, i, Value, Monotone ), WaveGPXSpline_Tangent( Points, i + 1, Value, Monotone ), Coeffs );
+	};
+	FitAxis( &FWaveGPXPoint::East, false, Segment.EastCoeffs );
+	FitAxis( &FWaveGPXPoint::North, false, Segment.NorthCoeffs );
+	FitAxis( &FWaveGPXPoint::Up, false, Segment.UpCoeffs );
+	FitAxis( &FWaveGPXPoint::Alt, true, Segment.AltCoeffs );
+}
+
+// Value, first and second derivative of one axis, T metres into the segment.
+static void WaveGPXSpline_EvalAxis( double Value, const float* Coeffs, double T, double& Pos, double& D1, double& D2 )
+{
+	Pos = Value + T * ( Coeffs[0] + T * ( Coeffs[1] + T * Coeffs[2] ) );
+	D1 = Coeffs[0] + T * ( 2.0 * Coeffs[1] + T * 3.0 * Coeffs[2] );
+	D2 = 2.0 * Coeffs[1] + T * 6.0 * Coeffs[2];
+}
+
+static FWaveGPXSplineSample WaveGPXSpline_EvalSegment( const FWaveGPXSplineSegment& Segment, float Dist )
+{
+	FWaveGPXSplineSample Sample;
+	double T = std::clamp( Dist - Segment.Dist, 0.0, ( double ) Segment.Length );
+	double DEast, DNorth, DUp, DAlt, DDEast, DDNorth, DDUp, DDAlt;
+	WaveGPXSpline_EvalAxis( Segment.East, Segment.EastCoeffs, T, Sample.Position.East, DEast, DDEast );
+	WaveGPXSpline_EvalAxis( Segment.North, Segment.NorthCoeffs, T, Sample.Position.North, DNorth, DDNorth );
+	WaveGPXSpline_EvalAxis( Segment.Up, Segment.UpCoeffs, T, Sample.Position.Up, DUp, DDUp );
+	WaveGPXSpline_EvalAxis( Segment.Alt, Segment.AltCoeffs, T, Sample.Position.Alt, DAlt, DDAlt );
+	Sample.Position.Dist = Dist;
+
+	double Speed = sqrt( DEast * DEast + DNorth * DNorth + DUp * DUp );
+	if ( Speed > 0.0 ) {
+		Sample.TangentEast = DEast / Speed;
+		Sample.TangentNorth = DNorth / Speed;
+		Sample.TangentUp = DUp / Speed;
+	}
+
+	double HorizontalSpeed = sqrt( DEast * DEast + DNorth * DNorth );
+	Sample.Grade = ( float ) ( DAlt / std::max( HorizontalSpeed, 0.0001 ) * 100.0 );
+	if ( HorizontalSpeed > 0.0 ) {
+		Sample.Curvature = ( float ) ( ( DEast * DDNorth - DNorth * DDEast ) / ( HorizontalSpeed * HorizontalSpeed * HorizontalSpeed ) );
+		Sample.Heading = ( float ) ( atan2( DEast, DNorth ) * 180.0 / 3.14159265358979323846 );
+		if ( Sample.Heading < 0.0f ) {
+			Sample.Heading += 360.0f;
+		}
+	}
+	return Sample;
+}
+
+void WaveRouteUtil_BuildSpline( const FWaveGPXRoute& Route, FWaveGPXSpline& Spline )
+{
+	Spline = FWaveGPXSpline();
+	auto& Points = Route.Points;
+	if ( Points.size() <= 0 ) {
+		return;
+	}
+
+	Spline.NumPoints = Points.size();
+	Spline.Segments.resize( std::max( Points.size() - 1, ( size_t ) 1 ) );
+	for ( size_t i = 0; i < Spline.Segments.size(); i++ ) {
+		WaveGPXSpline_BuildSegment( Points, i, Spline.Segments[i] );
+	}
+}
+
+FWaveGPXSplineSample WaveRouteUtil_EvalSpline( const FWaveGPXRoute& Route, int Segment, float Dist )
+{
+	if ( Route.Points.size() <= 0 ) {
+		return FWaveGPXSplineSample();
+	}
+
+	// Past the last point is the end of the last segment.
+	size_t Index = std::clamp( Segment, 0, std::max( ( int ) Route.Points.size() - 2, 0 ) );
+	if ( Route.Spline.NumPoints == Route.Points.size() ) {
+		return WaveGPXSpline_EvalSegment( Route.Spline.Segments[ Index ], Dist );
+	}
+
+	FWaveGPXSplineSegment Temp;
+	WaveGPXSpline_BuildSegment( Route.Points, Index, Temp );
+	return WaveGPXSpline_EvalSegment( Temp, Dist );
+}
+
+FWaveGPXSplineSample WaveRouteUtil_FindSplinePosAtDist( const FWaveGPXRoute& Route, float Dist )
+{
+	if ( Route.Points.size() <= 0 ) {
+		return FWaveGPXSplineSample();
+	}
+	return WaveRouteUtil_EvalSpline( Route, WaveRouteUtil_FindPointAtDist( Route, Dist ), Dist );
+}
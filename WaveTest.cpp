@@ -17,6 +17,11 @@
 	OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 #include "WaveControl.h"
 #include "WaveGPX.h"
 #include "WaveSimulation.h"
@@ -32,6 +37,807 @@ TEST_CASE( "Simple GPX Route Load", "[WaveGPX]" )
 	REQUIRE( Route.Name.size() > 0 );
 	REQUIRE( Route.Points.size() > 0 );
 	REQUIRE( Route.SourceFile.size() > 0 );
+
+	// Lookup structures are only built when asked for.
+	REQUIRE( Route.SpatialIndex.CellKeys.empty() );
+	REQUIRE( Route.GradeProfile.Dist.empty() );
+	REQUIRE( Route.LODPyramid.Levels.empty() );
+	REQUIRE( Route.Spline.Segments.empty() );
+}
+
+TEST_CASE( "GPX Streaming Load", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	REQUIRE( Route.Name == "Cherrybrook Hill Loop Beast Mode" );
+	REQUIRE( Route.Points.size() == 471 );
+	REQUIRE( Route.Points[0].Lat == Approx( -33.733255 ) );
+	REQUIRE( Route.Points[0].Lon == Approx( 151.032305 ) );
+	REQUIRE( Route.Points[0].Alt == Approx( 161.2 ) );
+	REQUIRE( Route.Points[0].East == 0.0 );
+	REQUIRE( Route.Points.back().Dist == Approx( Route.Stat_Length ) );
+
+	// Our own recordings write the author as text, and escape the name.
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/RecordedRide.gpx" ) );
+	REQUIRE( Route.Name == "Mach's Chow Mein" );
+	REQUIRE( Route.Author == "CYCLEWAVE - Virtual Cycling Route Simulation App" );
+	REQUIRE( Route.Points.size() == 476 );
+
+	auto BrokenFile = ( std::filesystem::temp_directory_path() / "WaveTest_Broken.gpx" ).string();
+	{
+		std::ofstream FileStream( BrokenFile );
+		FileStream << "<gpx version=\"1.1\"><trk><trkseg><trkpt lat=\"1\" lon=\"2\"><ele>3</ele></trkpt></trk></gpx>";
+	}
+	REQUIRE( !WRS.LoadRouteGPX( Route, BrokenFile ) );
+	std::filesystem::remove( BrokenFile );
+}
+
+TEST_CASE( "Route Cache", "[WaveGPX]" )
+{
+	auto SourceFile = ( std::filesystem::temp_directory_path() / "WaveTest_Cache.gpx" ).string();
+	auto CacheFile = WaveGPXCache_GetFileName( SourceFile );
+	std::filesystem::copy_file( "TestFiles/HawkHill.gpx", SourceFile, std::filesystem::copy_options::overwrite_existing );
+	std::filesystem::remove( CacheFile );
+
+	WaveGPX WRS;
+	FWaveGPXRoute Route, CachedRoute;
+	WRS.LoadOptions.UseRouteCache = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, SourceFile ) );
+	REQUIRE( std::filesystem::exists( CacheFile ) );
+
+	REQUIRE( WaveGPXCache_Load( CachedRoute, SourceFile ) );
+	REQUIRE( CachedRoute.Name == Route.Name );
+	REQUIRE( CachedRoute.Author == Route.Author );
+	REQUIRE( CachedRoute.Points.size() == Route.Points.size() );
+	REQUIRE( memcmp( CachedRoute.Points.data(), Route.Points.data(), Route.Points.size() * sizeof( FWaveGPXPoint ) ) == 0 );
+	REQUIRE( CachedRoute.Stat_Length == Route.Stat_Length );
+	REQUIRE( CachedRoute.Stat_Elev == Route.Stat_Elev );
+
+	// Touching the file doesn't invalidate the cache, since the contents still match.
+	std::filesystem::last_write_time( SourceFile, std::filesystem::last_write_time( SourceFile ) + std::chrono::hours( 1 ) );
+	REQUIRE( WaveGPXCache_Load( CachedRoute, SourceFile ) );
+
+	// Editing it does.
+	{
+		std::ofstream FileStream( SourceFile, std::ios::app );
+		FileStream << "\n";
+	}
+	REQUIRE( !WaveGPXCache_Load( CachedRoute, SourceFile ) );
+	REQUIRE( WRS.LoadRouteGPX( Route, SourceFile ) );
+	REQUIRE( WaveGPXCache_Load( CachedRoute, SourceFile ) );
+
+	std::filesystem::remove( SourceFile );
+	std::filesystem::remove( CacheFile );
+}
+
+TEST_CASE( "Route Directory Load", "[WaveGPX]" )
+{
+	auto Directory = std::filesystem::temp_directory_path() / "WaveTest_Routes";
+	std::filesystem::remove_all( Directory );
+	std::filesystem::create_directories( Directory / "Sub" );
+	std::filesystem::copy_file( "TestFiles/MachsChowMein.gpx", Directory / "B.gpx" );
+	std::filesystem::copy_file( "TestFiles/HawkHill.gpx", Directory / "Sub" / "A.GPX" );
+	std::filesystem::copy_file( "TestFiles/HawkHill.gpx", Directory / "C.txt" );
+	{
+		std::ofstream FileStream( Directory / "Broken.gpx" );
+		FileStream << "<gpx><trk><trkseg><trkpt lat=\"1\"";
+	}
+
+	WaveGPX WRS;
+	WRS.LoadOptions.UseRouteCache = false;
+	std::vector< std::string > FailedFiles;
+	int NumCallbacks = 0, NumFiles = 0;
+	int NumLoaded = WRS.LoadRouteDirectory( Directory.string(), [&]( const FWaveGPXLoadProgress& Progress )
+	{
+		NumCallbacks++;
+		NumFiles = Progress.NumFiles;
+		if ( !Progress.Success ) {
+			FailedFiles.push_back( Progress.FileName );
+		}
+	} );
+	REQUIRE( NumLoaded == 2 );
+	REQUIRE( NumFiles == 3 );
+	REQUIRE( NumCallbacks == 3 );
+	REQUIRE( FailedFiles.size() == 1 );
+	REQUIRE( std::filesystem::path( FailedFiles[0] ).filename() == "Broken.gpx" );
+
+	// Routes come back in file order, whatever order the workers finished in.
+	auto& Routes = WRS.GetLoadedRoutes();
+	REQUIRE( Routes.size() == 2 );
+	REQUIRE( std::filesystem::path( Routes[0].SourceFile ).filename() == "B.gpx" );
+	REQUIRE( std::filesystem::path( Routes[1].SourceFile ).filename() == "A.GPX" );
+	REQUIRE( Routes[1].Points.size() > 0 );
+
+	REQUIRE( WRS.ScanRouteDirectory( Directory.string() ) == 2 );
+	REQUIRE( WRS.GetCatalog().size() == 2 );
+	REQUIRE( WRS.GetCatalog()[1].SourceFile == Routes[1].SourceFile );
+	REQUIRE( WRS.GetCatalog()[1].Stat_Length == Routes[1].Stat_Length );
+
+	// A cancelled load leaves the loaded routes alone.
+	std::atomic< bool > Cancel = true;
+	REQUIRE( WRS.LoadRouteDirectory( Directory.string(), nullptr, &Cancel ) == 0 );
+	REQUIRE( WRS.GetLoadedRoutes().size() == 2 );
+
+	std::filesystem::remove_all( Directory );
+}
+
+TEST_CASE( "Route Catalog Scan", "[WaveGPX]" )
+{
+	auto SourceFile = ( std::filesystem::temp_directory_path() / "WaveTest_Catalog.gpx" ).string();
+	std::filesystem::copy_file( "TestFiles/MachsChowMein.gpx", SourceFile, std::filesystem::copy_options::overwrite_existing );
+	std::filesystem::remove( WaveGPXCache_GetFileName( SourceFile ) );
+
+	WaveGPX WRS;
+	WRS.LoadOptions.UseRouteCache = false;
+	FWaveGPXRoute Route;
+	REQUIRE( WRS.LoadRouteGPX( Route, SourceFile ) );
+
+	// Scanning gives exactly the same stats as a full load.
+	auto RequireSameInfo = [&]( const FWaveGPXCatalogEntry& Entry )
+	{
+		REQUIRE( Entry.Name == Route.Name );
+		REQUIRE( Entry.Author == Route.Author );
+		REQUIRE( Entry.SourceFile == SourceFile );
+		REQUIRE( Entry.NumPoints == Route.Points.size() );
+		REQUIRE( Entry.Stat_Length == Route.Stat_Length );
+		REQUIRE( Entry.Stat_Elev == Route.Stat_Elev );
+		REQUIRE( Entry.Stat_HillinessRating == Route.Stat_HillinessRating );
+		REQUIRE( Entry.Stat_HighestAlt == Route.Stat_HighestAlt );
+		REQUIRE( Entry.Stat_LowestAlt == Route.Stat_LowestAlt );
+	};
+	FWaveGPXCatalogEntry Entry;
+	REQUIRE( WRS.ScanRouteGPX( Entry, SourceFile ) );
+	RequireSameInfo( Entry );
+
+	// And so does a scan that reads the stats from the route cache.
+	WRS.LoadOptions.UseRouteCache = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, SourceFile ) );
+	FWaveGPXCatalogEntry CachedEntry;
+	REQUIRE( WaveGPXCache_LoadCatalogEntry( CachedEntry, SourceFile ) );
+	RequireSameInfo( CachedEntry );
+
+	FWaveGPXRoute PickedRoute;
+	REQUIRE( WRS.LoadCatalogRoute( PickedRoute, Entry ) );
+	REQUIRE( PickedRoute.Points.size() == Route.Points.size() );
+
+	REQUIRE( !WRS.ScanRouteGPX( Entry, "TestFiles/DoesNotExist.gpx" ) );
+
+	std::filesystem::remove( SourceFile );
+	std::filesystem::remove( WaveGPXCache_GetFileName( SourceFile ) );
+}
+
+TEST_CASE( "Compact Route", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	WRS.LoadOptions.UseRouteCache = false;
+	FWaveGPXRoute Route;
+	FWaveGPXCompactRoute CompactRoute;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/HawkHill.gpx" ) );
+	REQUIRE( WRS.LoadRouteGPX( CompactRoute, "TestFiles/HawkHill.gpx" ) );
+
+	REQUIRE( CompactRoute.Name == Route.Name );
+	REQUIRE( CompactRoute.GetNumPoints() == Route.Points.size() );
+	REQUIRE( CompactRoute.Stat_Length == Route.Stat_Length );
+	REQUIRE( CompactRoute.Stat_Elev == Route.Stat_Elev );
+
+	double MaxDegreeError = 0.0, MaxMetreError = 0.0;
+	for ( int i = 0; i < CompactRoute.GetNumPoints(); i++ ) {
+		auto Point = CompactRoute.GetPoint( i );
+		auto& Expected = Route.Points[i];
+		MaxDegreeError = std::max( { MaxDegreeError, fabs( Point.Lat - Expected.Lat ), fabs( Point.Lon - Expected.Lon ) } );
+		MaxMetreError = std::max( { MaxMetreError, fabs( Point.Alt - Expected.Alt ), fabs( Point.East - Expected.East ),
+			fabs( Point.North - Expected.North ), fabs( Point.Up - Expected.Up ), fabs( Point.Dist - Expected.Dist ) } );
+	}
+	REQUIRE( MaxDegreeError < 1e-7 );
+	REQUIRE( MaxMetreError < 1e-3 );
+
+	// The FWaveGPXRoute version interpolates Lat / Lon at float precision, hence the loose tolerance.
+	for ( float Dist = -10.0f; Dist < Route.Stat_Length + 10.0f; Dist += 7.3f ) {
+		REQUIRE( WaveRouteUtil_FindPointAtDist( CompactRoute, Dist ) == WaveRouteUtil_FindPointAtDist( Route, Dist ) );
+		auto Point = WaveRouteUtil_FindENUPosAtDist( CompactRoute, Dist );
+		auto Expected = WaveRouteUtil_FindENUPosAtDist( Route, Dist );
+		REQUIRE( fabs( Point.East - Expected.East ) < 0.5 );
+		REQUIRE( fabs( Point.North - Expected.North ) < 0.5 );
+		REQUIRE( fabs( Point.Alt - Expected.Alt ) < 0.01 );
+	}
+
+	FWaveGPXRoute ExpandedRoute;
+	WaveRouteUtil_ExpandCompactRoute( CompactRoute, ExpandedRoute );
+	REQUIRE( ExpandedRoute.Points.size() == Route.Points.size() );
+	REQUIRE( ExpandedRoute.Stat_Length == Route.Stat_Length );
+}
+
+TEST_CASE( "Route Simplification", "[WaveGPX]" )
+{
+	// Straight flat line with a little noise, and one bump that has to stay.
+	std::vector< FWaveGPXPoint > Points, SimplifiedPoints;
+	for ( int i = 0; i <= 100; i++ ) {
+		FWaveGPXPoint Point;
+		Point.East = i;
+		Point.North = ( i % 2 ) ? 0.1 : -0.1;
+		Point.Alt = ( i == 50 ) ? 2.0 : 0.0;
+		Points.push_back( Point );
+	}
+	auto Report = WaveRouteUtil_SimplifyPoints( Points, SimplifiedPoints, 1.0f, 0.5f );
+	// The bump and the points either side of it, since the climb starts and ends there.
+	REQUIRE( SimplifiedPoints.size() == 5 );
+	REQUIRE( SimplifiedPoints[2].Alt == 2.0 );
+	REQUIRE( Report.NumPointsBefore == 101 );
+	REQUIRE( Report.NumPointsRemoved == 96 );
+	REQUIRE( Report.MaxHorizontalDeviation <= 0.25f );
+	REQUIRE( Report.MaxVerticalDeviation <= 0.5f );
+
+	// Loosen the vertical tolerance and the bump goes too.
+	WaveRouteUtil_SimplifyPoints( Points, SimplifiedPoints, 1.0f, 5.0f );
+	REQUIRE( SimplifiedPoints.size() == 2 );
+
+	WaveGPX WRS;
+	WRS.LoadOptions.UseRouteCache = false;
+	FWaveGPXRoute Route, SimplifiedRoute;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/HawkHill_RecordedRide.gpx" ) );
+	WRS.LoadOptions.Simplify = true;
+	REQUIRE( WRS.LoadRouteGPX( SimplifiedRoute, "TestFiles/HawkHill_RecordedRide.gpx" ) );
+
+	REQUIRE( SimplifiedRoute.Points.size() < Route.Points.size() / 2 );
+	REQUIRE( fabs( SimplifiedRoute.Stat_Length - Route.Stat_Length ) <= Route.Stat_Length * WRS.LoadOptions.SimplifyMaxStatError );
+	REQUIRE( fabs( SimplifiedRoute.Stat_Elev - Route.Stat_Elev ) <= Route.Stat_Elev * WRS.LoadOptions.SimplifyMaxStatError );
+	REQUIRE( SimplifiedRoute.Points.back().Lat == Route.Points.back().Lat );
+	REQUIRE( fabs( SimplifiedRoute.Points.back().Dist - SimplifiedRoute.Stat_Length ) < 0.1 );
+}
+
+TEST_CASE( "Resampled Route", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+
+	FWaveGPXResampledRoute Resampled;
+	WaveRouteUtil_ResampleRoute( Route, Resampled, 5.0f );
+	REQUIRE( Resampled.Points.size() == ( size_t ) ( Route.Points.back().Dist / 5.0 ) + 2 );
+
+	// Exact at the samples themselves.
+	for ( size_t i = 0; i < Resampled.Points.size(); i += 7 ) {
+		float Dist = i * 5.0f;
+		auto Point = WaveRouteUtil_FindENUPosAtDist( Resampled, Dist );
+		auto Expected = WaveRouteUtil_FindENUPosAtDist( Route, Dist );
+		REQUIRE( Point.East == Expected.East );
+		REQUIRE( Point.North == Expected.North );
+		REQUIRE( Point.Alt == Expected.Alt );
+		REQUIRE( WaveRouteUtil_FindGradePosAtDist( Resampled, Dist ) == WaveRouteUtil_FindGradePosAtDist( Route, Dist ) );
+	}
+
+	// Mapping back to the original points is exact everywhere, and positions in between are within a sample's
+	// worth of corner cutting.
+	for ( float Dist = -10.0f; Dist < Route.Stat_Length + 10.0f; Dist += 1.37f ) {
+		REQUIRE( WaveRouteUtil_FindPointAtDist( Route, Resampled, Dist ) == WaveRouteUtil_FindPointAtDist( Route, Dist ) );
+		auto Point = WaveRouteUtil_FindENUPosAtDist( Resampled, Dist );
+		auto Expected = WaveRouteUtil_FindENUPosAtDist( Route, Dist );
+		REQUIRE( fabs( Point.East - Expected.East ) < 2.5 );
+		REQUIRE( fabs( Point.North - Expected.North ) < 2.5 );
+	}
+}
+
+TEST_CASE( "Route Nearest Dist", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.BuildSpatialIndex = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	REQUIRE( Route.SpatialIndex.CellKeys.size() > 0 );
+
+	// Same answer as checking every segment, on and off the route.
+	FWaveGPXRoute BruteForce = Route;
+	BruteForce.SpatialIndex = FWaveGPXSpatialIndex();
+	for ( size_t i = 0; i < Route.Points.size(); i += 13 ) {
+		for ( double Offset : { 0.0, 7.0, 60.0, -180.0, 1000.0 } ) {
+			double East = Route.Points[i].East + Offset;
+			double North = Route.Points[i].North - Offset * 0.5;
+			float OffRoute = 0.0f, ExpectedOffRoute = 0.0f;
+			WaveRouteUtil_FindNearestDistOnRoute( Route, East, North, -1.0f, &OffRoute );
+			WaveRouteUtil_FindNearestDistOnRoute( BruteForce, East, North, -1.0f, &ExpectedOffRoute );
+			REQUIRE( fabs( OffRoute - ExpectedOffRoute ) < 0.001f );
+		}
+		float OffRoute = 0.0f;
+		float Dist = WaveRouteUtil_FindNearestDistOnRoute( Route, Route.Points[i].East, Route.Points[i].North, ( float ) Route.Points[i].Dist, &OffRoute );
+		REQUIRE( OffRoute < 0.001f );
+		REQUIRE( fabs( Dist - Route.Points[i].Dist ) < 0.01 );
+	}
+
+	// Out and back along the same road, the hint picks the pass.
+	FWaveGPXRoute OutAndBack;
+	for ( int i = 0; i <= 200; i++ ) {
+		FWaveGPXPoint Point;
+		Point.East = ( i <= 100 ? i : 200 - i ) * 10.0;
+		Point.North = i <= 100 ? 0.0 : 3.0;
+		Point.Dist = i * 10.0;
+		OutAndBack.Points.push_back( Point );
+	}
+	WaveRouteUtil_BuildSpatialIndex( OutAndBack );
+	REQUIRE( fabs( WaveRouteUtil_FindNearestDistOnRoute( OutAndBack, 255.0, 1.0, 240.0f ) - 255.0f ) < 0.1 );
+	REQUIRE( fabs( WaveRouteUtil_FindNearestDistOnRoute( OutAndBack, 255.0, 1.0, 1730.0f ) - 1745.0f ) < 0.1 );
+	REQUIRE( fabs( WaveRouteUtil_FindNearestDistOnRoute( OutAndBack, 255.0, 1.0 ) - 255.0f ) < 0.1 );
+	REQUIRE( fabs( WaveRouteUtil_FindNearestDistOnRoute( OutAndBack, 255.0, 2.5 ) - 1745.0f ) < 0.1 );
+
+	// Ties are judged against the nearest pass, not chained from one near miss to the next.
+	FWaveGPXRoute ThreePasses;
+	for ( int i = 0; i <= 300; i++ ) {
+		FWaveGPXPoint Point;
+		int Pass = std::min( i / 101, 2 );
+		int Step = i - Pass * 101 + ( Pass == 2 ? 2 : 0 );
+		Point.East = ( Pass == 1 ? 100 - Step : Step ) * 10.0;
+		Point.North = Pass * 1.5;
+		if ( i > 0 ) {
+			auto& Last = ThreePasses.Points.back();
+			Point.Dist = Last.Dist + sqrt( pow( Point.East - Last.East, 2.0 ) + pow( Point.North - Last.North, 2.0 ) );
+		}
+		ThreePasses.Points.push_back( Point );
+	}
+	WaveRouteUtil_BuildSpatialIndex( ThreePasses );
+	float ThirdPassDist = WaveRouteUtil_FindNearestDistOnRoute( ThreePasses, 255.0, 3.0 );
+	float OffRoute = 0.0f;
+	WaveRouteUtil_FindNearestDistOnRoute( ThreePasses, 255.0, 0.0, ThirdPassDist, &OffRoute );
+	REQUIRE( fabs( OffRoute - 1.5f ) < 0.01f );
+
+	// An index left over from other points is ignored rather than trusted.
+	FWaveGPXPoint Extra;
+	Extra.East = 500.0;
+	Extra.North = 500.0;
+	Extra.Dist = 2000.0 + sqrt( 500.0 * 500.0 * 2.0 );
+	OutAndBack.Points.push_back( Extra );
+	REQUIRE( fabs( WaveRouteUtil_FindNearestDistOnRoute( OutAndBack, 500.0, 499.0 ) - ( float ) Extra.Dist ) < 1.5 );
+}
+
+TEST_CASE( "Route Grade Profile", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	WRS.LoadOptions.BuildGradeProfile = true;
+	for ( auto FileName : { "TestFiles/HawkHill.gpx", "TestFiles/MachsChowMein.gpx" } ) {
+		FWaveGPXRoute Route;
+		REQUIRE( WRS.LoadRouteGPX( Route, FileName ) );
+		REQUIRE( Route.GradeProfile.Dist.size() == Route.Points.size() );
+
+		// Same as the central difference on the route's own points, for any window. Relative, since stopped points
+		// give huge grades over a few millimetres.
+		FWaveGPXRoute NoProfile = Route;
+		NoProfile.GradeProfile = FWaveGPXGradeProfile();
+		double MaxError = 0.0;
+		for ( float Smoothness : { 0.5f, 2.5f, 10.0f, 100.0f } ) {
+			for ( float Dist = -20.0f; Dist < Route.Stat_Length + 20.0f; Dist += 0.77f ) {
+				float Grade = WaveRouteUtil_FindGradePosAtDist( Route, Dist, Smoothness );
+				float Expected = WaveRouteUtil_FindGradePosAtDist( NoProfile, Dist, Smoothness );
+				MaxError = std::max( MaxError, fabs( Grade - Expected ) / std::max( 1.0, ( double ) fabs( Expected ) ) );
+			}
+		}
+		REQUIRE( MaxError < 0.0001 );
+
+		// Each point's bucket starts at or before it.
+		for ( size_t i = 0; i < Route.Points.size(); i++ ) {
+			float Dist = ( float ) Route.Points[i].Dist;
+			REQUIRE( Route.GradeProfile.BucketPoint[ ( size_t ) ( Dist / Route.GradeProfile.BucketSize ) ] <= WaveRouteUtil_FindPointAtDist( Route, Dist ) + 1 );
+		}
+	}
+}
+
+TEST_CASE( "Route Geodetic Frame", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/HawkHill.gpx" ) );
+	REQUIRE( Route.GeoFrame.Valid );
+	REQUIRE( Route.GeoFrame.OriginLat == Route.Points[0].Lat );
+
+	FWaveGPXGeoFrame TempFrame;
+	REQUIRE( &WaveRouteUtil_GetGeoFrame( Route, TempFrame ) == &Route.GeoFrame );
+	FWaveGPXRoute NoFrame = Route;
+	NoFrame.GeoFrame = FWaveGPXGeoFrame();
+	REQUIRE( &WaveRouteUtil_GetGeoFrame( NoFrame, TempFrame ) == &TempFrame );
+
+	// Batch, single and uncached conversions all agree, and give back the ENU the points were loaded with.
+	std::vector< FWaveGPXPoint > Points = Route.Points;
+	WaveRouteUtil_FillENUFromLLA( Route, Points.data(), Points.size() );
+	std::vector< double > Lat, Lon, Alt, East( Points.size() ), North( Points.size() ), Up( Points.size() );
+	for ( auto& P : Route.Points ) {
+		Lat.push_back( P.Lat );
+		Lon.push_back( P.Lon );
+		Alt.push_back( P.Alt );
+	}
+	WaveGPXGeo_LLAToENU( Route.GeoFrame, Lat.data(), Lon.data(), Alt.data(), East.data(), North.data(), Up.data(), Points.size() );
+	for ( size_t i = 0; i < Points.size(); i += 11 ) {
+		auto Single = Route.Points[i];
+		WaveRouteUtil_FillENUFromLLA( NoFrame, Single );
+		REQUIRE( Single.East == Points[i].East );
+		REQUIRE( Single.Up == Points[i].Up );
+		REQUIRE( East[i] == Points[i].East );
+		REQUIRE( North[i] == Points[i].North );
+		REQUIRE( fabs( Points[i].East - Route.Points[i].East ) < 1e-6 );
+		REQUIRE( fabs( Points[i].North - Route.Points[i].North ) < 1e-6 );
+		REQUIRE( fabs( Points[i].Up - Route.Points[i].Up ) < 1e-6 );
+	}
+
+	// And back again. GeodeticConverter doesn't round trip exactly ( it rotates into ENU about the geocentric
+	// latitude but back out about the geodetic one ), so this only checks the batch and single paths agree.
+	std::vector< double > BackLat( Points.size() ), BackLon( Points.size() ), BackAlt( Points.size() );
+	WaveGPXGeo_ENUToLLA( Route.GeoFrame, East.data(), North.data(), Up.data(), BackLat.data(), BackLon.data(), BackAlt.data(), Points.size() );
+	WaveRouteUtil_FillLLAFromENU( Route, Points.data(), Points.size() );
+	for ( size_t i = 0; i < Points.size(); i += 11 ) {
+		auto Single = Points[i];
+		WaveRouteUtil_FillLLAFromENU( NoFrame, Single );
+		REQUIRE( Single.Lat == Points[i].Lat );
+		REQUIRE( Single.Alt == Points[i].Alt );
+		REQUIRE( BackLat[i] == Points[i].Lat );
+		REQUIRE( BackLon[i] == Points[i].Lon );
+		REQUIRE( fabs( Points[i].Lat - Route.Points[i].Lat ) < 1e-4 );
+		REQUIRE( fabs( Points[i].Lon - Route.Points[i].Lon ) < 1e-4 );
+	}
+}
+
+TEST_CASE( "Geodetic Batch Conversions", "[WaveGPX]" )
+{
+	// Up to half a degree and a few km around origins all over the world, an odd number so the last lanes get padded.
+	double Origins[][2] = { { 37.83, -122.48 }, { -33.86, 151.21 }, { 64.13, -21.9 }, { 0.1, 179.9 }, { -89.0, 10.0 } };
+	const size_t NumPoints = 1001;
+	for ( auto& Origin : Origins ) {
+		FWaveGPXGeoFrame Frame;
+		WaveGPXGeo_InitFrame( Frame, Origin[0], Origin[1], 100.0 );
+
+		std::vector< double > Lat( NumPoints ), Lon( NumPoints ), Alt( NumPoints );
+		for ( size_t i = 0; i < NumPoints; i++ ) {
+			Lat[i] = std::clamp( Origin[0] + 0.5 * sin( i * 0.37 ), -90.0, 90.0 );
+			Lon[i] = Origin[1] + 0.5 * cos( i * 0.73 );
+			Alt[i] = 3000.0 + 3400.0 * sin( i * 0.11 );
+		}
+
+		std::vector< double > X( NumPoints ), Y( NumPoints ), Z( NumPoints );
+		std::vector< double > BackLat( NumPoints ), BackLon( NumPoints ), BackAlt( NumPoints );
+		std::vector< double > East( NumPoints ), North( NumPoints ), Up( NumPoints );
+		WaveGPXGeo_LLAToECEF( Lat.data(), Lon.data(), Alt.data(), X.data(), Y.data(), Z.data(), NumPoints );
+		WaveGPXGeo_ECEFToLLA( X.data(), Y.data(), Z.data(), BackLat.data(), BackLon.data(), BackAlt.data(), NumPoints );
+		WaveGPXGeo_LLAToENU( Frame, Lat.data(), Lon.data(), Alt.data(), East.data(), North.data(), Up.data(), NumPoints );
+		for ( size_t i = 0; i < NumPoints; i++ ) {
+			// geodetic_converter::GeodeticConverter::geodetic2Ecef, with the standard library's sin and cos.
+			double LatRad = Lat[i] / 180.0 * M_PI, LonRad = Lon[i] / 180.0 * M_PI;
+			double Xi = sqrt( 1.0 - 6.69437999014e-3 * sin( LatRad ) * sin( LatRad ) );
+			REQUIRE( fabs( X[i] - ( 6378137.0 / Xi + Alt[i] ) * cos( LatRad ) * cos( LonRad ) ) < 1e-6 );
+			REQUIRE( fabs( Y[i] - ( 6378137.0 / Xi + Alt[i] ) * cos( LatRad ) * sin( LonRad ) ) < 1e-6 );
+			REQUIRE( fabs( Z[i] - ( 6378137.0 / Xi * ( 1.0 - 6.69437999014e-3 ) + Alt[i] ) * sin( LatRad ) ) < 1e-6 );
+
+			// Back to where it started, as near as the closed form gets.
+			REQUIRE( fabs( BackLat[i] - Lat[i] ) < 1e-9 );
+			REQUIRE( fabs( remainder( BackLon[i] - Lon[i], 360.0 ) ) < 1e-9 );
+			REQUIRE( fabs( BackAlt[i] - Alt[i] ) < 1e-3 );
+
+			// Single points give exactly the same.
+			double SingleX, SingleY, SingleZ, SingleLat, SingleLon, SingleAlt, SingleEast, SingleNorth, SingleUp;
+			WaveGPXGeo_LLAToECEF( Lat[i], Lon[i], Alt[i], SingleX, SingleY, SingleZ );
+			WaveGPXGeo_ECEFToLLA( X[i], Y[i], Z[i], SingleLat, SingleLon, SingleAlt );
+			WaveGPXGeo_LLAToENU( Frame, Lat[i], Lon[i], Alt[i], SingleEast, SingleNorth, SingleUp );
+			REQUIRE( SingleX == X[i] );
+			REQUIRE( SingleZ == Z[i] );
+			REQUIRE( SingleLat == BackLat[i] );
+			REQUIRE( SingleAlt == BackAlt[i] );
+			REQUIRE( SingleEast == East[i] );
+			REQUIRE( SingleUp == Up[i] );
+		}
+
+		// ENU is ECEF relative to the origin, rotated.
+		std::vector< double > ENUFromECEF( NumPoints * 3 ), ECEFFromENU( NumPoints * 3 );
+		double* E = ENUFromECEF.data(), * N = E + NumPoints, * U = N + NumPoints;
+		WaveGPXGeo_ECEFToENU( Frame, X.data(), Y.data(), Z.data(), E, N, U, NumPoints );
+		double* BackX = ECEFFromENU.data(), * BackY = BackX + NumPoints, * BackZ = BackY + NumPoints;
+		WaveGPXGeo_ENUToECEF( Frame, East.data(), North.data(), Up.data(), BackX, BackY, BackZ, NumPoints );
+		double OriginEast, OriginNorth, OriginUp;
+		WaveGPXGeo_LLAToENU( Frame, Origin[0], Origin[1], 100.0, OriginEast, OriginNorth, OriginUp );
+		REQUIRE( ( OriginEast == 0.0 && OriginNorth == 0.0 && OriginUp == 0.0 ) );
+		for ( size_t i = 0; i < NumPoints; i++ ) {
+			REQUIRE( E[i] == East[i] );
+			REQUIRE( N[i] == North[i] );
+			REQUIRE( U[i] == Up[i] );
+			double SingleX, SingleY, SingleZ;
+			WaveGPXGeo_ENUToECEF( Frame, East[i], North[i], Up[i], SingleX, SingleY, SingleZ );
+			REQUIRE( ( SingleX == BackX[i] && SingleY == BackY[i] && SingleZ == BackZ[i] ) );
+			// The way back rotates about the geodetic latitude rather than the geocentric one, as the converter does.
+			double Dist = sqrt( East[i] * East[i] + North[i] * North[i] + Up[i] * Up[i] );
+			REQUIRE( sqrt( pow( BackX[i] - X[i], 2 ) + pow( BackY[i] - Y[i], 2 ) + pow( BackZ[i] - Z[i], 2 ) ) < Dist * 0.004 + 1e-6 );
+		}
+
+		// And in place, from ENU to LLA.
+		std::vector< double > A = East, B = North, C = Up;
+		WaveGPXGeo_ENUToLLA( Frame, A.data(), B.data(), C.data(), A.data(), B.data(), C.data(), NumPoints );
+		for ( size_t i = 0; i < NumPoints; i += 7 ) {
+			double SingleLat, SingleLon, SingleAlt;
+			WaveGPXGeo_ENUToLLA( Frame, East[i], North[i], Up[i], SingleLat, SingleLon, SingleAlt );
+			REQUIRE( A[i] == SingleLat );
+			REQUIRE( B[i] == SingleLon );
+			REQUIRE( C[i] == SingleAlt );
+		}
+	}
+
+	// Nowhere near the surface, where the batch cube root doesn't hold.
+	double FarX[] = { 40000.0, 4.2e7, 1.0e6 }, FarY[] = { 0.0, 1.0e6, -2.0e5 }, FarZ[] = { 40000.0, 0.0, 3.0e5 };
+	double FarLat[3], FarLon[3], FarAlt[3];
+	WaveGPXGeo_ECEFToLLA( FarX, FarY, FarZ, FarLat, FarLon, FarAlt, 3 );
+	for ( int i = 0; i < 3; i++ ) {
+		double X, Y, Z;
+		WaveGPXGeo_LLAToECEF( FarLat[i], FarLon[i], FarAlt[i], X, Y, Z );
+		REQUIRE( fabs( X - FarX[i] ) < 1e-3 );
+		REQUIRE( fabs( Y - FarY[i] ) < 1e-3 );
+		REQUIRE( fabs( Z - FarZ[i] ) < 1e-3 );
+	}
+}
+
+TEST_CASE( "Route Cursor", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	WRS.LoadOptions.BuildSpline = true;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.BuildGradeProfile = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	FWaveGPXRoute NoProfile = Route;
+	NoProfile.GradeProfile = FWaveGPXGradeProfile();
+
+	// Riding forward, stopping, rolling back a little and jumping about all match the stateless lookups.
+	std::vector< float > Dists;
+	for ( float Dist = -5.0f; Dist < Route.Stat_Length + 5.0f; Dist += 3.3f ) {
+		Dists.push_back( Dist );
+	}
+	for ( float Dist = 500.0f; Dist > 400.0f; Dist -= 0.7f ) {
+		Dists.push_back( Dist );
+	}
+	Dists.push_back( Route.Stat_Length * 0.8f );
+	Dists.push_back( 10.0f );
+	Dists.push_back( Route.Stat_Length * 0.3f );
+
+	for ( auto* R : { &Route, &NoProfile } ) {
+		WaveRouteCursor Cursor( *R, 5.0f );
+		for ( auto Dist : Dists ) {
+			Cursor.SetDist( Dist );
+			REQUIRE( Cursor.GetPointIndex() == WaveRouteUtil_FindPointAtDist( *R, Dist ) );
+			auto Expected = WaveRouteUtil_FindENUPosAtDist( *R, Dist );
+			REQUIRE( Cursor.GetPosition().East == Expected.East );
+			REQUIRE( Cursor.GetPosition().North == Expected.North );
+			REQUIRE( Cursor.GetAlt() == Expected.Alt );
+			REQUIRE( Cursor.GetGrade() == WaveRouteUtil_FindGradePosAtDist( *R, Dist, 5.0f ) );
+			REQUIRE( Cursor.GetHeading() >= 0.0f );
+			REQUIRE( Cursor.GetHeading() < 360.0f );
+		}
+	}
+
+	// Heading follows the direction of travel.
+	FWaveGPXRoute Square;
+	double Corners[][2] = { { 0, 0 }, { 0, 100 }, { 100, 100 }, { 100, 0 } };
+	for ( int i = 0; i < 4; i++ ) {
+		FWaveGPXPoint Point;
+		Point.East = Corners[i][0];
+		Point.North = Corners[i][1];
+		Point.Dist = i * 100.0;
+		Square.Points.push_back( Point );
+	}
+	// No Lat / Lon here, so grade and heading have to come from the profile's ENU.
+	WaveRouteUtil_BuildGradeProfile( Square, Square.GradeProfile );
+	WaveRouteCursor SquareCursor( Square );
+	SquareCursor.SetDist( 50.0f );
+	REQUIRE( fabs( SquareCursor.GetHeading() - 0.0f ) < 0.01f );
+	SquareCursor.SetDist( 150.0f );
+	REQUIRE( fabs( SquareCursor.GetHeading() - 90.0f ) < 0.01f );
+	SquareCursor.SetDist( 250.0f );
+	REQUIRE( fabs( SquareCursor.GetHeading() - 180.0f ) < 0.01f );
+}
+
+TEST_CASE( "Route Sample", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.BuildGradeProfile = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	FWaveGPXRoute NoProfile = Route;
+	NoProfile.GradeProfile = FWaveGPXGradeProfile();
+
+	// Sorted, more than one block's worth, then out of order.
+	std::vector< float > Dists;
+	for ( float Dist = -5.0f; Dist < Route.Stat_Length + 5.0f; Dist += 1.3f ) {
+		Dists.push_back( Dist );
+	}
+	Dists.push_back( Route.Stat_Length * 0.5f );
+	Dists.push_back( 3.0f );
+	Dists.push_back( Route.Stat_Length * 0.9f );
+
+	size_t NumDists = Dists.size();
+	std::vector< double > Alt( NumDists ), East( NumDists ), North( NumDists );
+	std::vector< float > Grade( NumDists );
+	for ( auto* R : { &Route, &NoProfile } ) {
+		WaveRouteUtil_SampleRoute( *R, Dists.data(), NumDists, Alt.data(), Grade.data(), East.data(), North.data(), 5.0f );
+		for ( size_t n = 0; n < NumDists; n++ ) {
+			auto Expected = WaveRouteUtil_FindENUPosAtDist( *R, Dists[n] );
+			REQUIRE( Alt[n] == Expected.Alt );
+			REQUIRE( fabs( East[n] - Expected.East ) < 0.001 );
+			REQUIRE( fabs( North[n] - Expected.North ) < 0.001 );
+			// Same as the profile's grade whether or not the route has one.
+			REQUIRE( Grade[n] == WaveRouteUtil_FindGradePosAtDist( Route, Dists[n], 5.0f ) );
+		}
+	}
+
+	// Outputs are optional.
+	std::vector< float > GradeOnly( NumDists );
+	WaveRouteUtil_SampleRoute( Route, Dists.data(), NumDists, nullptr, GradeOnly.data(), nullptr, nullptr, 5.0f );
+	REQUIRE( GradeOnly == Grade );
+}
+
+TEST_CASE( "Route LOD Pyramid", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.BuildLODPyramid = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	auto& Pyramid = Route.LODPyramid;
+	REQUIRE( Pyramid.NumPoints == Route.Points.size() );
+	REQUIRE( Pyramid.Levels.back().size() == 1 );
+	for ( size_t i = 1; i < Pyramid.Levels.size(); i++ ) {
+		REQUIRE( Pyramid.Levels[i].size() == ( Pyramid.Levels[ i - 1 ].size() + 1 ) / 2 );
+	}
+
+	// Lowest, highest and average altitude between two distances, straight from the points.
+	auto AltRange = [&]( double Lo, double Hi, float& MinAlt, float& MaxAlt, double& AvgAlt )
+	{
+		auto AltAt = [&]( double Dist )
+		{
+			int Index = WaveRouteUtil_FindPointAtDist( Route, ( float ) Dist );
+			if ( Index < 0 || Index + 1 >= ( int ) Route.Points.size() ) {
+				return Route.Points[ std::clamp( Index, 0, ( int ) Route.Points.size() - 1 ) ].Alt;
+			}
+			auto& A = Route.Points[ Index ];
+			auto& B = Route.Points[ Index + 1 ];
+			return A.Alt + ( B.Alt - A.Alt ) * std::clamp( ( Dist - A.Dist ) / std::max( B.Dist - A.Dist, 0.01 ), 0.0, 1.0 );
+		};
+		Lo = std::clamp( Lo, 0.0, Route.Points.back().Dist );
+		Hi = std::clamp( Hi, Lo, Route.Points.back().Dist );
+		double PrevDist = Lo, PrevAlt = AltAt( Lo ), Area = 0.0;
+		MinAlt = MaxAlt = ( float ) PrevAlt;
+		for ( auto& Point : Route.Points ) {
+			if ( Point.Dist > Lo && Point.Dist < Hi ) {
+				Area += ( Point.Alt + PrevAlt ) * 0.5 * ( Point.Dist - PrevDist );
+				MinAlt = std::min( MinAlt, ( float ) Point.Alt );
+				MaxAlt = std::max( MaxAlt, ( float ) Point.Alt );
+				PrevDist = Point.Dist;
+				PrevAlt = Point.Alt;
+			}
+		}
+		double EndAlt = AltAt( Hi );
+		Area += ( EndAlt + PrevAlt ) * 0.5 * ( Hi - PrevDist );
+		MinAlt = std::min( MinAlt, ( float ) EndAlt );
+		MaxAlt = std::max( MaxAlt, ( float ) EndAlt );
+		AvgAlt = Hi > Lo ? Area / ( Hi - Lo ) : EndAlt;
+	};
+
+	// The top bucket is the whole route.
+	float MinAlt, MaxAlt;
+	double AvgAlt;
+	AltRange( 0.0, Route.Points.back().Dist, MinAlt, MaxAlt, AvgAlt );
+	auto& Top = Pyramid.Levels.back()[0];
+	REQUIRE( fabs( Top.MinAlt - MinAlt ) < 0.01f );
+	REQUIRE( fabs( Top.MaxAlt - MaxAlt ) < 0.01f );
+	REQUIRE( fabs( Top.AvgAlt - AvgAlt ) < 0.01 );
+	REQUIRE( ( Top.MinGrade <= Top.AvgGrade && Top.AvgGrade <= Top.MaxGrade ) );
+
+	// Whole route, zoomed in on a stretch, zoomed in past the finest buckets, and off both ends.
+	float Length = Route.Stat_Length;
+	float Views[][2] = { { 0.0f, Length }, { Length * 0.3f, Length * 0.45f }, { 100.0f, 130.0f }, { -200.0f, Length + 200.0f } };
+	for ( auto& View : Views ) {
+		for ( size_t NumPixels : { 1, 7, 80, 1000 } ) {
+			std::vector< FWaveGPXLODBucket > Pixels( NumPixels );
+			WaveRouteUtil_GetLODView( Route, View[0], View[1], Pixels.data(), NumPixels );
+			double PixelSize = ( ( double ) View[1] - View[0] ) / NumPixels;
+			double Slack = std::max( PixelSize, Pyramid.BucketSize );
+			for ( size_t i = 0; i < NumPixels; i++ ) {
+				double Lo = View[0] + i * PixelSize, Hi = Lo + PixelSize;
+				float NearMin, NearMax;
+				double NearAvg;
+				AltRange( Lo, Hi, MinAlt, MaxAlt, AvgAlt );
+				// Pixels off the end of the route take the bucket at that end.
+				AltRange( std::min( Lo, Route.Points.back().Dist ) - Slack, std::max( Hi, 0.0 ) + Slack, NearMin, NearMax, NearAvg );
+				// Takes in the whole pixel, and no more than a bucket past it.
+				REQUIRE( Pixels[i].MinAlt <= MinAlt + 0.01f );
+				REQUIRE( Pixels[i].MaxAlt >= MaxAlt - 0.01f );
+				REQUIRE( Pixels[i].MinAlt >= NearMin - 0.01f );
+				REQUIRE( Pixels[i].MaxAlt <= NearMax + 0.01f );
+				REQUIRE( ( Pixels[i].AvgAlt >= NearMin - 0.01f && Pixels[i].AvgAlt <= NearMax + 0.01f ) );
+				REQUIRE( ( Pixels[i].MinGrade <= Pixels[i].AvgGrade && Pixels[i].AvgGrade <= Pixels[i].MaxGrade ) );
+			}
+		}
+	}
+
+	// The route version builds its own pyramid if it has to.
+	FWaveGPXRoute NoPyramid = Route;
+	NoPyramid.LODPyramid = FWaveGPXLODPyramid();
+	FWaveGPXLODBucket WithPyramid[80], WithoutPyramid[80];
+	WaveRouteUtil_GetLODView( Route, 0.0f, Length, WithPyramid, 80 );
+	WaveRouteUtil_GetLODView( NoPyramid, 0.0f, Length, WithoutPyramid, 80 );
+	REQUIRE( memcmp( WithPyramid, WithoutPyramid, sizeof( WithPyramid ) ) == 0 );
+}
+
+TEST_CASE( "Route Spline", "[WaveGPX]" )
+{
+	WaveGPX WRS;
+	FWaveGPXRoute Route;
+	WRS.LoadOptions.BuildSpline = true;
+	REQUIRE( WRS.LoadRouteGPX( Route, "TestFiles/MachsChowMein.gpx" ) );
+	auto& Points = Route.Points;
+	REQUIRE( Route.Spline.NumPoints == Points.size() );
+	REQUIRE( Route.Spline.Segments.size() == Points.size() - 1 );
+
+	for ( size_t i = 0; i + 1 < Points.size(); i++ ) {
+		// Through every point.
+		auto AtPoint = WaveRouteUtil_EvalSpline( Route, ( int ) i, ( float ) Points[i].Dist );
+		REQUIRE( fabs( AtPoint.Position.East - Points[i].East ) < 1e-3 );
+		REQUIRE( fabs( AtPoint.Position.North - Points[i].North ) < 1e-3 );
+		REQUIRE( fabs( AtPoint.Position.Up - Points[i].Up ) < 1e-3 );
+		REQUIRE( fabs( AtPoint.Position.Alt - Points[i].Alt ) < 1e-3 );
+
+		// Altitude stays between the points either side.
+		double LowAlt = std::min( Points[i].Alt, Points[ i + 1 ].Alt ), HighAlt = std::max( Points[i].Alt, Points[ i + 1 ].Alt );
+		for ( double Frac : { 0.2, 0.5, 0.8 } ) {
+			float Dist = ( float ) ( Points[i].Dist + ( Points[ i + 1 ].Dist - Points[i].Dist ) * Frac );
+			auto Sample = WaveRouteUtil_EvalSpline( Route, ( int ) i, Dist );
+			REQUIRE( ( Sample.Position.Alt >= LowAlt - 1e-3 && Sample.Position.Alt <= HighAlt + 1e-3 ) );
+			if ( Points[ i + 1 ].Dist - Points[i].Dist > 0.01 ) {
+				REQUIRE( fabs( Sample.TangentEast * Sample.TangentEast + Sample.TangentNorth * Sample.TangentNorth + Sample.TangentUp * Sample.TangentUp - 1.0 ) < 1e-6 );
+			}
+		}
+
+		// No kink going from one segment to the next.
+		if ( i > 0 && Points[i].Dist - Points[ i - 1 ].Dist > 0.5 && Points[ i + 1 ].Dist - Points[i].Dist > 0.5 ) {
+			auto EndOfLast = WaveRouteUtil_EvalSpline( Route, ( int ) i - 1, ( float ) Points[i].Dist );
+			REQUIRE( fabs( EndOfLast.TangentEast - AtPoint.TangentEast ) < 1e-3 );
+			REQUIRE( fabs( EndOfLast.TangentNorth - AtPoint.TangentNorth ) < 1e-3 );
+			REQUIRE( fabs( EndOfLast.TangentUp - AtPoint.TangentUp ) < 1e-3 );
+			REQUIRE( fabs( EndOfLast.Grade - AtPoint.Grade ) < 0.05f );
+		}
+	}
+
+	// Fitting segments on the spot gives the same, and so does the cursor, clamped off both ends.
+	FWaveGPXRoute NoSpline = Route;
+	NoSpline.Spline = FWaveGPXSpline();
+	WaveRouteCursor Cursor( Route );
+	auto SameSample = []( const FWaveGPXSplineSample& A, const FWaveGPXSplineSample& B )
+	{
+		return A.Position.East == B.Position.East && A.Position.North == B.Position.North && A.Position.Up == B.Position.Up &&
+			A.Position.Alt == B.Position.Alt && A.Position.Dist == B.Position.Dist && A.TangentEast == B.TangentEast &&
+			A.TangentNorth == B.TangentNorth && A.TangentUp == B.TangentUp && A.Curvature == B.Curvature &&
+			A.Grade == B.Grade && A.Heading == B.Heading;
+	};
+	for ( float Dist = -10.0f; Dist < Route.Stat_Length + 10.0f; Dist += 3.7f ) {
+		auto Sample = WaveRouteUtil_FindSplinePosAtDist( Route, Dist );
+		auto Fitted = WaveRouteUtil_FindSplinePosAtDist( NoSpline, Dist );
+		Cursor.SetDist( Dist );
+		auto& FromCursor = Cursor.GetSplineSample();
+		REQUIRE( SameSample( Sample, Fitted ) );
+		REQUIRE( SameSample( Sample, FromCursor ) );
+	}
+
+	// A 5% climb round a 100m circle, anticlockwise.
+	FWaveGPXRoute Circle;
+	for ( int i = 0; i <= 90; i++ ) {
+		FWaveGPXPoint Point;
+		double Angle = i * 2.0 * M_PI / 180.0;
+		Point.East = 100.0 * cos( Angle );
+		Point.North = 100.0 * sin( Angle );
+		Point.Alt = Point.Up = 100.0 * Angle * 0.05;
+		if ( i > 0 ) {
+			auto& Prev = Circle.Points.back();
+			Point.Dist = Prev.Dist + sqrt( pow( Point.East - Prev.East, 2 ) + pow( Point.North - Prev.North, 2 ) + pow( Point.Up - Prev.Up, 2 ) );
+		}
+		Circle.Points.push_back( Point );
+	}
+	WaveRouteUtil_BuildSpline( Circle, Circle.Spline );
+	for ( float Dist = 20.0f; Dist < Circle.Points.back().Dist - 20.0f; Dist += 1.3f ) {
+		auto Sample = WaveRouteUtil_FindSplinePosAtDist( Circle, Dist );
+		REQUIRE( fabs( sqrt( Sample.Position.East * Sample.Position.East + Sample.Position.North * Sample.Position.North ) - 100.0 ) < 0.01 );
+		REQUIRE( fabs( Sample.Curvature - 0.01f ) < 0.0002f );
+		REQUIRE( fabs( Sample.Grade - 5.0f ) < 0.01f );
+		// Heading is 90 degrees on from the angle round the circle.
+		double Angle = atan2( Sample.Position.North, Sample.Position.East ) * 180.0 / M_PI;
+		REQUIRE( fabs( remainder( Sample.Heading - ( 90.0 - ( Angle + 90.0 ) ), 360.0 ) ) < 0.1 );
+	}
 }
 
 TEST_CASE( "Route Find Point At Dist", "[WaveGPX]" )
@@ -117,6 +923,418 @@ TEST_CASE( "Gradient Simulation 2", "[WaveSim]" )
 	}
 }
 
+TEST_CASE( "Synthetic Backend Fleet", "[WaveControl]" )
+{
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+	Options.SyntheticFleet.NumHR = 16;
+	Options.SyntheticFleet.NumCSC = 16;
+	Options.SyntheticFleet.NumPower = 16;
+	Options.SyntheticFleet.NumTrainer = 16;
+	Options.SyntheticFleet.NotifyRateHz = 50.0f;
+
+	WaveControl W( Options );
+	W.ScanStart();
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+	auto Peripherals = W.ListPeripherals();
+	REQUIRE( Peripherals.size() == 64 );
+
+	std::string HRAddress, PowerAddress;
+	for ( auto& P : Peripherals ) {
+		if ( !HRAddress.size() && P.first.find( "HR" ) != std::string::npos ) HRAddress = P.second;
+		if ( !PowerAddress.size() && P.first.find( "Power" ) != std::string::npos ) PowerAddress = P.second;
+	}
+	W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_HR, HRAddress );
+	W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_POWER, PowerAddress );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+
+	auto ReadState = W.GetSensorReadState();
+	REQUIRE( ReadState->HR_BPM > 0 );
+	REQUIRE( ReadState->Power > 0.0f );
+
+	auto Snapshot = W.GetSensorSnapshot();
+	REQUIRE( Snapshot.Version == W.GetSensorSnapshotVersion() );
+	REQUIRE( Snapshot.State.HR_BPM > 0 );
+	REQUIRE( Snapshot.HR_TimeNS > 0 );
+	REQUIRE( Snapshot.Power_TimeNS > 0 );
+	REQUIRE( Snapshot.Cadence_TimeNS == 0 );
+
+	WaveSensorSample Samples[ WAVECONTROL_SENSOR_SAMPLE_HISTORY ];
+	int NumHRSamples = W.DrainSensorSamples( WAVECONTROL_SENSORMETRIC_HR, 0, Samples, WAVECONTROL_SENSOR_SAMPLE_HISTORY );
+	REQUIRE( NumHRSamples > 1 );
+	REQUIRE( Samples[ NumHRSamples - 1 ].TimeNS <= Snapshot.ReadTimeNS );
+	REQUIRE( W.DrainSensorSamples( WAVECONTROL_SENSORMETRIC_CADENCE, 0, Samples, WAVECONTROL_SENSOR_SAMPLE_HISTORY ) == 0 );
+
+	auto Stats = W.GetStats();
+	REQUIRE( Stats.WorkerTicks > 0 );
+	REQUIRE( Stats.Backend.NumPeripherals == 64 );
+	REQUIRE( Stats.Backend.NumSubscriptions == 2 );
+	REQUIRE( Stats.Backend.NotificationsSent > 0 );
+}
+
+TEST_CASE( "Worker Wakes On Demand", "[WaveControl]" )
+{
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+
+	WaveControl W( Options );
+
+	// Nothing chosen, nothing queued: the worker should be asleep.
+	auto IdleTicks = W.GetStats().WorkerTicks;
+	std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) );
+	REQUIRE( W.GetStats().WorkerTicks - IdleTicks <= 1 );
+
+	// Commands should be picked up immediately rather than on the next housekeeping tick.
+	auto StartTime = std::chrono::steady_clock::now();
+	W.ScanStart();
+	while ( !W.ListPeripherals().size() && std::chrono::steady_clock::now() - StartTime < std::chrono::seconds( 1 ) ) {
+		std::this_thread::yield();
+	}
+	REQUIRE( W.ListPeripherals().size() > 0 );
+	REQUIRE( std::chrono::steady_clock::now() - StartTime < std::chrono::milliseconds( WAVECONTROL_WORKER_HOUSEKEEPING_MS / 2 ) );
+}
+
+TEST_CASE( "Command Queue Multiple Producers", "[WaveControl]" )
+{
+	const int NumProducers = 4;
+	const int NumCommands = 20000;
+
+	WaveCommandQueue Queue;
+	std::vector< int > LastSeen( NumProducers, -1 );
+	std::atomic< int > NumProducersDone = 0;
+	bool InOrder = true;
+	int NumRun = 0;
+
+	std::vector< std::thread > Producers;
+	for ( int p = 0; p < NumProducers; p++ ) {
+		Producers.emplace_back( [&, p]()
+		{
+			for ( int i = 0; i < NumCommands; i++ ) {
+				Queue.Push( [&, p, i]()
+				{
+					InOrder &= ( LastSeen[p] == i - 1 );
+					LastSeen[p] = i;
+					NumRun++;
+				} );
+			}
+			NumProducersDone++;
+		} );
+	}
+
+	while ( NumProducersDone < NumProducers ) {
+		Queue.Drain();
+	}
+	Queue.Drain();
+	for ( auto& Producer : Producers ) {
+		Producer.join();
+	}
+
+	REQUIRE( InOrder );
+	REQUIRE( NumRun == NumProducers * NumCommands );
+
+	// Overflow past the ring without a consumer, and check nothing is lost or reordered.
+	std::vector< int > Order;
+	for ( int i = 0; i < WAVECONTROL_COMMAND_QUEUE_SIZE * 2; i++ ) {
+		Queue.Push( [&Order, i]() { Order.push_back( i ); } );
+	}
+	REQUIRE( Queue.GetNumOverflowed() > 0 );
+	Queue.Drain();
+	REQUIRE( Order.size() == WAVECONTROL_COMMAND_QUEUE_SIZE * 2 );
+	REQUIRE( std::is_sorted( Order.begin(), Order.end() ) );
+}
+
+TEST_CASE( "Sensor Snapshot Is Tear Free", "[WaveControl]" )
+{
+	WaveCycleSensorSnapshotBuffer Buffer;
+	std::atomic< bool > WriterDone = false;
+
+	// Every published state has all fields equal, so a torn read shows up as a mismatch.
+	std::thread Writer( [&]()
+	{
+		WaveCycleSensorReadState State;
+		for ( int i = 1; i <= 200000; i++ ) {
+			State.HR_BPM = i;
+			State.Speed = State.Cadence = State.Power = ( float ) i;
+			Buffer.Publish( WAVECONTROL_SENSORFIELD_HR | WAVECONTROL_SENSORFIELD_SPEED | WAVECONTROL_SENSORFIELD_CADENCE | WAVECONTROL_SENSORFIELD_POWER, State, i );
+		}
+		WriterDone = true;
+	} );
+
+	bool Consistent = true;
+	bool Monotonic = true;
+	uint64_t LastVersion = 0;
+	while ( !WriterDone ) {
+		auto Snapshot = Buffer.Read();
+		Consistent &= ( Snapshot.State.Speed == Snapshot.State.HR_BPM || Snapshot.Version == 0 );
+		Consistent &= ( Snapshot.State.Power == Snapshot.State.HR_BPM || Snapshot.Version == 0 );
+		Consistent &= ( Snapshot.Version == ( uint64_t ) std::max( Snapshot.State.HR_BPM, 0 ) );
+		Monotonic &= ( Snapshot.Version >= LastVersion );
+		LastVersion = Snapshot.Version;
+	}
+	Writer.join();
+
+	REQUIRE( Consistent );
+	REQUIRE( Monotonic );
+	REQUIRE( Buffer.GetVersion() == 200000 );
+	REQUIRE( Buffer.Read().State.HR_BPM == 200000 );
+}
+
+TEST_CASE( "Sensor Sample History", "[WaveControl]" )
+{
+	WaveCycleSensorHistory History;
+	WaveCycleSensorReadState State;
+	const int NumPushed = WAVECONTROL_SENSOR_SAMPLE_HISTORY + 500;
+	for ( int i = 1; i <= NumPushed; i++ ) {
+		State.Power = ( float ) i;
+		History.Push( WAVECONTROL_SENSORFIELD_POWER, State, i * 1000 );
+	}
+
+	// Oldest samples have been overwritten, we get the newest full ring back in order.
+	std::vector< WaveSensorSample > Samples( WAVECONTROL_SENSOR_SAMPLE_HISTORY * 2 );
+	int NumSamples = History.Drain( WAVECONTROL_SENSORMETRIC_POWER, 0, Samples.data(), ( int ) Samples.size() );
+	REQUIRE( NumSamples == WAVECONTROL_SENSOR_SAMPLE_HISTORY );
+	REQUIRE( Samples[0].Version == NumPushed - WAVECONTROL_SENSOR_SAMPLE_HISTORY + 1 );
+	REQUIRE( Samples[ NumSamples - 1 ].Version == NumPushed );
+	REQUIRE( Samples[ NumSamples - 1 ].Value == ( float ) NumPushed );
+	REQUIRE( Samples[ NumSamples - 1 ].TimeNS == NumPushed * 1000 );
+
+	// Continuing from a version only returns what's newer, and respects MaxSamples.
+	REQUIRE( History.Drain( WAVECONTROL_SENSORMETRIC_POWER, NumPushed - 10, Samples.data(), 4 ) == 4 );
+	REQUIRE( Samples[0].Version == NumPushed - 9 );
+	REQUIRE( History.Drain( WAVECONTROL_SENSORMETRIC_POWER, NumPushed, Samples.data(), ( int ) Samples.size() ) == 0 );
+	REQUIRE( History.Drain( WAVECONTROL_SENSORMETRIC_HR, 0, Samples.data(), ( int ) Samples.size() ) == 0 );
+}
+
+TEST_CASE( "Measurement Decoding", "[WaveControl]" )
+{
+	// uint16 BPM, contact supported + detected, energy, two RR intervals.
+	const char HRBytes[] = { 0x1f, ( char ) 0xb4, 0x00, 0x10, 0x02, 0x00, 0x04, 0x20, 0x03 };
+	WaveHRMeasurement HR;
+	REQUIRE( WaveDecode_HRMeasurement( std::string_view( HRBytes, sizeof( HRBytes ) ), HR ) );
+	REQUIRE( HR.BPM == 180 );
+	REQUIRE( HR.ContactDetected );
+	REQUIRE( HR.EnergyExpended == 0x210 );
+	REQUIRE( HR.NumRRIntervals == 2 );
+	REQUIRE( HR.RRIntervals[1] == 0x320 );
+
+	// uint8 BPM above 127 must not come out negative.
+	const char HR8Bytes[] = { 0x00, ( char ) 0xc8 };
+	REQUIRE( WaveDecode_HRMeasurement( std::string_view( HR8Bytes, sizeof( HR8Bytes ) ), HR ) );
+	REQUIRE( HR.BPM == 200 );
+	REQUIRE( !HR.ContactSupported );
+
+	// Truncated packets are rejected, however short.
+	for ( size_t Size = 0; Size < 3; Size++ ) {
+		REQUIRE( !WaveDecode_HRMeasurement( std::string_view( HRBytes, Size ), HR ) );
+	}
+	const char CSCBytes[] = { 0x03, 0x10, 0x00, 0x00, 0x00, 0x00, 0x04, 0x05, 0x00, 0x00, 0x08 };
+	WaveCSCMeasurement CSC;
+	REQUIRE( WaveDecode_CSCMeasurement( std::string_view( CSCBytes, sizeof( CSCBytes ) ), CSC ) );
+	REQUIRE( CSC.WheelRevs == 16 );
+	REQUIRE( CSC.LastWheelTime == 1024 );
+	REQUIRE( CSC.CrankRevs == 5 );
+	REQUIRE( CSC.LastCrankTime == 2048 );
+	for ( size_t Size = 0; Size < sizeof( CSCBytes ); Size++ ) {
+		REQUIRE( !WaveDecode_CSCMeasurement( std::string_view( CSCBytes, Size ), CSC ) );
+	}
+
+	// Power is signed, and optional fields are skipped by their flags.
+	const char PowerBytes[] = { 0x21, 0x00, ( char ) 0xf6, ( char ) 0xff, 0x64, 0x0a, 0x00, 0x00, 0x04 };
+	WavePowerMeasurement Power;
+	REQUIRE( WaveDecode_PowerMeasurement( std::string_view( PowerBytes, sizeof( PowerBytes ) ), Power ) );
+	REQUIRE( Power.Power == -10 );
+	REQUIRE( Power.PedalBalance == 100 );
+	REQUIRE( Power.CrankRevs == 10 );
+	REQUIRE( Power.LastCrankTime == 1024 );
+	REQUIRE( !WaveDecode_PowerMeasurement( std::string_view( PowerBytes, sizeof( PowerBytes ) - 1 ), Power ) );
+
+	// A device fed a truncated packet keeps its last good reading.
+	WavePeripheralTable PeripheralTable;
+	WavePowerSensor PowerSensor( &PeripheralTable );
+	PowerSensor.ReadState = std::make_shared< WaveCycleSensorReadState >();
+	PowerSensor.ParseMeasurement( std::string_view( PowerBytes, sizeof( PowerBytes ) ) );
+	PowerSensor.ParseMeasurement( std::string_view( PowerBytes, 3 ) );
+	REQUIRE( PowerSensor.ReadState->Power == -10.0f );
+}
+
+TEST_CASE( "FTMS Trainer ERG", "[WaveControl]" )
+{
+	// Flags: speed ( More Data clear ), cadence, total distance ( skipped ), power, heart rate.
+	const char IBDBytes[] = { 0x54, 0x02, ( char ) 0xb8, 0x0b, ( char ) 0xb4, 0x00, 0x01, 0x02, 0x03, ( char ) 0xfa, 0x00, ( char ) 0x96 };
+	WaveIndoorBikeData BikeData;
+	REQUIRE( WaveDecode_IndoorBikeData( std::string_view( IBDBytes, sizeof( IBDBytes ) ), BikeData ) );
+	REQUIRE( BikeData.Speed == 3000 );
+	REQUIRE( BikeData.Cadence == 180 );
+	REQUIRE( BikeData.Power == 250 );
+	REQUIRE( BikeData.HeartRate == 150 );
+	REQUIRE( !WaveDecode_IndoorBikeData( std::string_view( IBDBytes, sizeof( IBDBytes ) - 1 ), BikeData ) );
+
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+	Options.SyntheticFleet.NumHR = 0;
+	Options.SyntheticFleet.NumCSC = 0;
+	Options.SyntheticFleet.NumPower = 0;
+	Options.SyntheticFleet.NumTrainer = 0;
+	Options.SyntheticFleet.NumFTMSTrainer = 1;
+	Options.SyntheticFleet.NotifyRateHz = 50.0f;
+
+	WaveControl W( Options );
+	W.ScanStart();
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	auto Peripherals = W.ListPeripherals();
+	REQUIRE( Peripherals.size() == 1 );
+	W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_TRAINER, Peripherals[0].second );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 1000 ) );
+
+	// With no power meter chosen, the trainer's Indoor Bike Data fills in.
+	REQUIRE( W.GetSensorSnapshot().Power_TimeNS > 0 );
+	REQUIRE( W.GetSensorReadState()->Cadence > 0.0f );
+
+	// Control was requested and granted before anything else went out: request control, start, simulation parameters.
+	auto CommandsBefore = W.GetStats().Backend.CommandsReceived;
+	REQUIRE( CommandsBefore == 3 );
+
+	WaveCycleSensorWriteState WriteState;
+	WriteState.TargetPower = 250.0f;
+	W.SetSensorWriteState( WriteState );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 600 ) );
+	REQUIRE( W.GetStats().Backend.CommandsReceived == CommandsBefore + 1 );
+	REQUIRE( W.GetSensorReadState()->Power >= 240.0f );
+	REQUIRE( W.GetSensorReadState()->Power <= 260.0f );
+
+	// In ERG the grade doesn't matter to the trainer, so it doesn't go out.
+	WriteState.Gradient = 5.0f;
+	W.SetSensorWriteState( WriteState );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) );
+	REQUIRE( W.GetStats().Backend.CommandsReceived == CommandsBefore + 1 );
+
+	// Leaving ERG puts the simulation back with one Set Indoor Bike Simulation Parameters.
+	WriteState.TargetPower = 0.0f;
+	W.SetSensorWriteState( WriteState );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 600 ) );
+	REQUIRE( W.GetStats().Backend.CommandsReceived == CommandsBefore + 2 );
+	REQUIRE( W.GetStats().TrainerCommands.Acked == CommandsBefore + 2 );
+}
+
+TEST_CASE( "Trainer Command Scheduler", "[WaveControl]" )
+{
+	WaveTrainerCommandScheduler Scheduler;
+	WavePeripheral Peripheral; // No backend; writes go nowhere.
+	Scheduler.SetMinIntervalMS( 0 );
+
+	// Last value wins per type.
+	Scheduler.Submit( WAVECONTROL_TRAINERCOMMAND_GRADE, "s", "c", false, std::string( { 0x46, 0x01 } ) );
+	Scheduler.Submit( WAVECONTROL_TRAINERCOMMAND_GRADE, "s", "c", false, std::string( { 0x46, 0x02 } ) );
+	Scheduler.Submit( WAVECONTROL_TRAINERCOMMAND_TARGET_POWER, "s", "c", false, std::string( { 0x42, 0x01 } ) );
+	REQUIRE( Scheduler.Counters->Merged == 1 );
+
+	// One in flight at a time; acks for anything else are ignored.
+	Scheduler.Pump( Peripheral );
+	Scheduler.Pump( Peripheral );
+	REQUIRE( Scheduler.Counters->Sent == 1 );
+	Scheduler.OnAck( 0x42, true );
+	REQUIRE( Scheduler.Counters->Acked == 0 );
+	Scheduler.OnAck( 0x46, true );
+	REQUIRE( Scheduler.Counters->Acked == 1 );
+	REQUIRE( Scheduler.Counters->LatencyMaxNS > 0 );
+
+	Scheduler.Pump( Peripheral );
+	REQUIRE( Scheduler.Counters->Sent == 2 );
+	Scheduler.OnAck( 0x42, false );
+	REQUIRE( Scheduler.Counters->Failed == 1 );
+	REQUIRE( Scheduler.IsIdle() );
+
+	// The minimum interval holds back the next write even once the last one is acked.
+	Scheduler.SetMinIntervalMS( 10000 );
+	Scheduler.Submit( WAVECONTROL_TRAINERCOMMAND_GRADE, "s", "c", false, std::string( { 0x46, 0x03 } ) );
+	Scheduler.Pump( Peripheral );
+	REQUIRE( Scheduler.Counters->Sent == 2 );
+
+	// Losing the link drops what hasn't gone out.
+	Scheduler.Reset();
+	REQUIRE( Scheduler.Counters->Dropped == 1 );
+	REQUIRE( Scheduler.IsIdle() );
+}
+
+TEST_CASE( "Trainer Gradient Every Frame", "[WaveControl]" )
+{
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+	Options.SyntheticFleet.NumHR = 0;
+	Options.SyntheticFleet.NumCSC = 0;
+	Options.SyntheticFleet.NumPower = 0;
+	Options.SyntheticFleet.NumTrainer = 1;
+
+	WaveControl W( Options );
+	W.ScanStart();
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_TRAINER, W.ListPeripherals()[0].second );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 600 ) );
+
+	// A game setting the gradient at 100 Hz for a second shouldn't turn into 100 writes.
+	WaveCycleSensorWriteState WriteState;
+	for ( int i = 0; i < 100; i++ ) {
+		WriteState.Gradient = i * 0.1f;
+		W.SetSensorWriteState( WriteState );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( 600 ) );
+
+	auto Stats = W.GetStats();
+	REQUIRE( Stats.Backend.CommandsReceived <= 1000 / WAVECONTROL_TRAINERCOMMAND_MIN_INTERVAL_MS + 4 );
+	REQUIRE( Stats.TrainerCommands.Sent == Stats.Backend.CommandsReceived );
+	REQUIRE( Stats.TrainerCommands.Acked == Stats.TrainerCommands.Sent );
+	REQUIRE( Stats.TrainerCommands.Merged > 50 );
+	REQUIRE( Stats.TrainerCommands.TimedOut == 0 );
+}
+
+TEST_CASE( "Capture And Replay Backend", "[WaveControl]" )
+{
+	auto CaptureFile = ( std::filesystem::temp_directory_path() / "WaveTest_Capture.wavecap" ).string();
+	std::string HRAddress;
+
+	{
+		WaveBackendOptions Options;
+		Options.BackendType = WAVECONTROL_BACKEND_TYPE_SYNTHETIC;
+		Options.SyntheticFleet.NotifyRateHz = 50.0f;
+		Options.CaptureFile = CaptureFile;
+
+		WaveControl W( Options );
+		W.ScanStart();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+		for ( auto& P : W.ListPeripherals() ) {
+			if ( !HRAddress.size() && P.first.find( "HR" ) != std::string::npos ) HRAddress = P.second;
+		}
+		W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_HR, HRAddress );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+		REQUIRE( W.GetSensorReadState()->HR_BPM > 0 );
+	}
+
+	WaveBackendOptions Options;
+	Options.BackendType = WAVECONTROL_BACKEND_TYPE_REPLAY;
+	Options.ReplayFile = CaptureFile;
+	Options.ReplaySpeed = 0.0f;
+
+	WaveControl W( Options );
+	W.ScanStart();
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+	bool FoundHR = false;
+	for ( auto& P : W.ListPeripherals() ) {
+		FoundHR |= ( P.second == HRAddress );
+	}
+	REQUIRE( FoundHR );
+
+	W.ChooseDeviceForUsage( WAVECONTROL_DEVICE_HR, HRAddress );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 500 ) );
+	REQUIRE( W.GetSensorReadState()->HR_BPM > 0 );
+	REQUIRE( W.GetStats().Backend.NotificationsSent > 0 );
+
+	std::filesystem::remove( CaptureFile );
+}
+
 bool WaveTest( int argc, char * argv[] )
 {
 	Catch::Session().run( argc, argv );